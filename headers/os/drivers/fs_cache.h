@@ -74,6 +74,8 @@ extern void *block_cache_get_empty(void *cache, off_t blockNumber,
 extern const void *block_cache_get_etc(void *cache, off_t blockNumber,
 					off_t base, off_t length);
 extern const void *block_cache_get(void *cache, off_t blockNumber);
+extern status_t block_cache_prefetch(void *cache, off_t blockNumber,
+					size_t numBlocks);
 extern status_t block_cache_set_dirty(void *cache, off_t blockNumber,
 					bool isDirty, int32 transaction);
 extern void block_cache_put(void *cache, off_t blockNumber);
@@ -106,6 +108,7 @@ extern status_t entry_cache_add(dev_t mountID, ino_t dirID, const char* name,
 					ino_t nodeID);
 extern status_t entry_cache_remove(dev_t mountID, ino_t dirID,
 					const char* name);
+extern status_t entry_cache_enable_complete_directories(dev_t mountID);
 
 #ifdef __cplusplus
 }
@@ -848,6 +848,7 @@
 #define block_cache_get_empty			fssh_block_cache_get_empty
 #define block_cache_get_etc				fssh_block_cache_get_etc
 #define block_cache_get					fssh_block_cache_get
+#define block_cache_prefetch			fssh_block_cache_prefetch
 #define block_cache_set_dirty			fssh_block_cache_set_dirty
 #define block_cache_put					fssh_block_cache_put
 
@@ -872,6 +873,7 @@
 /* entry cache */
 #define entry_cache_add					fssh_entry_cache_add
 #define entry_cache_remove				fssh_entry_cache_remove
+#define entry_cache_enable_complete_directories	fssh_entry_cache_enable_complete_directories
 
 ////////////////////////////////////////////////////////////////////////////////
 // #pragma mark - fssh_fs_index.h
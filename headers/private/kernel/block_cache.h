@@ -9,6 +9,41 @@
 #include <SupportDefs.h>
 
 
+#define BLOCK_CACHE_SYSCALLS "block_cache"
+
+#define BLOCK_CACHE_GET_STATS	1
+	// fills in an array of block_cache_stats, and returns the number of
+	// block caches
+#define BLOCK_CACHE_GET_WRITEBACK_POLICY	2
+#define BLOCK_CACHE_SET_WRITEBACK_POLICY	3
+	// both use a block_cache_writeback_policy
+
+struct block_cache_stats {
+	off_t	max_blocks;
+	size_t	block_size;
+	int32	unused_blocks;
+	int32	hot_unused_blocks;
+	int64	hits;
+	int64	misses;
+	int64	ghost_hits;
+	int64	promotions;
+	int64	evictions;
+};
+
+struct block_cache_writeback_policy {
+	bigtime_t	interval;
+		// the time between two writeback passes
+	bigtime_t	dirty_expire;
+		// dirty blocks are only written back when they are older than this;
+		// 0 writes them back regardless of their age
+	uint32		dirty_ratio;
+		// ... unless more than this percentage of a cache's blocks is dirty;
+		// 100 turns this off
+	uint32		blocks_per_pass;
+		// the maximum number of blocks written per cache and pass
+};
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,6 +16,7 @@
 
 #define CACHE_CLEAR			1	// takes no parameters
 #define CACHE_SET_MODULE	2	// gets the module name as parameter
+#define CACHE_GET_READ_AHEAD_STATS	3	// fills in a file_cache_read_ahead_stats
 
 #define CACHE_MODULES_NAME	"file_cache"
 
@@ -23,6 +24,15 @@
 #define FILE_CACHE_LOADED_COMPLETELY 	0x02
 #define FILE_CACHE_NO_IO				0x04
 
+struct file_cache_read_ahead_stats {
+	int64		sequential_hits;
+		// reads that continued where the previous one on that file ended
+	int64		sequential_misses;
+		// reads that broke a sequential stream, and shrunk its window
+	int64		prefetch_requests;
+	int64		prefetched_bytes;
+};
+
 struct cache_module_info {
 	module_info	info;
 
@@ -12,6 +12,9 @@
 #include <Drivers.h>
 
 
+struct vnode;
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,6 +32,8 @@ status_t devfs_publish_device(const char* path, device_hooks* calls);
 status_t devfs_publish_directory(const char* path);
 status_t devfs_rescan_driver(const char* driverName);
 
+bool devfs_is_asynchronous_device(struct vnode* vnode);
+
 void devfs_compute_geometry_size(device_geometry* geometry, uint64 blockCount,
 	uint32 blockSize);
 
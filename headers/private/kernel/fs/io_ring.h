@@ -0,0 +1,29 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_FS_IO_RING_H
+#define _KERNEL_FS_IO_RING_H
+
+
+#include <OS.h>
+
+#include <io_ring_defs.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+extern int		_user_io_ring_create(uint32 entryCount, uint32 threadCount,
+					io_ring_header** _userHeader, area_id* _userArea);
+extern ssize_t	_user_io_ring_enter(int ring, uint32 submitCount,
+					uint32 waitCount, uint32 flags, bigtime_t timeout);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _KERNEL_FS_IO_RING_H
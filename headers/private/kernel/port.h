@@ -45,6 +45,10 @@ status_t deselect_port(int32 object, struct select_info *info, bool kernel);
 status_t writev_port_etc(port_id id, int32 msgCode, const iovec *msgVecs,
 				size_t vecCount, size_t bufferSize, uint32 flags,
 				bigtime_t timeout);
+ssize_t read_port_area_etc(port_id id, int32 *msgCode, area_id *area,
+				void **address, uint32 flags, bigtime_t timeout);
+status_t write_port_area_etc(port_id id, int32 msgCode, area_id area,
+				size_t size, uint32 flags, bigtime_t timeout);
 
 // user syscalls
 port_id		_user_create_port(int32 queueLength, const char *name);
@@ -70,6 +74,11 @@ status_t	_user_writev_port_etc(port_id id, int32 msgCode,
 status_t	_user_get_port_message_info_etc(port_id port,
 				port_message_info *info, size_t infoSize, uint32 flags,
 				bigtime_t timeout);
+ssize_t		_user_read_port_area_etc(port_id port, int32 *msgCode,
+				area_id *area, void **address, uint32 flags,
+				bigtime_t timeout);
+status_t	_user_write_port_area_etc(port_id port, int32 msgCode,
+				area_id area, size_t size, uint32 flags, bigtime_t timeout);
 
 #ifdef __cplusplus
 }
@@ -84,6 +84,7 @@ void smp_send_broadcast_ici(int32 message, addr_t data, addr_t data2, addr_t dat
 		void *data_ptr, uint32 flags);
 void smp_send_broadcast_ici_interrupts_disabled(int32 currentCPU, int32 message,
 		addr_t data, addr_t data2, addr_t data3, void *data_ptr, uint32 flags);
+void smp_wait_for_quiescent_cpus(void);
 
 int32 smp_get_num_cpus(void);
 void smp_set_num_cpus(int32 numCPUs);
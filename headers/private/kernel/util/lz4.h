@@ -0,0 +1,36 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_UTIL_LZ4_H
+#define _KERNEL_UTIL_LZ4_H
+
+
+#include <SupportDefs.h>
+
+
+// Compression into the LZ4 block format. It is optimized for speed rather
+// than for ratio, and only supports inputs of up to LZ4_MAX_INPUT_SIZE bytes.
+
+#define LZ4_MAX_INPUT_SIZE		65536
+#define LZ4_WORKSPACE_SIZE		(4096 * sizeof(uint16))
+
+// the size of the output buffer that is always large enough
+#define LZ4_COMPRESS_BOUND(size)	((size) + (size) / 255 + 16)
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t lz4_compress(const void* source, size_t sourceSize, void* dest,
+	size_t destCapacity, void* workspace);
+ssize_t lz4_decompress(const void* source, size_t sourceSize, void* dest,
+	size_t destSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	/* _KERNEL_UTIL_LZ4_H */
@@ -25,7 +25,7 @@
 
 
 #define DEFAULT_FD_TABLE_SIZE	256
-#define MAX_FD_TABLE_SIZE		8192
+#define MAX_FD_TABLE_SIZE		65536
 #define DEFAULT_NODE_MONITORS	4096
 #define MAX_NODE_MONITORS		65536
 
@@ -105,6 +105,7 @@ status_t	vfs_write_pages(struct vnode *vnode, void *cookie, off_t pos,
 				generic_size_t *_numBytes);
 status_t	vfs_vnode_io(struct vnode* vnode, void* cookie,
 				io_request* request);
+status_t	vfs_fsync_vnode(struct vnode* vnode);
 status_t	vfs_synchronous_io(io_request* request,
 				status_t (*doIO)(void* cookie, off_t offset, void* buffer,
 					size_t* length),
@@ -126,6 +127,7 @@ void		vfs_unlock_vnode_if_locked(struct file_descriptor *descriptor);
 status_t	vfs_unmount(dev_t mountID, uint32 flags);
 status_t	vfs_disconnect_vnode(dev_t mountID, ino_t vnodeID);
 void		vfs_free_unused_vnodes(int32 level);
+void		vfs_entry_directory_changed(dev_t mountID, ino_t directoryID);
 
 status_t	vfs_read_stat(int fd, const char *path, bool traverseLeafLink,
 				struct stat *stat, bool kernel);
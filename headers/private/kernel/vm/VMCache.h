@@ -145,6 +145,8 @@ public:
 	// backing store operations
 	virtual	status_t			Commit(off_t size, int priority);
 	virtual	bool				HasPage(off_t offset);
+	virtual	void				GetReadAheadRange(off_t offset,
+									off_t& _start, off_t& _end);
 
 	virtual	status_t			Read(off_t offset, const generic_io_vec *vecs,
 									size_t count,uint32 flags,
@@ -11,6 +11,7 @@
 #include <lock.h>
 
 
+struct event_queue;
 struct select_sync;
 
 
@@ -26,6 +27,7 @@ typedef struct select_sync {
 	sem_id				sem;
 	uint32				count;
 	struct select_info*	set;
+	struct event_queue*	queue;				// set for event queue entries
 } select_sync;
 
 #define SELECT_FLAG(type) (1L << (type - 1))
@@ -40,6 +42,11 @@ extern void		put_select_sync(select_sync* sync);
 extern status_t	notify_select_events(select_info* info, uint16 events);
 extern void		notify_select_events_list(select_info* list, uint16 events);
 
+extern status_t	select_object(uint32 type, int32 object,
+					struct select_info* info, bool kernel);
+extern status_t	deselect_object(uint32 type, int32 object,
+					struct select_info* info, bool kernel);
+
 extern ssize_t	_user_wait_for_objects(object_wait_info* userInfos,
 					int numInfos, uint32 flags, bigtime_t timeout);
 
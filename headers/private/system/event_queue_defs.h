@@ -0,0 +1,30 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_EVENT_QUEUE_DEFS_H
+#define _SYSTEM_EVENT_QUEUE_DEFS_H
+
+
+#include <OS.h>
+
+
+typedef struct event_wait_info {
+	int32		object;		/* ID of the object */
+	uint16		type;		/* type of the object (B_OBJECT_TYPE_*) */
+	int32		events;		/* events mask and flags, or an error code */
+	void*		user_data;	/* returned with the object's events */
+} event_wait_info;
+
+
+/* event flags passed to _kern_event_queue_select() in addition to the events
+   (B_EVENT_*); objects are level-triggered by default */
+#define B_EVENT_EDGE_TRIGGERED	0x00010000
+	/* the object is reported once for every time an event occurs, not for as
+	   long as its condition holds */
+#define B_EVENT_ONE_SHOT		0x00020000
+	/* the object is disabled after it has been reported once, until it is
+	   selected again */
+
+
+#endif	/* _SYSTEM_EVENT_QUEUE_DEFS_H */
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_IO_RING_DEFS_H
+#define _SYSTEM_IO_RING_DEFS_H
+
+
+#include <OS.h>
+
+
+/* The ring's area starts with this header. The entries follow at the given
+   offsets. Heads and tails are free running indices; an entry is found at
+   (index & (count - 1)). They must be accessed via atomic_get()/atomic_set(),
+   so that the entries they cover are visible. */
+typedef struct io_ring_header {
+	uint32		submission_head;	/* written by the kernel */
+	uint32		submission_tail;	/* written by userland */
+	uint32		submission_count;
+	uint32		submission_offset;
+	uint32		completion_head;	/* written by userland */
+	uint32		completion_tail;	/* written by the kernel */
+	uint32		completion_count;
+	uint32		completion_offset;
+} io_ring_header;
+
+
+typedef struct io_ring_submission {
+	uint16		opcode;				/* IO_RING_* */
+	uint16		flags;				/* reserved, must be 0 */
+	int32		fd;
+	off_t		offset;				/* must not be negative */
+	void*		buffer;				/* iovec array for IO_RING_READV/WRITEV */
+	size_t		length;				/* number of bytes or iovecs */
+	void*		user_data;			/* returned with the completion */
+} io_ring_submission;
+
+
+typedef struct io_ring_completion {
+	void*		user_data;
+	ssize_t		result;				/* bytes transferred or an error code */
+} io_ring_completion;
+
+
+enum {
+	IO_RING_NOP		= 0,
+	IO_RING_READ,
+	IO_RING_WRITE,
+	IO_RING_READV,
+	IO_RING_WRITEV,
+	IO_RING_FSYNC
+};
+
+
+#define IO_RING_MAX_ENTRIES	4096
+#define IO_RING_MAX_THREADS	64
+
+
+#endif	/* _SYSTEM_IO_RING_DEFS_H */
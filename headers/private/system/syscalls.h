@@ -22,9 +22,11 @@ extern "C" {
 
 struct attr_info;
 struct dirent;
+struct event_wait_info;
 struct fd_info;
 struct fd_set;
 struct fs_info;
+struct io_ring_header;
 struct iovec;
 struct msqid_ds;
 struct net_stat;
@@ -73,6 +75,13 @@ extern status_t		_kern_get_safemode_option(const char *parameter,
 extern ssize_t		_kern_wait_for_objects(object_wait_info* infos, int numInfos,
 						uint32 flags, bigtime_t timeout);
 
+extern int			_kern_event_queue_create(int openFlags);
+extern ssize_t		_kern_event_queue_select(int queue,
+						struct event_wait_info* infos, int numInfos);
+extern ssize_t		_kern_event_queue_wait(int queue,
+						struct event_wait_info* infos, int numInfos,
+						uint32 flags, bigtime_t timeout);
+
 /* user mutex functions */
 extern status_t		_kern_mutex_lock(int32* mutex, const char* name,
 						uint32 flags, bigtime_t timeout);
@@ -317,6 +326,10 @@ extern ssize_t		_kern_write(int fd, off_t pos, const void *buffer,
 						size_t bufferSize);
 extern ssize_t		_kern_writev(int fd, off_t pos, const struct iovec *vecs,
 						size_t count);
+extern int			_kern_io_ring_create(uint32 entryCount, uint32 threadCount,
+						struct io_ring_header **_header, area_id *_area);
+extern ssize_t		_kern_io_ring_enter(int ring, uint32 submitCount,
+						uint32 waitCount, uint32 flags, bigtime_t timeout);
 extern status_t		_kern_ioctl(int fd, uint32 cmd, void *data, size_t length);
 extern ssize_t		_kern_read_dir(int fd, struct dirent *buffer,
 						size_t bufferSize, uint32 maxCount);
@@ -466,6 +479,12 @@ extern status_t		_kern_writev_port_etc(port_id id, int32 msgCode,
 extern status_t		_kern_get_port_message_info_etc(port_id port,
 						port_message_info *info, size_t infoSize, uint32 flags,
 						bigtime_t timeout);
+extern ssize_t		_kern_read_port_area_etc(port_id port, int32 *msgCode,
+						area_id *area, void **address, uint32 flags,
+						bigtime_t timeout);
+extern status_t		_kern_write_port_area_etc(port_id port, int32 msgCode,
+						area_id area, size_t size, uint32 flags,
+						bigtime_t timeout);
 
 // debug support functions
 extern status_t		_kern_kernel_debugger(const char *message);
@@ -34,8 +34,12 @@
 #define B_KERNEL_AREA			0x4000
 	// Usable from userland according to its protection flags, but the area
 	// itself is not deletable, resizable, etc from userland.
+#define B_LARGE_PAGES_AREA		0x8000
+	// Back the area with large pages where possible. Only used for
+	// B_FULL_LOCK areas, and only if the architecture supports it.
 
-#define B_USER_AREA_FLAGS		(B_USER_PROTECTION | B_OVERCOMMITTING_AREA)
+#define B_USER_AREA_FLAGS \
+	(B_USER_PROTECTION | B_OVERCOMMITTING_AREA | B_LARGE_PAGES_AREA)
 #define B_KERNEL_AREA_FLAGS \
 	(B_KERNEL_PROTECTION | B_USER_CLONEABLE_AREA | B_SHARED_AREA)
 
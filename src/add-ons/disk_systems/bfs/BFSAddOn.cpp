@@ -323,6 +323,8 @@ BFSPartitionHandle::Repair(bool checkOnly)
 		result.stats.double_indirect_array_blocks,
 		size_string(1.0 * result.stats.blocks_in_double_indirect
 			* result.stats.block_size).String());
+	printf("\tfragmented nodes\t\t%" B_PRIu64 " (%" B_PRIu64 " fragments)\n",
+		result.stats.fragmented_nodes, result.stats.fragments);
 	// TODO: this is currently not maintained correctly
 	//printf("\tpartial block runs\t%" B_PRIu64 "\n",
 	//	result.stats.partial_block_runs);
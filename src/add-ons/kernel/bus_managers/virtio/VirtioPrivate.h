@@ -132,9 +132,11 @@ private:
 									const physical_entry* vector,
 									size_t readVectorCount,
 									size_t writtenVectorCount);
-			void				Finish();
+			void				Finish(virtio_callback_func& callback,
+									void*& callbackCookie);
 
 			VirtioDevice*		fDevice;
+			spinlock			fLock;
 			uint16				fQueueNumber;
 			uint16				fRingSize;
 			uint16				fRingFree;
@@ -56,7 +56,8 @@ public:
 
 			status_t			InitCheck() { return fStatus; }
 
-			void				Callback();
+			virtio_callback_func Callback() { return fCallback; }
+			void*				CallbackCookie() { return fCookie; }
 			uint16				Size() { return fDescriptorCount; }
 			void				SetTo(uint16 size,
 									virtio_callback_func callback,
@@ -118,14 +119,6 @@ TransferDescriptor::~TransferDescriptor()
 }
 
 
-void
-TransferDescriptor::Callback()
-{
-	if (fCallback != NULL)
-		fCallback(fQueue->Device()->DriverCookie(), fCookie);
-}
-
-
 void
 TransferDescriptor::SetTo(uint16 size, virtio_callback_func callback,
 	void *callbackCookie)
@@ -160,6 +153,8 @@ VirtioQueue::VirtioQueue(VirtioDevice* device, uint16 queueNumber,
 	fStatus(B_OK),
 	fIndirectMaxSize(0)
 {
+	B_INITIALIZE_SPINLOCK(&fLock);
+
 	fDescriptors = new(std::nothrow) TransferDescriptor*[fRingSize];
 	if (fDescriptors == NULL) {
 		fStatus = B_NO_MEMORY;
@@ -236,18 +231,35 @@ status_t
 VirtioQueue::Interrupt()
 {
 	CALLED();
+	InterruptsSpinLocker locker(fLock);
 	DisableInterrupt();
 
-	while (fRingUsedIndex != fRing.used->idx)
-		Finish();
+	while (fRingUsedIndex != fRing.used->idx) {
+		memory_read_barrier();
+
+		virtio_callback_func callback;
+		void* callbackCookie;
+		Finish(callback, callbackCookie);
+
+		// Drivers may have many requests in flight, and might want to queue
+		// new ones from their callback
+		if (callback != NULL) {
+			locker.Unlock();
+			callback(fDevice->DriverCookie(), callbackCookie);
+			locker.Lock();
+		}
+	}
 
 	EnableInterrupt();
 	return B_OK;
 }
 
 
+/*!	Returns the descriptors of the next used request to the free list.
+	The queue lock must be held.
+*/
 void
-VirtioQueue::Finish()
+VirtioQueue::Finish(virtio_callback_func& callback, void*& callbackCookie)
 {
 	TRACE("Finish() fRingUsedIndex: %u\n", fRingUsedIndex);
 
@@ -257,7 +269,8 @@ VirtioQueue::Finish()
 	uint16 descriptorIndex = element->id;
 		// uint32 length = element->len;
 
-	fDescriptors[descriptorIndex]->Callback();
+	callback = fDescriptors[descriptorIndex]->Callback();
+	callbackCookie = fDescriptors[descriptorIndex]->CallbackCookie();
 	uint16 size = fDescriptors[descriptorIndex]->Size();
 	fDescriptors[descriptorIndex]->Unset();
 	fRingFree += size;
@@ -292,6 +305,7 @@ VirtioQueue::QueueRequest(const physical_entry* vector, size_t readVectorCount,
 			writtenVectorCount, callback, callbackCookie);
 	}
 
+	InterruptsSpinLocker locker(fLock);
 	if (count > fRingFree)
 		return B_BUSY;
 
@@ -321,7 +335,11 @@ VirtioQueue::QueueRequestIndirect(const physical_entry* vector,
 {
 	CALLED();
 	size_t count = readVectorCount + writtenVectorCount;
-	if (count > fRingFree || count > fIndirectMaxSize)
+	if (count > fIndirectMaxSize)
+		return B_BUSY;
+
+	InterruptsSpinLocker locker(fLock);
+	if (fRingFree == 0)
 		return B_BUSY;
 
 	uint16 insertIndex = fRingHeadIndex;
@@ -352,6 +370,7 @@ VirtioQueue::UpdateAvailable(uint16 index)
 	CALLED();
 	uint16 available = fRing.avail->idx & (fRingSize - 1);
 	fRing.avail->ring[available] = index;
+	memory_write_barrier();
 	fRing.avail->idx++;
 }
 
@@ -28,7 +28,7 @@
 
 #include "dma_resources.h"
 #include "IORequest.h"
-#include "IOSchedulerSimple.h"
+#include "IOSchedulerRoster.h"
 
 
 //#define TRACE_SCSI_DISK
@@ -466,15 +466,11 @@ das_set_capacity(das_driver_info* info, uint64 capacity, uint32 blockSize)
 		if (status != B_OK)
 			panic("initializing DMAResource failed: %s", strerror(status));
 
-		info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
-			info->dma_resource);
-		if (info->io_scheduler == NULL)
-			panic("allocating IOScheduler failed.");
-
 		// TODO: use whole device name here
-		status = info->io_scheduler->Init("scsi");
+		status = IOSchedulerRoster::Default()->CreateScheduler(
+			info->dma_resource, "scsi", info->io_scheduler);
 		if (status != B_OK)
-			panic("initializing IOScheduler failed: %s", strerror(status));
+			panic("creating IOScheduler failed: %s", strerror(status));
 
 		info->io_scheduler->SetCallback(do_io, info);
 	}
@@ -41,6 +41,10 @@
 #define VIRTIO_BLK_F_SCSI	0x0080	/* Supports scsi command passthru */
 #define VIRTIO_BLK_F_FLUSH	0x0200	/* Cache flush command support */
 #define VIRTIO_BLK_F_TOPOLOGY	0x0400	/* Topology information is available */
+#define VIRTIO_BLK_F_CONFIG_WCE	0x0800	/* Writeback mode available in config */
+#define VIRTIO_BLK_F_MQ		0x1000	/* Support more than one vq */
+#define VIRTIO_BLK_F_DISCARD	0x2000	/* Supports discard command */
+#define VIRTIO_BLK_F_WRITE_ZEROES	0x4000	/* Supports write zeroes command */
 
 #define VIRTIO_BLK_ID_BYTES	20	/* ID string length */
 
@@ -60,6 +64,40 @@ struct virtio_blk_config {
 
 	/* block size of device (if VIRTIO_BLK_F_BLK_SIZE) */
 	uint32_t blk_size;
+
+	/* the next 4 entries are guarded by VIRTIO_BLK_F_TOPOLOGY  */
+	struct virtio_blk_topology {
+		/* exponent for physical block per logical block. */
+		uint8_t physical_block_exp;
+		/* alignment offset in logical blocks. */
+		uint8_t alignment_offset;
+		/* minimum I/O size without performance penalty in logical
+		 * blocks. */
+		uint16_t min_io_size;
+		/* optimal sustained I/O size in logical blocks. */
+		uint32_t opt_io_size;
+	} topology;
+
+	/* writeback mode (if VIRTIO_BLK_F_CONFIG_WCE) */
+	uint8_t writeback;
+	uint8_t unused0;
+
+	/* number of vqs, only available when VIRTIO_BLK_F_MQ is set */
+	uint16_t num_queues;
+
+	/* the next 3 entries are guarded by VIRTIO_BLK_F_DISCARD */
+	/* The maximum discard sectors (in 512-byte sectors) for one segment */
+	uint32_t max_discard_sectors;
+	/* The maximum number of discard segments in a discard command */
+	uint32_t max_discard_seg;
+	/* Discard commands must be aligned to this number of sectors. */
+	uint32_t discard_sector_alignment;
+
+	/* the next 3 entries are guarded by VIRTIO_BLK_F_WRITE_ZEROES */
+	uint32_t max_write_zeroes_sectors;
+	uint32_t max_write_zeroes_seg;
+	uint8_t write_zeroes_may_unmap;
+	uint8_t unused1[3];
 } _PACKED;
 
 /*
@@ -86,6 +124,12 @@ struct virtio_blk_config {
 /* Get device ID command */
 #define VIRTIO_BLK_T_GET_ID	8
 
+/* Discard command */
+#define VIRTIO_BLK_T_DISCARD	11
+
+/* Write zeroes command */
+#define VIRTIO_BLK_T_WRITE_ZEROES	13
+
 /* Barrier before this op. */
 #define VIRTIO_BLK_T_BARRIER	0x80000000
 
@@ -102,6 +146,18 @@ struct virtio_blk_outhdr {
 	uint64_t sector;
 };
 
+/* Discard/write zeroes range for each request. */
+struct virtio_blk_discard_write_zeroes {
+	/* discard/write zeroes start sector */
+	uint64_t sector;
+	/* number of discard/write zeroes sectors */
+	uint32_t num_sectors;
+	/* flags for this range */
+	uint32_t flags;
+};
+
+#define VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP	0x00000001
+
 struct virtio_scsi_inhdr {
 	uint32_t errors;
 	uint32_t data_len;
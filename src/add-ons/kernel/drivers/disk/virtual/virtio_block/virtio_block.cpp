@@ -11,6 +11,7 @@
 
 struct DMAResource;
 struct IOScheduler;
+struct virtio_block_queue;
 
 
 static const uint8 kDriveIcon[] = {
@@ -49,7 +50,8 @@ typedef struct {
 	device_node*			node;
 	::virtio_device			virtio_device;
 	virtio_device_interface*	virtio;
-	::virtio_queue			virtio_queue;
+	virtio_block_queue*		queues;
+	uint32					queue_count;
 	IOScheduler*			io_scheduler;
 	DMAResource*			dma_resource;
 
@@ -59,8 +61,6 @@ typedef struct {
 	uint64					capacity;
 	uint32					block_size;
 	status_t				media_status;
-
-	sem_id 	sem_cb;
 } virtio_block_driver_info;
 
 
@@ -73,11 +73,15 @@ typedef struct {
 #include <string.h>
 #include <stdlib.h>
 
+#include <AutoDeleter.h>
+#include <condition_variable.h>
 #include <fs/devfs.h>
+#include <util/AutoLock.h>
+#include <util/fs_trim_support.h>
 
 #include "dma_resources.h"
 #include "IORequest.h"
-#include "IOSchedulerSimple.h"
+#include "IOSchedulerRoster.h"
 
 
 //#define TRACE_VIRTIO_BLOCK
@@ -90,6 +94,48 @@ typedef struct {
 #define CALLED() 			TRACE("CALLED %s\n", __PRETTY_FUNCTION__)
 
 
+// the number of descriptors of an indirect table in the virtio bus manager
+#define VIRTIO_BLOCK_INDIRECT_DESCRIPTORS	128
+
+static const uint32 kMaxRequestsPerQueue = 256;
+
+
+/*!	The part of a request the device accesses. They are allocated in one
+	physically contiguous area per queue, so that no memory has to be
+	allocated or mapped for an I/O operation.
+*/
+struct virtio_block_request_data {
+	struct virtio_blk_outhdr				header;
+	struct virtio_blk_discard_write_zeroes	discard;
+	uint8									status;
+};
+
+struct virtio_block_request {
+	virtio_block_request*		next;
+	virtio_block_queue*			queue;
+	virtio_block_request_data*	data;
+	phys_addr_t					physical_data;
+
+	IOOperation*				operation;
+		// NULL for commands, that are waited for synchronously
+	status_t					status;
+	bool						done;
+	ConditionVariable			completed;
+};
+
+struct virtio_block_queue {
+	::virtio_queue				virtio_queue;
+	spinlock					lock;
+	area_id						area;
+	virtio_block_request*		requests;
+	uint32						request_count;
+	virtio_block_request*		free_requests;
+	int32						in_flight;
+	uint32						completions;
+	ConditionVariable			request_freed;
+};
+
+
 static device_manager_info* sDeviceManager;
 
 
@@ -119,6 +165,14 @@ get_feature_name(uint32 feature)
 			return "flush command";
 		case VIRTIO_BLK_F_TOPOLOGY:
 			return "topology";
+		case VIRTIO_BLK_F_CONFIG_WCE:
+			return "writeback mode";
+		case VIRTIO_BLK_F_MQ:
+			return "multiqueue";
+		case VIRTIO_BLK_F_DISCARD:
+			return "discard command";
+		case VIRTIO_BLK_F_WRITE_ZEROES:
+			return "write zeroes command";
 	}
 	return NULL;
 }
@@ -183,55 +237,142 @@ virtio_block_config_callback(void* driverCookie)
 }
 
 
+static status_t
+init_queue(virtio_block_driver_info* info, virtio_block_queue* queue,
+	::virtio_queue virtioQueue)
+{
+	queue->virtio_queue = virtioQueue;
+	B_INITIALIZE_SPINLOCK(&queue->lock);
+	queue->free_requests = NULL;
+	queue->in_flight = 0;
+	queue->completions = 0;
+	queue->request_freed.Init(queue, "virtio block request");
+
+	// Without indirect descriptors, every request needs at least three
+	// descriptors of the ring
+	uint32 count = info->virtio->queue_size(virtioQueue);
+	if ((info->features & VIRTIO_FEATURE_RING_INDIRECT_DESC) == 0)
+		count /= 3;
+	count = min_c(max_c(count, 1), kMaxRequestsPerQueue);
+
+	queue->requests = new(std::nothrow) virtio_block_request[count];
+	if (queue->requests == NULL)
+		return B_NO_MEMORY;
+	queue->request_count = count;
+
+	size_t areaSize = (count * sizeof(virtio_block_request_data)
+		+ B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+	virtio_block_request_data* data;
+	queue->area = create_area("virtio block requests", (void**)&data,
+		B_ANY_KERNEL_ADDRESS, areaSize, B_CONTIGUOUS,
+		B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+	if (queue->area < 0)
+		return queue->area;
+
+	physical_entry entry;
+	status_t status = get_memory_map(data, areaSize, &entry, 1);
+	if (status != B_OK)
+		return status;
+
+	for (uint32 i = 0; i < count; i++) {
+		virtio_block_request* request = &queue->requests[i];
+		request->queue = queue;
+		request->data = &data[i];
+		request->physical_data = entry.address
+			+ i * sizeof(virtio_block_request_data);
+		request->completed.Init(request, "virtio block command");
+
+		request->next = queue->free_requests;
+		queue->free_requests = request;
+	}
+
+	return B_OK;
+}
+
+
 static void
-virtio_block_callback(void* driverCookie, void* cookie)
+uninit_queue(virtio_block_queue* queue)
 {
-	virtio_block_driver_info* info = (virtio_block_driver_info*)cookie;
+	if (queue->area >= 0)
+		delete_area(queue->area);
+	delete[] queue->requests;
+}
+
 
-	release_sem_etc(info->sem_cb, 1, B_DO_NOT_RESCHEDULE);
+/*!	Picks the queue of the current CPU, so that the CPUs don't contend for
+	the same ring.
+*/
+static inline virtio_block_queue*
+choose_queue(virtio_block_driver_info* info)
+{
+	return &info->queues[smp_get_current_cpu() % info->queue_count];
 }
 
 
-static status_t
-do_io(void* cookie, IOOperation* operation)
+static virtio_block_request*
+get_request(virtio_block_queue* queue)
 {
-	virtio_block_driver_info* info = (virtio_block_driver_info*)cookie;
+	InterruptsSpinLocker locker(queue->lock);
 
-	size_t bytesTransferred = 0;
-	status_t status = B_OK;
+	while (queue->free_requests == NULL) {
+		ConditionVariableEntry entry;
+		queue->request_freed.Add(&entry);
+		locker.Unlock();
 
-	physical_entry entries[operation->VecCount() + 2];
+		entry.Wait();
+		locker.Lock();
+	}
 
-	void *buffer = malloc(sizeof(struct virtio_blk_outhdr) + sizeof(uint8));
-	struct virtio_blk_outhdr *header = (struct virtio_blk_outhdr*)buffer;
-	header->type = operation->IsWrite() ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
-	header->sector = operation->Offset() / 512;
-	header->ioprio = 1;
+	virtio_block_request* request = queue->free_requests;
+	queue->free_requests = request->next;
+	return request;
+}
 
-	uint8* ack = (uint8*)buffer + sizeof(struct virtio_blk_outhdr);
-	*ack = 0xff;
 
-	get_memory_map(buffer, sizeof(struct virtio_blk_outhdr) + sizeof(uint8),
-		&entries[0], 1);
-	entries[operation->VecCount() + 1].address = entries[0].address
-		+ sizeof(struct virtio_blk_outhdr);
-	entries[operation->VecCount() + 1].size = sizeof(uint8);
-	entries[0].size = sizeof(struct virtio_blk_outhdr);
+static void
+put_request(virtio_block_request* request)
+{
+	virtio_block_queue* queue = request->queue;
 
-	memcpy(entries + 1, operation->Vecs(), operation->VecCount()
-		* sizeof(physical_entry));
+	InterruptsSpinLocker locker(queue->lock);
+	request->next = queue->free_requests;
+	queue->free_requests = request;
+	queue->request_freed.NotifyAll();
+}
 
-	info->virtio->queue_request_v(info->virtio_queue, entries,
-		1 + (operation->IsWrite() ? operation->VecCount() : 0 ),
-		1 + (operation->IsWrite() ? 0 : operation->VecCount()),
-		virtio_block_callback, info);
 
-	acquire_sem(info->sem_cb);
+static inline physical_entry
+request_entry(virtio_block_request* request, size_t offset, size_t size)
+{
+	physical_entry entry;
+	entry.address = request->physical_data + offset;
+	entry.size = size;
+	return entry;
+}
+
+
+static void
+prepare_request(virtio_block_request* request, uint32 type, uint64 sector)
+{
+	request->data->header.type = type;
+	request->data->header.ioprio = 1;
+	request->data->header.sector = sector;
+	request->data->status = 0xff;
+	request->done = false;
+}
+
 
-	switch (*ack) {
+static void
+virtio_block_callback(void* driverCookie, void* cookie)
+{
+	virtio_block_driver_info* info = (virtio_block_driver_info*)driverCookie;
+	virtio_block_request* request = (virtio_block_request*)cookie;
+	virtio_block_queue* queue = request->queue;
+
+	status_t status;
+	switch (request->data->status) {
 		case VIRTIO_BLK_S_OK:
 			status = B_OK;
-			bytesTransferred = operation->Length();
 			break;
 		case VIRTIO_BLK_S_UNSUPP:
 			status = ENOTSUP;
@@ -240,10 +381,208 @@ do_io(void* cookie, IOOperation* operation)
 			status = EIO;
 			break;
 	}
-	free(buffer);
 
-	info->io_scheduler->OperationCompleted(operation, status,
-		bytesTransferred);
+	IOOperation* operation = request->operation;
+
+	InterruptsSpinLocker locker(queue->lock);
+	queue->in_flight--;
+	queue->completions++;
+
+	if (operation == NULL) {
+		// the waiting thread returns the request to the pool
+		request->status = status;
+		request->done = true;
+		request->completed.NotifyAll();
+	} else {
+		request->next = queue->free_requests;
+		queue->free_requests = request;
+	}
+
+	queue->request_freed.NotifyAll();
+	locker.Unlock();
+
+	if (operation != NULL) {
+		info->io_scheduler->OperationCompleted(operation, status,
+			status == B_OK ? operation->Length() : 0);
+	}
+}
+
+
+/*!	Queues the \a request on its virtqueue, and waits for ring descriptors
+	to become available, if necessary. The request is completed by
+	virtio_block_callback().
+*/
+static status_t
+submit_request(virtio_block_driver_info* info, virtio_block_request* request,
+	const physical_entry* entries, size_t readCount, size_t writtenCount)
+{
+	virtio_block_queue* queue = request->queue;
+
+	while (true) {
+		InterruptsSpinLocker locker(queue->lock);
+		uint32 completions = queue->completions;
+		queue->in_flight++;
+		locker.Unlock();
+
+		status_t status = info->virtio->queue_request_v(queue->virtio_queue,
+			entries, readCount, writtenCount, virtio_block_callback, request);
+		if (status == B_OK)
+			return B_OK;
+
+		locker.Lock();
+		queue->in_flight--;
+
+		if (status != B_BUSY || queue->in_flight == 0)
+			return status;
+		if (queue->completions != completions)
+			continue;
+
+		ConditionVariableEntry entry;
+		queue->request_freed.Add(&entry);
+		locker.Unlock();
+
+		entry.Wait();
+	}
+}
+
+
+/*!	Executes a command without data transfer, and waits for it to finish.
+	A \a sectorCount other than zero adds a discard range to the command.
+*/
+static status_t
+do_command(virtio_block_driver_info* info, uint32 type, uint64 sector,
+	uint32 sectorCount)
+{
+	virtio_block_request* request = get_request(choose_queue(info));
+	virtio_block_queue* queue = request->queue;
+
+	request->operation = NULL;
+	prepare_request(request, type, 0);
+
+	physical_entry entries[3];
+	size_t count = 0;
+	entries[count++] = request_entry(request,
+		offsetof(virtio_block_request_data, header),
+		sizeof(struct virtio_blk_outhdr));
+
+	if (sectorCount != 0) {
+		request->data->discard.sector = sector;
+		request->data->discard.num_sectors = sectorCount;
+		request->data->discard.flags = 0;
+
+		entries[count++] = request_entry(request,
+			offsetof(virtio_block_request_data, discard),
+			sizeof(struct virtio_blk_discard_write_zeroes));
+	}
+
+	entries[count++] = request_entry(request,
+		offsetof(virtio_block_request_data, status), sizeof(uint8));
+
+	status_t status = submit_request(info, request, entries, count - 1, 1);
+	if (status == B_OK) {
+		InterruptsSpinLocker locker(queue->lock);
+		if (!request->done) {
+			ConditionVariableEntry entry;
+			request->completed.Add(&entry);
+			locker.Unlock();
+
+			entry.Wait();
+		}
+
+		status = request->status;
+	}
+
+	put_request(request);
+	return status;
+}
+
+
+static status_t
+synchronize_cache(virtio_block_driver_info* info)
+{
+	TRACE("synchronize_cache()\n");
+
+	// without the flush feature, the device does not cache writes
+	if ((info->features & VIRTIO_BLK_F_FLUSH) == 0)
+		return B_OK;
+
+	return do_command(info, VIRTIO_BLK_T_FLUSH, 0, 0);
+}
+
+
+static status_t
+trim_device(virtio_block_driver_info* info, fs_trim_data* trimData)
+{
+	TRACE("trim_device()\n");
+
+	if ((info->features & VIRTIO_BLK_F_DISCARD) == 0)
+		return B_UNSUPPORTED;
+
+	// split the ranges into whole blocks the device accepts in one segment
+	uint64 blockSize = info->block_size;
+	uint64 maxSize = UINT32_MAX * 512ULL;
+	if (info->config.max_discard_sectors != 0)
+		maxSize = info->config.max_discard_sectors * 512ULL;
+	maxSize = max_c(maxSize / blockSize, 1) * blockSize;
+
+	uint64 trimmedSize = 0;
+	status_t status = B_OK;
+
+	for (uint32 i = 0; i < trimData->range_count && status == B_OK; i++) {
+		uint64 offset = (trimData->ranges[i].offset + blockSize - 1)
+			/ blockSize * blockSize;
+		uint64 end = min_c(trimData->ranges[i].offset
+			+ trimData->ranges[i].size, info->capacity * blockSize)
+			/ blockSize * blockSize;
+
+		while (offset < end) {
+			uint64 size = min_c(end - offset, maxSize);
+			status = do_command(info, VIRTIO_BLK_T_DISCARD, offset / 512,
+				size / 512);
+			if (status != B_OK)
+				break;
+
+			offset += size;
+			trimmedSize += size;
+		}
+	}
+
+	trimData->trimmed_size = trimmedSize;
+	return status;
+}
+
+
+static status_t
+do_io(void* cookie, IOOperation* operation)
+{
+	virtio_block_driver_info* info = (virtio_block_driver_info*)cookie;
+
+	// The operation is completed asynchronously in virtio_block_callback(),
+	// so that the I/O scheduler can keep many of them in flight.
+	virtio_block_request* request = get_request(choose_queue(info));
+	request->operation = operation;
+	prepare_request(request,
+		operation->IsWrite() ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
+		operation->Offset() / 512);
+
+	uint32 vecCount = operation->VecCount();
+	physical_entry entries[vecCount + 2];
+
+	entries[0] = request_entry(request,
+		offsetof(virtio_block_request_data, header),
+		sizeof(struct virtio_blk_outhdr));
+	memcpy(entries + 1, operation->Vecs(), vecCount * sizeof(physical_entry));
+	entries[vecCount + 1] = request_entry(request,
+		offsetof(virtio_block_request_data, status), sizeof(uint8));
+
+	status_t status = submit_request(info, request, entries,
+		1 + (operation->IsWrite() ? vecCount : 0),
+		1 + (operation->IsWrite() ? 0 : vecCount));
+	if (status != B_OK) {
+		put_request(request);
+		info->io_scheduler->OperationCompleted(operation, status, 0);
+	}
+
 	return status;
 }
 
@@ -266,7 +605,8 @@ virtio_block_init_device(void* _info, void** _cookie)
 		VIRTIO_BLK_F_BARRIER | VIRTIO_BLK_F_SIZE_MAX
 			| VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_GEOMETRY
 			| VIRTIO_BLK_F_RO | VIRTIO_BLK_F_BLK_SIZE
-			| VIRTIO_BLK_F_FLUSH | VIRTIO_FEATURE_RING_INDIRECT_DESC,
+			| VIRTIO_BLK_F_FLUSH | VIRTIO_BLK_F_MQ | VIRTIO_BLK_F_DISCARD
+			| VIRTIO_FEATURE_RING_INDIRECT_DESC,
 		&info->features, &get_feature_name);
 
 	status_t status = info->virtio->read_device_config(
@@ -275,6 +615,38 @@ virtio_block_init_device(void* _info, void** _cookie)
 	if (status != B_OK)
 		return status;
 
+	// use a queue per CPU, if the device supports it
+	uint32 queueCount = 1;
+	if ((info->features & VIRTIO_BLK_F_MQ) != 0) {
+		queueCount = min_c(max_c(info->config.num_queues, 1),
+			min_c(smp_get_num_cpus(), VIRTIO_VIRTQUEUES_MAX_COUNT));
+	}
+
+	::virtio_queue virtioQueues[VIRTIO_VIRTQUEUES_MAX_COUNT];
+	status = info->virtio->alloc_queues(info->virtio_device, queueCount,
+		virtioQueues);
+	if (status != B_OK) {
+		ERROR("queue allocation failed (%s)\n", strerror(status));
+		return status;
+	}
+
+	info->queues = new(std::nothrow) virtio_block_queue[queueCount];
+	if (info->queues == NULL)
+		return B_NO_MEMORY;
+	for (uint32 i = 0; i < queueCount; i++) {
+		info->queues[i].area = -1;
+		info->queues[i].requests = NULL;
+	}
+	info->queue_count = queueCount;
+
+	for (uint32 i = 0; i < queueCount; i++) {
+		status = init_queue(info, &info->queues[i], virtioQueues[i]);
+		if (status != B_OK) {
+			ERROR("request allocation failed (%s)\n", strerror(status));
+			return status;
+		}
+	}
+
 	// and get (initial) capacity
 	uint32 block_size = 512;
 	if ((info->features & VIRTIO_BLK_F_BLK_SIZE) != 0)
@@ -283,15 +655,10 @@ virtio_block_init_device(void* _info, void** _cookie)
 
 	virtio_block_set_capacity(info, capacity, block_size);
 
-	TRACE("virtio_block: capacity: %" B_PRIu64 ", block_size %" B_PRIu32 "\n",
-		info->capacity, info->block_size);
+	TRACE("virtio_block: capacity: %" B_PRIu64 ", block_size %" B_PRIu32
+		", %" B_PRIu32 " queues\n", info->capacity, info->block_size,
+		info->queue_count);
 
-	status = info->virtio->alloc_queues(info->virtio_device, 1,
-		&info->virtio_queue);
-	if (status != B_OK) {
-		ERROR("queue allocation failed (%s)\n", strerror(status));
-		return status;
-	}
 	status = info->virtio->setup_interrupt(info->virtio_device,
 		virtio_block_config_callback, info);
 
@@ -308,6 +675,13 @@ virtio_block_uninit_device(void* _cookie)
 
 	delete info->io_scheduler;
 	delete info->dma_resource;
+
+	if (info->queues != NULL) {
+		for (uint32 i = 0; i < info->queue_count; i++)
+			uninit_queue(&info->queues[i]);
+		delete[] info->queues;
+		info->queues = NULL;
+	}
 }
 
 
@@ -474,8 +848,24 @@ virtio_block_ioctl(void* cookie, uint32 op, void* buffer, size_t length)
 			return user_memcpy(buffer, &iconData, sizeof(device_icon));
 		}
 
-		/*case B_FLUSH_DRIVE_CACHE:
-			return synchronize_cache(info);*/
+		case B_FLUSH_DRIVE_CACHE:
+			return synchronize_cache(info);
+
+		case B_TRIM_DEVICE:
+		{
+			fs_trim_data* trimData;
+			MemoryDeleter deleter;
+			status_t status = get_trim_data_from_user(buffer, length, deleter,
+				trimData);
+			if (status != B_OK)
+				return status;
+
+			status = trim_device(info, trimData);
+			if (status != B_OK)
+				return status;
+
+			return copy_trim_data_to_user(buffer, trimData);
+		}
 	}
 
 	return B_DEV_INVALID_IOCTL;
@@ -511,21 +901,29 @@ virtio_block_set_capacity(virtio_block_driver_info* info, uint64 capacity,
 		if ((info->features & VIRTIO_BLK_F_SEG_MAX) != 0)
 			restrictions.max_segment_count = info->config.seg_max;
 
+		// the header and the status need a descriptor each, too
+		uint32 maxSegments = VIRTIO_BLOCK_INDIRECT_DESCRIPTORS;
+		if ((info->features & VIRTIO_FEATURE_RING_INDIRECT_DESC) == 0) {
+			maxSegments = info->virtio->queue_size(
+				info->queues[0].virtio_queue);
+		}
+		maxSegments -= 2;
+		if (restrictions.max_segment_count == 0
+			|| restrictions.max_segment_count > maxSegments) {
+			restrictions.max_segment_count = maxSegments;
+		}
+
 		// TODO: we need to replace the DMAResource in our IOScheduler
 		status_t status = info->dma_resource->Init(restrictions, blockSize,
 			1024, 32);
 		if (status != B_OK)
 			panic("initializing DMAResource failed: %s", strerror(status));
 
-		info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
-			info->dma_resource);
-		if (info->io_scheduler == NULL)
-			panic("allocating IOScheduler failed.");
-
 		// TODO: use whole device name here
-		status = info->io_scheduler->Init("virtio");
+		status = IOSchedulerRoster::Default()->CreateScheduler(
+			info->dma_resource, "virtio", info->io_scheduler);
 		if (status != B_OK)
-			panic("initializing IOScheduler failed: %s", strerror(status));
+			panic("creating IOScheduler failed: %s", strerror(status));
 
 		info->io_scheduler->SetCallback(do_io, info);
 	}
@@ -596,13 +994,6 @@ virtio_block_init_driver(device_node *node, void **cookie)
 		return B_NO_MEMORY;
 	}
 
-	info->sem_cb = create_sem(0, "virtio_block_cb");
-	if (info->sem_cb < 0) {
-		delete info->dma_resource;
-		status_t status = info->sem_cb;
-		free(info);
-		return status;
-	}
 	info->node = node;
 
 	*cookie = info;
@@ -615,7 +1006,6 @@ virtio_block_uninit_driver(void *_cookie)
 {
 	CALLED();
 	virtio_block_driver_info* info = (virtio_block_driver_info*)_cookie;
-	delete_sem(info->sem_cb);
 	free(info);
 }
 
@@ -31,6 +31,11 @@ namespace BFS {
 #endif
 
 
+// How full BPlusTree::BulkInsert() fills the nodes it builds, in percent;
+// the rest is left for later inserts, so they don't split the nodes at once
+static const int32 kBulkLoadNodeFill = 75;
+
+
 /*!	Simple array used for the duplicate handling in the B+Tree. This is an
 	on disk structure.
 */
@@ -1149,6 +1154,35 @@ BPlusTree::_SeekDown(Stack<node_and_key>& stack, const uint8* key,
 }
 
 
+/*!	Lets the block cache start reading the blocks following the node at
+	\a offset within the same block run of the tree's stream, so that
+	walking along the leaves doesn't have to wait for every node in turn.
+	The stream must be locked.
+*/
+void
+BPlusTree::_PrefetchNodes(off_t offset)
+{
+	static const uint32 kMaxPrefetchBlocks = 32;
+
+	block_run run;
+	off_t fileOffset;
+	if (offset >= fStream->Size()
+		|| fStream->FindBlockRun(offset, run, fileOffset) != B_OK)
+		return;
+
+	Volume* volume = fStream->GetVolume();
+
+	// the block containing the node itself is already in the cache
+	uint32 blockOffset = ((offset - fileOffset) >> volume->BlockShift()) + 1;
+	if (blockOffset >= run.Length())
+		return;
+
+	block_cache_prefetch(volume->BlockCache(),
+		volume->ToBlock(run) + blockOffset,
+		min_c(run.Length() - blockOffset, kMaxPrefetchBlocks));
+}
+
+
 /*!	This will find a free duplicate fragment in the given bplustree_node.
 	The CachedNode will be set to the writable fragment on success.
 */
@@ -1730,10 +1764,7 @@ BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 			return B_IO_ERROR;
 
 		// is the node big enough to hold the pair?
-		if (int32(key_align(sizeof(bplustree_node)
-				+ writableNode->AllKeyLength() + keyLength)
-				+ (writableNode->NumKeys() + 1) * (sizeof(uint16)
-				+ sizeof(off_t))) < fNodeSize) {
+		if (_KeyFits(writableNode, keyLength)) {
 			_InsertKey(writableNode, nodeAndKey.keyIndex,
 				keyBuffer, keyLength, value);
 			_UpdateIterators(nodeAndKey.nodeOffset, BPLUSTREE_NULL,
@@ -1823,6 +1854,405 @@ BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 }
 
 
+/*!	Inserts all \a count key/value pairs of \a entries into the tree; the
+	changes will be part of the \a transaction. The \a entries are sorted by
+	key in the process.
+	If the tree only consists of its root node, as it is the case for a newly
+	created directory or index, the tree is built bottom-up from the sorted
+	keys, filling every node to kBulkLoadNodeFill percent. Otherwise, the keys
+	are inserted one by one, but in sorted order, so that consecutive inserts
+	work on the same nodes.
+	The tree is not restored if this fails halfway, you have to abort the
+	\a transaction in this case.
+	You need to have the inode write locked.
+*/
+status_t
+BPlusTree::BulkInsert(Transaction& transaction, key_and_value* entries,
+	int32 count)
+{
+	if (count < 0)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	for (int32 i = 0; i < count; i++) {
+		if (entries[i].keyLength < BPLUSTREE_MIN_KEY_LENGTH
+			|| entries[i].keyLength > BPLUSTREE_MAX_KEY_LENGTH)
+			RETURN_ERROR(B_BAD_VALUE);
+	}
+
+	ASSERT_WRITE_LOCKED_INODE(fStream);
+
+	if (count == 0)
+		return B_OK;
+
+	_SortEntries(entries, count);
+
+	if (!fAllowDuplicates) {
+		for (int32 i = 1; i < count; i++) {
+			if (_CompareEntries(entries[i - 1], entries[i]) == 0)
+				return B_NAME_IN_USE;
+		}
+	}
+
+	// The bulk load rearranges the keys in the root node, so we cannot use
+	// it if there is a TreeIterator positioned in there
+	if (fHeader.MaxNumberOfLevels() == 1
+		&& !_HasIteratorsAt(fHeader.RootNode())) {
+		status_t status = _BulkLoad(transaction, entries, count);
+		if (status != B_NOT_SUPPORTED)
+			return status;
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		status_t status = Insert(transaction, entries[i].key,
+			entries[i].keyLength, entries[i].value);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Returns whether or not a key of \a keyLength bytes still fits into
+	the \a node.
+*/
+bool
+BPlusTree::_KeyFits(const bplustree_node* node, uint16 keyLength) const
+{
+	return int32(key_align(sizeof(bplustree_node) + node->AllKeyLength()
+			+ keyLength)
+		+ (node->NumKeys() + 1) * (sizeof(uint16) + sizeof(off_t)))
+			< fNodeSize;
+}
+
+
+/*!	Like _KeyFits(), but only uses kBulkLoadNodeFill percent of the \a node.
+	A key always fits into an empty node.
+*/
+bool
+BPlusTree::_BulkLoadKeyFits(const bplustree_node* node, uint16 keyLength) const
+{
+	if (node->NumKeys() == 0)
+		return true;
+
+	return int32(key_align(sizeof(bplustree_node) + node->AllKeyLength()
+			+ keyLength)
+		+ (node->NumKeys() + 1) * (sizeof(uint16) + sizeof(off_t)))
+			< fNodeSize * kBulkLoadNodeFill / 100;
+}
+
+
+int32
+BPlusTree::_CompareEntries(const key_and_value& a, const key_and_value& b)
+{
+	return _CompareKeys(a.key, a.keyLength, b.key, b.keyLength);
+}
+
+
+/*!	Sorts the \a entries by key using a heap sort, as that needs neither
+	extra memory nor recursion.
+*/
+void
+BPlusTree::_SortEntries(key_and_value* entries, int32 count)
+{
+	for (int32 start = count / 2; start-- > 0;) {
+		for (int32 parent = start; parent * 2 + 1 < count;) {
+			int32 child = parent * 2 + 1;
+			if (child + 1 < count
+				&& _CompareEntries(entries[child], entries[child + 1]) < 0)
+				child++;
+			if (_CompareEntries(entries[parent], entries[child]) >= 0)
+				break;
+
+			key_and_value temp = entries[parent];
+			entries[parent] = entries[child];
+			entries[child] = temp;
+			parent = child;
+		}
+	}
+
+	for (int32 end = count; end-- > 1;) {
+		key_and_value temp = entries[0];
+		entries[0] = entries[end];
+		entries[end] = temp;
+
+		for (int32 parent = 0; parent * 2 + 1 < end;) {
+			int32 child = parent * 2 + 1;
+			if (child + 1 < end
+				&& _CompareEntries(entries[child], entries[child + 1]) < 0)
+				child++;
+			if (_CompareEntries(entries[parent], entries[child]) >= 0)
+				break;
+
+			temp = entries[parent];
+			entries[parent] = entries[child];
+			entries[child] = temp;
+			parent = child;
+		}
+	}
+}
+
+
+bool
+BPlusTree::_HasIteratorsAt(off_t offset)
+{
+	MutexLocker _(fIteratorLock);
+
+	SinglyLinkedList<TreeIterator>::Iterator iterator
+		= fIterators.GetIterator();
+	while (iterator.HasNext()) {
+		if (iterator.Next()->fCurrentNodeOffset == offset)
+			return true;
+	}
+
+	return false;
+}
+
+
+/*!	Builds the tree bottom-up from the sorted \a entries, and the keys that
+	are already in the root node, which must be a leaf.
+	The leaves are filled in key order, leaving some space for later
+	inserts, and linked to each other; the levels above are then built by
+	_BulkLoadLevel(). Only the first entry of each key is put into the
+	leaves, the duplicates are inserted afterwards.
+	Returns B_NOT_SUPPORTED if the root node already contains duplicates.
+*/
+status_t
+BPlusTree::_BulkLoad(Transaction& transaction, const key_and_value* entries,
+	int32 count)
+{
+	off_t rootOffset = fHeader.RootNode();
+
+	// Copy the root node, as we are going to overwrite it
+	uint8* rootCopy = (uint8*)malloc(fNodeSize);
+	if (rootCopy == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+
+	MemoryDeleter rootCopyDeleter(rootCopy);
+	const bplustree_node* oldRoot = (const bplustree_node*)rootCopy;
+
+	{
+		CachedNode cached(this);
+		const bplustree_node* root;
+		status_t status = cached.SetTo(rootOffset, &root, true);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+
+		if (!root->IsLeaf())
+			return B_NOT_SUPPORTED;
+
+		memcpy(rootCopy, root, fNodeSize);
+	}
+
+	int32 oldCount = oldRoot->NumKeys();
+	const off_t* oldValues = oldRoot->Values();
+	for (int32 i = 0; i < oldCount; i++) {
+		if (bplustree_node::IsDuplicate(BFS_ENDIAN_TO_HOST_INT64(
+				oldValues[i])))
+			return B_NOT_SUPPORTED;
+	}
+
+	// Merge the existing keys with the new ones
+
+	int32 total = count + oldCount;
+	key_and_value* merged = new(std::nothrow) key_and_value[total];
+	key_and_value* children = new(std::nothrow) key_and_value[total];
+	ArrayDeleter<key_and_value> mergedDeleter(merged);
+	ArrayDeleter<key_and_value> childrenDeleter(children);
+	if (merged == NULL || children == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+
+	for (int32 i = 0, j = 0, k = 0; k < total; k++) {
+		key_and_value old;
+		if (j < oldCount) {
+			old.key = oldRoot->KeyAt(j, &old.keyLength);
+			old.value = BFS_ENDIAN_TO_HOST_INT64(oldValues[j]);
+		}
+
+		int32 compare = j == oldCount ? 1
+			: i == count ? -1 : _CompareEntries(old, entries[i]);
+		if (compare == 0 && !fAllowDuplicates)
+			return B_NAME_IN_USE;
+
+		if (compare <= 0) {
+			merged[k] = old;
+			j++;
+		} else
+			merged[k] = entries[i++];
+	}
+
+	// Fill the leaves, starting with the old root node
+
+	CachedNode cached(this);
+	bplustree_node* leaf = cached.SetToWritable(transaction, rootOffset,
+		false);
+	if (leaf == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	leaf->Initialize();
+
+	off_t leafOffset = rootOffset;
+	int32 childCount = 0;
+	int32 last = -1;
+	bool hasDuplicates = false;
+
+	for (int32 i = 0; i < total; i++) {
+		if (last >= 0 && _CompareEntries(merged[last], merged[i]) == 0) {
+			hasDuplicates = true;
+			continue;
+		}
+
+		if (!_BulkLoadKeyFits(leaf, merged[i].keyLength)) {
+			// this leaf is full, continue with a new one
+			off_t nextOffset;
+			{
+				CachedNode cachedNext(this);
+				bplustree_node* next;
+				status_t status = cachedNext.Allocate(transaction, &next,
+					&nextOffset);
+				if (status != B_OK)
+					RETURN_ERROR(status);
+
+				next->left_link = HOST_ENDIAN_TO_BFS_INT64(leafOffset);
+			}
+
+			leaf->right_link = HOST_ENDIAN_TO_BFS_INT64(nextOffset);
+
+			children[childCount].key = merged[last].key;
+			children[childCount].keyLength = merged[last].keyLength;
+			children[childCount].value = leafOffset;
+			childCount++;
+
+			leafOffset = nextOffset;
+			leaf = cached.SetToWritable(transaction, leafOffset, false);
+			if (leaf == NULL)
+				RETURN_ERROR(B_IO_ERROR);
+		}
+
+		_InsertKey(leaf, leaf->NumKeys(), const_cast<uint8*>(merged[i].key),
+			merged[i].keyLength, merged[i].value);
+		last = i;
+	}
+
+	cached.Unset();
+
+	if (last >= 0) {
+		children[childCount].key = merged[last].key;
+		children[childCount].keyLength = merged[last].keyLength;
+	}
+	children[childCount].value = leafOffset;
+	childCount++;
+
+	// Build the index levels on top of the leaves
+
+	uint32 levels = 1;
+	while (childCount > 1) {
+		status_t status = _BulkLoadLevel(transaction, children, childCount);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+
+		levels++;
+	}
+
+	if (levels > 1) {
+		bplustree_header* header = cached.SetToWritableHeader(transaction);
+		if (header == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+
+		header->root_node_pointer = HOST_ENDIAN_TO_BFS_INT64(children[0].value);
+		header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(levels);
+		cached.Unset();
+	}
+
+	if (!hasDuplicates)
+		return B_OK;
+
+	// Finally, add the duplicates the usual way
+
+	for (int32 i = 1; i < total; i++) {
+		if (_CompareEntries(merged[i - 1], merged[i]) != 0)
+			continue;
+
+		status_t status = Insert(transaction, merged[i].key,
+			merged[i].keyLength, merged[i].value);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Builds one index level on top of the \a count \a children, whose keys
+	are the largest keys of their subtrees, and whose values point to the
+	child nodes. The last child of every new node is put into its overflow
+	link, the others get a key.
+	On return, \a children contains the nodes of the new level, in the same
+	format, and \a count is set to their number.
+*/
+status_t
+BPlusTree::_BulkLoadLevel(Transaction& transaction, key_and_value* children,
+	int32& count)
+{
+	CachedNode cached(this);
+	bplustree_node* node;
+	off_t nodeOffset;
+	status_t status = cached.Allocate(transaction, &node, &nodeOffset);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	// the child in the overflow link of the current node
+	key_and_value overflow = children[0];
+	node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(overflow.value);
+
+	int32 parentCount = 0;
+
+	for (int32 i = 1; i < count; i++) {
+		key_and_value child = children[i];
+
+		if (_BulkLoadKeyFits(node, overflow.keyLength)) {
+			_InsertKey(node, node->NumKeys(), const_cast<uint8*>(overflow.key),
+				overflow.keyLength, overflow.value);
+		} else {
+			// this node is full, continue with a new one
+			off_t nextOffset;
+			{
+				CachedNode cachedNext(this);
+				bplustree_node* next;
+				status = cachedNext.Allocate(transaction, &next, &nextOffset);
+				if (status != B_OK)
+					RETURN_ERROR(status);
+
+				next->left_link = HOST_ENDIAN_TO_BFS_INT64(nodeOffset);
+			}
+
+			node->right_link = HOST_ENDIAN_TO_BFS_INT64(nextOffset);
+
+			// we never write past the children we've already read
+			children[parentCount].key = overflow.key;
+			children[parentCount].keyLength = overflow.keyLength;
+			children[parentCount].value = nodeOffset;
+			parentCount++;
+
+			nodeOffset = nextOffset;
+			node = cached.SetToWritable(transaction, nodeOffset, false);
+			if (node == NULL)
+				RETURN_ERROR(B_IO_ERROR);
+		}
+
+		node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(child.value);
+		overflow = child;
+	}
+
+	children[parentCount].key = overflow.key;
+	children[parentCount].keyLength = overflow.keyLength;
+	children[parentCount].value = nodeOffset;
+	count = parentCount + 1;
+
+	return B_OK;
+}
+
+
 /*!	Removes the duplicate index/value pair from the tree.
 	It's part of the private tree interface.
 */
@@ -2599,6 +3029,10 @@ TreeIterator::Goto(int8 to)
 			fCurrentKey = to == BPLUSTREE_BEGIN ? -1 : node->NumKeys();
 			fDuplicateNode = BPLUSTREE_NULL;
 
+#if !_BOOT_MODE
+			if (to == BPLUSTREE_BEGIN)
+				fTree->_PrefetchNodes(nodeOffset);
+#endif
 			return B_OK;
 		}
 
@@ -2718,6 +3152,11 @@ TreeIterator::Traverse(int8 direction, void* key, uint16* keyLength,
 			if (!node)
 				RETURN_ERROR(B_ERROR);
 
+#if !_BOOT_MODE
+			if (forward)
+				fTree->_PrefetchNodes(fCurrentNodeOffset);
+#endif
+
 			// reset current key
 			fCurrentKey = forward ? 0 : node->NumKeys() - 1;
 		} else {
@@ -157,6 +157,13 @@ struct node_and_key {
 	off_t	nodeOffset;
 	uint16	keyIndex;
 };
+
+// an entry for BPlusTree::BulkInsert()
+struct key_and_value {
+	const uint8*	key;
+	uint16			keyLength;
+	off_t			value;
+};
 #endif // !_BOOT_MODE
 
 
@@ -281,6 +288,9 @@ public:
 			status_t			Insert(Transaction& transaction, double key,
 									off_t value);
 
+			status_t			BulkInsert(Transaction& transaction,
+									key_and_value* entries, int32 count);
+
 			status_t			Replace(Transaction& transaction,
 									const uint8* key, uint16 keyLength,
 									off_t value);
@@ -311,6 +321,7 @@ private:
 #if !_BOOT_MODE
 			status_t			_SeekDown(Stack<node_and_key>& stack,
 									const uint8* key, uint16 keyLength);
+			void				_PrefetchNodes(off_t offset);
 
 			status_t			_FindFreeDuplicateFragment(
 									Transaction& transaction,
@@ -328,6 +339,22 @@ private:
 									off_t otherOffset, uint16* _keyIndex,
 									uint8* key, uint16* _keyLength,
 									off_t* _value);
+			bool				_KeyFits(const bplustree_node* node,
+									uint16 keyLength) const;
+			bool				_BulkLoadKeyFits(
+									const bplustree_node* node,
+									uint16 keyLength) const;
+
+			void				_SortEntries(key_and_value* entries,
+									int32 count);
+			int32				_CompareEntries(const key_and_value& a,
+									const key_and_value& b);
+			bool				_HasIteratorsAt(off_t offset);
+			status_t			_BulkLoad(Transaction& transaction,
+									const key_and_value* entries,
+									int32 count);
+			status_t			_BulkLoadLevel(Transaction& transaction,
+									key_and_value* children, int32& count);
 
 			status_t			_RemoveDuplicate(Transaction& transaction,
 									const bplustree_node* node,
@@ -162,6 +162,14 @@ private:
 #	define T(x) ;
 #endif
 
+static const int32 kMaxReservedBlocks = 4096;
+
+// the index entries collected while rebuilding an index are added in
+// batches of at most this size, each in its own transaction
+static const int32 kMaxIndexBatchEntries = 2048;
+static const size_t kMaxIndexBatchKeyBytes = 64 * 1024;
+
+
 #ifdef DEBUG_ALLOCATION_GROUPS
 #	define CHECK_ALLOCATION_GROUP(group) _CheckGroup(group)
 #else
@@ -172,13 +180,31 @@ private:
 struct check_index {
 	check_index()
 		:
-		inode(NULL)
+		inode(NULL),
+		entries(NULL),
+		inodes(NULL),
+		keys(NULL),
+		count(0),
+		keys_used(0)
+	{
+	}
+
+	~check_index()
 	{
+		delete[] entries;
+		delete[] inodes;
+		delete[] keys;
 	}
 
 	char				name[B_FILE_NAME_LENGTH];
 	block_run			run;
 	Inode*				inode;
+	key_and_value*		entries;
+	Inode**				inodes;
+		// the inodes of the entries; we keep a reference to each of them
+	uint8*				keys;
+	int32				count;
+	size_t				keys_used;
 };
 
 
@@ -193,6 +219,7 @@ struct check_cookie {
 	mode_t				parent_mode;
 	Stack<block_run>	stack;
 	TreeIterator*		iterator;
+	off_t				next_block;
 	check_control		control;
 	Stack<check_index*>	indices;
 };
@@ -248,9 +275,110 @@ private:
 	int32	fLargestStart;
 	int32	fLargestLength;
 	bool	fLargestValid;
+
+	uint32*	fFreeBitsPerBlock;
+		// points into BlockAllocator::fFreeBitsPerBlock
+};
+
+
+struct changed_bitmap_block {
+	AllocationGroup*	group;
+	uint32				block;
+};
+
+
+/*!	Remembers the bitmap blocks that are changed in the current transaction.
+	If the transaction is aborted, the block cache reverts the bitmap blocks,
+	but not the free bit counts of the allocation groups, so these are then
+	counted again from the reverted blocks.
+	Like an Inode, it can only be part of one transaction at a time; it is
+	protected by the transaction lock.
+*/
+class BitmapTransactionListener : public TransactionListener {
+public:
+								BitmapTransactionListener(
+									BlockAllocator* allocator);
+
+			void				BlockChanged(Transaction& transaction,
+									AllocationGroup& group, uint32 block);
+
+	virtual	void				TransactionDone(bool success);
+	virtual	void				RemovedFromTransaction();
+
+private:
+			BlockAllocator*		fAllocator;
+			Stack<changed_bitmap_block> fBlocks;
+			bool				fInTransaction;
+			bool				fRecountAll;
+				// set if not all changed blocks could be remembered
 };
 
 
+BitmapTransactionListener::BitmapTransactionListener(
+		BlockAllocator* allocator)
+	:
+	fAllocator(allocator),
+	fInTransaction(false),
+	fRecountAll(false)
+{
+}
+
+
+void
+BitmapTransactionListener::BlockChanged(Transaction& transaction,
+	AllocationGroup& group, uint32 block)
+{
+	if (!fInTransaction) {
+		transaction.AddListener(this);
+		fInTransaction = true;
+	}
+
+	// Consecutive changes mostly hit the same block
+	int32 count = fBlocks.CountItems();
+	if (count > 0) {
+		const changed_bitmap_block& last = fBlocks.Array()[count - 1];
+		if (last.group == &group && last.block == block)
+			return;
+	}
+
+	changed_bitmap_block changed;
+	changed.group = &group;
+	changed.block = block;
+	if (fBlocks.Push(changed) != B_OK)
+		fRecountAll = true;
+}
+
+
+void
+BitmapTransactionListener::TransactionDone(bool success)
+{
+	if (success)
+		return;
+
+	if (fRecountAll) {
+		fAllocator->_RecountFreeBits(NULL, 0);
+		return;
+	}
+
+	for (int32 i = 0; i < fBlocks.CountItems(); i++) {
+		const changed_bitmap_block& changed = fBlocks.Array()[i];
+		fAllocator->_RecountFreeBits(changed.group, changed.block);
+	}
+}
+
+
+void
+BitmapTransactionListener::RemovedFromTransaction()
+{
+	fBlocks.MakeEmpty();
+	fInTransaction = false;
+	fRecountAll = false;
+}
+
+
+//	#pragma mark -
+
+
 AllocationBlock::AllocationBlock(Volume* volume)
 	: CachedBlock(volume)
 {
@@ -377,7 +505,8 @@ AllocationGroup::AllocationGroup()
 	:
 	fFirstFree(-1),
 	fFreeBits(0),
-	fLargestValid(false)
+	fLargestValid(false),
+	fFreeBitsPerBlock(NULL)
 {
 }
 
@@ -413,7 +542,8 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 	ASSERT(start + length <= (int32)fNumBits);
 
 	// Update the allocation group info
-	// TODO: this info will be incorrect if something goes wrong later
+	// If the transaction is aborted, the free bits of the changed blocks
+	// are counted again by the BitmapTransactionListener
 	// Note, the fFirstFree block doesn't have to be really free
 	if (start == fFirstFree)
 		fFirstFree = start + length;
@@ -460,6 +590,8 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 			numBlocks = cached.NumBlockBits() - start;
 
 		cached.Allocate(start, numBlocks);
+		fFreeBitsPerBlock[block] -= numBlocks;
+		volume->Allocator().BitmapBlockChanged(transaction, *this, block);
 
 		length -= numBlocks;
 		start = 0;
@@ -482,7 +614,8 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 	ASSERT(start + length <= (int32)fNumBits);
 
 	// Update the allocation group info
-	// TODO: this info will be incorrect if something goes wrong later
+	// If the transaction is aborted, the free bits of the changed blocks
+	// are counted again by the BitmapTransactionListener
 	if (fFirstFree > start)
 		fFirstFree = start;
 	fFreeBits += length;
@@ -520,6 +653,8 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 			freeLength = cached.NumBlockBits() - start;
 
 		cached.Free(start, freeLength);
+		fFreeBitsPerBlock[block] += freeLength;
+		volume->Allocator().BitmapBlockChanged(transaction, *this, block);
 
 		length -= freeLength;
 		start = 0;
@@ -537,10 +672,15 @@ BlockAllocator::BlockAllocator(Volume* volume)
 	:
 	fVolume(volume),
 	fGroups(NULL),
+	fFreeBitsPerBlock(NULL),
+	fNumReservations(0),
+	fNextReservation(0),
 	fCheckBitmap(NULL),
-	fCheckCookie(NULL)
+	fCheckCookie(NULL),
+	fTransactionListener(NULL)
 {
 	recursive_lock_init(&fLock, "bfs allocator");
+	memset(fReservations, 0, sizeof(fReservations));
 }
 
 
@@ -548,6 +688,8 @@ BlockAllocator::~BlockAllocator()
 {
 	recursive_lock_destroy(&fLock);
 	delete[] fGroups;
+	delete[] fFreeBitsPerBlock;
+	delete fTransactionListener;
 }
 
 
@@ -560,7 +702,10 @@ BlockAllocator::Initialize(bool full)
 		/ (fVolume->BlockSize() * 8);
 
 	fGroups = new(std::nothrow) AllocationGroup[fNumGroups];
-	if (fGroups == NULL)
+	fFreeBitsPerBlock = new(std::nothrow) uint32[fNumBlocks];
+	fTransactionListener = new(std::nothrow) BitmapTransactionListener(this);
+	if (fGroups == NULL || fFreeBitsPerBlock == NULL
+		|| fTransactionListener == NULL)
 		return B_NO_MEMORY;
 
 	if (!full)
@@ -588,6 +733,7 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 		return status;
 
 	uint32 numBits = 8 * fBlocksPerGroup * fVolume->BlockSize();
+	uint32 bitsPerBlock = fVolume->BlockSize() << 3;
 	uint32 blockShift = fVolume->BlockShift();
 
 	uint32* buffer = (uint32*)malloc(numBits >> 3);
@@ -622,6 +768,12 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 		fGroups[i].fFreeBits = fGroups[i].fLargestLength = fGroups[i].fNumBits;
 		fGroups[i].fLargestValid = true;
 
+		fGroups[i].fFreeBitsPerBlock = fFreeBitsPerBlock + offset - 1;
+		for (uint32 block = 0; block < fGroups[i].NumBlocks(); block++) {
+			fGroups[i].fFreeBitsPerBlock[block] = min_c(bitsPerBlock,
+				fGroups[i].NumBits() - block * bitsPerBlock);
+		}
+
 		offset += fBlocksPerGroup;
 	}
 	free(buffer);
@@ -675,11 +827,15 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 			groups[i].fNumBlocks = blocks;
 		}
 		groups[i].fStart = offset;
+		groups[i].fFreeBitsPerBlock = allocator->fFreeBitsPerBlock + offset - 1;
+		memset(groups[i].fFreeBitsPerBlock, 0,
+			groups[i].fNumBlocks * sizeof(uint32));
 
 		// finds all free ranges in this allocation group
 		int32 start = -1, range = 0;
 		int32 numBits = groups[i].fNumBits, bit = 0;
 		int32 count = (numBits + 31) / 32;
+		uint32 bitsPerBlockShift = blockShift + 3;
 
 		for (int32 k = 0; k < count; k++) {
 			for (int32 j = 0; j < 32 && bit < numBits; j++, bit++) {
@@ -689,9 +845,12 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 						groups[i].AddFreeRange(start, range);
 						range = 0;
 					}
-				} else if (range++ == 0) {
-					// block is free, start new free range
-					start = bit;
+				} else {
+					groups[i].fFreeBitsPerBlock[bit >> bitsPerBlockShift]++;
+					if (range++ == 0) {
+						// block is free, start new free range
+						start = bit;
+					}
 				}
 			}
 		}
@@ -738,6 +897,64 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 }
 
 
+/*!	Adds a bitmap block that is changed in the \a transaction to the
+	blocks whose free bits are counted again if it is aborted.
+	The allocator lock must be held.
+*/
+void
+BlockAllocator::BitmapBlockChanged(Transaction& transaction,
+	AllocationGroup& group, uint32 block)
+{
+	if (fTransactionListener != NULL)
+		fTransactionListener->BlockChanged(transaction, group, block);
+}
+
+
+/*!	Counts the free bits in the given bitmap \a block of the \a group again,
+	and updates the group's free bit counts. If \a group is \c NULL, all
+	blocks of all groups are counted.
+	This is used after the bitmap blocks have been reverted by an aborted
+	transaction, since the counts are updated as soon as the blocks change.
+*/
+void
+BlockAllocator::_RecountFreeBits(AllocationGroup* group, uint32 block)
+{
+	RecursiveLocker lock(fLock);
+
+	if (group == NULL) {
+		for (int32 i = 0; i < fNumGroups; i++) {
+			for (uint32 j = 0; j < fGroups[i].NumBlocks(); j++)
+				_RecountFreeBits(&fGroups[i], j);
+		}
+		return;
+	}
+
+	AllocationBlock cached(fVolume);
+	if (cached.SetTo(*group, block) != B_OK) {
+		FATAL(("could not recount free bits of bitmap block %" B_PRIu32
+			"\n", block));
+		return;
+	}
+
+	uint32 freeBits = 0;
+	for (uint32 bit = 0; bit < cached.NumBlockBits(); bit++) {
+		if (!cached.IsUsed(bit))
+			freeBits++;
+	}
+
+	group->fFreeBits += (int32)freeBits
+		- (int32)group->fFreeBitsPerBlock[block];
+	group->fFreeBitsPerBlock[block] = freeBits;
+
+	// The free ranges in this block are not known anymore
+	int32 firstBit = block * (fVolume->BlockSize() << 3);
+	if (freeBits > 0
+		&& (group->fFirstFree == -1 || group->fFirstFree > firstBit))
+		group->fFirstFree = firstBit;
+	group->fLargestValid = false;
+}
+
+
 void
 BlockAllocator::Uninitialize()
 {
@@ -753,19 +970,53 @@ BlockAllocator::Uninitialize()
 
 	The number of allocated blocks is always a multiple of \a minimum which
 	has to be a power of two value.
+
+	Blocks that are reserved for another \a owner are only used if the
+	allocation cannot be fulfilled otherwise.
 */
 status_t
 BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
-	uint16 start, uint16 maximum, uint16 minimum, block_run& run)
+	uint16 start, uint16 maximum, uint16 minimum, block_run& run, ino_t owner)
 {
 	if (maximum == 0)
 		return B_BAD_VALUE;
 
+	RecursiveLocker lock(fLock);
+
+	status_t status = _AllocateBlocks(transaction, groupIndex, start, maximum,
+		minimum, owner, false, run);
+	if (status == B_DEVICE_FULL && fNumReservations > 0) {
+		status = _AllocateBlocks(transaction, groupIndex, start, maximum,
+			minimum, owner, true, run);
+	}
+
+	return status;
+}
+
+
+void
+BlockAllocator::ReleaseReservation(ino_t owner)
+{
+	RecursiveLocker lock(fLock);
+
+	allocation_reservation* reservation = _FindReservation(owner);
+	if (reservation != NULL) {
+		reservation->length = 0;
+		fNumReservations--;
+	}
+}
+
+
+status_t
+BlockAllocator::_AllocateBlocks(Transaction& transaction, int32 groupIndex,
+	uint16 start, uint16 maximum, uint16 minimum, ino_t owner, bool useReserved,
+	block_run& run)
+{
 	FUNCTION_START(("group = %ld, start = %u, maximum = %u, minimum = %u\n",
 		groupIndex, start, maximum, minimum));
 
 	AllocationBlock cached(fVolume);
-	RecursiveLocker lock(fLock);
+	ASSERT_LOCKED_RECURSIVE(&fLock);
 
 	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
 
@@ -783,13 +1034,23 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 		if (start >= group.NumBits() || group.IsFull())
 			continue;
 
+		// The next range in this group that is reserved for someone else;
+		// the bits in there are treated as if they were in use
+		int32 reservedStart = group.NumBits();
+		int32 reservedEnd = group.NumBits();
+		if (!useReserved) {
+			_NextReservation(groupIndex, 0, owner, reservedStart,
+				reservedEnd);
+		}
+		bool hasReservations = reservedStart < (int32)group.NumBits();
+
 		// The wanted maximum is smaller than the largest free block in the
 		// group or already smaller than the minimum
 
 		if (start < group.fFirstFree)
 			start = group.fFirstFree;
 
-		if (group.fLargestValid) {
+		if (group.fLargestValid && !hasReservations) {
 			if (group.fLargestLength < bestLength)
 				continue;
 
@@ -818,58 +1079,111 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 		int32 groupLargestStart = -1;
 		int32 groupLargestLength = -1;
 		int32 currentBit = start;
-		bool canFindGroupLargest = start == 0;
+		bool canFindGroupLargest = start == 0 && !hasReservations;
 
 		for (; block < group.NumBlocks(); block++) {
-			if (cached.SetTo(group, block) < B_OK)
-				RETURN_ERROR(B_ERROR);
-
-			T(Block("alloc-in", group.Start() + block, cached.Block(),
-				fVolume->BlockSize(), groupIndex, currentStart));
-
-			// find a block large enough to hold the allocation
-			for (uint32 bit = start % bitsPerFullBlock;
-					bit < cached.NumBlockBits(); bit++) {
-				if (!cached.IsUsed(bit)) {
-					if (currentLength == 0) {
-						// start new range
-						currentStart = currentBit;
-					}
+			if (currentBit >= reservedEnd && !useReserved) {
+				_NextReservation(groupIndex, currentBit, owner, reservedStart,
+					reservedEnd);
+			}
 
-					// have we found a range large enough to hold numBlocks?
-					if (++currentLength >= maximum) {
+			// Bitmap blocks that are completely used or free don't need to
+			// be looked at
+			uint32 blockBits = min_c(bitsPerFullBlock,
+				group.NumBits() - block * bitsPerFullBlock);
+			uint32 freeBits = group.fFreeBitsPerBlock[block];
+			int32 bits = blockBits - start % bitsPerFullBlock;
+
+			if (freeBits == blockBits && currentBit + bits <= reservedStart) {
+				if (currentLength == 0) {
+					// start new range
+					currentStart = currentBit;
+				}
+				currentLength += bits;
+				currentBit += bits;
+
+				if (currentLength >= maximum) {
+					bestGroup = groupIndex;
+					bestStart = currentStart;
+					bestLength = currentLength;
+				}
+			} else if (freeBits == 0) {
+				if (currentLength) {
+					// end of a range
+					if (currentLength > bestLength) {
 						bestGroup = groupIndex;
 						bestStart = currentStart;
 						bestLength = currentLength;
-						break;
 					}
-				} else {
-					if (currentLength) {
-						// end of a range
-						if (currentLength > bestLength) {
+					if (currentLength > groupLargestLength) {
+						groupLargestStart = currentStart;
+						groupLargestLength = currentLength;
+					}
+					currentLength = 0;
+				}
+				currentBit += bits;
+
+				if ((int32)group.NumBits() - currentBit <= groupLargestLength) {
+					// We can't find a bigger block in this group anymore,
+					// let's skip the rest.
+					block = group.NumBlocks();
+				}
+			} else {
+				if (cached.SetTo(group, block) < B_OK)
+					RETURN_ERROR(B_ERROR);
+
+				T(Block("alloc-in", group.Start() + block, cached.Block(),
+					fVolume->BlockSize(), groupIndex, currentStart));
+
+				// find a block large enough to hold the allocation
+				for (uint32 bit = start % bitsPerFullBlock;
+						bit < cached.NumBlockBits(); bit++) {
+					if (currentBit >= reservedEnd && !useReserved) {
+						_NextReservation(groupIndex, currentBit, owner,
+							reservedStart, reservedEnd);
+					}
+
+					if (!cached.IsUsed(bit) && currentBit < reservedStart) {
+						if (currentLength == 0) {
+							// start new range
+							currentStart = currentBit;
+						}
+
+						// have we found a range large enough to hold numBlocks?
+						if (++currentLength >= maximum) {
 							bestGroup = groupIndex;
 							bestStart = currentStart;
 							bestLength = currentLength;
+							break;
 						}
-						if (currentLength > groupLargestLength) {
-							groupLargestStart = currentStart;
-							groupLargestLength = currentLength;
+					} else {
+						if (currentLength) {
+							// end of a range
+							if (currentLength > bestLength) {
+								bestGroup = groupIndex;
+								bestStart = currentStart;
+								bestLength = currentLength;
+							}
+							if (currentLength > groupLargestLength) {
+								groupLargestStart = currentStart;
+								groupLargestLength = currentLength;
+							}
+							currentLength = 0;
+						}
+						if ((int32)group.NumBits() - currentBit
+								<= groupLargestLength) {
+							// We can't find a bigger block in this group
+							// anymore, let's skip the rest.
+							block = group.NumBlocks();
+							break;
 						}
-						currentLength = 0;
-					}
-					if ((int32)group.NumBits() - currentBit
-							<= groupLargestLength) {
-						// We can't find a bigger block in this group anymore,
-						// let's skip the rest.
-						block = group.NumBlocks();
-						break;
 					}
+					currentBit++;
 				}
-				currentBit++;
-			}
 
-			T(Block("alloc-out", block, cached.Block(),
-				fVolume->BlockSize(), groupIndex, currentStart));
+				T(Block("alloc-out", block, cached.Block(),
+					fVolume->BlockSize(), groupIndex, currentStart));
+			}
 
 			if (bestLength >= maximum) {
 				canFindGroupLargest = false;
@@ -920,6 +1234,9 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 
 	CHECK_ALLOCATION_GROUP(bestGroup);
 
+	if (fNumReservations > 0)
+		_RemoveReservations(bestGroup, bestStart, bestLength);
+
 	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(bestGroup);
 	run.start = HOST_ENDIAN_TO_BFS_INT16(bestStart);
 	run.length = HOST_ENDIAN_TO_BFS_INT16(bestLength);
@@ -1016,7 +1333,26 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 		group = inode->BlockRun().AllocationGroup() + 1;
 	}
 
-	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run);
+	RecursiveLocker lock(fLock);
+
+	// If we have reserved the blocks after our last allocation, continue
+	// there; this also works when the data stream has already grown into
+	// the indirect ranges
+	allocation_reservation* reservation = _FindReservation(inode->ID());
+	if (reservation != NULL) {
+		group = reservation->group;
+		start = reservation->start;
+	}
+
+	status_t status = AllocateBlocks(transaction, group, start, numBlocks,
+		minimum, run, inode->ID());
+
+	// Reserve the space after a file's data, so that concurrent writers
+	// don't interleave their allocations
+	if (status == B_OK && inode->IsFile())
+		_Reserve(inode->ID(), run);
+
+	return status;
 }
 
 
@@ -1078,6 +1414,107 @@ BlockAllocator::Free(Transaction& transaction, block_run run)
 }
 
 
+allocation_reservation*
+BlockAllocator::_FindReservation(ino_t owner)
+{
+	for (int32 i = 0; i < BFS_MAX_RESERVATIONS; i++) {
+		if (fReservations[i].length != 0 && fReservations[i].owner == owner)
+			return &fReservations[i];
+	}
+	return NULL;
+}
+
+
+/*!	Finds the first range in \a groupIndex that is reserved for someone else
+	than \a owner, and that ends after \a bit. If there is none, \a start
+	and \a end are set to the end of the group.
+*/
+void
+BlockAllocator::_NextReservation(int32 groupIndex, int32 bit, ino_t owner,
+	int32& start, int32& end) const
+{
+	start = end = fGroups[groupIndex].NumBits();
+
+	for (int32 i = 0; i < BFS_MAX_RESERVATIONS; i++) {
+		const allocation_reservation& reservation = fReservations[i];
+		if (reservation.length == 0 || reservation.group != groupIndex
+			|| reservation.owner == owner
+			|| reservation.start + reservation.length <= bit
+			|| reservation.start >= start) {
+			continue;
+		}
+
+		start = reservation.start;
+		end = reservation.start + reservation.length;
+	}
+}
+
+
+/*!	Reserves the blocks following \a run for \a owner; the size of the
+	reservation grows with the size of the allocations.
+	If all slots are in use, the oldest reservation is replaced.
+*/
+void
+BlockAllocator::_Reserve(ino_t owner, const block_run& run)
+{
+	ASSERT_LOCKED_RECURSIVE(&fLock);
+
+	int32 group = run.AllocationGroup();
+	int32 start = run.Start() + run.Length();
+	int32 length = min_c((int32)run.Length(),
+		(int32)fGroups[group].NumBits() - start);
+	length = min_c(length, kMaxReservedBlocks);
+
+	allocation_reservation* reservation = _FindReservation(owner);
+	if (length <= 0) {
+		if (reservation != NULL) {
+			reservation->length = 0;
+			fNumReservations--;
+		}
+		return;
+	}
+
+	if (reservation == NULL) {
+		for (int32 i = 0; i < BFS_MAX_RESERVATIONS; i++) {
+			if (fReservations[i].length == 0) {
+				reservation = &fReservations[i];
+				break;
+			}
+		}
+		if (reservation == NULL) {
+			reservation = &fReservations[fNextReservation];
+			fNextReservation = (fNextReservation + 1) % BFS_MAX_RESERVATIONS;
+		} else
+			fNumReservations++;
+	}
+
+	reservation->owner = owner;
+	reservation->group = group;
+	reservation->start = start;
+	reservation->length = length;
+}
+
+
+/*!	Removes all reservations that overlap with the range that has just been
+	allocated.
+*/
+void
+BlockAllocator::_RemoveReservations(int32 group, int32 start, int32 length)
+{
+	for (int32 i = 0; i < BFS_MAX_RESERVATIONS; i++) {
+		allocation_reservation& reservation = fReservations[i];
+		if (reservation.length == 0 || reservation.group != group
+			|| reservation.start >= start + length
+			|| reservation.start + reservation.length <= start) {
+			continue;
+		}
+
+		reservation.length = 0;
+		fNumReservations--;
+	}
+}
+
+
 size_t
 BlockAllocator::BitmapSize() const
 {
@@ -1109,6 +1546,13 @@ BlockAllocator::Fragment()
 				cached.Block(index) |= HOST_ENDIAN_TO_BFS_INT32(kMask);
 			}
 
+			uint32 freeBits = 0;
+			for (uint32 bit = 0; bit < cached.NumBlockBits(); bit++) {
+				if (!cached.IsUsed(bit))
+					freeBits++;
+			}
+			group.fFreeBitsPerBlock[block] = freeBits;
+
 			transaction.Done();
 		}
 	}
@@ -1362,8 +1806,16 @@ BlockAllocator::StopChecking(check_control* control)
 			break;
 
 		case BFS_CHECK_PASS_INDEX:
+		{
+			status_t status = _FinishIndices();
+			if (status != B_OK) {
+				FATAL(("check: Could not add the index entries: %s\n",
+					strerror(status)));
+				fCheckCookie->control.status = status;
+			}
 			_FreeIndices();
 			break;
+		}
 	}
 
 	fVolume->SetCheckingThread(-1);
@@ -1524,6 +1976,7 @@ BlockAllocator::CheckNextNode(check_control* control)
 		strlcpy(fCheckCookie->control.name, name, B_FILE_NAME_LENGTH);
 		fCheckCookie->control.inode = id;
 		fCheckCookie->control.errors = 0;
+		fCheckCookie->control.fragments = 0;
 
 		Vnode vnode(fVolume, id);
 		Inode* inode;
@@ -1746,6 +2199,29 @@ BlockAllocator::_WriteBackCheckBitmap()
 			}
 			transaction.Done();
 		}
+
+		// update the number of free bits per bitmap block
+		uint32 bitsPerBlock = blockSize << 3;
+		for (int32 i = 0; i < fNumGroups; i++) {
+			AllocationGroup& group = fGroups[i];
+
+			for (uint32 block = 0; block < group.NumBlocks(); block++) {
+				const uint32* bitmap = fCheckBitmap
+					+ (group.Start() - 1 + block) * (blockSize >> 2);
+				uint32 numBits = min_c(bitsPerBlock,
+					group.NumBits() - block * bitsPerBlock);
+				uint32 freeBits = 0;
+
+				for (uint32 bit = 0; bit < numBits; bit++) {
+					if ((bitmap[bit >> 5]
+							& HOST_ENDIAN_TO_BFS_INT32(1UL << (bit & 0x1f)))
+								== 0) {
+						freeBits++;
+					}
+				}
+				group.fFreeBitsPerBlock[block] = freeBits;
+			}
+		}
 	}
 
 	return B_OK;
@@ -1915,6 +2391,12 @@ BlockAllocator::CheckInode(Inode* inode, const char* name)
 			if (status != B_OK)
 				return status;
 
+			if (fCheckCookie->control.fragments > 1) {
+				fCheckCookie->control.stats.fragmented_nodes++;
+				fCheckCookie->control.stats.fragments
+					+= fCheckCookie->control.fragments;
+			}
+
 			// Check the B+tree as well
 			if (inode->IsContainer()) {
 				bool repairErrors
@@ -1954,6 +2436,9 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 	if (status != B_OK)
 		return status;
 
+	fCheckCookie->control.fragments = 0;
+	fCheckCookie->next_block = -1;
+
 	// If the inode has an attribute directory, push it on the stack
 	if (!inode->Attributes().IsZero())
 		fCheckCookie->stack.Push(inode->Attributes());
@@ -1982,6 +2467,7 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 			fCheckCookie->control.stats.direct_block_runs++;
 			fCheckCookie->control.stats.blocks_in_direct
 				+= data->direct[i].Length();
+			_CountFragment(data->direct[i]);
 		}
 	}
 
@@ -2014,6 +2500,7 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 				fCheckCookie->control.stats.indirect_block_runs++;
 				fCheckCookie->control.stats.blocks_in_indirect
 					+= runs[index].Length();
+				_CountFragment(runs[index]);
 			}
 			fCheckCookie->control.stats.indirect_array_blocks++;
 
@@ -2075,6 +2562,7 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 					fCheckCookie->control.stats.double_indirect_block_runs++;
 					fCheckCookie->control.stats.blocks_in_double_indirect
 						+= runs[index % runsPerBlock].Length();
+					_CountFragment(runs[index % runsPerBlock]);
 				} while ((++index % runsPerBlock) != 0);
 			}
 
@@ -2086,6 +2574,20 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 }
 
 
+/*!	Counts the data runs of the inode being checked that do not directly
+	follow the previous one on disk.
+*/
+void
+BlockAllocator::_CountFragment(block_run run)
+{
+	off_t block = fVolume->ToBlock(run);
+	if (block != fCheckCookie->next_block)
+		fCheckCookie->control.fragments++;
+
+	fCheckCookie->next_block = block + run.Length();
+}
+
+
 status_t
 BlockAllocator::_PrepareIndices()
 {
@@ -2112,6 +2614,14 @@ BlockAllocator::_PrepareIndices()
 		if (status != B_OK)
 			return status;
 
+		index->entries = new(std::nothrow) key_and_value[
+			kMaxIndexBatchEntries];
+		index->inodes = new(std::nothrow) Inode*[kMaxIndexBatchEntries];
+		index->keys = new(std::nothrow) uint8[kMaxIndexBatchKeyBytes];
+		if (index->entries == NULL || index->inodes == NULL
+			|| index->keys == NULL)
+			return B_NO_MEMORY;
+
 		index->inode = inode;
 		vnode.Keep();
 		count++;
@@ -2121,68 +2631,202 @@ BlockAllocator::_PrepareIndices()
 }
 
 
+/*!	Adds the index entries that have been collected, but not yet added.
+	Must be called before the indices are freed.
+*/
+status_t
+BlockAllocator::_FinishIndices()
+{
+	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
+		check_index* index = fCheckCookie->indices.Array()[i];
+		if (index->inode == NULL)
+			continue;
+
+		status_t status = _WriteIndexEntries(index);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
 void
 BlockAllocator::_FreeIndices()
 {
 	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
 		check_index* index = fCheckCookie->indices.Array()[i];
 		if (index->inode != NULL) {
+			_PutIndexEntries(index);
 			put_vnode(fVolume->FSVolume(),
 				fVolume->ToVnode(index->inode->BlockRun()));
 		}
+		delete index;
 	}
 	fCheckCookie->indices.MakeEmpty();
 }
 
 
+/*!	Collects the keys of the \a inode for all indices that are being
+	rebuilt. They are added to the indices in batches, which lets
+	BPlusTree::BulkInsert() build each of the emptied trees bottom-up, and
+	insert the keys in sorted order afterwards.
+*/
 status_t
 BlockAllocator::_AddInodeToIndex(Inode* inode)
 {
-	Transaction transaction(fVolume, inode->BlockNumber());
-
 	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
 		check_index* index = fCheckCookie->indices.Array()[i];
 		if (index->inode == NULL)
 			continue;
 
-		index->inode->WriteLockInTransaction(transaction);
+		uint8 key[BPLUSTREE_MAX_KEY_LENGTH];
+		size_t keyLength;
+		status_t status = _GetIndexKey(index, inode, key, keyLength);
+		if (status == B_ENTRY_NOT_FOUND)
+			continue;
+		if (status == B_OK)
+			status = _AddIndexEntry(index, inode, key, keyLength);
+		if (status != B_OK)
+			return status;
+	}
 
-		BPlusTree* tree = index->inode->Tree();
-		if (tree == NULL)
+	return B_OK;
+}
+
+
+/*!	Retrieves the key of the \a inode in the \a index. Returns
+	\c B_ENTRY_NOT_FOUND if the \a inode is not part of the \a index.
+*/
+status_t
+BlockAllocator::_GetIndexKey(check_index* index, Inode* inode, uint8* key,
+	size_t& keyLength)
+{
+	if (!strcmp(index->name, "name")) {
+		if (!inode->InNameIndex())
+			return B_ENTRY_NOT_FOUND;
+		if (inode->GetName((char*)key, B_FILE_NAME_LENGTH) != B_OK)
 			return B_ERROR;
 
-		status_t status = B_OK;
+		keyLength = strlen((char*)key);
+	} else if (!strcmp(index->name, "last_modified")) {
+		if (!inode->InLastModifiedIndex())
+			return B_ENTRY_NOT_FOUND;
+
+		int64 lastModified = inode->OldLastModified();
+		memcpy(key, &lastModified, sizeof(int64));
+		keyLength = sizeof(int64);
+	} else if (!strcmp(index->name, "size")) {
+		if (!inode->InSizeIndex())
+			return B_ENTRY_NOT_FOUND;
+
+		int64 size = inode->Size();
+		memcpy(key, &size, sizeof(int64));
+		keyLength = sizeof(int64);
+	} else {
+		keyLength = BPLUSTREE_MAX_KEY_LENGTH;
+		if (inode->ReadAttribute(index->name, B_ANY_TYPE, 0, key,
+				&keyLength) != B_OK)
+			return B_ENTRY_NOT_FOUND;
+	}
 
-		if (!strcmp(index->name, "name")) {
-			if (inode->InNameIndex()) {
-				char name[B_FILE_NAME_LENGTH];
-				if (inode->GetName(name, B_FILE_NAME_LENGTH) != B_OK)
-					return B_ERROR;
+	return B_OK;
+}
 
-				status = tree->Insert(transaction, name, inode->ID());
-			}
-		} else if (!strcmp(index->name, "last_modified")) {
-			if (inode->InLastModifiedIndex()) {
-				status = tree->Insert(transaction, inode->OldLastModified(),
-					inode->ID());
-			}
-		} else if (!strcmp(index->name, "size")) {
-			if (inode->InSizeIndex())
-				status = tree->Insert(transaction, inode->Size(), inode->ID());
-		} else {
-			uint8 key[BPLUSTREE_MAX_KEY_LENGTH];
-			size_t keyLength = BPLUSTREE_MAX_KEY_LENGTH;
-			if (inode->ReadAttribute(index->name, B_ANY_TYPE, 0, key,
-					&keyLength) == B_OK) {
-				status = tree->Insert(transaction, key, keyLength, inode->ID());
-			}
-		}
 
+status_t
+BlockAllocator::_AddIndexEntry(check_index* index, Inode* inode,
+	const uint8* key, size_t keyLength)
+{
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	if (index->count == kMaxIndexBatchEntries
+		|| index->keys_used + keyLength > kMaxIndexBatchKeyBytes) {
+		status_t status = _WriteIndexEntries(index);
 		if (status != B_OK)
 			return status;
 	}
 
-	return transaction.Done();
+	// the inode must not go away until its entry has been written
+	status_t status = acquire_vnode(fVolume->FSVolume(), inode->ID());
+	if (status != B_OK)
+		return status;
+
+	uint8* copy = index->keys + index->keys_used;
+	memcpy(copy, key, keyLength);
+	index->keys_used += keyLength;
+
+	index->inodes[index->count] = inode;
+	key_and_value& entry = index->entries[index->count++];
+	entry.key = copy;
+	entry.keyLength = keyLength;
+	entry.value = inode->ID();
+
+	return B_OK;
+}
+
+
+/*!	Adds the collected entries of the \a index to its tree in a single
+	transaction.
+	The inodes may have been changed or removed since their keys have been
+	collected, and the file system has then already updated the index for
+	them. Since their keys can only change in a transaction, the entries are
+	validated again here, and those that are out of date are dropped.
+*/
+status_t
+BlockAllocator::_WriteIndexEntries(check_index* index)
+{
+	if (index->count == 0)
+		return B_OK;
+
+	status_t status = B_ERROR;
+
+	{
+		Transaction transaction(fVolume, index->inode->BlockNumber());
+		index->inode->WriteLockInTransaction(transaction);
+
+		BPlusTree* tree = index->inode->Tree();
+		if (tree != NULL) {
+			int32 count = 0;
+			for (int32 i = 0; i < index->count; i++) {
+				Inode* inode = index->inodes[i];
+				key_and_value& entry = index->entries[i];
+
+				uint8 key[BPLUSTREE_MAX_KEY_LENGTH];
+				size_t keyLength;
+				if ((inode->Flags() & INODE_DELETED) != 0
+					|| _GetIndexKey(index, inode, key, keyLength) != B_OK
+					|| keyLength != entry.keyLength
+					|| memcmp(key, entry.key, keyLength) != 0)
+					continue;
+
+				index->entries[count++] = entry;
+			}
+
+			status = tree->BulkInsert(transaction, index->entries, count);
+			if (status == B_OK)
+				status = transaction.Done();
+		}
+	}
+
+	// Putting the last reference to a removed inode frees it, which needs a
+	// transaction of its own
+	_PutIndexEntries(index);
+	return status;
+}
+
+
+//!	Drops the collected entries of the \a index, and their inode references.
+void
+BlockAllocator::_PutIndexEntries(check_index* index)
+{
+	for (int32 i = 0; i < index->count; i++)
+		put_vnode(fVolume->FSVolume(), index->inodes[i]->ID());
+
+	index->count = 0;
+	index->keys_used = 0;
 }
 
 
@@ -2260,6 +2904,26 @@ BlockAllocator::Dump(int32 index)
 			group.fLargestValid ? "" : "  (invalid)");
 		kprintf("      largest length: %" B_PRId32 "\n", group.fLargestLength);
 		kprintf("      free bits:      %" B_PRId32 "\n", group.fFreeBits);
+		kprintf("      bitmap blocks:  ");
+
+		uint32 bitsPerBlock = fVolume->BlockSize() << 3;
+		for (uint32 block = 0; block < group.NumBlocks(); block++) {
+			uint32 freeBits = group.fFreeBitsPerBlock[block];
+			kprintf("%c", freeBits == 0 ? '#' : freeBits == min_c(bitsPerBlock,
+				group.NumBits() - block * bitsPerBlock) ? '.' : '+');
+		}
+		kprintf("\n");
+	}
+
+	kprintf("reservations: %" B_PRId32 "\n", fNumReservations);
+	for (int32 i = 0; i < BFS_MAX_RESERVATIONS; i++) {
+		const allocation_reservation& reservation = fReservations[i];
+		if (reservation.length == 0)
+			continue;
+
+		kprintf("  inode %" B_PRIdINO ": %" B_PRId32 ".%u.%u\n",
+			reservation.owner, reservation.group, reservation.start,
+			reservation.length);
 	}
 }
 
@@ -10,6 +10,7 @@
 
 
 class AllocationGroup;
+class BitmapTransactionListener;
 class BPlusTree;
 class Inode;
 class Transaction;
@@ -18,11 +19,25 @@ struct disk_super_block;
 struct block_run;
 struct check_control;
 struct check_cookie;
+struct check_index;
 
 
 //#define DEBUG_ALLOCATION_GROUPS
 //#define DEBUG_FRAGMENTER
 
+#define BFS_MAX_RESERVATIONS	16
+
+
+// An in-memory reservation of the free blocks following the last allocation
+// of a file that is being written; other files only get these blocks if
+// there is no other space left.
+struct allocation_reservation {
+	ino_t			owner;
+	int32			group;
+	uint16			start;
+	uint16			length;
+};
+
 
 class BlockAllocator {
 public:
@@ -44,7 +59,9 @@ public:
 
 			status_t		AllocateBlocks(Transaction& transaction,
 								int32 group, uint16 start, uint16 numBlocks,
-								uint16 minimum, block_run& run);
+								uint16 minimum, block_run& run,
+								ino_t owner = -1);
+			void			ReleaseReservation(ino_t owner);
 
 			status_t		Trim(uint64 offset, uint64 size,
 								uint64& trimmedSize);
@@ -62,6 +79,9 @@ public:
 
 			size_t			BitmapSize() const;
 
+			void			BitmapBlockChanged(Transaction& transaction,
+								AllocationGroup& group, uint32 block);
+
 #ifdef BFS_DEBUGGER_COMMANDS
 			void			Dump(int32 index);
 #endif
@@ -70,19 +90,42 @@ public:
 #endif
 
 private:
+			status_t		_AllocateBlocks(Transaction& transaction,
+								int32 group, uint16 start, uint16 maximum,
+								uint16 minimum, ino_t owner,
+								bool useReserved, block_run& run);
+
+			allocation_reservation* _FindReservation(ino_t owner);
+			void			_NextReservation(int32 group, int32 bit,
+								ino_t owner, int32& start, int32& end) const;
+			void			_Reserve(ino_t owner, const block_run& run);
+			void			_RemoveReservations(int32 group, int32 start,
+								int32 length);
+
 			status_t		_RemoveInvalidNode(Inode* parent, BPlusTree* tree,
 								Inode* inode, const char* name);
 #ifdef DEBUG_ALLOCATION_GROUPS
 			void			_CheckGroup(int32 group) const;
 #endif
+			void			_RecountFreeBits(AllocationGroup* group,
+								uint32 block);
+
 			bool			_IsValidCheckControl(const check_control* control);
 			bool			_CheckBitmapIsUsedAt(off_t block) const;
 			void			_SetCheckBitmapAt(off_t block);
 			status_t		_CheckInodeBlocks(Inode* inode, const char* name);
+			void			_CountFragment(block_run run);
 			status_t		_FinishBitmapPass();
 			status_t		_PrepareIndices();
+			status_t		_FinishIndices();
 			void			_FreeIndices();
 			status_t		_AddInodeToIndex(Inode* inode);
+			status_t		_GetIndexKey(check_index* index, Inode* inode,
+								uint8* key, size_t& keyLength);
+			status_t		_AddIndexEntry(check_index* index, Inode* inode,
+								const uint8* key, size_t keyLength);
+			status_t		_WriteIndexEntries(check_index* index);
+			void			_PutIndexEntries(check_index* index);
 			status_t		_WriteBackCheckBitmap();
 			status_t		_AddTrim(fs_trim_data& trimData, uint32 maxRanges,
 								uint64 offset, uint64 size);
@@ -93,15 +136,25 @@ private:
 	static	status_t		_Initialize(BlockAllocator* self);
 
 private:
+	friend class BitmapTransactionListener;
+
 			Volume*			fVolume;
 			recursive_lock	fLock;
 			AllocationGroup* fGroups;
 			int32			fNumGroups;
 			uint32			fBlocksPerGroup;
 			uint32			fNumBlocks;
+			uint32*			fFreeBitsPerBlock;
+								// number of free bits in each bitmap block
+
+			allocation_reservation fReservations[BFS_MAX_RESERVATIONS];
+			int32			fNumReservations;
+			int32			fNextReservation;
 
 			uint32*			fCheckBitmap;
 			check_cookie*	fCheckCookie;
+
+			BitmapTransactionListener* fTransactionListener;
 };
 
 #ifdef BFS_DEBUGGER_COMMANDS
@@ -342,7 +342,8 @@ Inode::Inode(Volume* volume, ino_t id)
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fWriteCount(0)
 {
 	PRINT(("Inode::Inode(volume = %p, id = %Ld) @ %p\n", volume, id, this));
 
@@ -372,7 +373,8 @@ Inode::Inode(Volume* volume, Transaction& transaction, ino_t id, mode_t mode,
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fWriteCount(0)
 {
 	PRINT(("Inode::Inode(volume = %p, transaction = %p, id = %Ld) @ %p\n",
 		volume, &transaction, id, this));
@@ -1415,7 +1417,16 @@ Inode::AllocatedSize() const
 status_t
 Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 {
-	data_stream* data = &Node().data;
+	return _FindBlockRun(Node().data, pos, run, offset);
+}
+
+
+//!	Like FindBlockRun(), but looks in the given data stream \a stream.
+status_t
+Inode::_FindBlockRun(const data_stream& stream, off_t pos, block_run& run,
+	off_t& offset)
+{
+	const data_stream* data = &stream;
 
 	// find matching block run
 
@@ -1671,6 +1682,110 @@ Inode::_AllocateBlockArray(Transaction& transaction, block_run& run,
 }
 
 
+/*!	Counts the contiguous pieces the first \a size bytes of \a stream are
+	spread over on disk.
+*/
+status_t
+Inode::_CountFragments(const data_stream& stream, off_t size,
+	uint32& fragments)
+{
+	fragments = 0;
+
+	off_t nextBlock = -1;
+	off_t pos = 0;
+	while (pos < size) {
+		block_run run;
+		off_t offset;
+		status_t status = _FindBlockRun(stream, pos, run, offset);
+		if (status != B_OK)
+			return status;
+
+		off_t block = fVolume->ToBlock(run);
+		if (block != nextBlock)
+			fragments++;
+
+		nextBlock = block + run.Length();
+		pos = offset + ((off_t)run.Length() << fVolume->BlockShift());
+	}
+
+	return B_OK;
+}
+
+
+/*!	Copies the bytes from \a pos up to \a end of the \a source stream over
+	to the \a target stream. Both must be multiples of the block size.
+*/
+status_t
+Inode::_CopyStream(Transaction& transaction, const data_stream& source,
+	const data_stream& target, off_t pos, off_t end)
+{
+	const uint32 kCopyBufferSize = 65536;
+	uint32 blockShift = fVolume->BlockShift();
+
+	uint8* buffer = NULL;
+	if (FileCache() != NULL) {
+		buffer = (uint8*)malloc(kCopyBufferSize);
+		if (buffer == NULL)
+			return B_NO_MEMORY;
+	}
+	MemoryDeleter deleter(buffer);
+
+	CachedBlock cachedSource(fVolume);
+	CachedBlock cachedTarget(fVolume);
+
+	while (pos < end) {
+		block_run sourceRun;
+		block_run targetRun;
+		off_t sourceOffset;
+		off_t targetOffset;
+		status_t status = _FindBlockRun(source, pos, sourceRun, sourceOffset);
+		if (status == B_OK)
+			status = _FindBlockRun(target, pos, targetRun, targetOffset);
+		if (status != B_OK)
+			return status;
+
+		off_t sourceBlock = fVolume->ToBlock(sourceRun)
+			+ ((pos - sourceOffset) >> blockShift);
+		off_t targetBlock = fVolume->ToBlock(targetRun)
+			+ ((pos - targetOffset) >> blockShift);
+
+		off_t runEnd = min_c(sourceOffset
+			+ ((off_t)sourceRun.Length() << blockShift), targetOffset
+			+ ((off_t)targetRun.Length() << blockShift));
+		off_t blocks = (min_c(runEnd, end) - pos) >> blockShift;
+
+		if (buffer != NULL) {
+			// Data in the file cache never goes through the block cache
+			blocks = min_c(blocks, kCopyBufferSize >> blockShift);
+			size_t length = blocks << blockShift;
+
+			if (read_pos(fVolume->Device(), sourceBlock << blockShift, buffer,
+					length) != (ssize_t)length
+				|| write_pos(fVolume->Device(), targetBlock << blockShift,
+					buffer, length) != (ssize_t)length)
+				RETURN_ERROR(B_IO_ERROR);
+		} else {
+			for (off_t i = 0; i < blocks; i++) {
+				const uint8* data = cachedSource.SetTo(sourceBlock + i);
+				if (data == NULL)
+					RETURN_ERROR(B_IO_ERROR);
+
+				uint8* copy = cachedTarget.SetToWritable(transaction,
+					targetBlock + i, true);
+				if (copy == NULL)
+					RETURN_ERROR(B_IO_ERROR);
+
+				memcpy(copy, data, fVolume->BlockSize());
+			}
+		}
+
+		pos += blocks << blockShift;
+	}
+
+	return B_OK;
+}
+
+
 /*!	Grows the stream to \a size, and fills the direct/indirect/double indirect
 	ranges with the runs.
 	This method will also determine the size of the preallocation, if any.
@@ -2276,6 +2391,9 @@ Inode::TrimPreallocation(Transaction& transaction)
 	T(Resize(this, max_c(Node().data.MaxDirectRange(),
 		Node().data.MaxIndirectRange()), Size(), true));
 
+	// the file is not being written anymore
+	fVolume->Allocator().ReleaseReservation(ID());
+
 	status_t status = _ShrinkStream(transaction, Size());
 	if (status < B_OK)
 		return status;
@@ -2284,6 +2402,230 @@ Inode::TrimPreallocation(Transaction& transaction)
 }
 
 
+/*!	Returns the number of contiguous pieces the data of this inode is spread
+	over on disk. Preallocated blocks are not taken into account.
+*/
+status_t
+Inode::CountFragments(uint32& fragments)
+{
+	InodeReadLocker locker(this);
+
+	if (IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0) {
+		// This symlink does not have a data stream
+		fragments = 0;
+		return B_OK;
+	}
+
+	return _CountFragments(Node().data,
+		round_up(Size(), fVolume->BlockSize()), fragments);
+}
+
+
+/*!	Moves the data of this inode into as few block runs as the block
+	allocator can find, if that reduces the number of fragments.
+	The new blocks are allocated in a transaction of their own, and the inode
+	is only switched over to them in another one after all data has been
+	copied.
+	The data of inodes with a file cache is copied directly on the device,
+	outside of any transaction; only the inode is locked while copying. If it
+	has been changed by the time it is switched over, B_BUSY is returned.
+	Everything else (directories, indices, attributes without a file cache)
+	is copied through the block cache, and thus has to go through the log.
+	Therefore, the move is split into several transactions that each fit
+	into the log; the journal is locked all the time, so that nobody else
+	can change the inode in between.
+	\a fragments is set to the number of fragments before, and \a newFragments
+	to the number after the operation.
+*/
+status_t
+Inode::Defragment(uint32& fragments, uint32& newFragments)
+{
+	fragments = 0;
+	newFragments = 0;
+
+	if (IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0)
+		return B_OK;
+
+	if (FileCache() == NULL) {
+		Journal* journal = fVolume->GetJournal(0);
+		status_t status = journal->Lock(NULL, true);
+		if (status != B_OK)
+			return status;
+
+		status = _Defragment(fragments, newFragments);
+
+		journal->Unlock(NULL, true);
+		return status;
+	}
+
+	// Write back and remove all cached pages, and keep the file cache from
+	// caching (and writing back) any new ones during the move; until it is
+	// enabled again, all I/O goes through bfs_io(), which has to wait for
+	// the inode lock.
+	// (the FS shell's file cache does not cache anything)
+	status_t status = B_OK;
+#ifndef FS_SHELL
+	status = file_cache_disable(FileCache());
+#endif
+
+	if (status == B_OK) {
+		status = _Defragment(fragments, newFragments);
+
+#ifndef FS_SHELL
+		file_cache_enable(FileCache());
+#endif
+	}
+
+	return status;
+}
+
+
+//!	Frees the blocks of the given \a stream that is not used by this inode.
+status_t
+Inode::_FreeUnusedStream(const data_stream& stream)
+{
+	Transaction transaction(fVolume, BlockNumber());
+	WriteLockInTransaction(transaction);
+
+	data_stream oldStream = Node().data;
+	Node().data = stream;
+	status_t status = _ShrinkStream(transaction, 0);
+	Node().data = oldStream;
+
+	if (status == B_OK)
+		status = transaction.Done();
+	if (status != B_OK) {
+		FATAL(("Could not free the unused data stream of inode %" B_PRIdINO
+			": %s\n", ID(), strerror(status)));
+	}
+	return status;
+}
+
+
+/*!	Does the actual work for Defragment(); if the inode has a file cache,
+	it must be disabled, otherwise the journal must be locked.
+*/
+status_t
+Inode::_Defragment(uint32& fragments, uint32& newFragments)
+{
+	status_t status = CountFragments(fragments);
+	newFragments = fragments;
+	if (status != B_OK || fragments <= 1)
+		return status;
+
+	off_t size;
+	data_stream oldStream;
+	data_stream newStream;
+
+	{
+		// Let the allocator build a completely new stream; the inode keeps
+		// its old stream until all data has been copied. If this transaction
+		// fails, the inode is reverted from disk.
+		Transaction transaction(fVolume, BlockNumber());
+		WriteLockInTransaction(transaction);
+
+		size = round_up(Size(), fVolume->BlockSize());
+		oldStream = Node().data;
+		memset(&Node().data, 0, sizeof(data_stream));
+
+		status = _GrowStream(transaction, size);
+		if (status == B_OK) {
+			// we don't want any preallocated blocks here
+			status = _ShrinkStream(transaction, size);
+		}
+		if (status == B_OK)
+			status = _CountFragments(Node().data, size, newFragments);
+		if (status != B_OK || newFragments >= fragments) {
+			// The free space is not any better than what we have already
+			newFragments = fragments;
+			return status;
+		}
+
+		newStream = Node().data;
+		Node().data = oldStream;
+
+		status = transaction.Done();
+		if (status != B_OK) {
+			newFragments = fragments;
+			return status;
+		}
+	}
+
+	int32 writeCount = fWriteCount;
+
+	if (FileCache() != NULL) {
+		// The data never goes through the block cache, so it can be copied
+		// without a transaction; holding the inode lock keeps bfs_io() from
+		// accessing it meanwhile.
+		WriteLocker locker(fLock);
+
+		if (memcmp(&Node().data, &oldStream, sizeof(data_stream)) != 0)
+			status = B_BUSY;
+		else {
+			writeCount = fWriteCount;
+
+			Transaction transaction;
+			status = _CopyStream(transaction, oldStream, newStream, 0, size);
+		}
+
+		locker.Unlock();
+
+		// The data must be on disk before the inode refers to it
+		if (status == B_OK)
+			ioctl(fVolume->Device(), B_FLUSH_DRIVE_CACHE);
+	} else {
+		// Copy the data in chunks that each fit into the log
+		off_t chunkSize = (off_t)max_c(
+			fVolume->GetJournal(0)->MaxTransactionSize() / 2, 1)
+				<< fVolume->BlockShift();
+
+		for (off_t pos = 0; pos < size && status == B_OK; pos += chunkSize) {
+			Transaction transaction(fVolume, BlockNumber());
+			status = _CopyStream(transaction, oldStream, newStream, pos,
+				min_c(pos + chunkSize, size));
+			if (status == B_OK)
+				status = transaction.Done();
+		}
+	}
+
+	if (status == B_OK) {
+		// Switch to the new stream, and free the old one, including its
+		// indirect arrays
+		Transaction transaction(fVolume, BlockNumber());
+		WriteLockInTransaction(transaction);
+
+		if (memcmp(&Node().data, &oldStream, sizeof(data_stream)) != 0
+			|| fWriteCount != writeCount) {
+			// The inode has been changed after we copied it; nothing has
+			// been changed in this transaction yet, though.
+			transaction.Done();
+			status = B_BUSY;
+		} else {
+			status = _ShrinkStream(transaction, 0);
+			if (status == B_OK) {
+				Node().data = newStream;
+				Node().data.size = oldStream.size;
+				status = WriteBack(transaction);
+			}
+			if (status == B_OK)
+				status = transaction.Done();
+		}
+	}
+
+	if (status != B_OK) {
+		// Give back the new blocks; the inode has its old stream again
+		_FreeUnusedStream(newStream);
+		newFragments = fragments;
+		return status;
+	}
+
+	if (Map() != NULL)
+		file_map_invalidate(Map(), 0, Size());
+
+	return B_OK;
+}
+
+
 //!	Frees the file's data stream and removes all attributes
 status_t
 Inode::Free(Transaction& transaction)
@@ -2293,6 +2635,9 @@ Inode::Free(Transaction& transaction)
 	// Perhaps there should be an implementation of Inode::ShrinkStream() that
 	// just frees the data_stream, but doesn't change the inode (since it is
 	// freed anyway) - that would make an undelete command possible
+	if (IsFile())
+		fVolume->Allocator().ReleaseReservation(ID());
+
 	if (!IsSymLink() || (Flags() & INODE_LONG_SYMLINK) != 0) {
 		status_t status = SetFileSize(transaction, 0);
 		if (status < B_OK)
@@ -137,6 +137,9 @@ public:
 			// manipulating the data stream
 			status_t			FindBlockRun(off_t pos, block_run& run,
 									off_t& offset);
+			status_t			CountFragments(uint32& fragments);
+			status_t			Defragment(uint32& fragments,
+									uint32& newFragments);
 
 			status_t			ReadAt(off_t pos, uint8* buffer, size_t* length);
 			status_t			WriteAt(Transaction& transaction, off_t pos,
@@ -184,6 +187,8 @@ public:
 			void				SetFileCache(void* cache) { fCache = cache; }
 			void*				Map() const { return fMap; }
 			void				SetMap(void* map) { fMap = map; }
+			void				IncrementWriteCount()
+									{ atomic_add(&fWriteCount, 1); }
 
 #if _KERNEL_MODE && KDEBUG
 			void				AssertReadLocked()
@@ -232,6 +237,18 @@ private:
 			void				_AddIterator(AttributeIterator* iterator);
 			void				_RemoveIterator(AttributeIterator* iterator);
 
+			status_t			_FindBlockRun(const data_stream& stream,
+									off_t pos, block_run& run, off_t& offset);
+			status_t			_CountFragments(const data_stream& stream,
+									off_t size, uint32& fragments);
+			status_t			_CopyStream(Transaction& transaction,
+									const data_stream& source,
+									const data_stream& target, off_t pos,
+									off_t end);
+			status_t			_Defragment(uint32& fragments,
+									uint32& newFragments);
+			status_t			_FreeUnusedStream(const data_stream& stream);
+
 			size_t				_DoubleIndirectBlockLength() const;
 			status_t			_FreeStaticStreamArray(Transaction& transaction,
 									int32 level, block_run run, off_t size,
@@ -255,6 +272,9 @@ private:
 			Inode*				fAttributes;
 			void*				fCache;
 			void*				fMap;
+			int32				fWriteCount;
+				// counts the writes done through bfs_io(), so that
+				// Defragment() can tell whether the data has changed
 			bfs_inode			fNode;
 
 			off_t				fOldSize;
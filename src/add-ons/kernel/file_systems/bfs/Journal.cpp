@@ -141,6 +141,9 @@ private:
 //	#pragma mark -
 
 
+static const int32 kMaxLogVecs = 256;
+
+
 static void
 add_to_iovec(iovec* vecs, int32& index, int32 max, const void* address,
 	size_t size)
@@ -405,15 +408,34 @@ Journal::Journal(Volume* volume)
 	fUsed(0),
 	fUnwrittenTransactions(0),
 	fHasSubtransaction(false),
-	fSeparateSubTransactions(false)
+	fSeparateSubTransactions(false),
+	fLogWriterThread(-1),
+	fLogWriterQuit(false)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
+
+	fLogWriterSem = create_sem(0, "bfs log writer");
+	if (fLogWriterSem >= 0) {
+		fLogWriterThread = spawn_kernel_thread(&Journal::_LogWriter,
+			"bfs log writer", B_NORMAL_PRIORITY, this);
+		if (fLogWriterThread >= 0)
+			resume_thread(fLogWriterThread);
+	}
 }
 
 
 Journal::~Journal()
 {
+	if (fLogWriterThread >= 0) {
+		fLogWriterQuit = true;
+		release_sem(fLogWriterSem);
+
+		status_t result;
+		wait_for_thread(fLogWriterThread, &result);
+	}
+	delete_sem(fLogWriterSem);
+
 	FlushLogAndBlocks();
 
 	recursive_lock_destroy(&fLock);
@@ -424,6 +446,11 @@ Journal::~Journal()
 status_t
 Journal::InitCheck()
 {
+	if (fLogWriterSem < 0)
+		return fLogWriterSem;
+	if (fLogWriterThread < 0)
+		return fLogWriterThread;
+
 	return B_OK;
 }
 
@@ -686,18 +713,87 @@ Journal::_TransactionIdle(int32 transactionID, int32 event, void* _journal)
 {
 	// The current transaction seems to be idle - flush it. We can't do this
 	// in this thread, as flushing the log can produce new transaction events.
-	thread_id id = spawn_kernel_thread(&Journal::_FlushLog, "bfs log flusher",
-		B_NORMAL_PRIORITY, _journal);
-	if (id > 0)
-		resume_thread(id);
+	Journal* journal = (Journal*)_journal;
+	release_sem_etc(journal->fLogWriterSem, 1, B_DO_NOT_RESCHEDULE);
 }
 
 
+/*!	The log writer thread writes the current log entry to disk whenever it
+	is asked to, either because the transaction became idle, or because it
+	grew large enough. All transactions that have been finished until it
+	gets hold of the journal lock are written together in a single log entry,
+	and the thread finishing a transaction does not have to wait for the
+	log to be written.
+*/
 /*static*/ status_t
-Journal::_FlushLog(void* _journal)
+Journal::_LogWriter(void* _journal)
 {
 	Journal* journal = (Journal*)_journal;
-	return journal->_FlushLog(false, false);
+
+	while (true) {
+		status_t status = acquire_sem(journal->fLogWriterSem);
+		if (status != B_OK || journal->fLogWriterQuit)
+			break;
+
+		// Merge all requests that came in in the mean time
+		int32 count;
+		if (get_sem_count(journal->fLogWriterSem, &count) == B_OK
+			&& count > 0) {
+			acquire_sem_etc(journal->fLogWriterSem, count, 0, 0);
+		}
+
+		journal->_FlushLog(true, false);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Writes the \a count blocks in the \a index \a vecs to the log, starting
+	at \a logStart. Afterwards, \a logStart points to the block after them,
+	and \a index and \a count are reset.
+*/
+status_t
+Journal::_WriteLogVecs(const iovec* vecs, int32& index, int32& count,
+	off_t& logStart)
+{
+	off_t logOffset = fVolume->ToBlock(fVolume->Log()) << fVolume->BlockShift();
+	ssize_t written = writev_pos(fVolume->Device(),
+		logOffset + (logStart << fVolume->BlockShift()), vecs, index);
+
+	logStart = (logStart + count) % fLogSize;
+	index = 0;
+	count = 0;
+
+	if (written < 0) {
+		FATAL(("could not write log area: %s!\n", strerror(written)));
+		return written;
+	}
+	return B_OK;
+}
+
+
+/*!	Releases the blocks of the \a runArrays that have been acquired for
+	writing them to the log, up to (but not including) block \a block of
+	run \a run in array \a array.
+*/
+void
+Journal::_ReleaseLogBlocks(RunArrays& runArrays, int32 array, int32 run,
+	int32 block)
+{
+	for (int32 k = 0; k <= array && k < runArrays.CountArrays(); k++) {
+		run_array* runArray = runArrays.ArrayAt(k);
+		int32 runCount = k < array ? runArray->CountRuns() : run + 1;
+
+		for (int32 i = 0; i < runCount && i < runArray->CountRuns(); i++) {
+			const block_run& blockRun = runArray->RunAt(i);
+			off_t blockNumber = fVolume->ToBlock(blockRun);
+			int32 length = k < array || i < run ? blockRun.Length() : block;
+
+			for (int32 j = 0; j < length; j++)
+				block_cache_put(fVolume->BlockCache(), blockNumber + j);
+		}
+	}
 }
 
 
@@ -732,10 +828,8 @@ Journal::_WriteTransactionToLog()
 
 	fHasSubtransaction = false;
 
-	int32 blockShift = fVolume->BlockShift();
-	off_t logOffset = fVolume->ToBlock(fVolume->Log()) << blockShift;
 	off_t logStart = fVolume->LogEnd() % fLogSize;
-	off_t logPosition = logStart;
+	off_t logPosition;
 	status_t status;
 
 	// create run_array structures for all changed blocks
@@ -778,23 +872,27 @@ Journal::_WriteTransactionToLog()
 		}
 	}
 
-	// Write log entries to disk
-
-	int32 maxVecs = runArrays.MaxArrayLength() + 1;
-		// one extra for the index block
+	// Write log entries to disk; the blocks of all run arrays are collected
+	// into as few writes as possible, only the end of the log area, and the
+	// maximum number of vecs force us to write them in several parts
 
+	int32 maxVecs = min_c((int32)runArrays.LogEntryLength(), kMaxLogVecs);
 	iovec* vecs = (iovec*)malloc(sizeof(iovec) * maxVecs);
 	if (vecs == NULL) {
 		// TODO: write back log entries directly?
 		return B_NO_MEMORY;
 	}
 
+	int32 index = 0, count = 0;
+
 	for (int32 k = 0; k < runArrays.CountArrays(); k++) {
 		run_array* array = runArrays.ArrayAt(k);
-		int32 index = 0, count = 1;
-		int32 wrap = fLogSize - logStart;
+
+		if (count >= fLogSize - logStart || index == maxVecs)
+			_WriteLogVecs(vecs, index, count, logStart);
 
 		add_to_iovec(vecs, index, maxVecs, (void*)array, fVolume->BlockSize());
+		count++;
 
 		// add block runs
 
@@ -803,24 +901,17 @@ Journal::_WriteTransactionToLog()
 			off_t blockNumber = fVolume->ToBlock(run);
 
 			for (int32 j = 0; j < run.Length(); j++) {
-				if (count >= wrap) {
-					// We need to write back the first half of the entry
-					// directly as the log wraps around
-					if (writev_pos(fVolume->Device(), logOffset
-						+ (logStart << blockShift), vecs, index) < 0)
-						FATAL(("could not write log area!\n"));
-
-					logPosition = logStart + count;
-					logStart = 0;
-					wrap = fLogSize;
-					count = 0;
-					index = 0;
+				if (count >= fLogSize - logStart || index == maxVecs) {
+					// We need to write back the first part of the entry
+					// directly as the log wraps around, or we ran out of vecs
+					_WriteLogVecs(vecs, index, count, logStart);
 				}
 
 				// make blocks available in the cache
 				const void* data = block_cache_get(fVolume->BlockCache(),
 					blockNumber + j);
 				if (data == NULL) {
+					_ReleaseLogBlocks(runArrays, k, i, j);
 					free(vecs);
 					return B_IO_ERROR;
 				}
@@ -829,27 +920,15 @@ Journal::_WriteTransactionToLog()
 				count++;
 			}
 		}
+	}
 
-		// write back the rest of the log entry
-		if (count > 0) {
-			logPosition = logStart + count;
-			if (writev_pos(fVolume->Device(), logOffset
-					+ (logStart << blockShift), vecs, index) < 0)
-				FATAL(("could not write log area: %s!\n", strerror(errno)));
-		}
-
-		// release blocks again
-		for (int32 i = 0; i < array->CountRuns(); i++) {
-			const block_run& run = array->RunAt(i);
-			off_t blockNumber = fVolume->ToBlock(run);
-
-			for (int32 j = 0; j < run.Length(); j++) {
-				block_cache_put(fVolume->BlockCache(), blockNumber + j);
-			}
-		}
+	// write back the rest of the log entry
+	logPosition = logStart + count;
+	if (count > 0)
+		_WriteLogVecs(vecs, index, count, logStart);
 
-		logStart = logPosition % fLogSize;
-	}
+	// release blocks again
+	_ReleaseLogBlocks(runArrays, runArrays.CountArrays(), 0, 0);
 
 	free(vecs);
 
@@ -1076,6 +1155,13 @@ Journal::_TransactionDone(bool success)
 			cache_sync_transaction(fVolume->BlockCache(), fTransactionID);
 
 		fUnwrittenTransactions++;
+
+		// Once the batch has reached a certain size, let the log writer
+		// write it in the background; it will also include everything that
+		// is added until it gets hold of the journal lock
+		if (size >= fMaxTransactionSize / 2)
+			release_sem_etc(fLogWriterSem, 1, B_DO_NOT_RESCHEDULE);
+
 		return B_OK;
 	}
 
@@ -14,6 +14,7 @@
 
 struct run_array;
 class Inode;
+class RunArrays;
 class LogEntry;
 typedef DoublyLinkedList<LogEntry> LogEntryList;
 
@@ -40,6 +41,8 @@ public:
 			int32			TransactionID() const { return fTransactionID; }
 
 	inline	uint32			FreeLogBlocks() const;
+			uint32			MaxTransactionSize() const
+								{ return fMaxTransactionSize; }
 
 #ifdef BFS_DEBUGGER_COMMANDS
 			void			Dump();
@@ -52,6 +55,10 @@ private:
 			status_t		_FlushLog(bool canWait, bool flushBlocks);
 			uint32			_TransactionSize() const;
 			status_t		_WriteTransactionToLog();
+			status_t		_WriteLogVecs(const iovec* vecs, int32& index,
+								int32& count, off_t& logStart);
+			void			_ReleaseLogBlocks(RunArrays& runArrays,
+								int32 array, int32 run, int32 block);
 			status_t		_CheckRunArray(const run_array* array);
 			status_t		_ReplayRunArray(int32* start);
 			status_t		_TransactionDone(bool success);
@@ -60,7 +67,7 @@ private:
 								int32 event, void* _logEntry);
 	static	void			_TransactionIdle(int32 transactionID, int32 event,
 								void* _journal);
-	static	status_t		_FlushLog(void* _journal);
+	static	status_t		_LogWriter(void* _journal);
 
 private:
 			Volume*			fVolume;
@@ -76,6 +83,10 @@ private:
 			int32			fTransactionID;
 			bool			fHasSubtransaction;
 			bool			fSeparateSubTransactions;
+
+			sem_id			fLogWriterSem;
+			thread_id		fLogWriterThread;
+			bool			fLogWriterQuit;
 };
 
 
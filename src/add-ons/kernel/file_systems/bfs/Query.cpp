@@ -150,6 +150,10 @@ private:
 			uint8*		Value() const { return (uint8*)&fValue; }
 			status_t	MatchEmptyString();
 
+			status_t	_FillCandidates(Volume* volume,
+							TreeIterator* iterator);
+			void		_PrefetchCandidates(Volume* volume);
+
 			char*		fAttribute;
 			char*		fString;
 			union value fValue;
@@ -160,6 +164,15 @@ private:
 
 			int32		fScore;
 			bool		fHasIndex;
+
+	static	const int32	kMaxCandidates = 32;
+
+			off_t		fCandidates[kMaxCandidates];
+			int32		fCandidateCount;
+			int32		fCandidateIndex;
+			status_t	fCandidateStatus;
+				// the index entries that still need to be checked, and what
+				// the iterator reported after the last one
 };
 
 
@@ -207,7 +220,10 @@ Equation::Equation(char** expr)
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
-	fIsPattern(false)
+	fIsPattern(false),
+	fCandidateCount(0),
+	fCandidateIndex(0),
+	fCandidateStatus(B_OK)
 {
 	char* string = *expr;
 	char* start = string;
@@ -673,6 +689,10 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 {
 	status_t status = index.SetTo(fAttribute);
 
+	fCandidateCount = 0;
+	fCandidateIndex = 0;
+	fCandidateStatus = B_OK;
+
 	// if we should query attributes without an index, we can just proceed here
 	if (status != B_OK && !queryNonIndexed)
 		return B_ENTRY_NOT_FOUND;
@@ -764,11 +784,18 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 }
 
 
+/*!	Reads the next batch of index entries whose keys match the equation,
+	and lets the block cache read in their inodes in the background, so that
+	checking them doesn't have to wait for each inode in turn.
+	Returns an error if there are no more entries.
+*/
 status_t
-Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
-	struct dirent* dirent, size_t bufferSize)
+Equation::_FillCandidates(Volume* volume, TreeIterator* iterator)
 {
-	while (true) {
+	fCandidateCount = 0;
+	fCandidateIndex = 0;
+
+	while (fCandidateStatus == B_OK && fCandidateCount < kMaxCandidates) {
 		union value indexValue;
 		uint16 keyLength;
 		uint16 duplicate;
@@ -776,8 +803,10 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 
 		status_t status = iterator->GetNextEntry(&indexValue, &keyLength,
 			(uint16)sizeof(indexValue), &offset, &duplicate);
-		if (status != B_OK)
-			return status;
+		if (status != B_OK) {
+			fCandidateStatus = status;
+			break;
+		}
 
 		// only compare against the index entry when this is the correct
 		// index for the equation
@@ -789,14 +818,77 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			// fit.
 			if (fOp == OP_LESS_THAN
 				|| fOp == OP_LESS_THAN_OR_EQUAL
-				|| (fOp == OP_EQUAL && !fIsPattern))
-				return B_ENTRY_NOT_FOUND;
+				|| (fOp == OP_EQUAL && !fIsPattern)) {
+				fCandidateStatus = B_ENTRY_NOT_FOUND;
+				break;
+			}
 
 			if (duplicate > 0)
 				iterator->SkipDuplicates();
 			continue;
 		}
 
+		fCandidates[fCandidateCount++] = offset;
+	}
+
+	if (fCandidateCount == 0)
+		return fCandidateStatus;
+
+	_PrefetchCandidates(volume);
+	return B_OK;
+}
+
+
+/*!	Starts reading the inodes of the current candidates, merging adjacent
+	inodes into a single request.
+*/
+void
+Equation::_PrefetchCandidates(Volume* volume)
+{
+	if (fCandidateCount < 2 || !volume->PrefetchesQueries())
+		return;
+
+	off_t blocks[kMaxCandidates];
+	int32 count = 0;
+
+	// sort the inode block numbers (insertion sort is fine for so few)
+	for (int32 i = 0; i < fCandidateCount; i++) {
+		off_t block = fCandidates[i];
+		int32 j = count;
+		for (; j > 0 && blocks[j - 1] > block; j--)
+			blocks[j] = blocks[j - 1];
+		blocks[j] = block;
+		count++;
+	}
+
+	for (int32 i = 0; i < count;) {
+		int32 length = 1;
+		while (i + length < count
+			&& blocks[i + length] <= blocks[i] + length) {
+			length++;
+		}
+
+		block_cache_prefetch(volume->BlockCache(), blocks[i],
+			blocks[i + length - 1] - blocks[i] + 1);
+		i += length;
+	}
+}
+
+
+status_t
+Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
+	struct dirent* dirent, size_t bufferSize)
+{
+	while (true) {
+		if (fCandidateIndex >= fCandidateCount) {
+			status_t status = _FillCandidates(volume, iterator);
+			if (status != B_OK)
+				return status;
+		}
+
+		off_t offset = fCandidates[fCandidateIndex++];
+		status_t status;
+
 		Vnode vnode(volume, offset);
 		Inode* inode;
 		if ((status = vnode.Get(&inode)) != B_OK) {
@@ -18,7 +18,8 @@ class Query;
 
 
 enum volume_flags {
-	VOLUME_READ_ONLY	= 0x0001
+	VOLUME_READ_ONLY			= 0x0001,
+	VOLUME_NO_QUERY_PREFETCH	= 0x0002
 };
 
 enum volume_initialize_flags {
@@ -43,6 +44,8 @@ public:
 			bool			IsValidSuperBlock() const;
 			bool			IsValidInodeBlock(off_t block) const;
 			bool			IsReadOnly() const;
+			bool			PrefetchesQueries() const;
+			void			SetPrefetchesQueries(bool prefetch);
 			void			Panic();
 			mutex&			Lock();
 
@@ -186,6 +189,23 @@ Volume::IsReadOnly() const
 }
 
 
+inline bool
+Volume::PrefetchesQueries() const
+{
+	 return (fFlags & VOLUME_NO_QUERY_PREFETCH) == 0;
+}
+
+
+inline void
+Volume::SetPrefetchesQueries(bool prefetch)
+{
+	if (prefetch)
+		fFlags &= ~VOLUME_NO_QUERY_PREFETCH;
+	else
+		fFlags |= VOLUME_NO_QUERY_PREFETCH;
+}
+
+
 inline mutex&
 Volume::Lock()
 {
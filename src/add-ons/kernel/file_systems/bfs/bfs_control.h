@@ -51,6 +51,7 @@ struct check_control {
 	ino_t		inode;
 	uint32		mode;
 	uint32		errors;
+	uint32		fragments;
 	struct {
 		uint64	missing;
 		uint64	already_set;
@@ -65,6 +66,8 @@ struct check_control {
 		uint64	blocks_in_indirect;
 		uint64	blocks_in_double_indirect;
 		uint64	partial_block_runs;
+		uint64	fragmented_nodes;
+		uint64	fragments;
 		uint32	block_size;
 	} stats;
 	status_t	status;
@@ -97,5 +100,38 @@ struct check_control {
 /* check control magic value */
 #define BFS_IOCTL_CHECK_MAGIC	'BChk'
 
+/* ioctl to move the data of the file or directory it is called on into as
+ * few contiguous block runs as possible - the parameter is a
+ * struct defragment_control. "magic" and "flags" must be set, the other
+ * fields are filled in by the file system.
+ * Unless only counting, the file must be open for writing, or the caller
+ * must be root; directories can only be moved by root. If the file is
+ * written to while its data is being moved, B_BUSY is returned, and nothing
+ * is changed. If the system crashes during the move, the blocks that were
+ * allocated for the new location stay in use until the volume is checked.
+ */
+#define BFS_IOCTL_DEFRAGMENT		14205
+
+struct defragment_control {
+	uint32		magic;
+	uint32		flags;
+	uint32		fragments;
+	uint32		new_fragments;
+};
+
+/* values for the flags field */
+#define BFS_DEFRAGMENT_COUNT_ONLY	1
+	/* only report the number of fragments, don't move anything */
+
+/* defragment control magic value */
+#define BFS_IOCTL_DEFRAGMENT_MAGIC	'BDfr'
+
+/* ioctl to turn prefetching the inodes of query candidates on (the default)
+ * or off for the volume, to measure its effect - the parameter is an int32
+ * that is 0 to turn it off. Only root may use it, and it is not remembered
+ * across mounts.
+ */
+#define BFS_IOCTL_PREFETCH_QUERIES	14206
+
 
 #endif	/* BFS_CONTROL_H */
@@ -102,6 +102,10 @@ iterative_io_finished_hook(void* cookie, io_request* request, status_t status,
 	bool partialTransfer, size_t bytesTransferred)
 {
 	Inode* inode = (Inode*)cookie;
+#ifndef FS_SHELL
+	if (io_request_is_write(request))
+		inode->IncrementWriteCount();
+#endif
 	rw_lock_read_unlock(&inode->Lock());
 	return B_OK;
 }
@@ -178,6 +182,10 @@ bfs_mount(fs_volume* _volume, const char* device, uint32 flags,
 	_volume->ops = &gBFSVolumeOps;
 	*_rootID = volume->ToVnode(volume->Root());
 
+	// We keep the entry cache up to date, and notify about all changes, so
+	// it can also tell which entries don't exist.
+	entry_cache_enable_complete_directories(_volume->id);
+
 	INFORM(("mounted \"%s\" (root node at %" B_PRIdINO ", device = %s)\n",
 		volume->Name(), *_rootID, device));
 	return B_OK;
@@ -719,6 +727,55 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 
 			return volume->WriteSuperBlock();
 		}
+		case BFS_IOCTL_PREFETCH_QUERIES:
+		{
+			if (geteuid() != 0)
+				return B_PERMISSION_DENIED;
+
+			int32 prefetch;
+			if (bufferLength != sizeof(int32))
+				return B_BAD_VALUE;
+			if (user_memcpy(&prefetch, buffer, sizeof(int32)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			volume->SetPrefetchesQueries(prefetch != 0);
+			return B_OK;
+		}
+		case BFS_IOCTL_DEFRAGMENT:
+		{
+			Inode* inode = (Inode*)_node->private_node;
+			defragment_control control;
+			if (bufferLength != sizeof(defragment_control))
+				return B_BAD_VALUE;
+			if (user_memcpy(&control, buffer, sizeof(defragment_control))
+					!= B_OK)
+				return B_BAD_ADDRESS;
+			if (control.magic != BFS_IOCTL_DEFRAGMENT_MAGIC)
+				return B_BAD_VALUE;
+
+			status_t status;
+			if ((control.flags & BFS_DEFRAGMENT_COUNT_ONLY) != 0) {
+				status = inode->CountFragments(control.fragments);
+				control.new_fragments = control.fragments;
+			} else {
+				if (volume->IsReadOnly())
+					return B_READ_ONLY_DEVICE;
+
+				// Only root may move around the data of files it cannot
+				// write to, and of directories
+				file_cookie* cookie = (file_cookie*)_cookie;
+				if (geteuid() != 0 && (!inode->IsFile()
+						|| (cookie->open_mode & O_RWMASK) == O_RDONLY))
+					return B_PERMISSION_DENIED;
+
+				status = inode->Defragment(control.fragments,
+					control.new_fragments);
+			}
+			if (status != B_OK)
+				return status;
+
+			return user_memcpy(buffer, &control, sizeof(defragment_control));
+		}
 
 #ifdef DEBUG_FRAGMENTER
 		case 56741:
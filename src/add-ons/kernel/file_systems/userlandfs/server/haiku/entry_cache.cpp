@@ -22,3 +22,10 @@ entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 {
 	return B_OK;
 }
+
+
+status_t
+entry_cache_enable_complete_directories(dev_t mountID)
+{
+	return B_OK;
+}
@@ -331,9 +331,9 @@ X86PagingMethod64Bit::PageTableForAddress(uint64* virtualPML4,
 		mapCount++;
 	}
 
-	// No proper large page support at the moment, but they are used for the
-	// physical map area. Ensure that nothing tries to treat that as normal
-	// address space.
+	// Large pages are used for the physical map area and for areas mapped via
+	// X86VMTranslationMap64Bit::MapLargePage(). The latter are split by the
+	// translation map before it accesses the page table.
 	ASSERT(!(*pde & X86_64_PDE_LARGE_PAGE));
 
 	return (uint64*)pageMapper->GetPageTableAt(*pde & X86_64_PDE_ADDRESS_MASK);
@@ -362,24 +362,55 @@ X86PagingMethod64Bit::PutPageTableEntryInTable(uint64* entry,
 {
 	uint64 page = (physicalAddress & X86_64_PTE_ADDRESS_MASK)
 		| X86_64_PTE_PRESENT | (globalPage ? X86_64_PTE_GLOBAL : 0)
-		| MemoryTypeToPageTableEntryFlags(memoryType);
+		| MemoryTypeToPageTableEntryFlags(memoryType)
+		| _AttributesToPageTableEntryFlags(attributes);
 
+	// put it in the page table
+	SetTableEntry(entry, page);
+}
+
+
+/*!	Maps a 2 MB page directly from the page directory entry \a entry.
+	\a physicalAddress must be aligned to k64BitPageTableRange.
+*/
+/*static*/ void
+X86PagingMethod64Bit::PutLargePageEntryInDirectory(uint64* entry,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	bool globalPage)
+{
+	ASSERT(physicalAddress % k64BitPageTableRange == 0);
+
+	// The protection and memory type bits are at the same positions in page
+	// directory and page table entries (we never use the PAT bit).
+	uint64 page = (physicalAddress & X86_64_PDE_ADDRESS_MASK)
+		| X86_64_PDE_PRESENT | X86_64_PDE_LARGE_PAGE
+		| (globalPage ? X86_64_PDE_GLOBAL : 0)
+		| MemoryTypeToPageTableEntryFlags(memoryType)
+		| _AttributesToPageTableEntryFlags(attributes);
+
+	SetTableEntry(entry, page);
+}
+
+
+/*static*/ uint64
+X86PagingMethod64Bit::_AttributesToPageTableEntryFlags(uint32 attributes)
+{
 	// if the page is user accessible, it's automatically
 	// accessible in kernel space, too (but with the same
 	// protection)
+	uint64 flags = 0;
 	if ((attributes & B_USER_PROTECTION) != 0) {
-		page |= X86_64_PTE_USER;
+		flags |= X86_64_PTE_USER;
 		if ((attributes & B_WRITE_AREA) != 0)
-			page |= X86_64_PTE_WRITABLE;
+			flags |= X86_64_PTE_WRITABLE;
 		if ((attributes & B_EXECUTE_AREA) == 0
 			&& x86_check_feature(IA32_FEATURE_AMD_EXT_NX, FEATURE_EXT_AMD)) {
-			page |= X86_64_PTE_NOT_EXECUTABLE;
+			flags |= X86_64_PTE_NOT_EXECUTABLE;
 		}
 	} else if ((attributes & B_KERNEL_WRITE_AREA) != 0)
-		page |= X86_64_PTE_WRITABLE;
+		flags |= X86_64_PTE_WRITABLE;
 
-	// put it in the page table
-	SetTableEntry(entry, page);
+	return flags;
 }
 
 
@@ -87,6 +87,10 @@ public:
 									uint64* entry, phys_addr_t physicalAddress,
 									uint32 attributes, uint32 memoryType,
 									bool globalPage);
+	static	void				PutLargePageEntryInDirectory(
+									uint64* entry, phys_addr_t physicalAddress,
+									uint32 attributes, uint32 memoryType,
+									bool globalPage);
 	static	void				SetTableEntry(uint64_t* entry,
 									uint64_t newEntry);
 	static	uint64_t			SetTableEntryFlags(uint64_t* entryPointer,
@@ -101,6 +105,8 @@ public:
 									uint32 memoryType);
 
 private:
+	static	uint64				_AttributesToPageTableEntryFlags(
+									uint32 attributes);
 	static	void				_EnableExecutionDisable(void* dummy, int cpu);
 
 			phys_addr_t			fKernelPhysicalPML4;
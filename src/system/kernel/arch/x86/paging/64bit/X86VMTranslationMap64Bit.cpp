@@ -71,6 +71,10 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0)
 						continue;
 
+					// Large pages map pages of an area, not a page table.
+					if ((virtualPageDir[k] & X86_64_PDE_LARGE_PAGE) != 0)
+						continue;
+
 					address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
 					page = vm_lookup_page(address / B_PAGE_SIZE);
 					if (page == NULL) {
@@ -235,6 +239,18 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
+		uint64* largePage = _LargePageForRange(start, end);
+		if (largePage != NULL) {
+			uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(largePage);
+			fMapCount -= k64BitTableEntryCount;
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			start += k64BitPageTableRange;
+			continue;
+		}
+
 		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
 			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
 			NULL, fPageMapper, fMapCount);
@@ -271,6 +287,77 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 }
 
 
+size_t
+X86VMTranslationMap64Bit::LargePageSize() const
+{
+	return k64BitPageTableRange;
+}
+
+
+status_t
+X86VMTranslationMap64Bit::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	TRACE("X86VMTranslationMap64Bit::MapLargePage(%#" B_PRIxADDR ", %#"
+		B_PRIxPHYSADDR ")\n", virtualAddress, physicalAddress);
+
+	ASSERT(virtualAddress % k64BitPageTableRange == 0);
+	ASSERT(physicalAddress % k64BitPageTableRange == 0);
+
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	// Look up the page directory entry for the virtual address, allocating
+	// the page directory and PDPT if required.
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		true, reservation, fPageMapper, fMapCount);
+	ASSERT(pde != NULL);
+
+	if ((*pde & X86_64_PDE_PRESENT) != 0) {
+		ASSERT((*pde & X86_64_PDE_LARGE_PAGE) == 0);
+
+		// Page tables are not freed when their last page is unmapped, so
+		// there may be one left over from an earlier mapping. We can replace
+		// it, if it's unused.
+		phys_addr_t physicalPageTable = *pde & X86_64_PDE_ADDRESS_MASK;
+		uint64* pageTable = (uint64*)fPageMapper->GetPageTableAt(
+			physicalPageTable);
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+			if ((pageTable[i] & X86_64_PTE_PRESENT) != 0)
+				return B_BUSY;
+		}
+
+		X86PagingMethod64Bit::ClearTableEntry(pde);
+
+		// Other CPUs may still have the page table in their paging structure
+		// caches, so we need to flush those before freeing it.
+		InvalidatePage(virtualAddress);
+		Flush();
+
+		vm_page* page = vm_lookup_page(physicalPageTable / B_PAGE_SIZE);
+		if (page == NULL) {
+			panic("page table for %#" B_PRIxADDR " on invalid page %#"
+				B_PRIxPHYSADDR "\n", virtualAddress, physicalPageTable);
+		}
+
+		DEBUG_PAGE_ACCESS_START(page);
+		vm_page_set_state(page, PAGE_STATE_FREE);
+		fMapCount--;
+	}
+
+	X86PagingMethod64Bit::PutLargePageEntryInDirectory(pde, physicalAddress,
+		attributes, memoryType, fIsKernelMap);
+
+	// As with Map(), the entry was not present before, so there is no need to
+	// invalidate the TLB.
+
+	fMapCount += k64BitTableEntryCount;
+
+	return B_OK;
+}
+
+
 status_t
 X86VMTranslationMap64Bit::DebugMarkRangePresent(addr_t start, addr_t end,
 	bool markPresent)
@@ -334,6 +421,11 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
+	RecursiveLocker locker(fLock);
+
+	// If the page is part of a large page, we need to split the latter first.
+	_LargePageForRange(address, address + (B_PAGE_SIZE - 1));
+
 	// Look up the page table for the virtual address.
 	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
 		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
@@ -341,8 +433,6 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	RecursiveLocker locker(fLock);
-
 	uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(entry);
 
 	pinner.Unlock();
@@ -402,6 +492,28 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
+		uint64* largePage = _LargePageForRange(start, end);
+		if (largePage != NULL) {
+			uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(largePage);
+			fMapCount -= k64BitTableEntryCount;
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			// Process the pages the large page consisted of one by one.
+			phys_addr_t physicalAddress = oldEntry & X86_64_PDE_ADDRESS_MASK;
+			uint64 flags = oldEntry & (X86_64_PDE_ACCESSED | X86_64_PDE_DIRTY);
+			for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+				_PageUnmapped(area,
+					(physicalAddress + i * B_PAGE_SIZE) | flags,
+					updatePageQueue, queue);
+			}
+
+			Flush();
+			start += k64BitPageTableRange;
+			continue;
+		}
+
 		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
 			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
 			NULL, fPageMapper, fMapCount);
@@ -428,54 +540,7 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 				InvalidatePage(start);
 			}
 
-			if (area->cache_type != CACHE_TYPE_DEVICE) {
-				// get the page
-				vm_page* page = vm_lookup_page(
-					(oldEntry & X86_64_PTE_ADDRESS_MASK) / B_PAGE_SIZE);
-				ASSERT(page != NULL);
-
-				DEBUG_PAGE_ACCESS_START(page);
-
-				// transfer the accessed/dirty flags to the page
-				if ((oldEntry & X86_64_PTE_ACCESSED) != 0)
-					page->accessed = true;
-				if ((oldEntry & X86_64_PTE_DIRTY) != 0)
-					page->modified = true;
-
-				// remove the mapping object/decrement the wired_count of the
-				// page
-				if (area->wiring == B_NO_LOCK) {
-					vm_page_mapping* mapping = NULL;
-					vm_page_mappings::Iterator iterator
-						= page->mappings.GetIterator();
-					while ((mapping = iterator.Next()) != NULL) {
-						if (mapping->area == area)
-							break;
-					}
-
-					ASSERT(mapping != NULL);
-
-					area->mappings.Remove(mapping);
-					page->mappings.Remove(mapping);
-					queue.Add(mapping);
-				} else
-					page->DecrementWiredCount();
-
-				if (!page->IsMapped()) {
-					atomic_add(&gMappedPagesCount, -1);
-
-					if (updatePageQueue) {
-						if (page->Cache()->temporary)
-							vm_page_set_state(page, PAGE_STATE_INACTIVE);
-						else if (page->modified)
-							vm_page_set_state(page, PAGE_STATE_MODIFIED);
-						else
-							vm_page_set_state(page, PAGE_STATE_CACHED);
-					}
-				}
-
-				DEBUG_PAGE_ACCESS_END(page);
-			}
+			_PageUnmapped(area, oldEntry, updatePageQueue, queue);
 		}
 
 		Flush();
@@ -615,8 +680,9 @@ X86VMTranslationMap64Bit::Query(addr_t virtualAddress,
 	uint64 entry;
 	if ((*pde & X86_64_PDE_LARGE_PAGE) != 0) {
 		entry = *pde;
+		// like for small pages, return the address of the page
 		*_physicalAddress = (entry & X86_64_PDE_ADDRESS_MASK)
-			+ (virtualAddress % 0x200000);
+			+ ((virtualAddress % 0x200000) & ~(addr_t)(B_PAGE_SIZE - 1));
 	} else {
 		uint64* virtualPageTable = (uint64*)fPageMapper->GetPageTableAt(
 			*pde & X86_64_PDE_ADDRESS_MASK);
@@ -680,9 +746,36 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 	} else if ((attributes & B_KERNEL_WRITE_AREA) != 0)
 		newProtectionFlags = X86_64_PTE_WRITABLE;
 
+	uint64 memoryTypeFlags
+		= X86PagingMethod64Bit::MemoryTypeToPageTableEntryFlags(memoryType);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
+		uint64* largePage = _LargePageForRange(start, end);
+		if (largePage != NULL) {
+			// The protection bits are the same for large pages.
+			uint64 entry = *largePage;
+			uint64 oldEntry;
+			while (true) {
+				oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(
+					largePage,
+					(entry & ~(X86_64_PTE_PROTECTION_MASK
+							| X86_64_PTE_MEMORY_TYPE_MASK))
+						| newProtectionFlags | memoryTypeFlags,
+					entry);
+				if (oldEntry == entry)
+					break;
+				entry = oldEntry;
+			}
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			start += k64BitPageTableRange;
+			continue;
+		}
+
 		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
 			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
 			NULL, fPageMapper, fMapCount);
@@ -710,9 +803,7 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 					&pageTable[index],
 					(entry & ~(X86_64_PTE_PROTECTION_MASK
 							| X86_64_PTE_MEMORY_TYPE_MASK))
-						| newProtectionFlags
-						| X86PagingMethod64Bit::MemoryTypeToPageTableEntryFlags(
-							memoryType),
+						| newProtectionFlags | memoryTypeFlags,
 					entry);
 				if (oldEntry == entry)
 					break;
@@ -740,15 +831,29 @@ X86VMTranslationMap64Bit::ClearFlags(addr_t address, uint32 flags)
 
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
+	uint64 flagsToClear = ((flags & PAGE_MODIFIED) ? X86_64_PTE_DIRTY : 0)
+		| ((flags & PAGE_ACCESSED) ? X86_64_PTE_ACCESSED : 0);
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
+		false, NULL, fPageMapper, fMapCount);
+	if (pde != NULL && (*pde & X86_64_PDE_PRESENT) != 0
+		&& (*pde & X86_64_PDE_LARGE_PAGE) != 0) {
+		// The flags are shared by all pages of the large page, and are only
+		// hints anyway, so there is no need to split it.
+		uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntryFlags(pde,
+			flagsToClear);
+		if ((oldEntry & flagsToClear) != 0)
+			InvalidatePage(address);
+		return B_OK;
+	}
+
 	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
 		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
 		false, NULL, fPageMapper, fMapCount);
 	if (entry == NULL)
 		return B_OK;
 
-	uint64 flagsToClear = ((flags & PAGE_MODIFIED) ? X86_64_PTE_DIRTY : 0)
-		| ((flags & PAGE_ACCESSED) ? X86_64_PTE_ACCESSED : 0);
-
 	uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntryFlags(entry,
 		flagsToClear);
 
@@ -771,6 +876,9 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 	RecursiveLocker locker(fLock);
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
+	// The page might need to be unmapped, so split a large page it is part of.
+	_LargePageForRange(address, address + (B_PAGE_SIZE - 1));
+
 	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
 		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
 		false, NULL, fPageMapper, fMapCount);
@@ -843,3 +951,158 @@ X86VMTranslationMap64Bit::PagingStructures() const
 {
 	return fPagingStructures;
 }
+
+
+/*!	Checks whether \a start lies within a large page. If the range from
+	\a start to \a end covers the whole large page, its page directory entry
+	is returned. Otherwise the large page is split, so that the caller can
+	process the range with page granularity, and \c NULL is returned.
+	The map must be locked and the thread pinned.
+*/
+uint64*
+X86VMTranslationMap64Bit::_LargePageForRange(addr_t start, addr_t end)
+{
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), start, fIsKernelMap, false, NULL,
+		fPageMapper, fMapCount);
+	if (pde == NULL || (*pde & X86_64_PDE_PRESENT) == 0
+		|| (*pde & X86_64_PDE_LARGE_PAGE) == 0) {
+		return NULL;
+	}
+
+	addr_t base = ROUNDDOWN(start, k64BitPageTableRange);
+	if (start == base && end >= base + (k64BitPageTableRange - 1))
+		return pde;
+
+	status_t status = _SplitLargePage(pde, base);
+	if (status != B_OK) {
+		panic("X86VMTranslationMap64Bit: failed to split large page at %#"
+			B_PRIxADDR ": %s\n", base, strerror(status));
+	}
+
+	return NULL;
+}
+
+
+/*!	Replaces the large page mapped by \a pde with a page table that maps the
+	same physical pages with the same protection.
+	The map must be locked and the thread pinned.
+*/
+status_t
+X86VMTranslationMap64Bit::_SplitLargePage(uint64* pde, addr_t address)
+{
+	TRACE("X86VMTranslationMap64Bit::_SplitLargePage(%#" B_PRIxADDR ")\n",
+		address);
+
+	// We are called from paths that don't have a page reservation at hand,
+	// and we cannot wait for memory here; the VIP reserve is meant for
+	// exactly this kind of allocation.
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, 1, VM_PRIORITY_VIP))
+		return B_NO_MEMORY;
+
+	vm_page* page = vm_page_allocate_page(&reservation, PAGE_STATE_WIRED);
+	vm_page_unreserve_pages(&reservation);
+
+	DEBUG_PAGE_ACCESS_END(page);
+
+	phys_addr_t physicalPageTable
+		= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+	uint64* pageTable = (uint64*)fPageMapper->GetPageTableAt(
+		physicalPageTable);
+
+	// The page table is not visible yet, so we can fill it in directly. The
+	// accessed and dirty flags of the large page are applied to all of its
+	// pages; should the CPU update them in the meantime, we start over.
+	const uint64 kInheritedFlags = X86_64_PTE_PRESENT | X86_64_PTE_WRITABLE
+		| X86_64_PTE_USER | X86_64_PTE_WRITE_THROUGH
+		| X86_64_PTE_CACHING_DISABLED | X86_64_PTE_ACCESSED
+		| X86_64_PTE_DIRTY | X86_64_PTE_GLOBAL | X86_64_PTE_NOT_EXECUTABLE;
+
+	uint64 entry = *pde;
+	while (true) {
+		phys_addr_t physicalAddress = entry & X86_64_PDE_ADDRESS_MASK;
+		uint64 flags = entry & kInheritedFlags;
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+			pageTable[i] = (physicalAddress + i * B_PAGE_SIZE) | flags;
+
+		uint64 oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+			(physicalPageTable & X86_64_PDE_ADDRESS_MASK)
+				| X86_64_PDE_PRESENT
+				| X86_64_PDE_WRITABLE
+				| X86_64_PDE_USER,
+			entry);
+		if (oldEntry == entry)
+			break;
+		entry = oldEntry;
+	}
+
+	fMapCount++;
+
+	// Invalidating any address of the large page removes it from the TLB.
+	if ((entry & X86_64_PDE_ACCESSED) != 0)
+		InvalidatePage(address);
+
+	return B_OK;
+}
+
+
+/*!	Transfers the accessed and modified flags of the page table entry
+	\a oldEntry to its page, and removes the mapping of \a area from the
+	page, adding the mapping object to \a queue for the caller to free.
+	The map must be locked.
+*/
+void
+X86VMTranslationMap64Bit::_PageUnmapped(VMArea* area, uint64 oldEntry,
+	bool updatePageQueue, VMAreaMappings& queue)
+{
+	if (area->cache_type == CACHE_TYPE_DEVICE)
+		return;
+
+	// get the page
+	vm_page* page = vm_lookup_page(
+		(oldEntry & X86_64_PTE_ADDRESS_MASK) / B_PAGE_SIZE);
+	ASSERT(page != NULL);
+
+	DEBUG_PAGE_ACCESS_START(page);
+
+	// transfer the accessed/dirty flags to the page
+	if ((oldEntry & X86_64_PTE_ACCESSED) != 0)
+		page->accessed = true;
+	if ((oldEntry & X86_64_PTE_DIRTY) != 0)
+		page->modified = true;
+
+	// remove the mapping object/decrement the wired_count of the
+	// page
+	if (area->wiring == B_NO_LOCK) {
+		vm_page_mapping* mapping = NULL;
+		vm_page_mappings::Iterator iterator
+			= page->mappings.GetIterator();
+		while ((mapping = iterator.Next()) != NULL) {
+			if (mapping->area == area)
+				break;
+		}
+
+		ASSERT(mapping != NULL);
+
+		area->mappings.Remove(mapping);
+		page->mappings.Remove(mapping);
+		queue.Add(mapping);
+	} else
+		page->DecrementWiredCount();
+
+	if (!page->IsMapped()) {
+		atomic_add(&gMappedPagesCount, -1);
+
+		if (updatePageQueue) {
+			if (page->Cache()->temporary)
+				vm_page_set_state(page, PAGE_STATE_INACTIVE);
+			else if (page->modified)
+				vm_page_set_state(page, PAGE_STATE_MODIFIED);
+			else
+				vm_page_set_state(page, PAGE_STATE_CACHED);
+		}
+	}
+
+	DEBUG_PAGE_ACCESS_END(page);
+}
@@ -28,6 +28,12 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 									vm_page_reservation* reservation);
 	virtual	status_t			Unmap(addr_t start, addr_t end);
 
+	virtual	size_t				LargePageSize() const;
+	virtual	status_t			MapLargePage(addr_t virtualAddress,
+									phys_addr_t physicalAddress,
+									uint32 attributes, uint32 memoryType,
+									vm_page_reservation* reservation);
+
 	virtual	status_t			DebugMarkRangePresent(addr_t start, addr_t end,
 									bool markPresent);
 
@@ -61,6 +67,13 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 	inline	X86PagingStructures64Bit* PagingStructures64Bit() const
 									{ return fPagingStructures; }
 
+private:
+			uint64*				_LargePageForRange(addr_t start, addr_t end);
+			status_t			_SplitLargePage(uint64* pde, addr_t address);
+			void				_PageUnmapped(VMArea* area, uint64 oldEntry,
+									bool updatePageQueue,
+									VMAreaMappings& queue);
+
 private:
 			X86PagingStructures64Bit* fPagingStructures;
 };
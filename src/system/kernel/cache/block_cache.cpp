@@ -10,11 +10,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include <KernelExport.h>
 #include <fs_cache.h>
 
 #include <condition_variable.h>
+#ifndef BUILDING_USERLAND_FS_SERVER
+#	include <generic_syscall.h>
+#endif
 #include <lock.h>
 #include <low_resource_manager.h>
 #include <slab/Slab.h>
@@ -26,6 +30,10 @@
 
 #include "kernel_debug_config.h"
 
+#ifndef BUILDING_USERLAND_FS_SERVER
+#	include "IORequest.h"
+#endif
+
 
 // TODO: this is a naive but growing implementation to test the API:
 //	block reading/writing is not at all optimized for speed, it will
@@ -47,6 +55,19 @@
 static const bigtime_t kTransactionIdleTime = 2000000LL;
 	// a transaction is considered idle after 2 seconds of inactivity
 
+static const size_t kMaxCoalescedBlocks = 32;
+	// the maximum number of adjacent blocks written back with a single write
+
+static const uint32 kBlockShardShift = 4;
+static const uint32 kBlockShardCount = 1 << kBlockShardShift;
+	// the number of independently locked parts of a cache's block table
+
+static const uint32 kGhostBlockCount = 128;
+	// the number of recently evicted blocks each shard remembers
+static const int32 kHotBlockReuseTime = 2;
+	// an unused block that is accessed again after at least this many
+	// seconds is considered hot
+
 
 struct cache_transaction;
 struct cached_block;
@@ -77,13 +98,19 @@ struct cached_block {
 #endif
 	int32			ref_count;
 	int32			last_accessed;
+	int32			dirty_since;
+		// When the block last turned from clean to dirty; only valid if
+		// is_dirty is set.
+	bool			unused;
+	bool			hot;
+		// Like ref_count and last_accessed, these are protected by the lock
+		// of the block's shard, and must not be part of the bitfield below.
 	bool			busy_reading : 1;
 	bool			busy_writing : 1;
 	bool			is_writing : 1;
 		// Block has been checked out for writing without transactions, and
 		// cannot be written back if set
 	bool			is_dirty : 1;
-	bool			unused : 1;
 	bool			discard : 1;
 	bool			busy_reading_waiters : 1;
 	bool			busy_writing_waiters : 1;
@@ -148,6 +175,33 @@ struct BlockHash {
 typedef BOpenHashTable<BlockHash> BlockTable;
 
 
+/*!	The blocks of a cache are spread over several shards, each with its own
+	lock, hash table, and list of unused blocks. This allows to get and put
+	clean blocks without having to acquire the cache's lock.
+	The hash table may only be changed with both, the cache and the shard
+	locked, and can be searched with either one of them held. The reference
+	count and unused state of a block, as well as the unused lists, are
+	protected by the shard lock.
+
+	The unused blocks are managed using the 2Q replacement policy: blocks
+	start out in unused_blocks, and are only moved to hot_unused_blocks when
+	they are used again after a while, or shortly after they have been
+	evicted (which is detected via the ghost_blocks ring). Since blocks are
+	evicted from unused_blocks first, a large scan over the disk cannot push
+	out the hot blocks, like B+tree roots or bitmap blocks.
+*/
+struct block_shard {
+	mutex			lock;
+	BlockTable*		hash;
+	block_list		unused_blocks;
+	block_list		hot_unused_blocks;
+	int32			unused_count;
+	int32			hot_unused_count;
+	off_t			ghost_blocks[kGhostBlockCount];
+	uint32			next_ghost;
+};
+
+
 struct TransactionHash {
 	typedef int32				KeyType;
 	typedef	cache_transaction	ValueType;
@@ -166,7 +220,7 @@ typedef BOpenHashTable<TransactionHash> TransactionTable;
 
 
 struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
-	BlockTable*		hash;
+	block_shard		shards[kBlockShardCount];
 	mutex			lock;
 	int				fd;
 	off_t			max_blocks;
@@ -176,8 +230,14 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	TransactionTable* transaction_hash;
 
 	object_cache*	buffer_cache;
-	block_list		unused_blocks;
-	uint32			unused_block_count;
+	int32			unused_block_count;
+	uint32			next_unused_shard;
+
+	int64			hits;
+	int64			misses;
+	int64			ghost_hits;
+	int64			promotions;
+	int64			evictions;
 
 	ConditionVariable busy_reading_condition;
 	uint32			busy_reading_count;
@@ -199,20 +259,73 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 
 	status_t		Init();
 
+	block_shard&	ShardFor(off_t blockNumber);
+	cached_block*	Lookup(off_t blockNumber);
+
 	void			Free(void* buffer);
 	void*			Allocate();
 	void			FreeBlock(cached_block* block);
 	cached_block*	NewBlock(off_t blockNumber);
 	void			FreeBlockParentData(cached_block* block);
 
+	void			AddUnused(block_shard& shard, cached_block* block);
+	void			RemoveUnused(block_shard& shard, cached_block* block);
+	void			MarkUnusedIfUnreferenced(cached_block* block);
+	void			ReferenceBlock(block_shard& shard, cached_block* block);
+	bool			RemoveGhost(block_shard& shard, off_t blockNumber);
+	void			GetStats(block_cache_stats& stats);
+
 	void			RemoveUnusedBlocks(int32 count, int32 minSecondsOld = 0);
 	void			RemoveBlock(cached_block* block);
+	void			UnlinkBlock(block_shard& shard, cached_block* block);
 	void			DiscardBlock(cached_block* block);
 
 private:
 	static void		_LowMemoryHandler(void* data, uint32 resources,
 						int32 level);
+	int32			_RemoveUnusedBlocks(block_shard& shard, int32 count,
+						int32 minSecondsOld);
 	cached_block*	_GetUnusedBlock();
+	cached_block*	_NextVictim(block_shard& shard, int32 minSecondsOld);
+	void			_EvictBlock(block_shard& shard, cached_block* block);
+};
+
+
+/*!	Iterates over all blocks of a cache. Either the cache must be locked, or
+	it must be guaranteed otherwise that no blocks are added or removed.
+*/
+class CachedBlockIterator {
+public:
+	CachedBlockIterator(block_cache* cache)
+		:
+		fCache(cache),
+		fShard(0),
+		fIterator(cache->shards[0].hash)
+	{
+	}
+
+	bool HasNext()
+	{
+		while (!fIterator.HasNext()) {
+			if (++fShard >= kBlockShardCount)
+				return false;
+
+			fIterator = BlockTable::Iterator(fCache->shards[fShard].hash);
+		}
+		return true;
+	}
+
+	cached_block* Next()
+	{
+		if (!HasNext())
+			return NULL;
+		return fIterator.Next();
+	}
+
+private:
+	block_cache*			fCache;
+	uint32					fShard;
+	BlockTable::Iterator	fIterator;
 };
 
 struct cache_listener;
@@ -272,6 +385,8 @@ private:
 									cache_transaction* transaction);
 			void				_UnmarkWriting(cached_block* block);
 
+			status_t			_WriteBlocks(cached_block** blocks,
+									uint32 count);
 	static	int					_CompareBlocks(const void* _blockA,
 									const void* _blockB);
 
@@ -290,6 +405,36 @@ private:
 };
 
 
+#ifndef BUILDING_USERLAND_FS_SERVER
+class BlockPrefetcher {
+public:
+								BlockPrefetcher(block_cache* cache,
+									off_t blockNumber, size_t numBlocks);
+								~BlockPrefetcher();
+
+			status_t			Allocate();
+			status_t			ReadAsync();
+
+			size_t				NumAllocated() const
+									{ return fNumAllocated; }
+
+private:
+	static	status_t			_IOFinished(void* cookie, io_request* request,
+									status_t status, bool partialTransfer,
+									generic_size_t bytesTransferred);
+			void				_Finish(generic_size_t bytesTransferred);
+
+private:
+			block_cache*		fCache;
+			off_t				fBlockNumber;
+			size_t				fNumRequested;
+			size_t				fNumAllocated;
+			cached_block**		fBlocks;
+			generic_io_vec*		fVecs;
+};
+#endif	// !BUILDING_USERLAND_FS_SERVER
+
+
 class TransactionLocking {
 public:
 	inline bool Lock(block_cache* cache)
@@ -736,6 +881,16 @@ static thread_id sNotifierWriterThread;
 static DoublyLinkedListLink<block_cache> sMarkCache;
 	// TODO: this only works if the link is the first entry of block_cache
 static object_cache* sBlockCache;
+static mutex sWritebackPolicyLock
+	= MUTEX_INITIALIZER("block cache writeback policy");
+// The defaults write back dirty blocks regardless of their age, like the
+// writer did before it had a policy.
+static block_cache_writeback_policy sWritebackPolicy = {
+	2000000LL,	// interval
+	0,			// dirty_expire
+	100,		// dirty_ratio
+	64			// blocks_per_pass
+};
 
 
 //	#pragma mark - notifications/listener
@@ -1168,22 +1323,38 @@ BlockWriter::Write(cache_transaction* transaction, bool canUnlock)
 	if (canUnlock)
 		mutex_unlock(&fCache->lock);
 
-	// Sort blocks in their on-disk order
+	// Sort blocks in their on-disk order, so that adjacent blocks can be
+	// written back with a single request
 	// TODO: ideally, this should be handled by the I/O scheduler
 
 	qsort(fBlocks, fCount, sizeof(void*), &_CompareBlocks);
 	fDeletedTransaction = false;
 
-	for (uint32 i = 0; i < fCount; i++) {
-		status_t status = _WriteBlock(fBlocks[i]);
-		if (status != B_OK) {
-			// propagate to global error handling
-			if (fStatus == B_OK)
-				fStatus = status;
+	for (uint32 i = 0; i < fCount;) {
+		uint32 count = 1;
+		while (i + count < fCount && count < kMaxCoalescedBlocks
+			&& fBlocks[i + count]->block_number
+				== fBlocks[i]->block_number + count) {
+			count++;
+		}
 
-			_UnmarkWriting(fBlocks[i]);
-			fBlocks[i] = NULL;
-				// This block will not be marked clean
+		if (count > 1 && _WriteBlocks(fBlocks + i, count) == B_OK) {
+			i += count;
+			continue;
+		}
+
+		// Write the blocks one by one, so that we know which ones failed
+		for (uint32 end = i + count; i < end; i++) {
+			status_t status = _WriteBlock(fBlocks[i]);
+			if (status != B_OK) {
+				// propagate to global error handling
+				if (fStatus == B_OK)
+					fStatus = status;
+
+				_UnmarkWriting(fBlocks[i]);
+				fBlocks[i] = NULL;
+					// This block will not be marked clean
+			}
 		}
 	}
 
@@ -1251,6 +1422,38 @@ BlockWriter::_WriteBlock(cached_block* block)
 }
 
 
+/*!	Writes back the \a count adjacent \a blocks with a single request.
+	Errors are not reported, as the caller is expected to retry the blocks
+	one by one in this case.
+*/
+status_t
+BlockWriter::_WriteBlocks(cached_block** blocks, uint32 count)
+{
+	iovec vecs[kMaxCoalescedBlocks];
+	size_t blockSize = fCache->block_size;
+
+	for (uint32 i = 0; i < count; i++) {
+		ASSERT(blocks[i]->busy_writing);
+
+		TB(Write(fCache, blocks[i]));
+		TB2(BlockData(fCache, blocks[i], "before write"));
+
+		vecs[i].iov_base = _Data(blocks[i]);
+		vecs[i].iov_len = blockSize;
+	}
+
+	TRACE(("BlockWriter::_WriteBlocks(blocks %" B_PRIdOFF " - %" B_PRIdOFF
+		")\n", blocks[0]->block_number, blocks[count - 1]->block_number));
+
+	ssize_t written = writev_pos(fCache->fd,
+		blocks[0]->block_number * blockSize, vecs, count);
+	if (written != (ssize_t)(count * blockSize))
+		return written < 0 ? errno : B_IO_ERROR;
+
+	return B_OK;
+}
+
+
 void
 BlockWriter::_BlockDone(cached_block* block,
 	cache_transaction* transaction)
@@ -1301,12 +1504,9 @@ BlockWriter::_BlockDone(cached_block* block,
 			fDeletedTransaction = true;
 		}
 	}
-	if (block->transaction == NULL && block->ref_count == 0 && !block->unused) {
-		// the block is no longer used
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = true;
-		fCache->unused_blocks.Add(block);
-		fCache->unused_block_count++;
+	if (block->transaction == NULL) {
+		// the block might no longer be used
+		fCache->MarkUnusedIfUnreferenced(block);
 	}
 
 	TB2(BlockData(fCache, block, "after write"));
@@ -1350,7 +1550,6 @@ BlockWriter::_CompareBlocks(const void* _blockA, const void* _blockB)
 block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 		bool readOnly)
 	:
-	hash(NULL),
 	fd(_fd),
 	max_blocks(numBlocks),
 	block_size(blockSize),
@@ -1359,6 +1558,12 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	transaction_hash(NULL),
 	buffer_cache(NULL),
 	unused_block_count(0),
+	next_unused_shard(0),
+	hits(0),
+	misses(0),
+	ghost_hits(0),
+	promotions(0),
+	evictions(0),
 	busy_reading_count(0),
 	busy_reading_waiters(false),
 	busy_writing_count(0),
@@ -1366,6 +1571,16 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	num_dirty_blocks(0),
 	read_only(readOnly)
 {
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		block_shard& shard = shards[i];
+		shard.hash = NULL;
+		shard.unused_count = 0;
+		shard.hot_unused_count = 0;
+		shard.next_ghost = 0;
+
+		for (uint32 j = 0; j < kGhostBlockCount; j++)
+			shard.ghost_blocks[j] = -1;
+	}
 }
 
 
@@ -1375,7 +1590,11 @@ block_cache::~block_cache()
 	unregister_low_resource_handler(&_LowMemoryHandler, this);
 
 	delete transaction_hash;
-	delete hash;
+
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		delete shards[i].hash;
+		mutex_destroy(&shards[i].lock);
+	}
 
 	delete_object_cache(buffer_cache);
 
@@ -1391,14 +1610,20 @@ block_cache::Init()
 	condition_variable.Init(this, "cache transaction sync");
 	mutex_init(&lock, "block cache");
 
+	for (uint32 i = 0; i < kBlockShardCount; i++)
+		mutex_init(&shards[i].lock, "block cache shard");
+
 	buffer_cache = create_object_cache_etc("block cache buffers", block_size,
 		8, 0, 0, 0, CACHE_LARGE_SLAB, NULL, NULL, NULL, NULL);
 	if (buffer_cache == NULL)
 		return B_NO_MEMORY;
 
-	hash = new BlockTable();
-	if (hash == NULL || hash->Init(1024) != B_OK)
-		return B_NO_MEMORY;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		shards[i].hash = new(std::nothrow) BlockTable();
+		if (shards[i].hash == NULL
+			|| shards[i].hash->Init(1024 / kBlockShardCount) != B_OK)
+			return B_NO_MEMORY;
+	}
 
 	transaction_hash = new(std::nothrow) TransactionTable();
 	if (transaction_hash == NULL || transaction_hash->Init(16) != B_OK)
@@ -1410,6 +1635,24 @@ block_cache::Init()
 }
 
 
+block_shard&
+block_cache::ShardFor(off_t blockNumber)
+{
+	// Use the upper bits of a multiplicative hash, so that the hash tables
+	// of the shards can still use the lower bits of the block number
+	return shards[((uint32)blockNumber * 0x9e3779b1U)
+		>> (32 - kBlockShardShift)];
+}
+
+
+/*!	Either the cache, or the block's shard must be locked. */
+cached_block*
+block_cache::Lookup(off_t blockNumber)
+{
+	return ShardFor(blockNumber).hash->Lookup(blockNumber);
+}
+
+
 void
 block_cache::Free(void* buffer)
 {
@@ -1472,7 +1715,7 @@ block_cache::NewBlock(off_t blockNumber)
 		} else {
 			TB(Error(this, blockNumber, "allocation failed"));
 			dprintf("block allocation failed, unused list is %sempty.\n",
-				unused_blocks.IsEmpty() ? "" : "not ");
+				unused_block_count == 0 ? "" : "not ");
 
 			// allocation failed, try to reuse an unused block
 			block = _GetUnusedBlock();
@@ -1487,6 +1730,9 @@ block_cache::NewBlock(off_t blockNumber)
 	block->block_number = blockNumber;
 	block->ref_count = 0;
 	block->last_accessed = 0;
+	block->dirty_since = 0;
+	block->unused = false;
+	block->hot = false;
 	block->transaction_next = NULL;
 	block->transaction = block->previous_transaction = NULL;
 	block->original_data = NULL;
@@ -1495,7 +1741,6 @@ block_cache::NewBlock(off_t blockNumber)
 	block->busy_writing = false;
 	block->is_writing = false;
 	block->is_dirty = false;
-	block->unused = false;
 	block->discard = false;
 	block->busy_reading_waiters = false;
 	block->busy_writing_waiters = false;
@@ -1517,51 +1762,182 @@ block_cache::FreeBlockParentData(cached_block* block)
 }
 
 
+/*!	Puts the block into the unused list of its shard.
+	The shard must be locked.
+*/
 void
-block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
+block_cache::AddUnused(block_shard& shard, cached_block* block)
 {
-	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+	ASSERT(!block->unused);
+	ASSERT(block->original_data == NULL && block->parent_data == NULL);
+
+	block->unused = true;
+	if (block->hot) {
+		shard.hot_unused_blocks.Add(block);
+		shard.hot_unused_count++;
+	} else {
+		shard.unused_blocks.Add(block);
+		shard.unused_count++;
+	}
+	atomic_add(&unused_block_count, 1);
+}
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		if (minSecondsOld >= block->LastAccess()) {
-			// The list is sorted by last access
-			break;
+
+/*!	Removes the block from the unused list of its shard.
+	The shard must be locked.
+*/
+void
+block_cache::RemoveUnused(block_shard& shard, cached_block* block)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+	ASSERT(block->unused);
+
+	block->unused = false;
+	if (block->hot) {
+		shard.hot_unused_blocks.Remove(block);
+		shard.hot_unused_count--;
+	} else {
+		shard.unused_blocks.Remove(block);
+		shard.unused_count--;
+	}
+	atomic_add(&unused_block_count, -1);
+}
+
+
+/*!	Moves the block into the unused list, if it is neither referenced, nor
+	part of any transaction.
+	The cache must be locked.
+*/
+void
+block_cache::MarkUnusedIfUnreferenced(cached_block* block)
+{
+	if (block->transaction != NULL || block->previous_transaction != NULL)
+		return;
+
+	block_shard& shard = ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
+	if (block->ref_count == 0 && !block->unused)
+		AddUnused(shard, block);
+}
+
+
+/*!	Acquires a reference to the block, and takes it out of the unused list
+	if necessary. If the block has not been used for a while, it is
+	promoted to be a hot block.
+	The shard must be locked.
+*/
+void
+block_cache::ReferenceBlock(block_shard& shard, cached_block* block)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+
+	if (block->unused) {
+		RemoveUnused(shard, block);
+
+		if (!block->hot && block->LastAccess() >= kHotBlockReuseTime) {
+			block->hot = true;
+			atomic_add64(&promotions, 1);
 		}
-		if (block->busy_reading || block->busy_writing)
-			continue;
+	}
 
-		TB(Flush(this, block));
-		TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32 "\n",
-			block->block_number, block->last_accessed));
+	block->ref_count++;
+	block->last_accessed = system_time() / 1000000L;
+}
 
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->discard) {
-			if (block->busy_writing)
-				continue;
 
-			BlockWriter::WriteBlock(this, block);
+/*!	Returns whether or not the block has been evicted from the shard's
+	unused list recently, and forgets about it in this case.
+	The shard must be locked.
+*/
+bool
+block_cache::RemoveGhost(block_shard& shard, off_t blockNumber)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+
+	for (uint32 i = 0; i < kGhostBlockCount; i++) {
+		if (shard.ghost_blocks[i] == blockNumber) {
+			shard.ghost_blocks[i] = -1;
+			return true;
 		}
+	}
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		RemoveBlock(block);
+	return false;
+}
 
-		if (--count <= 0)
-			break;
+
+/*!	Fills in the statistics of this cache. The values are not retrieved
+	atomically, so they may be slightly inconsistent with each other.
+*/
+void
+block_cache::GetStats(block_cache_stats& stats)
+{
+	stats.max_blocks = max_blocks;
+	stats.block_size = block_size;
+	stats.unused_blocks = unused_block_count;
+	stats.hot_unused_blocks = 0;
+	for (uint32 i = 0; i < kBlockShardCount; i++)
+		stats.hot_unused_blocks += shards[i].hot_unused_count;
+
+	stats.hits = atomic_get64(&hits);
+	stats.misses = atomic_get64(&misses);
+	stats.ghost_hits = atomic_get64(&ghost_hits);
+	stats.promotions = atomic_get64(&promotions);
+	stats.evictions = atomic_get64(&evictions);
+}
+
+
+void
+block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
+{
+	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
+
+	// Spread the blocks to remove evenly over all shards; what one shard
+	// cannot provide is left to the following ones
+	for (uint32 i = 0; i < kBlockShardCount && count > 0; i++) {
+		uint32 shardsLeft = kBlockShardCount - i;
+		int32 shardCount = (count + shardsLeft - 1) / shardsLeft;
+
+		count -= _RemoveUnusedBlocks(shards[i], shardCount, minSecondsOld);
 	}
 }
 
 
+/*!	Removes the block from the hash, and frees it. If the block is still in
+	the unused list, it is removed from there, too.
+	The cache must be locked.
+*/
 void
 block_cache::RemoveBlock(cached_block* block)
 {
-	hash->Remove(block);
+	block_shard& shard = ShardFor(block->block_number);
+
+	mutex_lock(&shard.lock);
+	UnlinkBlock(shard, block);
+	mutex_unlock(&shard.lock);
+
 	FreeBlock(block);
 }
 
 
+/*!	Removes the block from the hash, and from the unused list if it is in
+	there. Since references are only acquired with the shard locked, the
+	block cannot gain new ones afterwards, and may be freed once the shard
+	has been unlocked.
+	The shard must be locked.
+*/
+void
+block_cache::UnlinkBlock(block_shard& shard, cached_block* block)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+
+	if (block->unused)
+		RemoveUnused(shard, block);
+	shard.hash->Remove(block);
+}
+
+
 /*!	Discards the block from a transaction (this method must not be called
 	for blocks not part of a transaction).
 */
@@ -1621,51 +1997,174 @@ block_cache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
 	}
 
 #ifdef TRACE_BLOCK_CACHE
-	uint32 oldUnused = cache->unused_block_count;
+	int32 oldUnused = cache->unused_block_count;
 #endif
 
 	cache->RemoveUnusedBlocks(free, secondsOld);
 
-	TRACE(("block_cache::_LowMemoryHandler(): %p: unused: %" B_PRIu32 " -> %" B_PRIu32 "\n",
+	TRACE(("block_cache::_LowMemoryHandler(): %p: unused: %" B_PRId32 " -> %" B_PRId32 "\n",
 		cache, oldUnused, cache->unused_block_count));
 }
 
 
+/*!	Removes up to \a count blocks from the unused lists of \a shard that
+	have not been accessed for at least \a minSecondsOld seconds, and frees
+	them. Returns the number of blocks removed.
+	The cache must be locked.
+*/
+int32
+block_cache::_RemoveUnusedBlocks(block_shard& shard, int32 count,
+	int32 minSecondsOld)
+{
+	int32 removed = 0;
+	MutexLocker shardLocker(shard.lock);
+
+	while (removed < count) {
+		cached_block* block = _NextVictim(shard, minSecondsOld);
+		if (block == NULL)
+			break;
+
+		TB(Flush(this, block));
+		TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32 "\n",
+			block->block_number, block->last_accessed));
+
+		// this can only happen if no transactions are used
+		if (block->is_dirty && !block->discard) {
+			// We must not hold the shard lock while writing the block back,
+			// and need to choose again afterwards, as the lists may have
+			// changed
+			shardLocker.Unlock();
+			status_t status = BlockWriter::WriteBlock(this, block);
+			shardLocker.Lock();
+
+			if (status != B_OK)
+				break;
+			continue;
+		}
+
+		_EvictBlock(shard, block);
+		FreeBlock(block);
+
+		removed++;
+	}
+
+	return removed;
+}
+
+
 cached_block*
 block_cache::_GetUnusedBlock()
 {
 	TRACE(("block_cache: get unused block\n"));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		TB(Flush(this, block, true));
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->busy_writing && !block->discard)
-			BlockWriter::WriteBlock(this, block);
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		uint32 index = (next_unused_shard + i) % kBlockShardCount;
+		block_shard& shard = shards[index];
+		MutexLocker shardLocker(shard.lock);
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		hash->Remove(block);
+		while (cached_block* block = _NextVictim(shard, -1)) {
+			TB(Flush(this, block, true));
+			// this can only happen if no transactions are used
+			if (block->is_dirty && !block->discard) {
+				shardLocker.Unlock();
+				status_t status = BlockWriter::WriteBlock(this, block);
+				shardLocker.Lock();
 
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = false;
+				if (status != B_OK)
+					break;
+				continue;
+			}
+
+			_EvictBlock(shard, block);
 
-		// TODO: see if compare data is handled correctly here!
+			// take the next block from another shard
+			next_unused_shard = (index + 1) % kBlockShardCount;
+
+			// TODO: see if compare data is handled correctly here!
 #if BLOCK_CACHE_DEBUG_CHANGED
-		if (block->compare != NULL)
-			Free(block->compare);
+			if (block->compare != NULL)
+				Free(block->compare);
 #endif
-		return block;
+			return block;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*!	Chooses the unused block of \a shard that should be evicted next, or
+	returns \c NULL if there is none that is older than \a minSecondsOld
+	seconds, and not busy.
+	As long as they make up more than a quarter of the unused blocks, the
+	blocks that have only been used once are evicted before the hot ones.
+	The shard must be locked.
+*/
+cached_block*
+block_cache::_NextVictim(block_shard& shard, int32 minSecondsOld)
+{
+	block_list* lists[2] = { &shard.unused_blocks, &shard.hot_unused_blocks };
+	if (shard.unused_count * 4 <= shard.unused_count + shard.hot_unused_count
+		&& shard.hot_unused_count > 0) {
+		lists[0] = &shard.hot_unused_blocks;
+		lists[1] = &shard.unused_blocks;
+	}
+
+	for (int32 i = 0; i < 2; i++) {
+		block_list::Iterator iterator = lists[i]->GetIterator();
+		while (cached_block* block = iterator.Next()) {
+			if (minSecondsOld >= block->LastAccess()) {
+				// The lists are sorted by last access
+				break;
+			}
+			if (block->busy_reading || block->busy_writing)
+				continue;
+
+			return block;
+		}
 	}
 
 	return NULL;
 }
 
 
+/*!	Removes the unused \a block from the shard. If it had only been used
+	once, it is remembered as a ghost, so that it will be considered hot
+	when it is needed again soon.
+	The shard must be locked.
+*/
+void
+block_cache::_EvictBlock(block_shard& shard, cached_block* block)
+{
+	RemoveUnused(shard, block);
+	shard.hash->Remove(block);
+
+	if (!block->hot) {
+		shard.ghost_blocks[shard.next_ghost] = block->block_number;
+		shard.next_ghost = (shard.next_ghost + 1) % kGhostBlockCount;
+	}
+
+	atomic_add64(&evictions, 1);
+}
+
+
 //	#pragma mark - private block functions
 
 
+/*!	Marks the block dirty, and remembers when it became so.
+	Cache must be locked.
+*/
+static void
+mark_block_dirty(cached_block* block)
+{
+	if (block->is_dirty)
+		return;
+
+	block->is_dirty = true;
+	block->dirty_since = system_time() / 1000000L;
+}
+
+
 /*!	Cache must be locked.
 */
 static void
@@ -1693,23 +2192,24 @@ mark_block_unbusy_reading(block_cache* cache, cached_block* block)
 }
 
 
-/*!	Cache must be locked.
+/*!	Waits once for the \a block to be read in, or for any other block that is
+	no longer busy reading.
+	If reading the block failed, it has been freed when this function returns,
+	so the caller must not access it anymore, but has to look it up again.
+	Cache must be locked.
 */
 static void
 wait_for_busy_reading_block(block_cache* cache, cached_block* block)
 {
-	while (block->busy_reading) {
-		// wait for at least the specified block to be read in
-		ConditionVariableEntry entry;
-		cache->busy_reading_condition.Add(&entry);
-		block->busy_reading_waiters = true;
+	ConditionVariableEntry entry;
+	cache->busy_reading_condition.Add(&entry);
+	block->busy_reading_waiters = true;
 
-		mutex_unlock(&cache->lock);
+	mutex_unlock(&cache->lock);
 
-		entry.Wait();
+	entry.Wait();
 
-		mutex_lock(&cache->lock);
-	}
+	mutex_lock(&cache->lock);
 }
 
 
@@ -1773,6 +2273,21 @@ wait_for_busy_writing_blocks(block_cache* cache)
 }
 
 
+/*!	Returns whether or not the block is in a state in which it may be
+	retrieved or released with only its shard locked: it must not be busy,
+	dirty, discarded, or part of any transaction.
+	Blocks can only leave this state with a reference held, so it is stable
+	while the shard is locked.
+*/
+static inline bool
+is_clean_block(cached_block* block)
+{
+	return !block->busy_reading && !block->busy_writing && !block->is_dirty
+		&& !block->is_writing && !block->discard && block->transaction == NULL
+		&& block->previous_transaction == NULL;
+}
+
+
 /*!	Removes a reference from the specified \a block. If this was the last
 	reference, the block is moved into the unused list.
 	In low memory situations, it will also free some blocks from that list,
@@ -1797,6 +2312,9 @@ put_cached_block(block_cache* cache, cached_block* block)
 #endif
 	TB(Put(cache, block));
 
+	block_shard& shard = cache->ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
 	if (block->ref_count < 1) {
 		panic("Invalid ref_count for block %p, cache %p\n", block, cache);
 		return;
@@ -1808,15 +2326,13 @@ put_cached_block(block_cache* cache, cached_block* block)
 		block->is_writing = false;
 
 		if (block->discard) {
+			// Discarded blocks are never handed out without the cache lock,
+			// so it's safe to unlock the shard here
+			shardLocker.Unlock();
 			cache->RemoveBlock(block);
 		} else {
 			// put this block in the list of unused blocks
-			ASSERT(!block->unused);
-			block->unused = true;
-
-			ASSERT(block->original_data == NULL && block->parent_data == NULL);
-			cache->unused_blocks.Add(block);
-			cache->unused_block_count++;
+			cache->AddUnused(shard, block);
 		}
 	}
 }
@@ -1830,7 +2346,7 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 			blockNumber, cache->max_blocks - 1);
 	}
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block != NULL)
 		put_cached_block(cache, block);
 	else {
@@ -1847,8 +2363,9 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 		to satisfy your request.
 	\param readBlock if \c false, the block will not be read in case it was
 		not already in the cache. The block you retrieve may contain random
-		data. If \c true, the cache will be temporarily unlocked while the
-		block is read in.
+		data, and is returned busy_reading in this case; you have to initialize
+		it and call mark_block_unbusy_reading() yourself. If \c true, the cache
+		will be temporarily unlocked while the block is read in.
 */
 static cached_block*
 get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
@@ -1862,8 +2379,10 @@ get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
 		return NULL;
 	}
 
+	block_shard& shard = cache->ShardFor(blockNumber);
+
 retry:
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	*_allocated = false;
 
 	if (block == NULL) {
@@ -1872,26 +2391,30 @@ retry:
 		if (block == NULL)
 			return NULL;
 
-		cache->hash->Insert(block);
+		// The block must not be found by anyone without the cache lock before
+		// its contents are valid
+		mark_block_busy_reading(cache, block);
+
+		MutexLocker shardLocker(shard.lock);
+		shard.hash->Insert(block);
 		*_allocated = true;
+
+		if (cache->RemoveGhost(shard, blockNumber)) {
+			// the block was evicted only recently, and is needed again
+			block->hot = true;
+			atomic_add64(&cache->ghost_hits, 1);
+		}
 	} else if (block->busy_reading) {
-		// The block is currently busy_reading - wait and try again later
+		// The block is currently busy_reading - wait and try again later; it
+		// is gone by then if it could not be read
 		wait_for_busy_reading_block(cache, block);
 		goto retry;
 	}
 
-	if (block->unused) {
-		//TRACE(("remove block %" B_PRIdOFF " from unused\n", blockNumber));
-		block->unused = false;
-		cache->unused_blocks.Remove(block);
-		cache->unused_block_count--;
-	}
-
 	if (*_allocated && readBlock) {
 		// read block into cache
 		int32 blockSize = cache->block_size;
 
-		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		ssize_t bytesRead = read_pos(cache->fd, blockNumber * blockSize,
@@ -1899,6 +2422,11 @@ retry:
 
 		mutex_lock(&cache->lock);
 		if (bytesRead < blockSize) {
+			// make sure no one gets hold of the block without the cache lock;
+			// the waiters don't access it anymore after they have been woken
+			// up, but look it up again
+			block->discard = true;
+			mark_block_unbusy_reading(cache, block);
 			cache->RemoveBlock(block);
 			TB(Error(cache, blockNumber, "read failed", bytesRead));
 
@@ -1911,13 +2439,75 @@ retry:
 		mark_block_unbusy_reading(cache, block);
 	}
 
-	block->ref_count++;
-	block->last_accessed = system_time() / 1000000L;
+	atomic_add64(*_allocated ? &cache->misses : &cache->hits, 1);
+
+	MutexLocker shardLocker(shard.lock);
+	cache->ReferenceBlock(shard, block);
 
 	return block;
 }
 
 
+/*!	Tries to get a reference to the clean block \a blockNumber without
+	locking the cache. Only the block's shard is locked; if the block is not
+	in the cache, or in any state that would need the cache lock, \c NULL is
+	returned, and you have to use get_cached_block() instead.
+*/
+static cached_block*
+get_clean_cached_block(block_cache* cache, off_t blockNumber)
+{
+#if BLOCK_CACHE_DEBUG_CHANGED
+	return NULL;
+#else
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
+	cached_block* block = shard.hash->Lookup(blockNumber);
+	if (block == NULL || !is_clean_block(block))
+		return NULL;
+
+	cache->ReferenceBlock(shard, block);
+	atomic_add64(&cache->hits, 1);
+
+	return block;
+#endif
+}
+
+
+/*!	Releases a reference to a clean block without locking the cache, if
+	possible. Returns \c false if you have to use put_cached_block() instead.
+*/
+static bool
+put_clean_cached_block(block_cache* cache, off_t blockNumber)
+{
+#if BLOCK_CACHE_DEBUG_CHANGED
+	return false;
+#else
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
+	cached_block* block = shard.hash->Lookup(blockNumber);
+	if (block == NULL || block->ref_count < 1)
+		return false;
+
+	if (block->ref_count > 1) {
+		// someone else still uses the block, its state doesn't matter
+		block->ref_count--;
+		TB(Put(cache, block));
+		return true;
+	}
+
+	if (!is_clean_block(block))
+		return false;
+
+	block->ref_count--;
+	cache->AddUnused(shard, block);
+	TB(Put(cache, block));
+	return true;
+#endif
+}
+
+
 /*!	Returns the writable block data for the requested blockNumber.
 	If \a cleared is true, the block is not read from disk; an empty block
 	is returned.
@@ -1943,6 +2533,16 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 	if (block == NULL)
 		return NULL;
 
+	if (allocated && cleared) {
+		// the new block is still busy_reading, and contains random data
+		mutex_unlock(&cache->lock);
+
+		memset(block->current_data, 0, cache->block_size);
+
+		mutex_lock(&cache->lock);
+		mark_block_unbusy_reading(cache, block);
+	}
+
 	if (block->busy_writing)
 		wait_for_busy_writing_block(cache, block);
 
@@ -1950,7 +2550,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 
 	// if there is no transaction support, we just return the current block
 	if (transactionID == -1) {
-		if (cleared) {
+		if (cleared && !allocated) {
 			mark_block_busy_reading(cache, block);
 			mutex_unlock(&cache->lock);
 
@@ -1964,8 +2564,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 
 		if (!block->is_dirty) {
 			cache->num_dirty_blocks++;
-			block->is_dirty = true;
-				// mark the block as dirty
+			mark_block_dirty(block);
 		}
 
 		TB(Get(cache, block));
@@ -2053,7 +2652,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		&& block->parent_data == NULL && wasUnchanged)
 		transaction->sub_num_blocks++;
 
-	if (cleared) {
+	if (cleared && !allocated) {
 		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
@@ -2063,7 +2662,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		mark_block_unbusy_reading(cache, block);
 	}
 
-	block->is_dirty = true;
+	mark_block_dirty(block);
 	TB(Get(cache, block));
 	TB2(BlockData(cache, block, "get writable"));
 
@@ -2071,6 +2670,165 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 }
 
 
+#ifndef BUILDING_USERLAND_FS_SERVER
+
+
+//	#pragma mark - BlockPrefetcher
+
+
+BlockPrefetcher::BlockPrefetcher(block_cache* cache, off_t blockNumber,
+		size_t numBlocks)
+	:
+	fCache(cache),
+	fBlockNumber(blockNumber),
+	fNumRequested(numBlocks),
+	fNumAllocated(0),
+	fBlocks(NULL),
+	fVecs(NULL)
+{
+}
+
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+	delete[] fBlocks;
+	delete[] fVecs;
+}
+
+
+/*!	Allocates and inserts blocks for the uncached run starting at
+	fBlockNumber. Stops at the first block that is already in the cache, so
+	that a single I/O request can be used to read the whole run; the caller
+	starts another prefetcher for the blocks after it.
+	The cache must be locked.
+*/
+status_t
+BlockPrefetcher::Allocate()
+{
+	ASSERT_LOCKED_MUTEX(&fCache->lock);
+
+	fBlocks = new(std::nothrow) cached_block*[fNumRequested];
+	fVecs = new(std::nothrow) generic_io_vec[fNumRequested];
+	if (fBlocks == NULL || fVecs == NULL)
+		return B_NO_MEMORY;
+
+	int32 now = system_time() / 1000000L;
+
+	for (size_t i = 0; i < fNumRequested; i++) {
+		off_t blockNumber = fBlockNumber + i;
+		if (fCache->Lookup(blockNumber) != NULL)
+			break;
+
+		cached_block* block = fCache->NewBlock(blockNumber);
+		if (block == NULL)
+			break;
+
+		block->last_accessed = now;
+		mark_block_busy_reading(fCache, block);
+
+		block_shard& shard = fCache->ShardFor(blockNumber);
+		MutexLocker shardLocker(shard.lock);
+		shard.hash->Insert(block);
+		shardLocker.Unlock();
+
+		fBlocks[i] = block;
+		fVecs[i].base = (generic_addr_t)block->current_data;
+		fVecs[i].length = fCache->block_size;
+		fNumAllocated++;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Starts reading the allocated blocks with a single I/O request. The
+	object is deleted when the request has finished.
+	The cache must not be locked.
+*/
+status_t
+BlockPrefetcher::ReadAsync()
+{
+	size_t blockSize = fCache->block_size;
+
+	IORequest* request = IORequest::Create(false);
+	if (request == NULL) {
+		_Finish(0);
+		return B_NO_MEMORY;
+	}
+
+	status_t status = request->Init(fBlockNumber * blockSize, fVecs,
+		fNumAllocated, fNumAllocated * blockSize, false, B_DELETE_IO_REQUEST);
+	if (status != B_OK) {
+		delete request;
+		_Finish(0);
+		return status;
+	}
+
+	request->SetFinishedCallback(&_IOFinished, this);
+
+	return do_fd_io(fCache->fd, request);
+}
+
+
+/*static*/ status_t
+BlockPrefetcher::_IOFinished(void* cookie, io_request* request,
+	status_t status, bool partialTransfer, generic_size_t bytesTransferred)
+{
+	BlockPrefetcher* prefetcher = (BlockPrefetcher*)cookie;
+
+	if (status != B_OK) {
+		TB(Error(prefetcher->fCache, prefetcher->fBlockNumber,
+			"prefetch failed", status));
+		bytesTransferred = 0;
+	}
+
+	prefetcher->_Finish(bytesTransferred);
+	return B_OK;
+}
+
+
+/*!	Makes the blocks that could be read accessible, and removes the others
+	again. Blocks that have not been asked for in the mean time are moved to
+	the unused list.
+	Deletes the prefetcher.
+*/
+void
+BlockPrefetcher::_Finish(generic_size_t bytesTransferred)
+{
+	block_cache* cache = fCache;
+	size_t numRead = bytesTransferred / cache->block_size;
+
+	mutex_lock(&cache->lock);
+
+	for (size_t i = 0; i < fNumAllocated; i++) {
+		cached_block* block = fBlocks[i];
+
+		if (i >= numRead) {
+			// make sure no one gets hold of the block without the cache lock
+			block->discard = true;
+		}
+
+		mark_block_unbusy_reading(cache, block);
+
+		if (block->discard) {
+			// Waiters will retry, and read the block themselves
+			cache->RemoveBlock(block);
+			continue;
+		}
+
+		TB(Read(cache, block));
+		cache->MarkUnusedIfUnreferenced(block);
+	}
+
+	delete this;
+
+	mutex_unlock(&cache->lock);
+}
+
+
+#endif	// !BUILDING_USERLAND_FS_SERVER
+
+
 #if DEBUG_BLOCK_CACHE
 
 
@@ -2084,7 +2842,8 @@ dump_block(cached_block* block)
 		(addr_t)block->parent_data, block->ref_count, block->LastAccess(),
 		block->busy_reading ? 'r' : '-', block->busy_writing ? 'w' : '-',
 		block->is_writing ? 'W' : '-', block->is_dirty ? 'D' : '-',
-		block->unused ? 'U' : '-', block->discard ? 'D' : '-',
+		block->unused ? (block->hot ? 'H' : 'U') : '-',
+		block->discard ? 'D' : '-',
 		(addr_t)block->transaction,
 		(addr_t)block->previous_transaction);
 }
@@ -2113,6 +2872,8 @@ dump_block_long(cached_block* block)
 		kprintf(" is-dirty");
 	if (block->unused)
 		kprintf(" unused");
+	if (block->hot)
+		kprintf(" hot");
 	if (block->discard)
 		kprintf(" discard");
 	kprintf("\n");
@@ -2186,7 +2947,7 @@ dump_cache(int argc, char** argv)
 	off_t blockNumber = -1;
 	if (i + 1 < argc) {
 		blockNumber = parse_expression(argv[i + 1]);
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL)
 			dump_block_long(block);
 		else
@@ -2246,7 +3007,7 @@ dump_cache(int argc, char** argv)
 	uint32 count = 0;
 	uint32 dirty = 0;
 	uint32 discarded = 0;
-	BlockTable::Iterator iterator(cache->hash);
+	CachedBlockIterator iterator(cache);
 	while (iterator.HasNext()) {
 		cached_block* block = iterator.Next();
 		if (showBlocks)
@@ -2261,11 +3022,18 @@ dump_cache(int argc, char** argv)
 		count++;
 	}
 
+	block_cache_stats stats;
+	cache->GetStats(stats);
+
 	kprintf(" %" B_PRIu32 " blocks total, %" B_PRIu32 " dirty, %" B_PRIu32
-		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRIu32
-		" in unused.\n",
+		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRId32
+		" in unused (%" B_PRId32 " hot).\n",
 		count, dirty, discarded, referenced, cache->busy_reading_count,
-		cache->unused_block_count);
+		stats.unused_blocks, stats.hot_unused_blocks);
+	kprintf(" %" B_PRId64 " hits, %" B_PRId64 " misses, %" B_PRId64
+		" ghost hits, %" B_PRId64 " promotions, %" B_PRId64 " evictions.\n",
+		stats.hits, stats.misses, stats.ghost_hits, stats.promotions,
+		stats.evictions);
 	return 0;
 }
 
@@ -2499,9 +3267,38 @@ get_next_locked_block_cache(block_cache* last)
 }
 
 
+/*!	Returns whether or not more than the allowed percentage of the cached
+	blocks of \a cache are dirty. This includes the blocks of transactions
+	that have been ended, but not yet written back.
+	The cache must be locked.
+*/
+static bool
+has_too_many_dirty_blocks(block_cache* cache,
+	const block_cache_writeback_policy& policy)
+{
+	if (policy.dirty_ratio >= 100)
+		return false;
+
+	uint64 dirty = cache->num_dirty_blocks;
+
+	TransactionTable::Iterator iterator(cache->transaction_hash);
+	while (cache_transaction* transaction = iterator.Next()) {
+		if (!transaction->open)
+			dirty += transaction->num_blocks;
+	}
+
+	uint64 total = 0;
+	for (uint32 i = 0; i < kBlockShardCount; i++)
+		total += cache->shards[i].hash->CountElements();
+
+	return dirty * 100 > total * policy.dirty_ratio;
+}
+
+
 /*!	Background thread that continuously checks for pending notifications of
 	all caches.
-	Every two seconds, it will also write back up to 64 blocks per cache.
+	Periodically, it will also write back the dirty blocks of each cache as
+	configured by the writeback policy.
 */
 static status_t
 block_notifier_and_writer(void* /*data*/)
@@ -2520,28 +3317,48 @@ block_notifier_and_writer(void* /*data*/)
 			continue;
 		}
 
-		// write 64 blocks of each block_cache every two seconds
+		// write back the expired dirty blocks of each block_cache, or all of
+		// them if there are too many
 		// TODO: change this once we have an I/O scheduler
-		timeout = kTimeout;
+		mutex_lock(&sWritebackPolicyLock);
+		block_cache_writeback_policy policy = sWritebackPolicy;
+		mutex_unlock(&sWritebackPolicyLock);
+
+		timeout = policy.interval;
+
 		size_t usedMemory;
 		object_cache_get_usage(sBlockCache, &usedMemory);
 
 		block_cache* cache = NULL;
 		while ((cache = get_next_locked_block_cache(cache)) != NULL) {
-			BlockWriter writer(cache, 64);
+			BlockWriter writer(cache, policy.blocks_per_pass);
 
 			size_t cacheUsedMemory;
 			object_cache_get_usage(cache->buffer_cache, &cacheUsedMemory);
 			usedMemory += cacheUsedMemory;
 
+			bool tooManyDirty = has_too_many_dirty_blocks(cache, policy);
+			if (tooManyDirty) {
+				// come back sooner to get the number of dirty blocks down
+				timeout = policy.interval / 4;
+			}
+
+			bigtime_t now = system_time();
+
 			if (cache->num_dirty_blocks) {
 				// This cache is not using transactions, we'll scan the blocks
 				// directly
-				BlockTable::Iterator iterator(cache->hash);
+				int32 expired = (now - policy.dirty_expire) / 1000000L;
+				CachedBlockIterator iterator(cache);
 
 				while (iterator.HasNext()) {
 					cached_block* block = iterator.Next();
-					if (block->CanBeWritten() && !writer.Add(block))
+					if (!block->CanBeWritten()
+						|| (!tooManyDirty && policy.dirty_expire > 0
+							&& block->dirty_since > expired))
+						continue;
+
+					if (!writer.Add(block))
 						break;
 				}
 
@@ -2551,7 +3368,7 @@ block_notifier_and_writer(void* /*data*/)
 				while (iterator.HasNext()) {
 					cache_transaction* transaction = iterator.Next();
 					if (transaction->open) {
-						if (system_time() > transaction->last_used
+						if (now > transaction->last_used
 								+ kTransactionIdleTime) {
 							// Transaction is open but idle
 							notify_transaction_listeners(cache, transaction,
@@ -2559,6 +3376,9 @@ block_notifier_and_writer(void* /*data*/)
 						}
 						continue;
 					}
+					if (!tooManyDirty && policy.dirty_expire > 0
+						&& now < transaction->last_used + policy.dirty_expire)
+						continue;
 
 					bool hasLeftOvers;
 						// we ignore this one
@@ -2645,6 +3465,87 @@ wait_for_notifications(block_cache* cache)
 }
 
 
+#ifndef BUILDING_USERLAND_FS_SERVER
+
+
+static status_t
+block_cache_control(const char* subsystem, uint32 function, void* buffer,
+	size_t bufferSize)
+{
+	switch (function) {
+		case BLOCK_CACHE_GET_STATS:
+		{
+			if (buffer == NULL || !IS_USER_ADDRESS(buffer))
+				return B_BAD_ADDRESS;
+
+			block_cache_stats* userStats = (block_cache_stats*)buffer;
+			size_t maxCount = bufferSize / sizeof(block_cache_stats);
+			int32 count = 0;
+
+			MutexLocker locker(sCachesLock);
+
+			DoublyLinkedList<block_cache>::Iterator iterator
+				= sCaches.GetIterator();
+			while (block_cache* cache = iterator.Next()) {
+				if (cache == (block_cache*)&sMarkCache)
+					continue;
+
+				if ((size_t)count < maxCount) {
+					block_cache_stats stats;
+					cache->GetStats(stats);
+
+					if (user_memcpy(&userStats[count], &stats, sizeof(stats))
+							!= B_OK)
+						return B_BAD_ADDRESS;
+				}
+				count++;
+			}
+
+			return count;
+		}
+
+		case BLOCK_CACHE_GET_WRITEBACK_POLICY:
+		{
+			if (buffer == NULL || !IS_USER_ADDRESS(buffer)
+				|| bufferSize < sizeof(block_cache_writeback_policy))
+				return B_BAD_VALUE;
+
+			mutex_lock(&sWritebackPolicyLock);
+			block_cache_writeback_policy policy = sWritebackPolicy;
+			mutex_unlock(&sWritebackPolicyLock);
+
+			return user_memcpy(buffer, &policy, sizeof(policy));
+		}
+
+		case BLOCK_CACHE_SET_WRITEBACK_POLICY:
+		{
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+			if (buffer == NULL || !IS_USER_ADDRESS(buffer)
+				|| bufferSize < sizeof(block_cache_writeback_policy))
+				return B_BAD_VALUE;
+
+			block_cache_writeback_policy policy;
+			if (user_memcpy(&policy, buffer, sizeof(policy)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			if (policy.interval < 100000 || policy.dirty_expire < 0
+				|| policy.dirty_ratio > 100 || policy.blocks_per_pass == 0)
+				return B_BAD_VALUE;
+
+			MutexLocker _(sWritebackPolicyLock);
+			sWritebackPolicy = policy;
+			return B_OK;
+		}
+	}
+
+	return B_BAD_VALUE;
+}
+
+
+#endif	// !BUILDING_USERLAND_FS_SERVER
+
+
 status_t
 block_cache_init(void)
 {
@@ -2665,6 +3566,10 @@ block_cache_init(void)
 	if (sNotifierWriterThread >= B_OK)
 		resume_thread(sNotifierWriterThread);
 
+#ifndef BUILDING_USERLAND_FS_SERVER
+	register_generic_syscall(BLOCK_CACHE_SYSCALLS, block_cache_control, 1, 0);
+#endif
+
 #if DEBUG_BLOCK_CACHE
 	add_debugger_command_etc("block_caches", &dump_caches,
 		"dumps all block caches", "\n", 0);
@@ -3060,12 +3965,8 @@ cache_abort_sub_transaction(void* _cache, int32 id)
 				block->original_data = NULL;
 				block->is_dirty = false;
 
-				if (block->ref_count == 0) {
-					// Move the block into the unused list if possible
-					block->unused = true;
-					cache->unused_blocks.Add(block);
-					cache->unused_block_count++;
-				}
+				// Move the block into the unused list if possible
+				cache->MarkUnusedIfUnreferenced(block);
 			}
 		} else {
 			if (block->parent_data != block->current_data) {
@@ -3318,11 +4219,13 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	// free all blocks
 
-	cached_block* block = cache->hash->Clear(true);
-	while (block != NULL) {
-		cached_block* next = block->next;
-		cache->FreeBlock(block);
-		block = next;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		cached_block* block = cache->shards[i].hash->Clear(true);
+		while (block != NULL) {
+			cached_block* next = block->next;
+			cache->FreeBlock(block);
+			block = next;
+		}
 	}
 
 	// free all transactions (they will all be aborted)
@@ -3369,7 +4272,7 @@ block_cache_sync(void* _cache)
 	MutexLocker locker(&cache->lock);
 
 	BlockWriter writer(cache);
-	BlockTable::Iterator iterator(cache->hash);
+	CachedBlockIterator iterator(cache);
 
 	while (iterator.HasNext()) {
 		cached_block* block = iterator.Next();
@@ -3407,7 +4310,7 @@ block_cache_sync_etc(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (; numBlocks > 0; numBlocks--, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
@@ -3441,7 +4344,7 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL && block->previous_transaction != NULL)
 			writer.Add(block);
 	}
@@ -3453,16 +4356,22 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 		// reset blockNumber to its original value
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
 		ASSERT(block->previous_transaction == NULL);
 
-		if (block->unused) {
-			cache->unused_blocks.Remove(block);
-			cache->unused_block_count--;
-			cache->RemoveBlock(block);
+		block_shard& shard = cache->ShardFor(blockNumber);
+		MutexLocker shardLocker(shard.lock);
+
+		if (block->unused && block->ref_count == 0) {
+			// The fast path of block_cache_get() could reference the block
+			// as soon as we unlock the shard, so we remove it from the hash
+			// before that
+			cache->UnlinkBlock(shard, block);
+			shardLocker.Unlock();
+			cache->FreeBlock(block);
 		} else {
 			if (block->transaction != NULL && block->parent_data != NULL
 				&& block->parent_data != block->current_data) {
@@ -3545,6 +4454,16 @@ const void*
 block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+	if (blockNumber >= 0 && blockNumber < cache->max_blocks) {
+		// try to get a clean cached block without locking the whole cache
+		cached_block* block = get_clean_cached_block(cache, blockNumber);
+		if (block != NULL) {
+			TB(Get(cache, block));
+			return block->current_data;
+		}
+	}
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
@@ -3571,6 +4490,75 @@ block_cache_get(void* _cache, off_t blockNumber)
 }
 
 
+/*!	Starts reading the blocks from \a blockNumber on into the cache, without
+	waiting for the I/O to complete, and without acquiring references to the
+	blocks. Blocks that are already in the cache are skipped; every run of
+	uncached blocks in between is read with a single request.
+	A later block_cache_get() of one of those blocks will only wait if it has
+	not arrived yet.
+	Note, if the device does not have an io() hook, the VFS executes the
+	requests synchronously, and this function only returns after all blocks
+	have been read.
+*/
+status_t
+block_cache_prefetch(void* _cache, off_t blockNumber, size_t numBlocks)
+{
+#ifndef BUILDING_USERLAND_FS_SERVER
+	block_cache* cache = (block_cache*)_cache;
+
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return B_BAD_VALUE;
+	if ((off_t)numBlocks > cache->max_blocks - blockNumber)
+		numBlocks = cache->max_blocks - blockNumber;
+	if (numBlocks == 0)
+		return B_OK;
+
+	// Prefetching is only an optimization - don't make memory shortage worse
+	if (low_resource_state(B_KERNEL_RESOURCE_PAGES | B_KERNEL_RESOURCE_MEMORY
+			| B_KERNEL_RESOURCE_ADDRESS_SPACE) != B_NO_LOW_RESOURCE)
+		return B_OK;
+
+	TRACE(("block_cache_prefetch(block = %" B_PRIdOFF ", count = %" B_PRIuSIZE
+		")\n", blockNumber, numBlocks));
+
+	off_t end = blockNumber + numBlocks;
+
+	MutexLocker locker(&cache->lock);
+
+	while (true) {
+		while (blockNumber < end && cache->Lookup(blockNumber) != NULL)
+			blockNumber++;
+		if (blockNumber == end)
+			return B_OK;
+
+		BlockPrefetcher* prefetcher = new(std::nothrow) BlockPrefetcher(cache,
+			blockNumber, end - blockNumber);
+		if (prefetcher == NULL)
+			return B_NO_MEMORY;
+
+		status_t status = prefetcher->Allocate();
+		if (prefetcher->NumAllocated() == 0) {
+			delete prefetcher;
+			return status;
+		}
+
+		blockNumber += prefetcher->NumAllocated();
+
+		// the request may finish right away, which needs the cache lock
+		locker.Unlock();
+
+		status = prefetcher->ReadAsync();
+		if (status != B_OK)
+			return status;
+
+		locker.Lock();
+	}
+#else
+	return B_NOT_SUPPORTED;
+#endif
+}
+
+
 /*!	Changes the internal status of a writable block to \a dirty. This can be
 	helpful in case you realize you don't need to change that block anymore
 	for whatever reason.
@@ -3585,7 +4573,7 @@ block_cache_set_dirty(void* _cache, off_t blockNumber, bool dirty,
 	block_cache* cache = (block_cache*)_cache;
 	MutexLocker locker(&cache->lock);
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block == NULL)
 		return B_BAD_VALUE;
 	if (block->is_dirty == dirty) {
@@ -3605,6 +4593,9 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+	if (put_clean_cached_block(cache, blockNumber))
+		return;
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
@@ -42,6 +42,10 @@
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
 
+// read-ahead window limits (in bytes)
+#define READ_AHEAD_MIN_SIZE	(MAX_IO_VECS * B_PAGE_SIZE)	// 128 kB
+#define READ_AHEAD_MAX_SIZE	(2 * 1024 * 1024)
+
 struct file_cache_ref {
 	VMCache			*cache;
 	struct vnode	*vnode;
@@ -52,6 +56,14 @@ struct file_cache_ref {
 	int32			last_access_index;
 	uint16			disabled_count;
 
+	// read-ahead state, protected by the cache lock
+	off_t			read_ahead_next;
+		// the offset a sequential reader is expected to continue at
+	off_t			read_ahead_end;
+		// the end of the range that has already been scheduled for reading
+	size_t			read_ahead_size;
+		// the current read-ahead window, 0 when read-ahead is off
+
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
 		// we remember writes as negative offsets
@@ -113,6 +125,8 @@ static const size_t kZeroVecSize = kZeroVecCount * B_PAGE_SIZE;
 static phys_addr_t sZeroPage;	// physical address
 static generic_io_vec sZeroVecs[kZeroVecCount];
 
+static file_cache_read_ahead_stats sReadAheadStats;
+
 
 //	#pragma mark -
 
@@ -282,6 +296,179 @@ push_access(file_cache_ref* ref, off_t offset, generic_size_t bytes,
 }
 
 
+/*!	Schedules asynchronous reading of the pages in the given range of the
+	file that are not yet in its cache.
+	Returns \c B_OK if the whole range has been taken care of, an error code
+	if the prefetch was refused or could only be started in part. In either
+	case, \a _bytesIssued is set to the number of bytes actually scheduled.
+	The caller must hold a reference to the cache, but must not have it
+	locked.
+*/
+static status_t
+prefetch_cache(file_cache_ref* ref, off_t offset, size_t size,
+	size_t& _bytesIssued)
+{
+	VMCache* cache = ref->cache;
+	off_t fileSize = cache->virtual_end;
+
+	_bytesIssued = 0;
+
+	if ((off_t)(offset + size) > fileSize)
+		size = fileSize - offset;
+
+	// "offset" and "size" are always aligned to B_PAGE_SIZE,
+	offset = ROUNDDOWN(offset, B_PAGE_SIZE);
+	size = ROUNDUP(size, B_PAGE_SIZE);
+
+	size_t reservePages = size / B_PAGE_SIZE;
+
+	if (offset >= fileSize)
+		return B_BAD_VALUE;
+
+	// Don't do anything if we don't have the resources left, or the cache
+	// already contains more than 2/3 of its pages
+	if (vm_page_num_unused_pages() < 2 * reservePages
+		|| 3 * cache->page_count > 2 * fileSize / B_PAGE_SIZE) {
+		return B_NO_MEMORY;
+	}
+
+	status_t status = B_OK;
+	size_t bytesToRead = 0;
+	off_t lastOffset = offset;
+
+	vm_page_reservation reservation;
+	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
+
+	cache->Lock();
+
+	while (true) {
+		// check if this page is already in memory
+		if (size > 0) {
+			vm_page* page = cache->LookupPage(offset);
+
+			offset += B_PAGE_SIZE;
+			size -= B_PAGE_SIZE;
+
+			if (page == NULL) {
+				bytesToRead += B_PAGE_SIZE;
+				continue;
+			}
+		}
+		if (bytesToRead != 0) {
+			// read the part before the current page (or the end of the request)
+			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
+				bytesToRead);
+			status = io != NULL ? io->Prepare(&reservation) : B_NO_MEMORY;
+			if (status != B_OK) {
+				delete io;
+				break;
+			}
+
+			// we must not have the cache locked during I/O
+			cache->Unlock();
+			io->ReadAsync();
+			cache->Lock();
+
+			_bytesIssued += bytesToRead;
+			bytesToRead = 0;
+		}
+
+		if (size == 0) {
+			// we have reached the end of the request
+			break;
+		}
+
+		lastOffset = offset;
+	}
+
+	cache->Unlock();
+	vm_page_unreserve_pages(&reservation);
+
+	return status;
+}
+
+
+/*!	Updates the read-ahead window of the file for a read of \a size bytes at
+	\a offset, and schedules asynchronous reading of the data following the
+	request if the reader is likely to need it soon.
+	Sequential reads let the window grow up to READ_AHEAD_MAX_SIZE, any other
+	read shrinks it again, until read-ahead is turned off completely.
+	The cache must not be locked when calling this function.
+*/
+static void
+read_ahead(file_cache_ref* ref, off_t offset, size_t size)
+{
+	VMCache* cache = ref->cache;
+	off_t prefetchOffset = 0;
+	size_t prefetchSize = 0;
+
+	cache->Lock();
+
+	off_t end = offset + size;
+	off_t fileSize = cache->virtual_end;
+	if (end > fileSize)
+		end = fileSize;
+
+	if (offset == ref->read_ahead_next) {
+		atomic_add64(&sReadAheadStats.sequential_hits, 1);
+
+		if (ref->read_ahead_size == 0)
+			ref->read_ahead_size = READ_AHEAD_MIN_SIZE;
+		else if (ref->read_ahead_size < READ_AHEAD_MAX_SIZE)
+			ref->read_ahead_size *= 2;
+
+		if (ref->read_ahead_end < end)
+			ref->read_ahead_end = end;
+
+		// Keep at least half a window ahead of the reader, so that the
+		// next part is already on its way when the reader gets there
+		if (ref->read_ahead_end < fileSize
+			&& ref->read_ahead_end - end
+				< (off_t)ref->read_ahead_size / 2) {
+			prefetchOffset = ref->read_ahead_end;
+			prefetchSize = min_c((off_t)ref->read_ahead_size,
+				fileSize - prefetchOffset);
+		}
+	} else {
+		atomic_add64(&sReadAheadStats.sequential_misses, 1);
+
+		ref->read_ahead_size /= 2;
+		if (ref->read_ahead_size < READ_AHEAD_MIN_SIZE)
+			ref->read_ahead_size = 0;
+		ref->read_ahead_end = end;
+	}
+
+	ref->read_ahead_next = end;
+
+	cache->Unlock();
+
+	if (prefetchSize == 0
+		|| low_resource_state(B_KERNEL_RESOURCE_PAGES) != B_NO_LOW_RESOURCE)
+		return;
+
+	TRACE(("%p: read ahead %Ld, %lu\n", ref, prefetchOffset, prefetchSize));
+
+	size_t bytesIssued;
+	status_t status = prefetch_cache(ref, prefetchOffset, prefetchSize,
+		bytesIssued);
+
+	if (bytesIssued > 0) {
+		atomic_add64(&sReadAheadStats.prefetch_requests, 1);
+		atomic_add64(&sReadAheadStats.prefetched_bytes, bytesIssued);
+	}
+
+	if (status != B_OK)
+		return;
+
+	// Only now that the window is on its way, move its end forward -- unless
+	// another reader has changed it in the mean time
+	cache->Lock();
+	if (ref->read_ahead_end == prefetchOffset)
+		ref->read_ahead_end = prefetchOffset + prefetchSize;
+	cache->Unlock();
+}
+
+
 static void
 reserve_pages(file_cache_ref* ref, vm_page_reservation* reservation,
 	size_t reservePages, bool isWrite)
@@ -930,6 +1117,29 @@ file_cache_control(const char* subsystem, uint32 function, void* buffer,
 
 			return status;
 		}
+
+		case CACHE_GET_READ_AHEAD_STATS:
+		{
+			if (buffer == NULL
+				|| bufferSize < sizeof(file_cache_read_ahead_stats))
+				return B_BAD_VALUE;
+
+			file_cache_read_ahead_stats stats;
+			stats.sequential_hits
+				= atomic_get64(&sReadAheadStats.sequential_hits);
+			stats.sequential_misses
+				= atomic_get64(&sReadAheadStats.sequential_misses);
+			stats.prefetch_requests
+				= atomic_get64(&sReadAheadStats.prefetch_requests);
+			stats.prefetched_bytes
+				= atomic_get64(&sReadAheadStats.prefetched_bytes);
+
+			if (!IS_USER_ADDRESS(buffer)
+				|| user_memcpy(buffer, &stats, sizeof(stats)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			return B_OK;
+		}
 	}
 
 	return B_BAD_HANDLER;
@@ -949,74 +1159,11 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 	if (vfs_get_vnode_cache(vnode, &cache, false) != B_OK)
 		return;
 
-	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
-	off_t fileSize = cache->virtual_end;
-
-	if ((off_t)(offset + size) > fileSize)
-		size = fileSize - offset;
+	size_t bytesIssued;
+	prefetch_cache(((VMVnodeCache*)cache)->FileCacheRef(), offset, size,
+		bytesIssued);
 
-	// "offset" and "size" are always aligned to B_PAGE_SIZE,
-	offset = ROUNDDOWN(offset, B_PAGE_SIZE);
-	size = ROUNDUP(size, B_PAGE_SIZE);
-
-	size_t reservePages = size / B_PAGE_SIZE;
-
-	// Don't do anything if we don't have the resources left, or the cache
-	// already contains more than 2/3 of its pages
-	if (offset >= fileSize || vm_page_num_unused_pages() < 2 * reservePages
-		|| 3 * cache->page_count > 2 * fileSize / B_PAGE_SIZE) {
-		cache->ReleaseRef();
-		return;
-	}
-
-	size_t bytesToRead = 0;
-	off_t lastOffset = offset;
-
-	vm_page_reservation reservation;
-	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
-
-	cache->Lock();
-
-	while (true) {
-		// check if this page is already in memory
-		if (size > 0) {
-			vm_page* page = cache->LookupPage(offset);
-
-			offset += B_PAGE_SIZE;
-			size -= B_PAGE_SIZE;
-
-			if (page == NULL) {
-				bytesToRead += B_PAGE_SIZE;
-				continue;
-			}
-		}
-		if (bytesToRead != 0) {
-			// read the part before the current page (or the end of the request)
-			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
-				bytesToRead);
-			if (io == NULL || io->Prepare(&reservation) != B_OK) {
-				delete io;
-				break;
-			}
-
-			// we must not have the cache locked during I/O
-			cache->Unlock();
-			io->ReadAsync();
-			cache->Lock();
-
-			bytesToRead = 0;
-		}
-
-		if (size == 0) {
-			// we have reached the end of the request
-			break;
-		}
-
-		lastOffset = offset;
-	}
-
-	cache->ReleaseRefAndUnlock();
-	vm_page_unreserve_pages(&reservation);
+	cache->ReleaseRef();
 }
 
 
@@ -1133,6 +1280,9 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 	memset(ref->last_access, 0, sizeof(ref->last_access));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
+	ref->read_ahead_next = 0;
+	ref->read_ahead_end = 0;
+	ref->read_ahead_size = 0;
 
 	// TODO: delay VMCache creation until data is
 	//	requested/written for the first time? Listing lots of
@@ -1299,6 +1449,9 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
+	if (buffer != NULL && *_size > 0)
+		read_ahead(ref, offset, *_size);
+
 	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
 }
 
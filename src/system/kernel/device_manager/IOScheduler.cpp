@@ -21,6 +21,7 @@ IOScheduler::IOScheduler(DMAResource* resource)
 	fIOCallbackData(NULL),
 	fSchedulerRegistered(false)
 {
+	memset(&fStatistics, 0, sizeof(fStatistics));
 }
 
 
@@ -72,3 +73,28 @@ void
 IOScheduler::MediaChanged()
 {
 }
+
+
+void
+IOScheduler::DumpStatistics() const
+{
+	static const char* const kDirections[] = { "read", "write" };
+
+	kprintf("  operations:       %" B_PRIu64 "\n", fStatistics.operations);
+
+	for (int32 i = 0; i < IO_SCHEDULER_DIRECTIONS; i++) {
+		kprintf("  %s requests:%s   %" B_PRIu64 " (%" B_PRIu64 " merged), %"
+			B_PRIu64 " bytes\n", kDirections[i], i == 0 ? " " : "",
+			fStatistics.requests[i], fStatistics.merged_requests[i],
+			fStatistics.bytes[i]);
+
+		if (fStatistics.dispatched[i] == 0)
+			continue;
+
+		kprintf("    dispatched %" B_PRIu64 ", %" B_PRIu64 " expired, wait "
+			"time avg %" B_PRId64 " us, max %" B_PRId64 " us\n",
+			fStatistics.dispatched[i], fStatistics.expired[i],
+			fStatistics.total_wait_time[i] / fStatistics.dispatched[i],
+			fStatistics.max_wait_time[i]);
+	}
+}
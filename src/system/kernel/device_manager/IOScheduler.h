@@ -32,6 +32,27 @@ struct IORequestOwner : DoublyLinkedListLinkImpl<IORequestOwner> {
 };
 
 
+// indices of the per direction statistics
+enum {
+	IO_SCHEDULER_READ = 0,
+	IO_SCHEDULER_WRITE,
+	IO_SCHEDULER_DIRECTIONS
+};
+
+struct io_scheduler_statistics {
+	uint64			requests[IO_SCHEDULER_DIRECTIONS];
+	uint64			merged_requests[IO_SCHEDULER_DIRECTIONS];
+	uint64			bytes[IO_SCHEDULER_DIRECTIONS];
+	uint64			operations;
+
+	// only maintained by schedulers that queue and reorder requests
+	uint64			dispatched[IO_SCHEDULER_DIRECTIONS];
+	uint64			expired[IO_SCHEDULER_DIRECTIONS];
+	bigtime_t		total_wait_time[IO_SCHEDULER_DIRECTIONS];
+	bigtime_t		max_wait_time[IO_SCHEDULER_DIRECTIONS];
+};
+
+
 class IOScheduler : public DoublyLinkedListLinkImpl<IOScheduler> {
 public:
 								IOScheduler(DMAResource* resource);
@@ -61,6 +82,10 @@ public:
 
 	virtual	void				Dump() const = 0;
 
+			const io_scheduler_statistics& Statistics() const
+									{ return fStatistics; }
+			void				DumpStatistics() const;
+
 protected:
 			DMAResource*		fDMAResource;
 			char*				fName;
@@ -68,6 +93,7 @@ protected:
 			io_callback			fIOCallback;
 			void*				fIOCallbackData;
 			bool				fSchedulerRegistered;
+			io_scheduler_statistics fStatistics;
 };
 
 
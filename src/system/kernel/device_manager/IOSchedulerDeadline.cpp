@@ -0,0 +1,829 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	An I/O scheduler that keeps the requests of each direction sorted by
+	their offset, and serves them in elevator order in batches. Every request
+	gets an expiry deadline, and when the oldest request of a direction has
+	expired, the next batch starts with it. Reads are preferred over writes,
+	but only for a limited number of batches while writes are waiting.
+	Requests that are adjacent to a queued one of the same direction are
+	merged into a run, whose operations are passed to the driver back to back.
+	Unlike IOSchedulerSimple, operations are passed to the driver as soon as
+	there is room in the device queue, instead of in separate iterations.
+*/
+
+
+#include "IOSchedulerDeadline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <thread.h>
+#include <util/AutoLock.h>
+
+#include "IOSchedulerRoster.h"
+
+
+//#define TRACE_IO_SCHEDULER
+#ifdef TRACE_IO_SCHEDULER
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+static const bigtime_t kDefaultReadExpire = 500000;
+static const bigtime_t kDefaultWriteExpire = 5000000;
+static const int32 kDefaultFifoBatch = 16;
+static const int32 kDefaultWritesStarved = 2;
+static const int32 kDefaultQueueDepth = 32;
+
+// merging stops at this size, so that runs don't monopolize the device
+static const off_t kMaxRunLength = 1024 * 1024;
+
+
+IOSchedulerDeadline::IOSchedulerDeadline(DMAResource* resource)
+	:
+	IOScheduler(resource),
+	fSchedulerThread(-1),
+	fRequestNotifierThread(-1),
+	fActiveOperations(NULL),
+	fActiveOperationCount(0),
+	fCurrentRun(NULL),
+	fCurrentDirection(IO_SCHEDULER_READ),
+	fBatchCount(0),
+	fStarvedWrites(0),
+	fNextRunSequence(0),
+	fLastOffset(0),
+	fBlockSize(0),
+	fFifoBatch(kDefaultFifoBatch),
+	fWritesStarved(kDefaultWritesStarved),
+	fQueueDepth(kDefaultQueueDepth),
+	fTerminating(false)
+{
+	mutex_init(&fLock, "I/O deadline scheduler");
+	B_INITIALIZE_SPINLOCK(&fFinisherLock);
+
+	fWorkCondition.Init(this, "I/O scheduler work");
+	fFinishedRequestCondition.Init(this, "I/O finished request");
+
+	fDirections[IO_SCHEDULER_READ].expire = kDefaultReadExpire;
+	fDirections[IO_SCHEDULER_WRITE].expire = kDefaultWriteExpire;
+}
+
+
+IOSchedulerDeadline::~IOSchedulerDeadline()
+{
+	// shutdown threads
+	MutexLocker locker(fLock);
+	InterruptsSpinLocker finisherLocker(fFinisherLock);
+	fTerminating = true;
+
+	fWorkCondition.NotifyAll();
+	fFinishedRequestCondition.NotifyAll();
+
+	finisherLocker.Unlock();
+	locker.Unlock();
+
+	if (fSchedulerThread >= 0)
+		wait_for_thread(fSchedulerThread, NULL);
+
+	if (fRequestNotifierThread >= 0)
+		wait_for_thread(fRequestNotifierThread, NULL);
+
+	// destroy our belongings
+	mutex_lock(&fLock);
+	mutex_destroy(&fLock);
+
+	while (IOOperation* operation = fUnusedOperations.RemoveHead())
+		delete operation;
+
+	for (int32 i = 0; i < IO_SCHEDULER_DIRECTIONS; i++) {
+		while (Run* run = fDirections[i].fifo.RemoveHead()) {
+			fDirections[i].sorted.Remove(run);
+			delete run;
+		}
+	}
+	delete fCurrentRun;
+
+	delete[] fActiveOperations;
+}
+
+
+status_t
+IOSchedulerDeadline::Init(const char* name)
+{
+	status_t error = IOScheduler::Init(name);
+	if (error != B_OK)
+		return error;
+
+	size_t count = fDMAResource != NULL ? fDMAResource->BufferCount() : 16;
+	for (size_t i = 0; i < count; i++) {
+		IOOperation* operation = new(std::nothrow) IOOperation;
+		if (operation == NULL)
+			return B_NO_MEMORY;
+
+		fUnusedOperations.Add(operation);
+	}
+
+	fActiveOperations = new(std::nothrow) IOOperation*[count];
+	if (fActiveOperations == NULL)
+		return B_NO_MEMORY;
+
+	fQueueDepth = min_c(fQueueDepth, (int32)count);
+
+	if (fDMAResource != NULL)
+		fBlockSize = fDMAResource->BlockSize();
+	if (fBlockSize == 0)
+		fBlockSize = 512;
+
+	// start threads
+	char buffer[B_OS_NAME_LENGTH];
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " scheduler ", sizeof(buffer));
+	size_t nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fSchedulerThread = spawn_kernel_thread(&_SchedulerThread, buffer,
+		B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fSchedulerThread < B_OK)
+		return fSchedulerThread;
+
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " notifier ", sizeof(buffer));
+	nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fRequestNotifierThread = spawn_kernel_thread(&_RequestNotifierThread,
+		buffer, B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fRequestNotifierThread < B_OK)
+		return fRequestNotifierThread;
+
+	resume_thread(fSchedulerThread);
+	resume_thread(fRequestNotifierThread);
+
+	return B_OK;
+}
+
+
+void
+IOSchedulerDeadline::SetReadExpire(bigtime_t expire)
+{
+	fDirections[IO_SCHEDULER_READ].expire = max_c(expire, 0);
+}
+
+
+void
+IOSchedulerDeadline::SetWriteExpire(bigtime_t expire)
+{
+	fDirections[IO_SCHEDULER_WRITE].expire = max_c(expire, 0);
+}
+
+
+void
+IOSchedulerDeadline::SetFifoBatch(int32 fifoBatch)
+{
+	fFifoBatch = max_c(fifoBatch, 1);
+}
+
+
+void
+IOSchedulerDeadline::SetWritesStarved(int32 writesStarved)
+{
+	fWritesStarved = max_c(writesStarved, 0);
+}
+
+
+void
+IOSchedulerDeadline::SetQueueDepth(int32 queueDepth)
+{
+	fQueueDepth = max_c(queueDepth, 1);
+}
+
+
+status_t
+IOSchedulerDeadline::ScheduleRequest(IORequest* request)
+{
+	TRACE("%p->IOSchedulerDeadline::ScheduleRequest(%p)\n", this, request);
+
+	IOBuffer* buffer = request->Buffer();
+
+	if (buffer->IsVirtual()) {
+		status_t status = buffer->LockMemory(request->TeamID(),
+			request->IsWrite());
+		if (status != B_OK) {
+			request->SetStatusAndNotify(status);
+			return status;
+		}
+	}
+
+	MutexLocker locker(fLock);
+
+	int32 index = request->IsWrite() ? IO_SCHEDULER_WRITE : IO_SCHEDULER_READ;
+	Direction& direction = fDirections[index];
+	off_t offset = request->Offset();
+	off_t end = offset + request->Length();
+
+	fStatistics.requests[index]++;
+	fStatistics.bytes[index] += request->Length();
+
+	// try to append the request to a run that ends where it starts
+	Run* run = direction.sorted.FindClosest(offset, true);
+	if (run != NULL && run->end == offset
+		&& end - run->start <= kMaxRunLength) {
+		run->requests.Add(request);
+		run->end = end;
+		fStatistics.merged_requests[index]++;
+	} else {
+		// or to prepend it to a run that starts where it ends
+		run = direction.sorted.Find(end);
+		if (run != NULL && run->end - offset <= kMaxRunLength) {
+			direction.sorted.Remove(run);
+			run->requests.Add(request, false);
+			run->start = offset;
+			direction.sorted.Insert(run);
+			fStatistics.merged_requests[index]++;
+		} else {
+			run = new(std::nothrow) Run;
+			if (run == NULL) {
+				locker.Unlock();
+				if (buffer->IsVirtual())
+					buffer->UnlockMemory(request->TeamID(), request->IsWrite());
+				request->SetStatusAndNotify(B_NO_MEMORY);
+				return B_NO_MEMORY;
+			}
+
+			run->start = offset;
+			run->end = end;
+			run->arrival = system_time();
+			run->deadline = run->arrival + direction.expire;
+			run->sequence = fNextRunSequence++;
+			run->requests.Add(request);
+
+			direction.sorted.Insert(run);
+			direction.fifo.Add(run);
+		}
+	}
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_SCHEDULED, this,
+		request);
+
+	fWorkCondition.NotifyAll();
+	return B_OK;
+}
+
+
+void
+IOSchedulerDeadline::AbortRequest(IORequest* request, status_t status)
+{
+	TRACE("%p->IOSchedulerDeadline::AbortRequest(%p, %" B_PRId32 ")\n", this,
+		request, status);
+
+	MutexLocker locker(fLock);
+
+	if (!_RemoveQueuedRequest(request)) {
+		// the current run has already been dequeued
+		if (fCurrentRun == NULL || !fCurrentRun->requests.Contains(request))
+			return;
+
+		fCurrentRun->requests.Remove(request);
+
+		// Only the first request of the current run can have been passed to
+		// the driver already.
+		generic_size_t translated
+			= request->Length() - request->RemainingBytes();
+		if (translated > 0) {
+			request->SetTransferredBytes(true, translated);
+
+			// the operations still pending finish the request, if there are
+			// any
+			if (_HasPendingOperations(request))
+				return;
+		}
+	}
+
+	locker.Unlock();
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED, this,
+		request);
+	request->SetStatusAndNotify(status);
+}
+
+
+void
+IOSchedulerDeadline::OperationCompleted(IOOperation* operation,
+	status_t status, generic_size_t transferredBytes)
+{
+	InterruptsSpinLocker _(fFinisherLock);
+
+	// finish operation only once
+	if (operation->Status() <= 0)
+		return;
+
+	operation->SetStatus(status);
+
+	// set the bytes transferred (of the net data)
+	generic_size_t partialBegin
+		= operation->OriginalOffset() - operation->Offset();
+	operation->SetTransferredBytes(
+		transferredBytes > partialBegin ? transferredBytes - partialBegin : 0);
+
+	fCompletedOperations.Add(operation);
+	fWorkCondition.NotifyAll();
+}
+
+
+void
+IOSchedulerDeadline::Dump() const
+{
+	kprintf("IOSchedulerDeadline at %p\n", this);
+	kprintf("  DMA resource:   %p\n", fDMAResource);
+	kprintf("  expire:         read %" B_PRId64 " us, write %" B_PRId64
+		" us\n", fDirections[IO_SCHEDULER_READ].expire,
+		fDirections[IO_SCHEDULER_WRITE].expire);
+	kprintf("  batching:       %" B_PRId32 " runs, writes starved after %"
+		B_PRId32 "\n", fFifoBatch, fWritesStarved);
+	kprintf("  queue depth:    %" B_PRId32 " (%" B_PRId32 " active)\n",
+		fQueueDepth, fActiveOperationCount);
+	kprintf("  queued runs:    read %" B_PRId32 ", write %" B_PRId32 "\n",
+		fDirections[IO_SCHEDULER_READ].sorted.Count(),
+		fDirections[IO_SCHEDULER_WRITE].sorted.Count());
+	kprintf("  current run:    %p, %s, batch %" B_PRId32 "\n", fCurrentRun,
+		fCurrentDirection == IO_SCHEDULER_WRITE ? "write" : "read",
+		fBatchCount);
+
+	kprintf("  active operations:");
+	for (int32 i = 0; i < fActiveOperationCount; i++)
+		kprintf(" %p", fActiveOperations[i]);
+	kprintf("\n");
+
+	DumpStatistics();
+}
+
+
+/*!	Must not be called with the fLock held. */
+void
+IOSchedulerDeadline::_Finisher()
+{
+	while (true) {
+		InterruptsSpinLocker locker(fFinisherLock);
+		IOOperation* operation = fCompletedOperations.RemoveHead();
+		if (operation == NULL)
+			return;
+
+		locker.Unlock();
+
+		TRACE("IOSchedulerDeadline::_Finisher(): operation: %p\n", operation);
+
+		bool operationFinished = operation->Finish();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_FINISHED,
+			this, operation->Parent(), operation);
+			// Notify for every time the operation is passed to the I/O hook,
+			// not only when it is fully finished.
+
+		if (!operationFinished) {
+			TRACE("  operation: %p not finished yet\n", operation);
+			MutexLocker _(fLock);
+			_RemoveActiveOperation(operation);
+			operation->SetTransferredBytes(0);
+			fUnfinishedOperations.Add(operation, false);
+			continue;
+		}
+
+		// notify request and remove operation
+		IORequest* request = operation->Parent();
+
+		generic_size_t operationOffset
+			= operation->OriginalOffset() - request->Offset();
+		request->OperationFinished(operation, operation->Status(),
+			operation->TransferredBytes() < operation->OriginalLength(),
+			operation->Status() == B_OK
+				? operationOffset + operation->OriginalLength()
+				: operationOffset);
+
+		// recycle the operation
+		MutexLocker _(fLock);
+		_RemoveActiveOperation(operation);
+		if (fDMAResource != NULL)
+			fDMAResource->RecycleBuffer(operation->Buffer());
+
+		fUnusedOperations.Add(operation);
+
+		if (!request->IsFinished())
+			continue;
+
+		// Only the first request of the current run can still have parts that
+		// haven't been passed to the driver yet.
+		bool translating = fCurrentRun != NULL
+			&& fCurrentRun->requests.Head() == request;
+		if (translating && request->Status() == B_OK
+			&& request->RemainingBytes() > 0
+			&& !request->IsPartialTransfer()) {
+			// The request has been processed OK so far, but it isn't really
+			// finished yet.
+			request->SetUnfinished();
+			continue;
+		}
+
+		if (translating)
+			fCurrentRun->requests.Remove(request);
+
+		if (request->HasCallbacks()) {
+			// The request has callbacks that may take some time to
+			// perform, so we hand it over to the request notifier.
+			fFinishedRequests.Add(request);
+			fFinishedRequestCondition.NotifyAll();
+		} else {
+			// No callbacks -- finish the request right now.
+			IOSchedulerRoster::Default()->Notify(
+				IO_SCHEDULER_REQUEST_FINISHED, this, request);
+			request->NotifyFinished();
+		}
+	}
+}
+
+
+/*!	Called with \c fFinisherLock held.
+*/
+bool
+IOSchedulerDeadline::_FinisherWorkPending()
+{
+	return !fCompletedOperations.IsEmpty();
+}
+
+
+/*!	Chooses the run to be served next, and removes it from the queues.
+	Called with \c fLock held.
+*/
+IOSchedulerDeadline::Run*
+IOSchedulerDeadline::_NextRun()
+{
+	// continue the current batch in elevator order
+	if (fBatchCount < fFifoBatch) {
+		Run* run = fDirections[fCurrentDirection].sorted.FindClosest(
+			fLastOffset, false);
+		if (run != NULL) {
+			fBatchCount++;
+			_DequeueRun(run, fCurrentDirection);
+			return run;
+		}
+	}
+
+	// start a new batch, preferring reads as long as writes are not starved
+	bool reads = !fDirections[IO_SCHEDULER_READ].fifo.IsEmpty();
+	bool writes = !fDirections[IO_SCHEDULER_WRITE].fifo.IsEmpty();
+
+	int32 index;
+	if (reads && (!writes || fStarvedWrites < fWritesStarved)) {
+		index = IO_SCHEDULER_READ;
+		if (writes)
+			fStarvedWrites++;
+	} else if (writes) {
+		index = IO_SCHEDULER_WRITE;
+		fStarvedWrites = 0;
+	} else
+		return NULL;
+
+	Direction& direction = fDirections[index];
+
+	// start with the oldest run, if it has expired, or else continue from the
+	// current position
+	Run* run = direction.fifo.Head();
+	if (run->deadline > system_time()) {
+		Run* next = direction.sorted.FindClosest(fLastOffset, false);
+		if (next != NULL)
+			run = next;
+	} else
+		fStatistics.expired[index]++;
+
+	fCurrentDirection = index;
+	fBatchCount = 1;
+
+	_DequeueRun(run, index);
+	return run;
+}
+
+
+void
+IOSchedulerDeadline::_DequeueRun(Run* run, int32 index)
+{
+	fDirections[index].sorted.Remove(run);
+	fDirections[index].fifo.Remove(run);
+
+	bigtime_t waitTime = system_time() - run->arrival;
+	fStatistics.dispatched[index]++;
+	fStatistics.total_wait_time[index] += waitTime;
+	if (waitTime > fStatistics.max_wait_time[index])
+		fStatistics.max_wait_time[index] = waitTime;
+
+	fLastOffset = run->end;
+}
+
+
+/*!	Removes the \a request from the run it is queued in, if it is in one that
+	has not been chosen yet. Empty runs are deleted.
+	Called with \c fLock held.
+*/
+bool
+IOSchedulerDeadline::_RemoveQueuedRequest(IORequest* request)
+{
+	int32 index = request->IsWrite() ? IO_SCHEDULER_WRITE : IO_SCHEDULER_READ;
+	Direction& direction = fDirections[index];
+
+	RunList::Iterator iterator = direction.fifo.GetIterator();
+	while (Run* run = iterator.Next()) {
+		if (!run->requests.Contains(request))
+			continue;
+
+		run->requests.Remove(request);
+
+		if (run->requests.IsEmpty()) {
+			direction.sorted.Remove(run);
+			direction.fifo.Remove(run);
+			delete run;
+		} else {
+			// The run might not be contiguous anymore, but its range still
+			// covers all of its requests.
+			IORequest* first = run->requests.Head();
+			IORequest* last = run->requests.Tail();
+			if (first->Offset() != run->start) {
+				direction.sorted.Remove(run);
+				run->start = first->Offset();
+				direction.sorted.Insert(run);
+			}
+			run->end = last->Offset() + last->Length();
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+/*!	Returns whether any operations of the \a request have been passed to the
+	driver, or are waiting to be, and have not been processed by the finisher
+	yet. If there are none, the finisher won't notify the \a request anymore.
+	Called with \c fLock held.
+*/
+bool
+IOSchedulerDeadline::_HasPendingOperations(IORequest* request)
+{
+	for (int32 i = 0; i < fActiveOperationCount; i++) {
+		if (fActiveOperations[i]->Parent() == request)
+			return true;
+	}
+
+	IOOperationList::Iterator iterator = fUnfinishedOperations.GetIterator();
+	while (IOOperation* operation = iterator.Next()) {
+		if (operation->Parent() == request)
+			return true;
+	}
+
+	return false;
+}
+
+
+/*!	Returns the next operation to pass to the driver, or \c NULL, if there is
+	none, or if it has to wait for active operations to finish. If a request
+	failed, and none of its operations are pending anymore, it is returned in
+	\a _failedRequest, and has to be notified by the caller.
+	Called with \c fLock held.
+*/
+IOOperation*
+IOSchedulerDeadline::_NextOperation(IORequest*& _failedRequest,
+	status_t& _failure)
+{
+	// operations that need another pass (the read part of partial writes
+	// is done) come first
+	IOOperation* operation = fUnfinishedOperations.Head();
+	if (operation != NULL) {
+		if (_Overlaps(operation))
+			return NULL;
+
+		fUnfinishedOperations.Remove(operation);
+		return operation;
+	}
+
+	while (true) {
+		if (fCurrentRun == NULL) {
+			fCurrentRun = _NextRun();
+			if (fCurrentRun == NULL)
+				return NULL;
+		}
+
+		IORequest* request = fCurrentRun->requests.Head();
+		if (request == NULL) {
+			delete fCurrentRun;
+			fCurrentRun = NULL;
+			continue;
+		}
+
+		if (request->RemainingBytes() == 0 || request->Status() <= 0
+			|| request->IsPartialTransfer()) {
+			// nothing more to do for this one
+			fCurrentRun->requests.Remove(request);
+			continue;
+		}
+
+		operation = fUnusedOperations.RemoveHead();
+		if (operation == NULL)
+			return NULL;
+
+		status_t status;
+		if (fDMAResource != NULL)
+			status = fDMAResource->TranslateNext(request, operation, 0);
+		else {
+			// TODO: If the device has block size restrictions, we might need
+			// to use a bounce buffer.
+			status = operation->Prepare(request);
+			if (status == B_OK) {
+				operation->SetOriginalRange(request->Offset(),
+					request->Length());
+				request->Advance(request->Length());
+			}
+		}
+
+		if (status != B_OK) {
+			operation->SetParent(NULL);
+			fUnusedOperations.Add(operation);
+
+			// B_BUSY means some resource (DMABuffers or DMABounceBuffers) was
+			// temporarily unavailable. That's OK, we'll retry later.
+			if (status == B_BUSY)
+				return NULL;
+
+			fCurrentRun->requests.Remove(request);
+
+			generic_size_t translated
+				= request->Length() - request->RemainingBytes();
+			if (translated > 0) {
+				request->SetTransferredBytes(true, translated);
+
+				// the operations still pending finish the request, if there
+				// are any
+				if (_HasPendingOperations(request))
+					continue;
+			}
+
+			_failedRequest = request;
+			_failure = status;
+			return NULL;
+		}
+
+		if (_Overlaps(operation)) {
+			// wait until the operations on the same blocks have finished
+			fUnfinishedOperations.Add(operation);
+			return NULL;
+		}
+
+		return operation;
+	}
+}
+
+
+/*!	Returns whether the \a operation accesses any of the blocks of the active
+	operations. Called with \c fLock held.
+*/
+bool
+IOSchedulerDeadline::_Overlaps(IOOperation* operation) const
+{
+	off_t offset = operation->Offset();
+	off_t end = offset + operation->Length();
+
+	for (int32 i = 0; i < fActiveOperationCount; i++) {
+		IOOperation* active = fActiveOperations[i];
+		if (offset < active->Offset() + (off_t)active->Length()
+			&& active->Offset() < end) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void
+IOSchedulerDeadline::_RemoveActiveOperation(IOOperation* operation)
+{
+	for (int32 i = 0; i < fActiveOperationCount; i++) {
+		if (fActiveOperations[i] == operation) {
+			fActiveOperations[i]
+				= fActiveOperations[--fActiveOperationCount];
+			return;
+		}
+	}
+}
+
+
+status_t
+IOSchedulerDeadline::_Scheduler()
+{
+	while (!fTerminating) {
+		_Finisher();
+
+		MutexLocker locker(fLock);
+
+		IORequest* failedRequest = NULL;
+		status_t failure = B_OK;
+		IOOperation* operation = NULL;
+		if (fActiveOperationCount < fQueueDepth)
+			operation = _NextOperation(failedRequest, failure);
+
+		if (failedRequest != NULL) {
+			locker.Unlock();
+
+			IOSchedulerRoster::Default()->Notify(
+				IO_SCHEDULER_REQUEST_FINISHED, this, failedRequest);
+			failedRequest->SetStatusAndNotify(failure);
+			continue;
+		}
+
+		if (operation == NULL) {
+			// Wait for new requests or finished operations. First check
+			// whether any finisher work has to be done.
+			InterruptsSpinLocker finisherLocker(fFinisherLock);
+			if (_FinisherWorkPending())
+				continue;
+
+			ConditionVariableEntry entry;
+			fWorkCondition.Add(&entry);
+
+			finisherLocker.Unlock();
+			locker.Unlock();
+
+			entry.Wait(B_CAN_INTERRUPT);
+			continue;
+		}
+
+		fActiveOperations[fActiveOperationCount++] = operation;
+		fStatistics.operations++;
+
+		locker.Unlock();
+
+		TRACE("IOSchedulerDeadline::_Scheduler(): calling callback for "
+			"operation: %p\n", operation);
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_STARTED,
+			this, operation->Parent(), operation);
+
+		fIOCallback(fIOCallbackData, operation);
+	}
+
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerDeadline::_SchedulerThread(void *_self)
+{
+	IOSchedulerDeadline *self = (IOSchedulerDeadline *)_self;
+	return self->_Scheduler();
+}
+
+
+status_t
+IOSchedulerDeadline::_RequestNotifier()
+{
+	while (true) {
+		MutexLocker locker(fLock);
+
+		// get a request
+		IORequest* request = fFinishedRequests.RemoveHead();
+
+		if (request == NULL) {
+			if (fTerminating)
+				return B_OK;
+
+			ConditionVariableEntry entry;
+			fFinishedRequestCondition.Add(&entry);
+
+			locker.Unlock();
+
+			entry.Wait();
+			continue;
+		}
+
+		locker.Unlock();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+
+		// notify the request
+		request->NotifyFinished();
+	}
+
+	// never can get here
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerDeadline::_RequestNotifierThread(void *_self)
+{
+	IOSchedulerDeadline *self = (IOSchedulerDeadline*)_self;
+	return self->_RequestNotifier();
+}
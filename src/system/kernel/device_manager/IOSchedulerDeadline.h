@@ -0,0 +1,141 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_DEADLINE_H
+#define IO_SCHEDULER_DEADLINE_H
+
+
+#include <KernelExport.h>
+
+#include <condition_variable.h>
+#include <lock.h>
+#include <util/AVLTree.h>
+
+#include "dma_resources.h"
+#include "IOScheduler.h"
+
+
+class IOSchedulerDeadline : public IOScheduler {
+public:
+								IOSchedulerDeadline(DMAResource* resource);
+	virtual						~IOSchedulerDeadline();
+
+	virtual	status_t			Init(const char* name);
+
+			// must be called before Init()
+			void				SetReadExpire(bigtime_t expire);
+			void				SetWriteExpire(bigtime_t expire);
+			void				SetFifoBatch(int32 fifoBatch);
+			void				SetWritesStarved(int32 writesStarved);
+			void				SetQueueDepth(int32 queueDepth);
+
+	virtual	status_t			ScheduleRequest(IORequest* request);
+
+	virtual	void				AbortRequest(IORequest* request,
+									status_t status = B_CANCELED);
+	virtual	void				OperationCompleted(IOOperation* operation,
+									status_t status,
+									generic_size_t transferredBytes);
+									// called by the driver when the operation
+									// has been completed successfully or failed
+									// for some reason
+
+	virtual	void				Dump() const;
+
+private:
+			// adjacent requests of the same direction, dispatched back to back
+			struct Run : AVLTreeNode, DoublyLinkedListLinkImpl<Run> {
+				IORequestList	requests;
+				off_t			start;
+				off_t			end;
+				bigtime_t		arrival;
+				bigtime_t		deadline;
+				int64			sequence;
+					// orders runs that start at the same offset
+			};
+
+			struct RunTreeDefinition {
+				typedef off_t	Key;
+				typedef Run		Value;
+
+				AVLTreeNode* GetAVLTreeNode(Value* value) const
+				{
+					return value;
+				}
+
+				Value* GetValue(AVLTreeNode* node) const
+				{
+					return static_cast<Value*>(node);
+				}
+
+				int Compare(off_t a, const Value* b) const
+				{
+					if (a == b->start)
+						return 0;
+					return a < b->start ? -1 : 1;
+				}
+
+				int Compare(const Value* a, const Value* b) const
+				{
+					// runs may start at the same offset; they must be served
+					// in the order they arrived, as they might overlap
+					if (a->start == b->start && a != b)
+						return a->sequence < b->sequence ? -1 : 1;
+					return Compare(a->start, b);
+				}
+			};
+
+			typedef AVLTree<RunTreeDefinition> RunTree;
+			typedef DoublyLinkedList<Run> RunList;
+
+			struct Direction {
+				RunTree			sorted;
+				RunList			fifo;
+				bigtime_t		expire;
+			};
+
+			void				_Finisher();
+			bool				_FinisherWorkPending();
+			Run*				_NextRun();
+			void				_DequeueRun(Run* run, int32 direction);
+			bool				_RemoveQueuedRequest(IORequest* request);
+			bool				_HasPendingOperations(IORequest* request);
+			IOOperation*		_NextOperation(IORequest*& _failedRequest,
+									status_t& _failure);
+			bool				_Overlaps(IOOperation* operation) const;
+			void				_RemoveActiveOperation(IOOperation* operation);
+			status_t			_Scheduler();
+	static	status_t			_SchedulerThread(void* self);
+			status_t			_RequestNotifier();
+	static	status_t			_RequestNotifierThread(void* self);
+
+private:
+			spinlock			fFinisherLock;
+			mutex				fLock;
+			thread_id			fSchedulerThread;
+			thread_id			fRequestNotifierThread;
+			IORequestList		fFinishedRequests;
+			ConditionVariable	fWorkCondition;
+			ConditionVariable	fFinishedRequestCondition;
+			IOOperationList		fUnusedOperations;
+			IOOperationList		fCompletedOperations;
+			IOOperationList		fUnfinishedOperations;
+			IOOperation**		fActiveOperations;
+			int32				fActiveOperationCount;
+			Direction			fDirections[IO_SCHEDULER_DIRECTIONS];
+			Run*				fCurrentRun;
+			int32				fCurrentDirection;
+			int32				fBatchCount;
+			int32				fStarvedWrites;
+			int64				fNextRunSequence;
+			off_t				fLastOffset;
+			generic_size_t		fBlockSize;
+			int32				fFifoBatch;
+			int32				fWritesStarved;
+			int32				fQueueDepth;
+	volatile bool				fTerminating;
+};
+
+
+#endif	// IO_SCHEDULER_DEADLINE_H
@@ -6,12 +6,75 @@
 
 #include "IOSchedulerRoster.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <driver_settings.h>
 #include <util/AutoLock.h>
 
+#include "IOSchedulerDeadline.h"
+#include "IOSchedulerSimple.h"
+
 
 /*static*/ IOSchedulerRoster IOSchedulerRoster::sDefaultInstance;
 
 
+static const driver_parameter*
+find_parameter(const driver_parameter* parameters, int count,
+	const char* name, const char* value = NULL)
+{
+	for (int i = 0; i < count; i++) {
+		if (strcmp(parameters[i].name, name) != 0)
+			continue;
+		if (value == NULL || (parameters[i].value_count > 0
+				&& strcmp(parameters[i].values[0], value) == 0)) {
+			return &parameters[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/*!	Returns the value of the setting \a name, preferring the one in the
+	section of the \a device over the global one.
+*/
+static const char*
+get_setting(const driver_settings* settings, const driver_parameter* device,
+	const char* name)
+{
+	const driver_parameter* parameter = NULL;
+	if (device != NULL) {
+		parameter = find_parameter(device->parameters,
+			device->parameter_count, name);
+	}
+	if (parameter == NULL && settings != NULL) {
+		parameter = find_parameter(settings->parameters,
+			settings->parameter_count, name);
+	}
+
+	if (parameter == NULL || parameter->value_count == 0)
+		return NULL;
+	return parameter->values[0];
+}
+
+
+static bool
+get_number_setting(const driver_settings* settings,
+	const driver_parameter* device, const char* name, int64& _value)
+{
+	const char* value = get_setting(settings, device, name);
+	if (value == NULL)
+		return false;
+
+	_value = strtoll(value, NULL, 0);
+	return true;
+}
+
+
+//	#pragma mark -
+
+
 /*static*/ void
 IOSchedulerRoster::Init()
 {
@@ -19,6 +82,76 @@ IOSchedulerRoster::Init()
 }
 
 
+/*!	Creates and initializes the I/O scheduler for the device \a name, as
+	chosen in the I/O scheduler settings file, for example:
+
+		scheduler simple
+		device scsi {
+			scheduler deadline
+			read_expire 250		# ms
+			write_expire 5000	# ms
+			fifo_batch 16
+			writes_starved 2
+			queue_depth 32
+		}
+
+	Settings outside of a device section apply to all devices.
+*/
+status_t
+IOSchedulerRoster::CreateScheduler(DMAResource* resource, const char* name,
+	IOScheduler*& _scheduler)
+{
+	void* handle = load_driver_settings(IO_SCHEDULER_SETTINGS);
+	const driver_settings* settings = get_driver_settings(handle);
+	const driver_parameter* device = NULL;
+	if (settings != NULL) {
+		device = find_parameter(settings->parameters,
+			settings->parameter_count, "device", name);
+	}
+
+	IOScheduler* scheduler;
+	const char* type = get_setting(settings, device, "scheduler");
+	if (type != NULL && strcmp(type, "deadline") == 0) {
+		IOSchedulerDeadline* deadline
+			= new(std::nothrow) IOSchedulerDeadline(resource);
+		if (deadline != NULL) {
+			int64 value;
+			if (get_number_setting(settings, device, "read_expire", value))
+				deadline->SetReadExpire(value * 1000);
+			if (get_number_setting(settings, device, "write_expire", value))
+				deadline->SetWriteExpire(value * 1000);
+			if (get_number_setting(settings, device, "fifo_batch", value))
+				deadline->SetFifoBatch(value);
+			if (get_number_setting(settings, device, "writes_starved", value))
+				deadline->SetWritesStarved(value);
+			if (get_number_setting(settings, device, "queue_depth", value))
+				deadline->SetQueueDepth(value);
+		}
+		scheduler = deadline;
+	} else {
+		if (type != NULL && strcmp(type, "simple") != 0) {
+			dprintf("I/O scheduler \"%s\" for \"%s\" is unknown, using "
+				"\"simple\"\n", type, name);
+		}
+		scheduler = new(std::nothrow) IOSchedulerSimple(resource);
+	}
+
+	unload_driver_settings(handle);
+
+	if (scheduler == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = scheduler->Init(name);
+	if (status != B_OK) {
+		delete scheduler;
+		return status;
+	}
+
+	_scheduler = scheduler;
+	return B_OK;
+}
+
+
 void
 IOSchedulerRoster::AddScheduler(IOScheduler* scheduler)
 {
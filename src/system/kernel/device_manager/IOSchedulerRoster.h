@@ -20,6 +20,8 @@
 #define IO_SCHEDULER_OPERATION_STARTED	0x10
 #define IO_SCHEDULER_OPERATION_FINISHED	0x20
 
+// name of the driver settings file that selects and configures the schedulers
+#define IO_SCHEDULER_SETTINGS			"io_scheduler"
 
 
 typedef DoublyLinkedList<IOScheduler> IOSchedulerList;
@@ -38,6 +40,10 @@ public:
 									// caller must keep the roster locked,
 									// while accessing the list
 
+			status_t			CreateScheduler(DMAResource* resource,
+									const char* name,
+									IOScheduler*& _scheduler);
+
 			void				AddScheduler(IOScheduler* scheduler);
 			void				RemoveScheduler(IOScheduler* scheduler);
 
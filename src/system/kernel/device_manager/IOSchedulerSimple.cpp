@@ -256,6 +256,11 @@ IOSchedulerSimple::ScheduleRequest(IORequest* request)
 	request->SetOwner(owner);
 	owner->requests.Add(request);
 
+	int32 direction = request->IsWrite()
+		? IO_SCHEDULER_WRITE : IO_SCHEDULER_READ;
+	fStatistics.requests[direction]++;
+	fStatistics.bytes[direction] += request->Length();
+
 	int32 priority = thread_get_io_priority(request->ThreadID());
 	if (priority >= 0)
 		owner->priority = priority;
@@ -317,6 +322,8 @@ IOSchedulerSimple::Dump() const
 		kprintf(" %p", owner);
 	}
 	kprintf("\n");
+
+	DumpStatistics();
 }
 
 
@@ -687,6 +694,7 @@ panic("no more requests for owner %p (thread %" B_PRId32 ")", owner, owner->thre
 			continue;
 
 		fPendingOperations = operationCount;
+		fStatistics.operations += operationCount;
 
 		locker.Unlock();
 
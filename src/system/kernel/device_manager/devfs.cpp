@@ -2112,6 +2112,22 @@ devfs_unpublish_device(const char* path, bool disconnect)
 }
 
 
+/*!	Returns whether the given vnode is a device that handles I/O requests
+	asynchronously, so that vfs_vnode_io() doesn't block the calling thread
+	until they are done.
+*/
+extern "C" bool
+devfs_is_asynchronous_device(struct vnode* vnode)
+{
+	fs_vnode* fsNode = vfs_fsnode_for_vnode(vnode);
+	if (fsNode->ops != &kVnodeOps)
+		return false;
+
+	devfs_vnode* node = (devfs_vnode*)fsNode->private_node;
+	return S_ISCHR(node->stream.type) && node->stream.u.dev.device->HasIO();
+}
+
+
 //	#pragma mark - device_manager private API
 
 
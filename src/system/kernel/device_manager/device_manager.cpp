@@ -302,6 +302,22 @@ dump_io_scheduler(int argc, char** argv)
 }
 
 
+static int
+dump_io_schedulers(int argc, char** argv)
+{
+	const IOSchedulerList& schedulers
+		= IOSchedulerRoster::Default()->SchedulerList();
+	for (IOSchedulerList::ConstIterator it = schedulers.GetIterator();
+			IOScheduler* scheduler = it.Next();) {
+		kprintf("%3" B_PRId32 " %p  %s\n", scheduler->ID(), scheduler,
+			scheduler->Name());
+		scheduler->DumpStatistics();
+	}
+
+	return 0;
+}
+
+
 static int
 dump_io_request_owner(int argc, char** argv)
 {
@@ -2286,6 +2302,8 @@ device_manager_init(struct kernel_args* args)
 		"Dump an I/O scheduler",
 		"<scheduler>\n"
 		"Dumps I/O scheduler at address <scheduler>.\n", 0);
+	add_debugger_command("io_schedulers", &dump_io_schedulers,
+		"List all I/O schedulers with their statistics");
 	add_debugger_command_etc("io_request_owner", &dump_io_request_owner,
 		"Dump an I/O request owner",
 		"<owner>\n"
@@ -0,0 +1,805 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Event queues are persistent interest sets of objects -- file descriptors,
+	semaphores, ports, and threads. Unlike select(), poll(), and
+	wait_for_objects(), which select and deselect every object on each call,
+	an object stays selected for as long as it is part of the queue, and its
+	notifications move it to the queue's ready list. The cost of waiting thus
+	depends on the number of objects that are ready, not on the number of
+	objects in the queue.
+
+	Every entry has its own select_sync, which the objects refer to via the
+	entry's select_info, so that an entry stays valid for as long as an
+	object might still notify it, even after it has been removed from the
+	queue.
+
+	Objects are level-triggered by default: after an object has been
+	reported, it is selected anew on the next wait, which reports it again if
+	its condition still holds. Edge-triggered objects are only reported again
+	once a new event occurred, and one-shot objects are deselected until they
+	are selected again.
+*/
+
+
+#include <event_queue.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include <new>
+
+#include <AutoDeleter.h>
+#include <Referenceable.h>
+
+#include <fs/fd.h>
+#include <kernel.h>
+#include <lock.h>
+#include <syscall_restart.h>
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+#include <wait_for_objects.h>
+
+
+//#define TRACE_EVENT_QUEUE
+#ifdef TRACE_EVENT_QUEUE
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x) ;
+#endif
+
+
+using std::nothrow;
+
+
+static const int kMaxWaitInfos = 1024;
+static const int32 kEventFlags = B_EVENT_EDGE_TRIGGERED | B_EVENT_ONE_SHOT;
+
+
+struct event_queue;
+
+
+struct event_queue_entry {
+	select_sync			sync;
+		// must be first, the entry is found via select_info::sync
+	select_info			info;
+	event_queue*		queue;
+	event_queue_entry*	hash_link;
+	DoublyLinkedListLink<event_queue_entry> ready_link;
+	DoublyLinkedListLink<event_queue_entry> reported_link;
+		// for the recheck list
+	DoublyLinkedListLink<event_queue_entry> collected_link;
+		// for the entries reported by a single _Collect() call
+	int32				object;
+	uint16				type;
+	int32				events;
+		// the selected events and flags
+	void*				user_data;
+	bool				selected;
+		// the object has the info selected, guarded by the queue lock
+	bool				queued;
+	bool				removed;
+		// guarded by the queue's ready lock
+	bool				reported;
+		// the entry is in the recheck list, guarded by the queue lock
+};
+
+
+struct EntryKey {
+	uint16	type;
+	int32	object;
+
+	EntryKey(uint16 type, int32 object)
+		:
+		type(type),
+		object(object)
+	{
+	}
+};
+
+
+struct EntryHashDefinition {
+	typedef EntryKey			KeyType;
+	typedef	event_queue_entry	ValueType;
+
+	size_t HashKey(const EntryKey& key) const
+	{
+		return (size_t)key.object ^ ((size_t)key.type << 24);
+	}
+
+	size_t Hash(event_queue_entry* value) const
+	{
+		return HashKey(EntryKey(value->type, value->object));
+	}
+
+	bool Compare(const EntryKey& key, event_queue_entry* value) const
+	{
+		return value->type == key.type && value->object == key.object;
+	}
+
+	event_queue_entry*& GetLink(event_queue_entry* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+
+typedef BOpenHashTable<EntryHashDefinition> EntryTable;
+typedef DoublyLinkedList<event_queue_entry,
+	DoublyLinkedListMemberGetLink<event_queue_entry,
+		&event_queue_entry::ready_link> > ReadyList;
+typedef DoublyLinkedList<event_queue_entry,
+	DoublyLinkedListMemberGetLink<event_queue_entry,
+		&event_queue_entry::reported_link> > ReportedList;
+typedef DoublyLinkedList<event_queue_entry,
+	DoublyLinkedListMemberGetLink<event_queue_entry,
+		&event_queue_entry::collected_link> > CollectedList;
+
+
+struct event_queue : BReferenceable {
+								event_queue(bool kernel);
+	virtual						~event_queue();
+
+			status_t			Init();
+			void				Close();
+
+			status_t			Select(int32 object, uint16 type,
+									int32 events, void* userData);
+			ssize_t				Wait(event_wait_info* infos, int numInfos,
+									uint32 flags, bigtime_t timeout);
+
+			status_t			Notify(event_queue_entry* entry,
+									uint16 events);
+
+			bool				IsOwner() const;
+
+private:
+			void				_RemoveEntry(event_queue_entry* entry,
+									bool deselect);
+			void				_Deselect(event_queue_entry* entry);
+			void				_Recheck();
+			int					_Collect(event_wait_info* infos,
+									int numInfos);
+
+private:
+			mutex				fLock;
+			spinlock			fReadyLock;
+			sem_id				fSem;
+			EntryTable			fEntries;
+			ReadyList			fReadyList;
+			ReportedList		fRecheckList;
+			io_context*			fContext;
+				// only compared against, never dereferenced
+			bool				fKernel;
+			bool				fClosed;
+};
+
+
+event_queue::event_queue(bool kernel)
+	:
+	fSem(-1),
+	fContext(get_current_io_context(kernel)),
+	fKernel(kernel),
+	fClosed(false)
+{
+	mutex_init(&fLock, "event queue");
+	B_INITIALIZE_SPINLOCK(&fReadyLock);
+}
+
+
+event_queue::~event_queue()
+{
+	if (fSem >= 0)
+		delete_sem(fSem);
+	mutex_destroy(&fLock);
+}
+
+
+status_t
+event_queue::Init()
+{
+	fSem = create_sem(0, "event queue");
+	if (fSem < 0)
+		return fSem;
+
+	return fEntries.Init();
+}
+
+
+/*!	Called when the last file descriptor of the queue has been closed.
+	Removes all entries and wakes up the threads still waiting.
+*/
+void
+event_queue::Close()
+{
+	MutexLocker locker(fLock);
+
+	fClosed = true;
+
+	// When the team is going away, its I/O context is torn down by someone
+	// else, and deselects its file descriptors itself.
+	bool sameContext = IsOwner();
+
+	event_queue_entry* entry = fEntries.Clear(true);
+	while (entry != NULL) {
+		event_queue_entry* next = entry->hash_link;
+		_RemoveEntry(entry, sameContext || entry->type != B_OBJECT_TYPE_FD);
+		entry = next;
+	}
+
+	delete_sem(fSem);
+	fSem = -1;
+}
+
+
+status_t
+event_queue::Select(int32 object, uint16 type, int32 events, void* userData)
+{
+	MutexLocker locker(fLock);
+
+	if (fClosed)
+		return B_FILE_ERROR;
+
+	event_queue_entry* entry = fEntries.Lookup(EntryKey(type, object));
+	if (entry != NULL
+		&& (atomic_get(&entry->info.events) & B_EVENT_INVALID) != 0) {
+		// the object is gone, and has not been reported yet -- the one we're
+		// asked for must be a new one with the same ID
+		fEntries.RemoveUnchecked(entry);
+		_RemoveEntry(entry, false);
+		entry = NULL;
+	}
+
+	if ((events & ~kEventFlags) == 0) {
+		// no events means that the object is to be removed
+		if (entry == NULL)
+			return B_ENTRY_NOT_FOUND;
+
+		fEntries.RemoveUnchecked(entry);
+		_RemoveEntry(entry, true);
+		return B_OK;
+	}
+
+	if (entry == NULL) {
+		entry = new(nothrow) event_queue_entry;
+		if (entry == NULL)
+			return B_NO_MEMORY;
+
+		entry->sync.ref_count = 1;
+			// the queue's reference
+		entry->sync.sem = fSem;
+		entry->sync.count = 1;
+		entry->sync.set = &entry->info;
+		entry->sync.queue = this;
+		entry->info.next = NULL;
+		entry->info.sync = &entry->sync;
+		entry->info.events = 0;
+		entry->queue = this;
+		entry->object = object;
+		entry->type = type;
+		entry->selected = false;
+		entry->queued = false;
+		entry->removed = false;
+		entry->reported = false;
+
+		status_t status = fEntries.Insert(entry);
+		if (status != B_OK) {
+			delete entry;
+			return status;
+		}
+
+		AcquireReference();
+	} else {
+		// change the selected events -- start over
+		_Deselect(entry);
+
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		if (entry->queued) {
+			fReadyList.Remove(entry);
+			entry->queued = false;
+		}
+		readyLocker.Unlock();
+
+		if (entry->reported) {
+			fRecheckList.Remove(entry);
+			entry->reported = false;
+		}
+		atomic_set(&entry->info.events, 0);
+	}
+
+	entry->events = events;
+	entry->user_data = userData;
+	entry->info.selected_events = (events & ~kEventFlags)
+		| B_EVENT_INVALID | B_EVENT_ERROR | B_EVENT_DISCONNECTED;
+
+	status_t status = select_object(type, object, &entry->info, fKernel);
+	if (status != B_OK) {
+		fEntries.RemoveUnchecked(entry);
+		_RemoveEntry(entry, false);
+		return status;
+	}
+
+	entry->selected = true;
+	return B_OK;
+}
+
+
+ssize_t
+event_queue::Wait(event_wait_info* infos, int numInfos, uint32 flags,
+	bigtime_t timeout)
+{
+	if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout > 0
+		&& timeout != B_INFINITE_TIMEOUT) {
+		timeout += system_time();
+		flags = (flags & ~B_RELATIVE_TIMEOUT) | B_ABSOLUTE_TIMEOUT;
+	}
+
+	MutexLocker locker(fLock);
+
+	if (fClosed)
+		return B_FILE_ERROR;
+
+	_Recheck();
+
+	while (true) {
+		int count = _Collect(infos, numInfos);
+		if (count > 0)
+			return count;
+
+		sem_id sem = fSem;
+		locker.Unlock();
+
+		status_t status = acquire_sem_etc(sem, 1, B_CAN_INTERRUPT | flags,
+			timeout);
+		if (status != B_OK)
+			return status == B_BAD_SEM_ID ? B_FILE_ERROR : status;
+
+		locker.Lock();
+
+		if (fClosed)
+			return B_FILE_ERROR;
+	}
+}
+
+
+/*!	Called by notify_select_events() for the queue's entries. Interrupts
+	might be disabled, and the object's lock held.
+*/
+status_t
+event_queue::Notify(event_queue_entry* entry, uint16 events)
+{
+	if ((entry->info.selected_events & events) == 0)
+		return B_OK;
+
+	InterruptsSpinLocker locker(fReadyLock);
+
+	if (entry->removed || entry->queued)
+		return B_OK;
+
+	bool wasEmpty = fReadyList.IsEmpty();
+	fReadyList.Add(entry);
+	entry->queued = true;
+
+	locker.Unlock();
+
+	// only wake up a waiter, when the list has become non-empty; it
+	// takes all ready entries at once
+	if (wasEmpty)
+		return release_sem_etc(entry->sync.sem, 1, B_DO_NOT_RESCHEDULE);
+
+	return B_OK;
+}
+
+
+bool
+event_queue::IsOwner() const
+{
+	return get_current_io_context(fKernel) == fContext;
+}
+
+
+/*!	Removes the entry, which must no longer be in the table, and releases
+	the queue's reference to it. If the object is not deselected, the entry
+	stays alive until the object drops it, but won't be queued anymore.
+	The queue lock must be held.
+*/
+void
+event_queue::_RemoveEntry(event_queue_entry* entry, bool deselect)
+{
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	entry->removed = true;
+	if (entry->queued) {
+		fReadyList.Remove(entry);
+		entry->queued = false;
+	}
+	readyLocker.Unlock();
+
+	if (entry->reported) {
+		fRecheckList.Remove(entry);
+		entry->reported = false;
+	}
+
+	if (deselect)
+		_Deselect(entry);
+
+	put_select_sync(&entry->sync);
+}
+
+
+void
+event_queue::_Deselect(event_queue_entry* entry)
+{
+	if (!entry->selected)
+		return;
+
+	deselect_object(entry->type, entry->object, &entry->info, fKernel);
+	entry->selected = false;
+}
+
+
+/*!	Selects the level-triggered objects that have been reported by the
+	previous wait again -- if their condition still holds, that puts them
+	right back into the ready list.
+	The queue lock must be held.
+*/
+void
+event_queue::_Recheck()
+{
+	while (event_queue_entry* entry = fRecheckList.RemoveHead()) {
+		entry->reported = false;
+
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		bool queued = entry->queued;
+		readyLocker.Unlock();
+
+		// if it has been notified in the meantime, it is reported anyway
+		if (queued || !entry->selected)
+			continue;
+
+		deselect_object(entry->type, entry->object, &entry->info, fKernel);
+		atomic_set(&entry->info.events, 0);
+		if (select_object(entry->type, entry->object, &entry->info, fKernel)
+				!= B_OK) {
+			entry->selected = false;
+			notify_select_events(&entry->info, B_EVENT_INVALID);
+		}
+	}
+}
+
+
+/*!	Moves up to \a numInfos entries from the ready list to \a infos.
+	The queue lock must be held.
+*/
+int
+event_queue::_Collect(event_wait_info* infos, int numInfos)
+{
+	CollectedList reported;
+		// the entries may still be in the recheck list
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+
+	int count = 0;
+	while (count < numInfos) {
+		event_queue_entry* entry = fReadyList.RemoveHead();
+		if (entry == NULL)
+			break;
+
+		entry->queued = false;
+
+		int32 events = atomic_get_and_set(&entry->info.events, 0)
+			& entry->info.selected_events;
+		if (events == 0)
+			continue;
+
+		infos[count].object = entry->object;
+		infos[count].type = entry->type;
+		infos[count].events = events;
+		infos[count].user_data = entry->user_data;
+		count++;
+
+		reported.Add(entry);
+	}
+
+	readyLocker.Unlock();
+
+	// the reported entries are in the same order as the infos
+	for (int i = 0; i < count; i++) {
+		event_queue_entry* entry = reported.RemoveHead();
+
+		TRACE(("event queue %p: object %" B_PRId32 " (type %" B_PRIu16
+			"): events %#" B_PRIx32 "\n", this, entry->object, entry->type,
+			infos[i].events));
+
+		if ((infos[i].events & B_EVENT_INVALID) != 0) {
+			// the object is gone, and has already dropped the entry
+			fEntries.RemoveUnchecked(entry);
+			entry->selected = false;
+			_RemoveEntry(entry, false);
+		} else if ((entry->events & B_EVENT_ONE_SHOT) != 0) {
+			_Deselect(entry);
+		} else if ((entry->events & B_EVENT_EDGE_TRIGGERED) == 0
+			&& !entry->reported) {
+			fRecheckList.Add(entry);
+			entry->reported = true;
+		}
+	}
+
+	return count;
+}
+
+
+//	#pragma mark - file descriptor
+
+
+static status_t
+event_queue_close(struct file_descriptor* descriptor)
+{
+	event_queue* queue = (event_queue*)descriptor->cookie;
+	queue->Close();
+	return B_OK;
+}
+
+
+static void
+event_queue_free(struct file_descriptor* descriptor)
+{
+	event_queue* queue = (event_queue*)descriptor->cookie;
+	queue->ReleaseReference();
+}
+
+
+static struct fd_ops sEventQueueFDOps = {
+	NULL,	// fd_read
+	NULL,	// fd_write
+	NULL,	// fd_seek
+	NULL,	// fd_ioctl
+	NULL,	// fd_set_flags
+	NULL,	// fd_select
+	NULL,	// fd_deselect
+	NULL,	// fd_read_dir
+	NULL,	// fd_rewind_dir
+	NULL,	// fd_read_stat
+	NULL,	// fd_write_stat
+	&event_queue_close,
+	&event_queue_free
+};
+
+
+static status_t
+get_event_queue(int fd, bool kernel, file_descriptor*& _descriptor,
+	event_queue*& _queue)
+{
+	file_descriptor* descriptor = get_fd(get_current_io_context(kernel), fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	if (descriptor->type != FDTYPE_EVENT_QUEUE) {
+		put_fd(descriptor);
+		return B_BAD_VALUE;
+	}
+
+	event_queue* queue = (event_queue*)descriptor->cookie;
+	if (!queue->IsOwner()) {
+		// the queue has been inherited from another team
+		put_fd(descriptor);
+		return B_NOT_ALLOWED;
+	}
+
+	_descriptor = descriptor;
+	_queue = queue;
+	return B_OK;
+}
+
+
+// #pragma mark - common implementation
+
+
+static int
+common_event_queue_create(int openFlags, bool kernel)
+{
+	event_queue* queue = new(nothrow) event_queue(kernel);
+	if (queue == NULL)
+		return B_NO_MEMORY;
+	BReference<event_queue> queueReference(queue, true);
+
+	status_t status = queue->Init();
+	if (status != B_OK)
+		return status;
+
+	file_descriptor* descriptor = alloc_fd();
+	if (descriptor == NULL)
+		return B_NO_MEMORY;
+
+	descriptor->type = FDTYPE_EVENT_QUEUE;
+	descriptor->ops = &sEventQueueFDOps;
+	descriptor->cookie = queue;
+	descriptor->open_mode = O_RDWR;
+
+	io_context* context = get_current_io_context(kernel);
+	int fd = new_fd(context, descriptor);
+	if (fd < 0) {
+		free(descriptor);
+		return fd;
+	}
+
+	// the descriptor owns the reference now
+	queueReference.Detach();
+
+	mutex_lock(&context->io_mutex);
+	fd_set_close_on_exec(context, fd, (openFlags & O_CLOEXEC) != 0);
+	mutex_unlock(&context->io_mutex);
+
+	return fd;
+}
+
+
+static ssize_t
+common_event_queue_select(int fd, event_wait_info* infos, int numInfos,
+	bool kernel)
+{
+	file_descriptor* descriptor;
+	event_queue* queue;
+	status_t status = get_event_queue(fd, kernel, descriptor, queue);
+	if (status != B_OK)
+		return status;
+	CObjectDeleter<file_descriptor> descriptorPutter(descriptor, put_fd);
+
+	// errors are reported per object
+	ssize_t count = 0;
+	for (int i = 0; i < numInfos; i++) {
+		status = queue->Select(infos[i].object, infos[i].type,
+			infos[i].events, infos[i].user_data);
+		if (status != B_OK)
+			infos[i].events = status;
+		else
+			count++;
+	}
+
+	return count;
+}
+
+
+static ssize_t
+common_event_queue_wait(int fd, event_wait_info* infos, int numInfos,
+	uint32 flags, bigtime_t timeout, bool kernel)
+{
+	file_descriptor* descriptor;
+	event_queue* queue;
+	status_t status = get_event_queue(fd, kernel, descriptor, queue);
+	if (status != B_OK)
+		return status;
+	CObjectDeleter<file_descriptor> descriptorPutter(descriptor, put_fd);
+
+	return queue->Wait(infos, numInfos, flags, timeout);
+}
+
+
+// #pragma mark - kernel private
+
+
+status_t
+event_queue_notify(select_info* info, uint16 events)
+{
+	event_queue_entry* entry = (event_queue_entry*)info->sync;
+	return entry->queue->Notify(entry, events);
+}
+
+
+void
+event_queue_free_entry(select_sync* sync)
+{
+	event_queue_entry* entry = (event_queue_entry*)sync;
+	event_queue* queue = entry->queue;
+
+	delete entry;
+	queue->ReleaseReference();
+}
+
+
+//	#pragma mark - kernel syscalls
+
+
+int
+_kern_event_queue_create(int openFlags)
+{
+	return common_event_queue_create(openFlags, true);
+}
+
+
+ssize_t
+_kern_event_queue_select(int queue, event_wait_info* infos, int numInfos)
+{
+	if (numInfos <= 0)
+		return B_BAD_VALUE;
+
+	return common_event_queue_select(queue, infos, numInfos, true);
+}
+
+
+ssize_t
+_kern_event_queue_wait(int queue, event_wait_info* infos, int numInfos,
+	uint32 flags, bigtime_t timeout)
+{
+	if (numInfos <= 0)
+		return B_BAD_VALUE;
+
+	return common_event_queue_wait(queue, infos, numInfos, flags, timeout,
+		true);
+}
+
+
+//	#pragma mark - user syscalls
+
+
+int
+_user_event_queue_create(int openFlags)
+{
+	return common_event_queue_create(openFlags, false);
+}
+
+
+ssize_t
+_user_event_queue_select(int queue, event_wait_info* userInfos, int numInfos)
+{
+	if (numInfos <= 0 || numInfos > kMaxWaitInfos)
+		return B_BAD_VALUE;
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	size_t bytes = sizeof(event_wait_info) * numInfos;
+	event_wait_info* infos = (event_wait_info*)malloc(bytes);
+	if (infos == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter infosDeleter(infos);
+
+	if (user_memcpy(infos, userInfos, bytes) != B_OK)
+		return B_BAD_ADDRESS;
+
+	ssize_t result = common_event_queue_select(queue, infos, numInfos, false);
+
+	// copy back the errors
+	if (result >= 0 && result < numInfos
+		&& user_memcpy(userInfos, infos, bytes) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return result;
+}
+
+
+ssize_t
+_user_event_queue_wait(int queue, event_wait_info* userInfos, int numInfos,
+	uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (numInfos <= 0)
+		return B_BAD_VALUE;
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	// more infos are returned by the next call
+	numInfos = min_c(numInfos, kMaxWaitInfos);
+
+	size_t bytes = sizeof(event_wait_info) * numInfos;
+	event_wait_info* infos = (event_wait_info*)malloc(bytes);
+	if (infos == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter infosDeleter(infos);
+
+	ssize_t result = common_event_queue_wait(queue, infos, numInfos, flags,
+		timeout, false);
+	if (result < 0)
+		return syscall_restart_handle_timeout_post(result, timeout);
+
+	if (user_memcpy(userInfos, infos, sizeof(event_wait_info) * result)
+			!= B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return result;
+}
@@ -6,10 +6,16 @@
 
 #include "EntryCache.h"
 
+#include <dirent.h>
 #include <new>
 
+#include <smp.h>
+
 
 static const int32 kEntriesPerGeneration = 1024;
+static const int32 kMaxRetiredEntries = 256;
+static const int32 kMaxCompleteDirectories = 1024;
+static const int32 kMaxEnumerations = 64;
 
 static const int32 kEntryNotInArray = -1;
 static const int32 kEntryRemoved = -2;
@@ -50,7 +56,13 @@ EntryCacheGeneration::Init()
 
 EntryCache::EntryCache()
 	:
-	fCurrentGeneration(0)
+	fCurrentGeneration(0),
+	fRetiredEntries(NULL),
+	fRetiredEntryCount(0),
+	fCompleteDirectoriesEnabled(false),
+	fCompleteDirectoryCount(0),
+	fEnumerationCount(0),
+	fStatistics(NULL)
 {
 	rw_lock_init(&fLock, "entry cache");
 
@@ -68,6 +80,23 @@ EntryCache::~EntryCache()
 		entry = next;
 	}
 
+	while (fRetiredEntries != NULL) {
+		EntryCacheEntry* next = fRetiredEntries->retired_link;
+		free(fRetiredEntries);
+		fRetiredEntries = next;
+	}
+
+	fCompleteDirectories.Clear();
+	while (EntryCacheDirectory* directory
+			= fCompleteDirectoryList.RemoveHead()) {
+		delete directory;
+	}
+
+	while (EntryCacheEnumeration* enumeration = fEnumerations.RemoveHead())
+		delete enumeration;
+
+	delete[] fStatistics;
+
 	rw_lock_destroy(&fLock);
 }
 
@@ -75,7 +104,10 @@ EntryCache::~EntryCache()
 status_t
 EntryCache::Init()
 {
-	status_t error = fEntries.Init();
+	// The table is not resized, as lock-free lookups could not cope with that.
+	// It can hold all entries of all generations.
+	status_t error = fEntries.Init(kGenerationCount * kEntriesPerGeneration
+		/ 2);
 	if (error != B_OK)
 		return error;
 
@@ -85,6 +117,17 @@ EntryCache::Init()
 			return error;
 	}
 
+	error = fCompleteDirectories.Init();
+	if (error != B_OK)
+		return error;
+
+	int32 cpuCount = smp_get_num_cpus();
+	fStatistics = new(std::nothrow) EntryCacheStatistics[cpuCount];
+	if (fStatistics == NULL)
+		return B_NO_MEMORY;
+
+	memset(fStatistics, 0, sizeof(EntryCacheStatistics) * cpuCount);
+
 	return B_OK;
 }
 
@@ -92,37 +135,11 @@ EntryCache::Init()
 status_t
 EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
 {
-	EntryCacheKey key(dirID, name);
+	if (fRetiredEntryCount >= kMaxRetiredEntries)
+		_FreeRetiredEntries();
 
 	WriteLocker _(fLock);
-
-	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry != NULL) {
-		entry->node_id = nodeID;
-		if (entry->generation != fCurrentGeneration) {
-			if (entry->index >= 0) {
-				fGenerations[entry->generation].entries[entry->index] = NULL;
-				_AddEntryToCurrentGeneration(entry);
-			}
-		}
-		return B_OK;
-	}
-
-	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
-	if (entry == NULL)
-		return B_NO_MEMORY;
-
-	entry->node_id = nodeID;
-	entry->dir_id = dirID;
-	entry->generation = fCurrentGeneration;
-	entry->index = kEntryNotInArray;
-	strcpy(entry->name, name);
-
-	fEntries.Insert(entry);
-
-	_AddEntryToCurrentGeneration(entry);
-
-	return B_OK;
+	return _Add(dirID, name, nodeID);
 }
 
 
@@ -131,18 +148,31 @@ EntryCache::Remove(ino_t dirID, const char* name)
 {
 	EntryCacheKey key(dirID, name);
 
+	if (fRetiredEntryCount >= kMaxRetiredEntries)
+		_FreeRetiredEntries();
+
 	WriteLocker writeLocker(fLock);
 
+	// A directory read might already have returned the entry, and must not add
+	// it back to the cache. The directory remains complete, though.
+	if (fEnumerationCount > 0) {
+		for (EnumerationList::Iterator it = fEnumerations.GetIterator();
+				EntryCacheEnumeration* enumeration = it.Next();) {
+			if (enumeration->dir_id == dirID)
+				enumeration->valid = false;
+		}
+	}
+
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	fEntries.Remove(entry);
+	fEntries.RemoveUnchecked(entry);
 
 	if (entry->index >= 0) {
 		// remove the entry from its generation and delete it
 		fGenerations[entry->generation].entries[entry->index] = NULL;
-		free(entry);
+		_RetireEntry(entry);
 	} else {
 		// We can't free it, since another thread is about to try to move it
 		// to another generation. We mark it removed and the other thread will
@@ -154,14 +184,66 @@ EntryCache::Remove(ino_t dirID, const char* name)
 }
 
 
+/*!	Looks up the entry without locking, if possible. This works, since the
+	key and node ID of an entry don't change while it is in the table, the
+	hash links are only ever replaced atomically, and removed entries are only
+	freed after all CPUs have enabled interrupts again (cf.
+	_FreeRetiredEntries()). The generation and index of an entry do change,
+	but only under the lock; a stale generation just makes the lookup take the
+	lock. The lock is also needed when the entry has to be moved to the
+	current generation.
+	If the entry is not in the cache, but the directory is complete (cf.
+	FinishEnumeration()), the entry does not exist either. In this case
+	\c true is returned, and \a _missing is set to \c true.
+*/
 bool
-EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
+EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
+	bool& _missing)
 {
 	EntryCacheKey key(dirID, name);
 
-	ReadLocker readLocker(fLock);
+	_missing = false;
+
+	cpu_status state = disable_interrupts();
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
+	bool current = entry != NULL
+		&& entry->generation == atomic_get(&fCurrentGeneration);
+	if (current) {
+		_nodeID = entry->node_id;
+		fStatistics[smp_get_current_cpu()].hits++;
+	}
+
+	restore_interrupts(state);
+
+	if (current)
+		return true;
+
+	if (entry == NULL) {
+		if (atomic_get(&fCompleteDirectoryCount) == 0
+			|| strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+			_Count(&EntryCacheStatistics::misses);
+			return false;
+		}
+
+		ReadLocker readLocker(fLock);
+
+		if (fEntries.Lookup(key) != NULL
+			|| fCompleteDirectories.Lookup(dirID) == NULL) {
+			_Count(&EntryCacheStatistics::misses);
+			return false;
+		}
+
+		_Count(&EntryCacheStatistics::missing_hits);
+		_missing = true;
+		return true;
+	}
+
+	_Count(&EntryCacheStatistics::hits);
+
+	ReadLocker readLocker(fLock);
+
+	entry = fEntries.Lookup(key);
 	if (entry == NULL)
 		return false;
 
@@ -194,7 +276,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
 
 	if (entry->index == kEntryRemoved) {
 		// the entry has been removed in the meantime
-		free(entry);
+		_RetireEntry(entry);
 		return false;
 	}
 
@@ -205,6 +287,175 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
 }
 
 
+/*!	Allows Lookup() to report entries as missing, when they are not in the
+	cache, but their directory has been read in full. The file system must add
+	all entries it creates to the cache, and remove those it deletes.
+*/
+void
+EntryCache::EnableCompleteDirectories()
+{
+	WriteLocker _(fLock);
+	fCompleteDirectoriesEnabled = true;
+}
+
+
+/*!	Starts tracking a read of the directory \a dirID from its start via
+	\a cookie. Also to be called when the directory is rewound.
+*/
+void
+EntryCache::StartEnumeration(ino_t dirID, void* cookie)
+{
+	if (!fCompleteDirectoriesEnabled)
+		return;
+
+	WriteLocker _(fLock);
+
+	EntryCacheEnumeration* enumeration = _FindEnumeration(cookie);
+	if (enumeration == NULL) {
+		if (fEnumerationCount >= kMaxEnumerations) {
+			delete fEnumerations.RemoveHead();
+			fEnumerationCount--;
+		}
+
+		enumeration = new(std::nothrow) EntryCacheEnumeration;
+		if (enumeration == NULL)
+			return;
+
+		enumeration->cookie = cookie;
+		fEnumerations.Add(enumeration);
+		fEnumerationCount++;
+	}
+
+	enumeration->dir_id = dirID;
+	enumeration->valid = true;
+}
+
+
+/*!	Adds the \a count entries the file system returned for the directory read
+	via \a cookie. Entries of other file systems (i.e. mount points fixed up
+	by the VFS) are ignored.
+*/
+void
+EntryCache::AddEnumeratedEntries(void* cookie, dev_t device,
+	const struct dirent* entries, uint32 count)
+{
+	if (atomic_get(&fEnumerationCount) == 0)
+		return;
+
+	if (fRetiredEntryCount >= kMaxRetiredEntries)
+		_FreeRetiredEntries();
+
+	WriteLocker _(fLock);
+
+	EntryCacheEnumeration* enumeration = _FindEnumeration(cookie);
+	if (enumeration == NULL)
+		return;
+
+	const struct dirent* entry = entries;
+	for (uint32 i = 0; i < count && enumeration->valid; i++) {
+		// adding an entry might push entries of the directory out of the cache
+		// again, which invalidates the enumeration
+		if (entry->d_dev == device && strcmp(entry->d_name, ".") != 0
+			&& strcmp(entry->d_name, "..") != 0
+			&& _Add(enumeration->dir_id, entry->d_name, entry->d_ino)
+				!= B_OK) {
+			enumeration->valid = false;
+		}
+
+		entry = (const struct dirent*)((const uint8*)entry + entry->d_reclen);
+	}
+}
+
+
+/*!	Called when the directory read via \a cookie has reached its end. If all
+	of its entries have been added and none have been lost since, the directory
+	is complete.
+*/
+void
+EntryCache::FinishEnumeration(void* cookie)
+{
+	if (atomic_get(&fEnumerationCount) == 0)
+		return;
+
+	WriteLocker _(fLock);
+
+	EntryCacheEnumeration* enumeration = _FindEnumeration(cookie);
+	if (enumeration == NULL)
+		return;
+
+	bool valid = enumeration->valid;
+	ino_t dirID = enumeration->dir_id;
+	enumeration->valid = false;
+
+	if (!valid || fCompleteDirectories.Lookup(dirID) != NULL)
+		return;
+
+	if (fCompleteDirectoryCount >= kMaxCompleteDirectories) {
+		EntryCacheDirectory* directory = fCompleteDirectoryList.RemoveHead();
+		fCompleteDirectories.RemoveUnchecked(directory);
+		delete directory;
+		atomic_add(&fCompleteDirectoryCount, -1);
+	}
+
+	EntryCacheDirectory* directory = new(std::nothrow) EntryCacheDirectory;
+	if (directory == NULL)
+		return;
+
+	directory->dir_id = dirID;
+	fCompleteDirectories.InsertUnchecked(directory);
+	fCompleteDirectoryList.Add(directory);
+	atomic_add(&fCompleteDirectoryCount, 1);
+}
+
+
+void
+EntryCache::StopEnumeration(void* cookie)
+{
+	if (atomic_get(&fEnumerationCount) == 0)
+		return;
+
+	WriteLocker _(fLock);
+
+	EntryCacheEnumeration* enumeration = _FindEnumeration(cookie);
+	if (enumeration == NULL)
+		return;
+
+	fEnumerations.Remove(enumeration);
+	fEnumerationCount--;
+	delete enumeration;
+}
+
+
+/*!	To be called whenever an entry of the directory \a dirID has been created,
+	removed, or renamed.
+*/
+void
+EntryCache::DirectoryChanged(ino_t dirID)
+{
+	if (atomic_get(&fCompleteDirectoryCount) == 0
+		&& atomic_get(&fEnumerationCount) == 0) {
+		return;
+	}
+
+	WriteLocker _(fLock);
+	_InvalidateDirectory(dirID);
+}
+
+
+void
+EntryCache::GetStatistics(EntryCacheStatistics& statistics) const
+{
+	memset(&statistics, 0, sizeof(statistics));
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		statistics.hits += fStatistics[i].hits;
+		statistics.missing_hits += fStatistics[i].missing_hits;
+		statistics.misses += fStatistics[i].misses;
+	}
+}
+
+
 const char*
 EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 {
@@ -221,6 +472,56 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 }
 
 
+/*!	The caller must hold the write lock.
+*/
+status_t
+EntryCache::_Add(ino_t dirID, const char* name, ino_t nodeID)
+{
+	EntryCacheKey key(dirID, name);
+
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	if (entry != NULL && entry->node_id == nodeID) {
+		if (entry->generation != fCurrentGeneration) {
+			if (entry->index >= 0) {
+				fGenerations[entry->generation].entries[entry->index] = NULL;
+				_AddEntryToCurrentGeneration(entry);
+			}
+		}
+		return B_OK;
+	}
+
+	EntryCacheEntry* oldEntry = entry;
+
+	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
+	if (entry == NULL)
+		return B_NO_MEMORY;
+
+	entry->node_id = nodeID;
+	entry->dir_id = dirID;
+	entry->generation = fCurrentGeneration;
+	entry->index = kEntryNotInArray;
+	strcpy(entry->name, name);
+
+	// The node ID of an entry doesn't change once it is in the table, since
+	// lock-free lookups might be looking at it. A changed entry is replaced
+	// instead.
+	if (oldEntry != NULL) {
+		fEntries.RemoveUnchecked(oldEntry);
+		if (oldEntry->index >= 0) {
+			fGenerations[oldEntry->generation].entries[oldEntry->index] = NULL;
+			_RetireEntry(oldEntry);
+		} else
+			oldEntry->index = kEntryRemoved;
+	}
+
+	fEntries.Publish(entry);
+
+	_AddEntryToCurrentGeneration(entry);
+
+	return B_OK;
+}
+
+
 void
 EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 {
@@ -241,8 +542,10 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 			continue;
 
 		fGenerations[newGeneration].entries[i] = NULL;
-		fEntries.Remove(otherEntry);
-		free(otherEntry);
+		fEntries.RemoveUnchecked(otherEntry);
+		if (fCompleteDirectoryCount > 0 || fEnumerationCount > 0)
+			_InvalidateDirectory(otherEntry->dir_id);
+		_RetireEntry(otherEntry);
 	}
 
 	// set the new generation and add the entry
@@ -252,3 +555,89 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+/*!	Keeps the removed \a entry around until _FreeRetiredEntries() can be
+	sure that no lock-free lookup is still looking at it.
+	The caller must hold the write lock.
+*/
+void
+EntryCache::_RetireEntry(EntryCacheEntry* entry)
+{
+	// The hash link is left alone, so that a lookup standing on the entry
+	// can still continue in its hash bucket.
+	entry->retired_link = fRetiredEntries;
+	fRetiredEntries = entry;
+	fRetiredEntryCount++;
+}
+
+
+void
+EntryCache::_FreeRetiredEntries()
+{
+	WriteLocker writeLocker(fLock);
+
+	EntryCacheEntry* entry = fRetiredEntries;
+	fRetiredEntries = NULL;
+	fRetiredEntryCount = 0;
+
+	writeLocker.Unlock();
+
+	if (entry == NULL)
+		return;
+
+	// Lock-free lookups run with interrupts disabled, so once all CPUs had
+	// them enabled, none of them can still see these entries.
+	smp_wait_for_quiescent_cpus();
+
+	while (entry != NULL) {
+		EntryCacheEntry* next = entry->retired_link;
+		free(entry);
+		entry = next;
+	}
+}
+
+
+/*!	The directory \a dirID is no longer complete, and reads of it in progress
+	can't make it complete anymore.
+	The caller must hold the write lock.
+*/
+void
+EntryCache::_InvalidateDirectory(ino_t dirID)
+{
+	EntryCacheDirectory* directory = fCompleteDirectories.Lookup(dirID);
+	if (directory != NULL) {
+		fCompleteDirectories.RemoveUnchecked(directory);
+		fCompleteDirectoryList.Remove(directory);
+		delete directory;
+		atomic_add(&fCompleteDirectoryCount, -1);
+	}
+
+	for (EnumerationList::Iterator it = fEnumerations.GetIterator();
+			EntryCacheEnumeration* enumeration = it.Next();) {
+		if (enumeration->dir_id == dirID)
+			enumeration->valid = false;
+	}
+}
+
+
+EntryCacheEnumeration*
+EntryCache::_FindEnumeration(void* cookie) const
+{
+	for (EnumerationList::ConstIterator it = fEnumerations.GetIterator();
+			EntryCacheEnumeration* enumeration = it.Next();) {
+		if (enumeration->cookie == cookie)
+			return enumeration;
+	}
+
+	return NULL;
+}
+
+
+void
+EntryCache::_Count(int64 EntryCacheStatistics::* counter)
+{
+	cpu_status state = disable_interrupts();
+	fStatistics[smp_get_current_cpu()].*counter += 1;
+	restore_interrupts(state);
+}
@@ -8,7 +8,9 @@
 
 #include <stdlib.h>
 
+#include <arch/cpu.h>
 #include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
 #include <util/OpenHashTable.h>
 #include <util/StringHash.h>
 
@@ -32,6 +34,7 @@ struct EntryCacheKey {
 
 struct EntryCacheEntry {
 			EntryCacheEntry*	hash_link;
+			EntryCacheEntry*	retired_link;
 			ino_t				node_id;
 			ino_t				dir_id;
 			int32				generation;
@@ -79,6 +82,73 @@ struct EntryCacheHashDefinition {
 };
 
 
+/*!	The entry table never changes its size, and entries are only published
+	after they have been fully initialized, so that the table can also be
+	searched without holding the entry cache lock.
+*/
+struct EntryCacheTable : BOpenHashTable<EntryCacheHashDefinition, false> {
+	void Publish(EntryCacheEntry* entry)
+	{
+		size_t index = fDefinition.Hash(entry) & (fTableSize - 1);
+		entry->hash_link = fTable[index];
+		memory_write_barrier();
+		fTable[index] = entry;
+		fItemCount++;
+	}
+};
+
+
+/*!	A directory whose entries are all in the cache, so that names that are
+	not in the cache do not exist.
+*/
+struct EntryCacheDirectory : DoublyLinkedListLinkImpl<EntryCacheDirectory> {
+			EntryCacheDirectory* hash_link;
+			ino_t				dir_id;
+};
+
+
+struct EntryCacheDirectoryHashDefinition {
+	typedef ino_t				KeyType;
+	typedef EntryCacheDirectory	ValueType;
+
+	size_t HashKey(ino_t key) const
+	{
+		return (uint32)key ^ (uint32)(key >> 32);
+	}
+
+	size_t Hash(const EntryCacheDirectory* value) const
+	{
+		return HashKey(value->dir_id);
+	}
+
+	bool Compare(ino_t key, const EntryCacheDirectory* value) const
+	{
+		return value->dir_id == key;
+	}
+
+	EntryCacheDirectory*& GetLink(EntryCacheDirectory* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+
+//! A directory being read from its start via the file descriptor \c cookie
+struct EntryCacheEnumeration
+	: DoublyLinkedListLinkImpl<EntryCacheEnumeration> {
+			void*				cookie;
+			ino_t				dir_id;
+			bool				valid;
+};
+
+
+struct EntryCacheStatistics {
+			int64				hits;
+			int64				missing_hits;
+			int64				misses;
+} CACHE_LINE_ALIGN;
+
+
 class EntryCache {
 public:
 								EntryCache();
@@ -92,25 +162,61 @@ public:
 			status_t			Remove(ino_t dirID, const char* name);
 
 			bool				Lookup(ino_t dirID, const char* name,
-									ino_t& nodeID);
+									ino_t& nodeID, bool& _missing);
+
+			// directories read in full
+			void				EnableCompleteDirectories();
+			void				StartEnumeration(ino_t dirID, void* cookie);
+			void				AddEnumeratedEntries(void* cookie,
+									dev_t device, const struct dirent* entries,
+									uint32 count);
+			void				FinishEnumeration(void* cookie);
+			void				StopEnumeration(void* cookie);
+			void				DirectoryChanged(ino_t dirID);
+
+			void				GetStatistics(
+									EntryCacheStatistics& statistics) const;
+			int32				CountCompleteDirectories() const
+									{ return fCompleteDirectoryCount; }
 
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
 
 private:
 	static	const int32			kGenerationCount = 8;
 
-			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
+			typedef EntryCacheTable EntryTable;
 			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
+			typedef BOpenHashTable<EntryCacheDirectoryHashDefinition>
+				DirectoryTable;
+			typedef DoublyLinkedList<EntryCacheDirectory> DirectoryList;
+			typedef DoublyLinkedList<EntryCacheEnumeration> EnumerationList;
 
 private:
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
+			status_t			_Add(ino_t dirID, const char* name,
+									ino_t nodeID);
+			void				_RetireEntry(EntryCacheEntry* entry);
+			void				_FreeRetiredEntries();
+			void				_InvalidateDirectory(ino_t dirID);
+			EntryCacheEnumeration* _FindEnumeration(void* cookie) const;
+			void				_Count(int64 EntryCacheStatistics::* counter);
 
 private:
 			rw_lock				fLock;
 			EntryTable			fEntries;
 			EntryCacheGeneration fGenerations[kGenerationCount];
 			int32				fCurrentGeneration;
+			EntryCacheEntry*	fRetiredEntries;
+			int32				fRetiredEntryCount;
+
+			bool				fCompleteDirectoriesEnabled;
+			DirectoryTable		fCompleteDirectories;
+			DirectoryList		fCompleteDirectoryList;
+			int32				fCompleteDirectoryCount;
+			EnumerationList		fEnumerations;
+			int32				fEnumerationCount;
+			EntryCacheStatistics* fStatistics;
 };
 
 
@@ -0,0 +1,967 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	I/O rings let a team submit batches of reads, writes, and syncs via memory
+	it shares with the kernel, and collect their results the same way, instead
+	of doing a blocking syscall per operation.
+
+	The ring's area is created in the kernel address space and fully locked,
+	so that completions can be posted from any thread; the team gets a clone
+	of it. _user_io_ring_enter() consumes submissions, and optionally waits
+	for completions. Exactly one completion is posted for every submission,
+	and a submission is only consumed when there is room for its completion.
+
+	Operations on devices that handle I/O requests asynchronously, like disks,
+	are passed to the device as an IORequest, whose finished callback posts
+	the completion. Reads and writes of regular files would block the
+	submitting thread, or have to go through a file cache, and are executed by
+	the ring's threads the same way the respective syscall would. These are
+	kernel threads of the team, so that they can access its buffers.
+	Since these threads are not in a syscall, other file descriptors, like
+	FIFOs, sockets, or synchronous devices, are not supported: they would
+	treat the team's buffers as kernel memory.
+*/
+
+
+#include <fs/io_ring.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <new>
+
+#include <AutoDeleter.h>
+#include <Referenceable.h>
+
+#include <condition_variable.h>
+#include <fs/devfs.h>
+#include <fs/fd.h>
+#include <kernel.h>
+#include <lock.h>
+#include <syscall_restart.h>
+#include <team.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <vfs.h>
+#include <vm/vm.h>
+#include <vm/VMAddressSpace.h>
+
+#include "IORequest.h"
+
+
+//#define TRACE_IO_RING
+#ifdef TRACE_IO_RING
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x) ;
+#endif
+
+
+using std::nothrow;
+
+
+static const uint32 kDefaultThreadCount = 4;
+static const size_t kEntriesAlignment = 64;
+
+
+struct io_ring;
+
+
+struct io_ring_operation : DoublyLinkedListLinkImpl<io_ring_operation> {
+	io_ring*			ring;
+	io_ring_submission	submission;
+	file_descriptor*	descriptor;
+	iovec*				vecs;
+		// copied in for IO_RING_READV and IO_RING_WRITEV
+	int32				references;
+		// held by the I/O request and by _StartRequest()
+	ssize_t				result;
+};
+
+typedef DoublyLinkedList<io_ring_operation> OperationList;
+
+
+struct io_ring : BReferenceable {
+								io_ring();
+	virtual						~io_ring();
+
+			status_t			Init(uint32 entryCount, uint32 threadCount);
+			void				Close();
+
+			ssize_t				Enter(uint32 submitCount, uint32 waitCount,
+									uint32 flags, bigtime_t timeout);
+
+			bool				IsOwner() const;
+			io_ring_header*		UserHeader() const { return fUserHeader; }
+			area_id				UserArea() const { return fUserArea; }
+			void				DeleteUserArea();
+
+private:
+			uint32				_FreeCompletions() const;
+			void				_Submit(const io_ring_submission& submission);
+			status_t			_Prepare(io_ring_operation* operation);
+			void				_StartRequest(io_ring_operation* operation,
+									struct vnode* vnode);
+			ssize_t				_Execute(io_ring_operation* operation);
+			void				_Complete(io_ring_operation* operation,
+									ssize_t result);
+			void				_PostCompletion(void* userData,
+									ssize_t result);
+
+	static	status_t			_RequestFinished(void* data,
+									io_request* request, status_t status,
+									bool partialTransfer,
+									generic_size_t transferEndOffset);
+			void				_Worker();
+	static	status_t			_WorkerThread(void* self);
+
+private:
+			mutex				fSubmitLock;
+			spinlock			fLock;
+			ConditionVariable	fWorkCondition;
+			ConditionVariable	fCompletionCondition;
+			OperationList		fQueue;
+			area_id				fArea;
+			area_id				fUserArea;
+			io_ring_header*		fHeader;
+				// the kernel's mapping of the ring
+			io_ring_header*		fUserHeader;
+			io_ring_submission*	fSubmissions;
+			io_ring_completion*	fCompletions;
+			uint32				fSubmissionCount;
+			uint32				fCompletionCount;
+			uint32				fSubmissionHead;
+				// guarded by fSubmitLock
+			uint32				fCompletionTail;
+			uint32				fInFlight;
+				// submissions consumed, but not completed yet
+			team_id				fTeam;
+			bool				fClosed;
+};
+
+
+static inline bool
+is_user_range(const void* buffer, size_t length)
+{
+	addr_t address = (addr_t)buffer;
+	return IS_USER_ADDRESS(address)
+		&& (length == 0 || (address + length > address
+			&& IS_USER_ADDRESS(address + length - 1)));
+}
+
+
+// #pragma mark - io_ring
+
+
+io_ring::io_ring()
+	:
+	fArea(-1),
+	fUserArea(-1),
+	fHeader(NULL),
+	fUserHeader(NULL),
+	fSubmissionCount(0),
+	fCompletionCount(0),
+	fSubmissionHead(0),
+	fCompletionTail(0),
+	fInFlight(0),
+	fTeam(team_get_current_team_id()),
+	fClosed(false)
+{
+	mutex_init(&fSubmitLock, "io ring submit");
+	B_INITIALIZE_SPINLOCK(&fLock);
+	fWorkCondition.Init(this, "io ring work");
+	fCompletionCondition.Init(this, "io ring completion");
+}
+
+
+io_ring::~io_ring()
+{
+	if (fArea >= 0)
+		delete_area(fArea);
+	mutex_destroy(&fSubmitLock);
+}
+
+
+status_t
+io_ring::Init(uint32 entryCount, uint32 threadCount)
+{
+	fSubmissionCount = 1;
+	while (fSubmissionCount < entryCount)
+		fSubmissionCount <<= 1;
+	fCompletionCount = fSubmissionCount * 2;
+
+	size_t submissionOffset = ROUNDUP(sizeof(io_ring_header),
+		kEntriesAlignment);
+	size_t completionOffset = ROUNDUP(submissionOffset
+		+ fSubmissionCount * sizeof(io_ring_submission), kEntriesAlignment);
+	size_t size = ROUNDUP(completionOffset
+		+ fCompletionCount * sizeof(io_ring_completion), B_PAGE_SIZE);
+
+	void* address;
+	fArea = create_area("io ring", &address, B_ANY_KERNEL_ADDRESS, size,
+		B_FULL_LOCK, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+	if (fArea < 0)
+		return fArea;
+
+	memset(address, 0, size);
+
+	fHeader = (io_ring_header*)address;
+	fHeader->submission_count = fSubmissionCount;
+	fHeader->submission_offset = submissionOffset;
+	fHeader->completion_count = fCompletionCount;
+	fHeader->completion_offset = completionOffset;
+	fSubmissions = (io_ring_submission*)((uint8*)address + submissionOffset);
+	fCompletions = (io_ring_completion*)((uint8*)address + completionOffset);
+
+	// Like the commpage, the team must not be able to resize or delete its
+	// mapping, as that would affect the kernel's mapping as well.
+	fUserArea = vm_clone_area(fTeam, "io ring", (void**)&fUserHeader,
+		B_ANY_ADDRESS, B_READ_AREA | B_WRITE_AREA | B_KERNEL_AREA,
+		REGION_NO_PRIVATE_MAP, fArea, true);
+	if (fUserArea < 0)
+		return fUserArea;
+
+	for (uint32 i = 0; i < threadCount; i++) {
+		// every thread has a reference to the ring
+		AcquireReference();
+
+		thread_id thread = spawn_kernel_thread_etc(&_WorkerThread,
+			"io ring worker", B_NORMAL_PRIORITY, this, fTeam);
+		if (thread < 0) {
+			ReleaseReference();
+			DeleteUserArea();
+			return thread;
+		}
+
+		resume_thread(thread);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Called when the last file descriptor of the ring has been closed.
+	Operations that haven't been started yet are canceled, and the ring's
+	threads quit. Operations in progress complete normally.
+*/
+void
+io_ring::Close()
+{
+	InterruptsSpinLocker locker(fLock);
+
+	fClosed = true;
+
+	OperationList queue;
+	queue.MoveFrom(&fQueue);
+
+	fWorkCondition.NotifyAll();
+	fCompletionCondition.NotifyAll();
+
+	locker.Unlock();
+
+	while (io_ring_operation* operation = queue.RemoveHead())
+		_Complete(operation, B_CANCELED);
+}
+
+
+ssize_t
+io_ring::Enter(uint32 submitCount, uint32 waitCount, uint32 flags,
+	bigtime_t timeout)
+{
+	ssize_t submitted = 0;
+
+	if (submitCount > 0) {
+		MutexLocker submitLocker(fSubmitLock);
+
+		uint32 tail = atomic_get((int32*)&fHeader->submission_tail);
+		uint32 available = tail - fSubmissionHead;
+		if (available > fSubmissionCount)
+			return B_BAD_VALUE;
+
+		submitCount = min_c(submitCount, available);
+
+		while ((uint32)submitted < submitCount) {
+			InterruptsSpinLocker locker(fLock);
+
+			if (fClosed)
+				return submitted > 0 ? submitted : B_FILE_ERROR;
+
+			// reserve the completion
+			if (_FreeCompletions() == 0)
+				break;
+
+			fInFlight++;
+			locker.Unlock();
+
+			// Userland could change the entry while we look at it, so we only
+			// use our copy.
+			io_ring_submission submission
+				= fSubmissions[fSubmissionHead & (fSubmissionCount - 1)];
+			fSubmissionHead++;
+			atomic_set((int32*)&fHeader->submission_head, fSubmissionHead);
+
+			_Submit(submission);
+			submitted++;
+		}
+	}
+
+	if (waitCount == 0)
+		return submitted;
+
+	if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout > 0
+		&& timeout != B_INFINITE_TIMEOUT) {
+		timeout += system_time();
+		flags = (flags & ~B_RELATIVE_TIMEOUT) | B_ABSOLUTE_TIMEOUT;
+	}
+	flags &= B_RELATIVE_TIMEOUT | B_ABSOLUTE_TIMEOUT;
+
+	InterruptsSpinLocker locker(fLock);
+
+	while (true) {
+		// Return when there are enough completions, or when no more will
+		// come.
+		uint32 head = atomic_get((int32*)&fHeader->completion_head);
+		if (fCompletionTail - head >= waitCount || fInFlight == 0 || fClosed)
+			break;
+
+		ConditionVariableEntry entry;
+		fCompletionCondition.Add(&entry);
+
+		locker.Unlock();
+
+		status_t status = entry.Wait(B_CAN_INTERRUPT | flags, timeout);
+		if (status != B_OK)
+			return submitted > 0 ? submitted : status;
+
+		locker.Lock();
+	}
+
+	return submitted;
+}
+
+
+bool
+io_ring::IsOwner() const
+{
+	return fTeam == team_get_current_team_id();
+}
+
+
+void
+io_ring::DeleteUserArea()
+{
+	if (fUserArea >= 0) {
+		vm_delete_area(fTeam, fUserArea, true);
+		fUserArea = -1;
+		fUserHeader = NULL;
+	}
+}
+
+
+/*!	Returns the number of completions that have not been reserved for a
+	submission yet. The caller must hold fLock.
+*/
+uint32
+io_ring::_FreeCompletions() const
+{
+	uint32 head = atomic_get((int32*)&fHeader->completion_head);
+	uint32 pending = fCompletionTail - head;
+	if (pending > fCompletionCount || pending + fInFlight >= fCompletionCount)
+		return 0;
+
+	return fCompletionCount - pending - fInFlight;
+}
+
+
+/*!	Starts the operation for the given submission, for which a completion
+	has already been reserved. Errors are reported via the completion.
+*/
+void
+io_ring::_Submit(const io_ring_submission& submission)
+{
+	TRACE(("io_ring %p: submit opcode %u, fd %" B_PRId32 ", offset %" B_PRIdOFF
+		"\n", this, submission.opcode, submission.fd, submission.offset));
+
+	io_ring_operation* operation = new(nothrow) io_ring_operation;
+	if (operation == NULL) {
+		_PostCompletion(submission.user_data, B_NO_MEMORY);
+		return;
+	}
+
+	operation->ring = this;
+	operation->submission = submission;
+	operation->descriptor = NULL;
+	operation->vecs = NULL;
+
+	// the operation keeps the ring alive
+	AcquireReference();
+
+	status_t status = _Prepare(operation);
+	if (status != B_OK) {
+		_Complete(operation, status);
+		return;
+	}
+
+	uint16 opcode = operation->submission.opcode;
+	if (opcode == IO_RING_NOP) {
+		_Complete(operation, B_OK);
+		return;
+	}
+
+	struct vnode* vnode = fd_vnode(operation->descriptor);
+	if (opcode != IO_RING_FSYNC && vnode != NULL
+		&& devfs_is_asynchronous_device(vnode)) {
+		_StartRequest(operation, vnode);
+		return;
+	}
+
+	InterruptsSpinLocker locker(fLock);
+
+	if (fClosed) {
+		locker.Unlock();
+		_Complete(operation, B_CANCELED);
+		return;
+	}
+
+	fQueue.Add(operation);
+	fWorkCondition.NotifyOne();
+}
+
+
+/*!	Checks the submission, and gets the file descriptor and the I/O vectors
+	the operation works on.
+*/
+status_t
+io_ring::_Prepare(io_ring_operation* operation)
+{
+	const io_ring_submission& submission = operation->submission;
+
+	if (submission.flags != 0)
+		return B_BAD_VALUE;
+
+	switch (submission.opcode) {
+		case IO_RING_NOP:
+			return B_OK;
+		case IO_RING_READ:
+		case IO_RING_WRITE:
+		case IO_RING_READV:
+		case IO_RING_WRITEV:
+		case IO_RING_FSYNC:
+			break;
+		default:
+			return B_BAD_VALUE;
+	}
+
+	file_descriptor* descriptor = get_fd(get_current_io_context(false),
+		submission.fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	operation->descriptor = descriptor;
+
+	// An operation queued on the ring itself would keep it open forever.
+	if (descriptor->type == FDTYPE_IO_RING)
+		return B_BAD_VALUE;
+
+	struct vnode* vnode = fd_vnode(descriptor);
+	if (vnode == NULL)
+		return B_BAD_VALUE;
+
+	if (submission.opcode == IO_RING_FSYNC)
+		return B_OK;
+
+	// Only regular files, and devices that get an I/O request, can be read
+	// and written (cf. the comment at the top of this file)
+	if (descriptor->type != FDTYPE_FILE)
+		return B_BAD_VALUE;
+
+	if (!devfs_is_asynchronous_device(vnode)) {
+		struct stat stat;
+		status_t status = vfs_stat_vnode(vnode, &stat);
+		if (status != B_OK)
+			return status;
+		if (!S_ISREG(stat.st_mode))
+			return B_BAD_VALUE;
+	}
+
+	bool write = submission.opcode == IO_RING_WRITE
+		|| submission.opcode == IO_RING_WRITEV;
+	if (write ? (descriptor->open_mode & O_RWMASK) == O_RDONLY
+			: (descriptor->open_mode & O_RWMASK) == O_WRONLY) {
+		return B_FILE_ERROR;
+	}
+
+	if (write ? descriptor->ops->fd_write == NULL
+			: descriptor->ops->fd_read == NULL) {
+		return B_BAD_VALUE;
+	}
+
+	if (submission.offset < 0)
+		return B_BAD_VALUE;
+
+	if (submission.opcode == IO_RING_READ
+		|| submission.opcode == IO_RING_WRITE) {
+		if (submission.length > SSIZE_MAX)
+			return B_BAD_VALUE;
+		if (!is_user_range(submission.buffer, submission.length))
+			return B_BAD_ADDRESS;
+		return B_OK;
+	}
+
+	// prevent integer overflow exploit in malloc()
+	if (submission.length > IOV_MAX)
+		return B_BAD_VALUE;
+	if (submission.length == 0)
+		return B_OK;
+
+	if (!is_user_range(submission.buffer,
+			sizeof(iovec) * submission.length)) {
+		return B_BAD_ADDRESS;
+	}
+
+	operation->vecs = (iovec*)malloc(sizeof(iovec) * submission.length);
+	if (operation->vecs == NULL)
+		return B_NO_MEMORY;
+
+	if (user_memcpy(operation->vecs, submission.buffer,
+			sizeof(iovec) * submission.length) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	for (size_t i = 0; i < submission.length; i++) {
+		if (!is_user_range(operation->vecs[i].iov_base,
+				operation->vecs[i].iov_len)) {
+			return B_BAD_ADDRESS;
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*!	Passes the operation to the device as an asynchronous I/O request. The
+	request's finished callback completes the operation, also when it fails.
+*/
+void
+io_ring::_StartRequest(io_ring_operation* operation, struct vnode* vnode)
+{
+	const io_ring_submission& submission = operation->submission;
+	bool write = submission.opcode == IO_RING_WRITE
+		|| submission.opcode == IO_RING_WRITEV;
+
+	generic_io_vec singleVec;
+	generic_io_vec* vecs = &singleVec;
+	size_t vecCount = 1;
+
+	if (operation->vecs == NULL) {
+		// an empty vector for IO_RING_READV and IO_RING_WRITEV
+		singleVec.base = (generic_addr_t)submission.buffer;
+		singleVec.length = operation->vecs == NULL
+			&& (submission.opcode == IO_RING_READV
+				|| submission.opcode == IO_RING_WRITEV)
+			? 0 : submission.length;
+	} else {
+		vecCount = submission.length;
+		vecs = (generic_io_vec*)malloc(sizeof(generic_io_vec) * vecCount);
+		if (vecs == NULL) {
+			_Complete(operation, B_NO_MEMORY);
+			return;
+		}
+
+		for (size_t i = 0; i < vecCount; i++) {
+			vecs[i].base = (generic_addr_t)operation->vecs[i].iov_base;
+			vecs[i].length = operation->vecs[i].iov_len;
+		}
+	}
+	MemoryDeleter vecsDeleter(vecs != &singleVec ? vecs : NULL);
+
+	generic_size_t length = 0;
+	for (size_t i = 0; i < vecCount; i++) {
+		if (vecs[i].length > SSIZE_MAX - length) {
+			_Complete(operation, B_BAD_VALUE);
+			return;
+		}
+		length += vecs[i].length;
+	}
+
+	if (length == 0) {
+		_Complete(operation, 0);
+		return;
+	}
+
+	IORequest* request = IORequest::Create(false);
+	if (request == NULL) {
+		_Complete(operation, B_NO_MEMORY);
+		return;
+	}
+
+	status_t status = request->Init(submission.offset, vecs, vecCount, length,
+		write, B_DELETE_IO_REQUEST);
+	if (status != B_OK) {
+		delete request;
+		_Complete(operation, status);
+		return;
+	}
+
+	request->SetFinishedCallback(&_RequestFinished, operation);
+
+	// The request may be finished before vfs_vnode_io() returns, so the
+	// operation has to stay around until we know whether it was notified.
+	operation->references = 2;
+	operation->result = B_ERROR;
+
+	status = vfs_vnode_io(vnode, operation->descriptor->cookie, request);
+	if (status != B_OK && atomic_get(&operation->references) == 2) {
+		// the request failed without being notified
+		request->SetStatusAndNotify(status);
+		if (atomic_get(&operation->references) == 2) {
+			// its status had already been set, so it won't be notified
+			// anymore either
+			delete request;
+			operation->result = status;
+			atomic_add(&operation->references, -1);
+		}
+	}
+
+	if (atomic_add(&operation->references, -1) == 1)
+		_Complete(operation, operation->result);
+}
+
+
+/*!	Executes the operation synchronously. Called by the ring's threads.
+*/
+ssize_t
+io_ring::_Execute(io_ring_operation* operation)
+{
+	const io_ring_submission& submission = operation->submission;
+	file_descriptor* descriptor = operation->descriptor;
+
+	if (submission.opcode == IO_RING_FSYNC) {
+		struct vnode* vnode = fd_vnode(descriptor);
+		if (vnode == NULL)
+			return B_BAD_VALUE;
+
+		return vfs_fsync_vnode(vnode);
+	}
+
+	bool write = submission.opcode == IO_RING_WRITE
+		|| submission.opcode == IO_RING_WRITEV;
+
+	iovec singleVec;
+	const iovec* vecs = operation->vecs;
+	size_t vecCount = submission.length;
+	if (submission.opcode == IO_RING_READ
+		|| submission.opcode == IO_RING_WRITE) {
+		singleVec.iov_base = submission.buffer;
+		singleVec.iov_len = submission.length;
+		vecs = &singleVec;
+		vecCount = 1;
+	}
+
+	// like readv()/writev()
+	off_t pos = submission.offset;
+	ssize_t bytesTransferred = 0;
+	for (size_t i = 0; i < vecCount; i++) {
+		size_t length = vecs[i].iov_len;
+		status_t status;
+		if (write) {
+			status = descriptor->ops->fd_write(descriptor, pos,
+				vecs[i].iov_base, &length);
+		} else {
+			status = descriptor->ops->fd_read(descriptor, pos,
+				vecs[i].iov_base, &length);
+		}
+
+		if (status != B_OK) {
+			if (bytesTransferred == 0)
+				return status;
+			break;
+		}
+
+		if ((uint64)bytesTransferred + length > SSIZE_MAX)
+			bytesTransferred = SSIZE_MAX;
+		else
+			bytesTransferred += (ssize_t)length;
+
+		pos += length;
+
+		if (length < vecs[i].iov_len)
+			break;
+	}
+
+	return bytesTransferred;
+}
+
+
+void
+io_ring::_Complete(io_ring_operation* operation, ssize_t result)
+{
+	TRACE(("io_ring %p: complete opcode %u: %" B_PRIdSSIZE "\n", this,
+		operation->submission.opcode, result));
+
+	_PostCompletion(operation->submission.user_data, result);
+
+	if (operation->descriptor != NULL)
+		put_fd(operation->descriptor);
+	free(operation->vecs);
+	delete operation;
+
+	ReleaseReference();
+}
+
+
+void
+io_ring::_PostCompletion(void* userData, ssize_t result)
+{
+	InterruptsSpinLocker locker(fLock);
+
+	// the completion has been reserved when the submission was consumed
+	io_ring_completion& completion
+		= fCompletions[fCompletionTail & (fCompletionCount - 1)];
+	completion.user_data = userData;
+	completion.result = result;
+
+	// publishes the completion
+	fCompletionTail++;
+	atomic_set((int32*)&fHeader->completion_tail, fCompletionTail);
+
+	fInFlight--;
+	fCompletionCondition.NotifyAll();
+}
+
+
+/*static*/ status_t
+io_ring::_RequestFinished(void* data, io_request* request, status_t status,
+	bool partialTransfer, generic_size_t transferEndOffset)
+{
+	io_ring_operation* operation = (io_ring_operation*)data;
+
+	ssize_t result;
+	if (!partialTransfer)
+		result = request->Length();
+	else if (transferEndOffset > 0)
+		result = transferEndOffset;
+	else
+		result = status != B_OK ? status : 0;
+
+	operation->result = result;
+	if (atomic_add(&operation->references, -1) == 1)
+		operation->ring->_Complete(operation, operation->result);
+	return B_OK;
+}
+
+
+void
+io_ring::_Worker()
+{
+	while (true) {
+		InterruptsSpinLocker locker(fLock);
+
+		io_ring_operation* operation = fQueue.RemoveHead();
+		if (operation == NULL) {
+			if (fClosed)
+				return;
+
+			ConditionVariableEntry entry;
+			fWorkCondition.Add(&entry);
+
+			locker.Unlock();
+
+			// only the death of the team interrupts us
+			if (entry.Wait(B_KILL_CAN_INTERRUPT) != B_OK)
+				return;
+
+			continue;
+		}
+
+		locker.Unlock();
+
+		_Complete(operation, _Execute(operation));
+	}
+}
+
+
+/*static*/ status_t
+io_ring::_WorkerThread(void* self)
+{
+	io_ring* ring = (io_ring*)self;
+	ring->_Worker();
+	ring->ReleaseReference();
+	return B_OK;
+}
+
+
+//	#pragma mark - file descriptor
+
+
+static status_t
+io_ring_close(struct file_descriptor* descriptor)
+{
+	io_ring* ring = (io_ring*)descriptor->cookie;
+	ring->Close();
+	return B_OK;
+}
+
+
+static void
+io_ring_free(struct file_descriptor* descriptor)
+{
+	io_ring* ring = (io_ring*)descriptor->cookie;
+	ring->ReleaseReference();
+}
+
+
+static struct fd_ops sIORingFDOps = {
+	NULL,	// fd_read
+	NULL,	// fd_write
+	NULL,	// fd_seek
+	NULL,	// fd_ioctl
+	NULL,	// fd_set_flags
+	NULL,	// fd_select
+	NULL,	// fd_deselect
+	NULL,	// fd_read_dir
+	NULL,	// fd_rewind_dir
+	NULL,	// fd_read_stat
+	NULL,	// fd_write_stat
+	&io_ring_close,
+	&io_ring_free
+};
+
+
+static status_t
+get_io_ring(int fd, file_descriptor*& _descriptor, io_ring*& _ring)
+{
+	file_descriptor* descriptor = get_fd(get_current_io_context(false), fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	if (descriptor->type != FDTYPE_IO_RING) {
+		put_fd(descriptor);
+		return B_BAD_VALUE;
+	}
+
+	io_ring* ring = (io_ring*)descriptor->cookie;
+	if (!ring->IsOwner()) {
+		// the ring has been inherited from another team
+		put_fd(descriptor);
+		return B_NOT_ALLOWED;
+	}
+
+	_descriptor = descriptor;
+	_ring = ring;
+	return B_OK;
+}
+
+
+//	#pragma mark - user syscalls
+
+
+/*!	Creates an I/O ring with at least \a entryCount submission entries, and
+	twice as many completion entries, and \a threadCount threads for the
+	operations that can't be started asynchronously (0 for the default).
+	Returns the ring's file descriptor, which is always closed on exec().
+	The ring's area is returned in \a _userArea; it is the caller's to delete
+	after the ring has been closed.
+*/
+int
+_user_io_ring_create(uint32 entryCount, uint32 threadCount,
+	io_ring_header** _userHeader, area_id* _userArea)
+{
+	if (entryCount == 0 || entryCount > IO_RING_MAX_ENTRIES
+		|| threadCount > IO_RING_MAX_THREADS) {
+		return B_BAD_VALUE;
+	}
+	if (_userHeader == NULL || !IS_USER_ADDRESS(_userHeader)
+		|| _userArea == NULL || !IS_USER_ADDRESS(_userArea)) {
+		return B_BAD_ADDRESS;
+	}
+
+	if (threadCount == 0)
+		threadCount = kDefaultThreadCount;
+
+	io_ring* ring = new(nothrow) io_ring;
+	if (ring == NULL)
+		return B_NO_MEMORY;
+	BReference<io_ring> ringReference(ring, true);
+
+	status_t status = ring->Init(entryCount, threadCount);
+	if (status != B_OK) {
+		ring->Close();
+		return status;
+	}
+
+	io_ring_header* header = ring->UserHeader();
+	area_id area = ring->UserArea();
+	if (user_memcpy(_userHeader, &header, sizeof(header)) != B_OK
+		|| user_memcpy(_userArea, &area, sizeof(area)) != B_OK) {
+		ring->DeleteUserArea();
+		ring->Close();
+		return B_BAD_ADDRESS;
+	}
+
+	file_descriptor* descriptor = alloc_fd();
+	if (descriptor == NULL) {
+		ring->DeleteUserArea();
+		ring->Close();
+		return B_NO_MEMORY;
+	}
+
+	descriptor->type = FDTYPE_IO_RING;
+	descriptor->ops = &sIORingFDOps;
+	descriptor->cookie = ring;
+	descriptor->open_mode = O_RDWR;
+
+	io_context* context = get_current_io_context(false);
+	int fd = new_fd(context, descriptor);
+	if (fd < 0) {
+		free(descriptor);
+		ring->DeleteUserArea();
+		ring->Close();
+		return fd;
+	}
+
+	// the descriptor owns the reference now
+	ringReference.Detach();
+
+	// the ring's threads don't survive exec()
+	mutex_lock(&context->io_mutex);
+	fd_set_close_on_exec(context, fd, true);
+	mutex_unlock(&context->io_mutex);
+
+	return fd;
+}
+
+
+/*!	Consumes up to \a submitCount submissions of the ring, and then waits
+	until at least \a waitCount completions are pending, or until all
+	submissions have been completed.
+	Returns the number of submissions consumed. It is less than requested
+	when the completion ring can't take more completions.
+*/
+ssize_t
+_user_io_ring_enter(int fd, uint32 submitCount, uint32 waitCount,
+	uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	file_descriptor* descriptor;
+	io_ring* ring;
+	status_t status = get_io_ring(fd, descriptor, ring);
+	if (status != B_OK)
+		return status;
+	CObjectDeleter<file_descriptor> descriptorPutter(descriptor, put_fd);
+
+	ssize_t result = ring->Enter(submitCount, waitCount, flags, timeout);
+	if (result < 0)
+		return syscall_restart_handle_timeout_post(result, timeout);
+
+	return result;
+}
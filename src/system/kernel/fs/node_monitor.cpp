@@ -1099,6 +1099,8 @@ status_t
 notify_entry_created(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_entry_directory_changed(device, directory);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_CREATED,
 		device, directory, name, node);
 }
@@ -1117,6 +1119,8 @@ status_t
 notify_entry_removed(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_entry_directory_changed(device, directory);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_REMOVED,
 		device, directory, name, node);
 }
@@ -1138,6 +1142,10 @@ notify_entry_moved(dev_t device, ino_t fromDirectory,
 	const char *fromName, ino_t toDirectory, const char *toName,
 	ino_t node)
 {
+	vfs_entry_directory_changed(device, fromDirectory);
+	if (toDirectory != fromDirectory)
+		vfs_entry_directory_changed(device, toDirectory);
+
 	return sNodeMonitorService.NotifyEntryMoved(device, fromDirectory,
 		fromName, toDirectory, toName, node);
 }
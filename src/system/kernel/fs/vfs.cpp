@@ -43,6 +43,7 @@
 #include <KPath.h>
 #include <lock.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <syscalls.h>
 #include <syscall_restart.h>
 #include <tracing.h>
@@ -235,6 +236,10 @@ static recursive_lock sMountOpLock;
 	write accessed when holding a read lock to sVnodeLock *and* having the vnode
 	locked. Write access to covered_by and covers requires to write lock
 	sVnodeLock.
+	The only exception are lock-free lookups (cf. get_vnode_lockless()), which
+	only acquire references to vnodes that are already referenced. Since those
+	run with interrupts disabled, vnodes and old hash tables are only freed
+	after smp_wait_for_quiescent_cpus().
 
 	The thread trying to acquire the lock must not hold sMountMutex.
 	You must not hold this lock when calling create_sem(), as this might call
@@ -281,7 +286,95 @@ struct VnodeHash {
 	}
 };
 
-typedef BOpenHashTable<VnodeHash> VnodeTable;
+/*!	The vnode table, which can also be searched without holding sVnodeLock.
+	It is resized explicitly, so that the old table stays around until no
+	lock-free lookup can use it anymore; fSequence is odd while the table is
+	being replaced.
+*/
+class VnodeTable : public BOpenHashTable<VnodeHash, false> {
+public:
+	VnodeTable()
+		:
+		fSequence(0)
+	{
+	}
+
+	status_t Insert(struct vnode* vnode)
+	{
+		// lock-free lookups must not see the vnode before its link
+		size_t index = fDefinition.Hash(vnode) & (fTableSize - 1);
+		vnode->next = fTable[index];
+		memory_write_barrier();
+		fTable[index] = vnode;
+		fItemCount++;
+
+		_Resize();
+		return B_OK;
+	}
+
+	bool Remove(struct vnode* vnode)
+	{
+		if (!RemoveUnchecked(vnode))
+			return false;
+
+		_Resize();
+		return true;
+	}
+
+	/*!	Must be called with interrupts disabled. Might miss the vnode, if the
+		table is changed at the same time.
+	*/
+	struct vnode* LookupLockless(dev_t mountID, ino_t vnodeID) const
+	{
+		static const int32 kMaxSteps = 64;
+
+		int32 sequence = atomic_get((int32*)&fSequence);
+		memory_read_barrier();
+		struct vnode** table = fTable;
+		size_t tableSize = fTableSize;
+		memory_read_barrier();
+		if ((sequence & 1) != 0
+			|| atomic_get((int32*)&fSequence) != sequence) {
+			return NULL;
+		}
+
+		vnode_hash_key key;
+		key.device = mountID;
+		key.vnode = vnodeID;
+
+		struct vnode* vnode = table[fDefinition.HashKey(key) & (tableSize - 1)];
+		for (int32 i = 0; vnode != NULL && i < kMaxSteps; i++) {
+			if (vnode->device == mountID && vnode->id == vnodeID)
+				return vnode;
+			vnode = vnode->next;
+		}
+
+		return NULL;
+	}
+
+private:
+	void _Resize()
+	{
+		size_t size = ResizeNeeded();
+		if (size == 0)
+			return;
+
+		void* allocation = malloc(size);
+		if (allocation == NULL)
+			return;
+
+		void* oldTable;
+		atomic_add(&fSequence, 1);
+		Resize(allocation, size, true, &oldTable);
+		atomic_add(&fSequence, 1);
+
+		smp_wait_for_quiescent_cpus();
+		free(oldTable);
+	}
+
+private:
+	int32	fSequence;
+};
 
 
 struct MountHash {
@@ -316,6 +409,12 @@ typedef BOpenHashTable<MountHash> MountTable;
 static VnodeTable* sVnodeTable;
 static struct vnode* sRoot;
 
+// vnodes that are freed once no lock-free lookup can see them anymore
+static const int32 kMaxRetiredVnodes = 64;
+static spinlock sRetiredVnodesLock = B_SPINLOCK_INITIALIZER;
+static struct vnode* sRetiredVnodes;
+static int32 sRetiredVnodeCount;
+
 #define MOUNTS_HASH_TABLE_SIZE 16
 static MountTable* sMountsTable;
 static dev_t sNextMountID = 1;
@@ -859,6 +958,48 @@ remove_vnode_from_mount_list(struct vnode* vnode, struct fs_mount* mount)
 }
 
 
+/*!	Frees a vnode that has been removed from the sVnodeTable as soon as no
+	lock-free lookup can see it anymore.
+	The vnode keeps its busy flag, so that such lookups ignore it.
+*/
+static void
+retire_vnode(struct vnode* vnode)
+{
+	InterruptsSpinLocker locker(sRetiredVnodesLock);
+
+	// a lookup standing on the vnode will just follow the retired list
+	vnode->next = sRetiredVnodes;
+	sRetiredVnodes = vnode;
+	sRetiredVnodeCount++;
+}
+
+
+/*!	Frees the retired vnodes, if there are enough of them.
+	Must be called with interrupts enabled.
+*/
+static void
+free_retired_vnodes()
+{
+	InterruptsSpinLocker locker(sRetiredVnodesLock);
+	if (sRetiredVnodeCount < kMaxRetiredVnodes)
+		return;
+
+	struct vnode* vnode = sRetiredVnodes;
+	sRetiredVnodes = NULL;
+	sRetiredVnodeCount = 0;
+
+	locker.Unlock();
+
+	smp_wait_for_quiescent_cpus();
+
+	while (vnode != NULL) {
+		struct vnode* next = vnode->next;
+		free(vnode);
+		vnode = next;
+	}
+}
+
+
 /*!	\brief Looks up a vnode by mount and node ID in the sVnodeTable.
 
 	The caller must hold the sVnodeLock (read lock at least).
@@ -1007,7 +1148,8 @@ free_vnode(struct vnode* vnode, bool reenter)
 
 	remove_vnode_from_mount_list(vnode, vnode->mount);
 
-	free(vnode);
+	retire_vnode(vnode);
+	free_retired_vnodes();
 }
 
 
@@ -1028,6 +1170,17 @@ free_vnode(struct vnode* vnode, bool reenter)
 static status_t
 dec_vnode_ref_count(struct vnode* vnode, bool alwaysFree, bool reenter)
 {
+	// Only the last reference needs the locks
+	int32 refCount = atomic_get(&vnode->ref_count);
+	while (refCount > 1) {
+		int32 oldRefCount = atomic_test_and_set(&vnode->ref_count,
+			refCount - 1, refCount);
+		if (oldRefCount == refCount)
+			return B_OK;
+
+		refCount = oldRefCount;
+	}
+
 	ReadLocker locker(sVnodeLock);
 	AutoLocker<Vnode> nodeLocker(vnode);
 
@@ -1111,6 +1264,59 @@ create_special_sub_node(struct vnode* vnode, uint32 flags)
 }
 
 
+/*!	\brief Acquires a reference to a vnode without any locking, if it is
+	already referenced.
+
+	That's the case for most directories along the paths being resolved, and
+	for most nodes that are looked up by many threads at the same time. All
+	other vnodes are left to get_vnode(), as are vnodes that are busy or take
+	part in covering, so that vfs_unmount() can still rely on the reference
+	counts it sees while holding sVnodeLock write locked.
+
+	\return The vnode, or \c NULL, if the caller has to go the locked way.
+*/
+static struct vnode*
+get_vnode_lockless(dev_t mountID, ino_t vnodeID)
+{
+	// Vnodes are only freed after all CPUs had interrupts enabled again
+	cpu_status state = disable_interrupts();
+
+	struct vnode* vnode = sVnodeTable->LookupLockless(mountID, vnodeID);
+	if (vnode != NULL && (vnode->IsBusy() || vnode->IsCovered()
+			|| vnode->IsCovering())) {
+		vnode = NULL;
+	}
+
+	if (vnode != NULL) {
+		int32 refCount = atomic_get(&vnode->ref_count);
+		while (true) {
+			if (refCount == 0) {
+				// unused vnodes need to be taken off the unused list
+				vnode = NULL;
+				break;
+			}
+
+			int32 oldRefCount = atomic_test_and_set(&vnode->ref_count,
+				refCount + 1, refCount);
+			if (oldRefCount == refCount)
+				break;
+
+			refCount = oldRefCount;
+		}
+	}
+
+	if (vnode != NULL && vnode->IsBusy()) {
+		// We might have caught free_vnode() setting the reference count; the
+		// count cannot drop to zero while the vnode is busy.
+		atomic_add(&vnode->ref_count, -1);
+		vnode = NULL;
+	}
+
+	restore_interrupts(state);
+	return vnode;
+}
+
+
 /*!	\brief Retrieves a vnode for a given mount ID, node ID pair.
 
 	If the node is not yet in memory, it will be loaded.
@@ -1132,6 +1338,11 @@ get_vnode(dev_t mountID, ino_t vnodeID, struct vnode** _vnode, bool canWait,
 	FUNCTION(("get_vnode: mountid %" B_PRId32 " vnid 0x%" B_PRIx64 " %p\n",
 		mountID, vnodeID, _vnode));
 
+	if (struct vnode* vnode = get_vnode_lockless(mountID, vnodeID)) {
+		*_vnode = vnode;
+		return B_OK;
+	}
+
 	rw_lock_read_lock(&sVnodeLock);
 
 	int32 tries = 2000;
@@ -1212,7 +1423,7 @@ restart:
 			remove_vnode_from_mount_list(vnode, vnode->mount);
 			rw_lock_write_unlock(&sVnodeLock);
 
-			free(vnode);
+			retire_vnode(vnode);
 			return status;
 		}
 
@@ -2089,9 +2300,13 @@ static status_t
 lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 {
 	ino_t id;
+	bool missing;
 
-	if (dir->mount->entry_cache.Lookup(dir->id, name, id))
+	if (dir->mount->entry_cache.Lookup(dir->id, name, id, missing)) {
+		if (missing)
+			return B_ENTRY_NOT_FOUND;
 		return get_vnode(dir->device, id, _vnode, true, false);
+	}
 
 	status_t status = FS_CALL(dir, lookup, name, &id);
 	if (status != B_OK)
@@ -2981,6 +3196,13 @@ _dump_mount(struct fs_mount* mount)
 	kprintf(" flags:        %s%s\n", mount->unmounting ? " unmounting" : "",
 		mount->owns_file_device ? " owns_file_device" : "");
 
+	EntryCacheStatistics statistics;
+	mount->entry_cache.GetStatistics(statistics);
+	kprintf(" entry cache:   %" B_PRId64 " hits, %" B_PRId64 " missing, %"
+		B_PRId64 " misses, %" B_PRId32 " complete directories\n",
+		statistics.hits, statistics.missing_hits, statistics.misses,
+		mount->entry_cache.CountCompleteDirectories());
+
 	fs_volume* volume = mount->volume;
 	while (volume != NULL) {
 		kprintf(" volume %p:\n", volume);
@@ -3718,7 +3940,7 @@ publish_vnode(fs_volume* volume, ino_t vnodeID, void* privateNode,
 			locker.Lock();
 			sVnodeTable->Remove(vnode);
 			remove_vnode_from_mount_list(vnode, vnode->mount);
-			free(vnode);
+			retire_vnode(vnode);
 		}
 	} else {
 		// we still hold the write lock -- mark the node unbusy and published
@@ -4030,6 +4252,26 @@ entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 }
 
 
+/*!	Lets the entry cache of the given mount answer lookups of entries that
+	don't exist, for directories that have been read in full. The file system
+	must maintain the entry cache via entry_cache_add() and
+	entry_cache_remove(), and send node monitoring notifications for all
+	changes of its directories.
+*/
+extern "C" status_t
+entry_cache_enable_complete_directories(dev_t mountID)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return B_BAD_VALUE;
+	locker.Unlock();
+
+	mount->entry_cache.EnableCompleteDirectories();
+	return B_OK;
+}
+
+
 //	#pragma mark - private VFS API
 //	Functions the VFS exports for other parts of the kernel
 
@@ -4525,6 +4767,23 @@ vfs_free_unused_vnodes(int32 level)
 }
 
 
+/*!	Called by the node monitor whenever an entry of the given directory has
+	been created, removed, or moved, so that the entry cache no longer
+	considers the directory complete.
+*/
+extern "C" void
+vfs_entry_directory_changed(dev_t mountID, ino_t directoryID)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return;
+	locker.Unlock();
+
+	mount->entry_cache.DirectoryChanged(directoryID);
+}
+
+
 extern "C" bool
 vfs_can_page(struct vnode* vnode, void* cookie)
 {
@@ -4670,6 +4929,16 @@ vfs_stat_vnode(struct vnode* vnode, struct stat* stat)
 }
 
 
+status_t
+vfs_fsync_vnode(struct vnode* vnode)
+{
+	if (!HAS_FS_CALL(vnode, fsync))
+		return B_UNSUPPORTED;
+
+	return FS_CALL_NO_PARAMS(vnode, fsync);
+}
+
+
 status_t
 vfs_stat_node_ref(dev_t device, ino_t inode, struct stat* stat)
 {
@@ -4767,16 +5036,25 @@ vfs_exec_io_context(io_context* context)
 		struct file_descriptor* descriptor = context->fds[i];
 		bool remove = false;
 
+		select_info* selectInfos = NULL;
+
 		if (descriptor != NULL && fd_close_on_exec(context, i)) {
 			context->fds[i] = NULL;
 			context->num_used_fds--;
 
+			selectInfos = context->select_infos[i];
+			context->select_infos[i] = NULL;
+
 			remove = true;
 		}
 
 		mutex_unlock(&context->io_mutex);
 
 		if (remove) {
+			// event queues of the team may still have the FD selected
+			if (selectInfos != NULL)
+				deselect_select_infos(descriptor, selectInfos, true);
+
 			close_fd(descriptor);
 			put_fd(descriptor);
 		}
@@ -4900,6 +5178,12 @@ vfs_free_io_context(io_context* context)
 
 	for (i = 0; i < context->table_size; i++) {
 		if (struct file_descriptor* descriptor = context->fds[i]) {
+			// event queues may still have the FD selected
+			if (select_info* selectInfos = context->select_infos[i]) {
+				context->select_infos[i] = NULL;
+				deselect_select_infos(descriptor, selectInfos, true);
+			}
+
 			close_fd(descriptor);
 			put_fd(descriptor);
 		}
@@ -5345,11 +5629,14 @@ open_dir_vnode(struct vnode* vnode, bool kernel)
 	if (status != B_OK)
 		return status;
 
+	vnode->mount->entry_cache.StartEnumeration(vnode->id, cookie);
+
 	// directory is opened, create a fd
 	status = get_new_fd(FDTYPE_DIR, NULL, vnode, cookie, O_CLOEXEC, kernel);
 	if (status >= 0)
 		return status;
 
+	vnode->mount->entry_cache.StopEnumeration(cookie);
 	FS_CALL(vnode, close_dir, cookie);
 	FS_CALL(vnode, free_dir_cookie, cookie);
 
@@ -5807,6 +6094,7 @@ dir_free_fd(struct file_descriptor* descriptor)
 	struct vnode* vnode = descriptor->u.vnode;
 
 	if (vnode != NULL) {
+		vnode->mount->entry_cache.StopEnumeration(descriptor->cookie);
 		FS_CALL(vnode, free_dir_cookie, descriptor->cookie);
 		put_vnode(vnode);
 	}
@@ -5883,8 +6171,16 @@ dir_read(struct io_context* ioContext, struct vnode* vnode, void* cookie,
 	if (error != B_OK)
 		return error;
 
-	// we need to adjust the read dirents
+	// If the directory is read in full, the entry cache knows all of its
+	// entries. It needs the dirents as the file system returned them.
 	uint32 count = *_count;
+	if (count > 0) {
+		vnode->mount->entry_cache.AddEnumeratedEntries(cookie, vnode->device,
+			buffer, count);
+	} else
+		vnode->mount->entry_cache.FinishEnumeration(cookie);
+
+	// we need to adjust the read dirents
 	for (uint32 i = 0; i < count; i++) {
 		error = fix_dirent(vnode, buffer, ioContext);
 		if (error != B_OK)
@@ -5903,7 +6199,12 @@ dir_rewind(struct file_descriptor* descriptor)
 	struct vnode* vnode = descriptor->u.vnode;
 
 	if (HAS_FS_CALL(vnode, rewind_dir)) {
-		return FS_CALL(vnode, rewind_dir, descriptor->cookie);
+		status_t status = FS_CALL(vnode, rewind_dir, descriptor->cookie);
+		if (status == B_OK) {
+			vnode->mount->entry_cache.StartEnumeration(vnode->id,
+				descriptor->cookie);
+		}
+		return status;
 	}
 
 	return B_UNSUPPORTED;
@@ -6158,10 +6459,7 @@ common_sync(int fd, bool kernel)
 	if (descriptor == NULL)
 		return B_FILE_ERROR;
 
-	if (HAS_FS_CALL(vnode, fsync))
-		status = FS_CALL_NO_PARAMS(vnode, fsync);
-	else
-		status = B_UNSUPPORTED;
+	status = vfs_fsync_vnode(vnode);
 
 	put_fd(descriptor);
 	return status;
@@ -7625,14 +7923,15 @@ fs_unmount(char* path, dev_t mountID, uint32 flags, bool kernel)
 	while (struct vnode* vnode = iterator.Next()) {
 		// Remove all covers/covered_by links from other mounts' nodes to this
 		// vnode and adjust the node ref count accordingly. We will release the
-		// references to the external vnodes below.
+		// references to the external vnodes below. The ref counts are changed
+		// atomically, as get_vnode_lockless() might access them, too.
 		if (Vnode* coveredNode = vnode->covers) {
 			if (Vnode* coveringNode = vnode->covered_by) {
 				// We have both covered and covering vnodes, so just remove us
 				// from the chain.
 				coveredNode->covered_by = coveringNode;
 				coveringNode->covers = coveredNode;
-				vnode->ref_count -= 2;
+				atomic_add(&vnode->ref_count, -2);
 
 				vnode->covered_by = NULL;
 				vnode->covers = NULL;
@@ -7642,28 +7941,28 @@ fs_unmount(char* path, dev_t mountID, uint32 flags, bool kernel)
 				// We only have a covered vnode. Remove its link to us.
 				coveredNode->covered_by = NULL;
 				coveredNode->SetCovered(false);
-				vnode->ref_count--;
+				atomic_add(&vnode->ref_count, -1);
 
 				// If the other node is an external vnode, we keep its link
 				// link around so we can put the reference later on. Otherwise
 				// we get rid of it right now.
 				if (coveredNode->mount == mount) {
 					vnode->covers = NULL;
-					coveredNode->ref_count--;
+					atomic_add(&coveredNode->ref_count, -1);
 				}
 			}
 		} else if (Vnode* coveringNode = vnode->covered_by) {
 			// We only have a covering vnode. Remove its link to us.
 			coveringNode->covers = NULL;
 			coveringNode->SetCovering(false);
-			vnode->ref_count--;
+			atomic_add(&vnode->ref_count, -1);
 
 			// If the other node is an external vnode, we keep its link
 			// link around so we can put the reference later on. Otherwise
 			// we get rid of it right now.
 			if (coveringNode->mount == mount) {
 				vnode->covered_by = NULL;
-				coveringNode->ref_count--;
+				atomic_add(&coveringNode->ref_count, -1);
 			}
 		}
 
@@ -33,6 +33,9 @@
 #include <util/AutoLock.h>
 #include <util/list.h>
 #include <vm/vm.h>
+#include <vm/VMAddressSpace.h>
+#include <vm/VMArea.h>
+#include <vm/VMCache.h>
 #include <wait_for_objects.h>
 
 
@@ -97,6 +100,11 @@ struct port_message : DoublyLinkedListLinkImpl<port_message> {
 	uid_t				sender;
 	gid_t				sender_group;
 	team_id				sender_team;
+	area_id				area;
+		// the kernel area holding the data of a message written with
+		// write_port_area_etc(), or -1
+	void*				area_address;
+	uint32				area_protection;
 	char				buffer[0];
 };
 
@@ -522,7 +530,11 @@ _dump_port_info(Port* port)
 
 		MessageList::Iterator iterator = port->messages.GetIterator();
 		while (port_message* message = iterator.Next()) {
-			kprintf(" %p  %08" B_PRIx32 "  %ld\n", message, message->code, message->size);
+			kprintf(" %p  %08" B_PRIx32 "  %ld", message, message->code,
+				message->size);
+			if (message->area >= 0)
+				kprintf("  area %" B_PRId32, message->area);
+			kprintf("\n");
 		}
 	}
 
@@ -639,7 +651,11 @@ is_port_closed(Port* port)
 static void
 put_port_message(port_message* message)
 {
+	// area messages are charged like copied ones, even though their data
+	// is not part of the allocation
 	const size_t size = sizeof(port_message) + message->size;
+	if (message->area >= 0)
+		delete_area(message->area);
 	free(message);
 
 	atomic_add(&sTotalSpaceCommited, -size);
@@ -648,10 +664,13 @@ put_port_message(port_message* message)
 }
 
 
-/*! Port must be locked. */
+/*! Port must be locked.
+	If \a isArea is \c true, the message data will be passed in an area; it is
+	charged against the space limit, but no buffer is allocated for it.
+*/
 static status_t
-get_port_message(int32 code, size_t bufferSize, uint32 flags, bigtime_t timeout,
-	port_message** _message, Port& port)
+get_port_message(int32 code, size_t bufferSize, bool isArea, uint32 flags,
+	bigtime_t timeout, port_message** _message, Port& port)
 {
 	const size_t size = sizeof(port_message) + bufferSize;
 
@@ -703,10 +722,12 @@ get_port_message(int32 code, size_t bufferSize, uint32 flags, bigtime_t timeout,
 		}
 
 		// Quota is fulfilled, try to allocate the buffer
-		port_message* message = (port_message*)malloc(size);
+		port_message* message = (port_message*)malloc(
+			isArea ? sizeof(port_message) : size);
 		if (message != NULL) {
 			message->code = code;
 			message->size = bufferSize;
+			message->area = -1;
 
 			*_message = message;
 			return B_OK;
@@ -749,19 +770,159 @@ copy_port_message(port_message* message, int32* _code, void* buffer,
 	if (_code != NULL)
 		*_code = message->code;
 
+	const void* data = message->area >= 0
+		? message->area_address : message->buffer;
+
 	if (size > 0) {
 		if (userCopy) {
-			status_t status = user_memcpy(buffer, message->buffer, size);
+			status_t status = user_memcpy(buffer, data, size);
 			if (status != B_OK)
 				return status;
 		} else
-			memcpy(buffer, message->buffer, size);
+			memcpy(buffer, data, size);
 	}
 
 	return size;
 }
 
 
+/*!	Returns whether the kernel area \a id covers at least \a size bytes,
+	and whether its RAM cache is not mapped by any other area than
+	\a otherArea. Only then, nobody but the kernel can change or shrink the
+	data of the message once \a otherArea is gone.
+*/
+static bool
+is_private_port_message_area(area_id id, area_id otherArea, size_t size)
+{
+	VMArea* area = VMAreaHash::Lookup(id);
+	if (area == NULL)
+		return false;
+
+	VMCache* cache = vm_area_get_locked_cache(area);
+
+	bool isPrivate = cache->type == CACHE_TYPE_RAM && area->Size() >= size;
+	for (VMArea* current = cache->areas; current != NULL && isPrivate;
+			current = current->cache_next) {
+		if (current != area && current->id != otherArea)
+			isPrivate = false;
+	}
+
+	vm_area_put_locked_cache(cache);
+	return isPrivate;
+}
+
+
+/*!	Moves the area \a id of the current team into the kernel address space,
+	where it holds the first \a size bytes of data of \a message until the
+	message is read. The pages of the area are not copied.
+	Areas that share their pages with other areas are refused, as the sender
+	could otherwise still change the data, or resize the cache from under
+	the kernel's mapping.
+*/
+static status_t
+attach_port_message_area(port_message* message, area_id id, size_t size,
+	bool kernel)
+{
+	area_info info;
+	status_t status = get_area_info(id, &info);
+	if (status != B_OK)
+		return status;
+
+	team_id team = team_get_current_team_id();
+	if (info.team != team)
+		return B_PERMISSION_DENIED;
+	if (size > info.size)
+		return B_BAD_VALUE;
+
+	void* address;
+	area_id kernelArea = vm_clone_area(VMAddressSpace::KernelID(),
+		"port message", &address, B_ANY_KERNEL_ADDRESS, B_KERNEL_READ_AREA,
+		REGION_NO_PRIVATE_MAP, id, true);
+	if (kernelArea < 0)
+		return kernelArea;
+
+	// the area may have changed since we looked at it
+	if (!is_private_port_message_area(kernelArea, id, size)) {
+		vm_delete_area(VMAddressSpace::KernelID(), kernelArea, true);
+		return B_NOT_ALLOWED;
+	}
+
+	status = vm_delete_area(team, id, kernel);
+	if (status != B_OK) {
+		vm_delete_area(VMAddressSpace::KernelID(), kernelArea, true);
+		return status;
+	}
+
+	// Another thread of the team might have cloned or resized the area
+	// before it was deleted. The area is gone in this case, anyway.
+	if (!is_private_port_message_area(kernelArea, -1, size)) {
+		vm_delete_area(VMAddressSpace::KernelID(), kernelArea, true);
+		return B_NOT_ALLOWED;
+	}
+
+	message->size = size;
+	message->area = kernelArea;
+	message->area_address = address;
+	message->area_protection = info.protection & ~B_SHARED_AREA;
+	return B_OK;
+}
+
+
+/*!	Maps the data of \a message into a new area of the current team. If the
+	message has been written as an area, the new area shares its pages,
+	otherwise the data is copied into it. Empty messages don't get an area.
+*/
+static ssize_t
+detach_port_message_area(port_message* message, int32* _code,
+	area_id* _area, void** _address, bool kernel)
+{
+	*_code = message->code;
+	*_area = -1;
+	*_address = NULL;
+
+	if (message->size == 0)
+		return 0;
+
+	uint32 addressSpec = kernel ? B_ANY_KERNEL_ADDRESS : B_ANY_ADDRESS;
+	team_id team = team_get_current_team_id();
+	void* address = NULL;
+	area_id area;
+
+	if (message->area >= 0) {
+		// the kernel area is deleted with the message
+		area = vm_clone_area(team, "port message", &address, addressSpec,
+			message->area_protection, REGION_NO_PRIVATE_MAP, message->area,
+			true);
+		if (area < 0)
+			return area;
+	} else {
+		uint32 protection = kernel
+			? B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA
+			: B_READ_AREA | B_WRITE_AREA;
+		virtual_address_restrictions virtualRestrictions = {};
+		virtualRestrictions.address_specification = addressSpec;
+		physical_address_restrictions physicalRestrictions = {};
+		area = create_area_etc(team, "port message",
+			ROUNDUP(message->size, B_PAGE_SIZE), B_NO_LOCK, protection, 0, 0,
+			&virtualRestrictions, &physicalRestrictions, &address);
+		if (area < 0)
+			return area;
+
+		if (kernel)
+			memcpy(address, message->buffer, message->size);
+		else if (user_memcpy(address, message->buffer, message->size)
+				!= B_OK) {
+			vm_delete_area(team, area, true);
+			return B_BAD_ADDRESS;
+		}
+	}
+
+	*_area = area;
+	*_address = address;
+	return message->size;
+}
+
+
 static void
 uninit_port(Port* port)
 {
@@ -1406,9 +1567,13 @@ read_port(port_id port, int32* msgCode, void* buffer, size_t bufferSize)
 }
 
 
-ssize_t
-read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
-	uint32 flags, bigtime_t timeout)
+/*!	Reads the next message from the port. If \a _area is not \c NULL, the
+	message data is returned in a new area instead of being copied into
+	\a buffer.
+*/
+static ssize_t
+read_port_message(port_id id, int32* _code, void* buffer, size_t bufferSize,
+	area_id* _area, void** _address, uint32 flags, bigtime_t timeout)
 {
 	if (!sPortsActive || id < 0)
 		return B_BAD_PORT_ID;
@@ -1418,6 +1583,8 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) != 0;
 	bool peekOnly = !userCopy && (flags & B_PEEK_PORT_MESSAGE) != 0;
 		// TODO: we could allow peeking for user apps now
+	if (peekOnly && _area != NULL)
+		return B_BAD_VALUE;
 
 	flags &= B_CAN_INTERRUPT | B_KILL_CAN_INTERRUPT | B_RELATIVE_TIMEOUT
 		| B_ABSOLUTE_TIMEOUT;
@@ -1500,14 +1667,47 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 
 	locker.Unlock();
 
-	size_t size = copy_port_message(message, _code, buffer, bufferSize,
-		userCopy);
+	ssize_t size;
+	if (_area != NULL) {
+		size = detach_port_message_area(message, _code, _area, _address,
+			!userCopy);
+	} else {
+		size = copy_port_message(message, _code, buffer, bufferSize,
+			userCopy);
+	}
 
 	put_port_message(message);
 	return size;
 }
 
 
+ssize_t
+read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
+	uint32 flags, bigtime_t timeout)
+{
+	return read_port_message(id, _code, buffer, bufferSize, NULL, NULL, flags,
+		timeout);
+}
+
+
+/*!	Reads the next message from the port, and returns its data in a new area
+	of the current team, which the caller is responsible to delete. Messages
+	written with write_port_area_etc() are passed on without copying their
+	data. The area is set to -1 for empty messages.
+	\return The size of the message, or an error code.
+*/
+ssize_t
+read_port_area_etc(port_id id, int32* _code, area_id* _area, void** _address,
+	uint32 flags, bigtime_t timeout)
+{
+	if (_code == NULL || _area == NULL || _address == NULL)
+		return B_BAD_VALUE;
+
+	return read_port_message(id, _code, NULL, 0, _area, _address, flags,
+		timeout);
+}
+
+
 status_t
 write_port(port_id id, int32 msgCode, const void* buffer, size_t bufferSize)
 {
@@ -1527,15 +1727,22 @@ write_port_etc(port_id id, int32 msgCode, const void* buffer,
 }
 
 
-status_t
-writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
-	size_t vecCount, size_t bufferSize, uint32 flags, bigtime_t timeout)
+/*!	Writes a message to the port. Its data is either gathered from
+	\a msgVecs, or, if \a area is valid, consists of the first \a bufferSize
+	bytes of that area, which is moved into the message.
+*/
+static status_t
+write_port_message(port_id id, int32 msgCode, const iovec* msgVecs,
+	size_t vecCount, size_t bufferSize, area_id area, uint32 flags,
+	bigtime_t timeout)
 {
 	if (!sPortsActive || id < 0)
 		return B_BAD_PORT_ID;
-	if (bufferSize > PORT_MAX_MESSAGE_SIZE)
+	if (bufferSize > (area < 0 ? PORT_MAX_MESSAGE_SIZE : kTeamSpaceLimit))
 		return B_BAD_VALUE;
 
+	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) != 0;
+
 	// mask irrelevant flags (for acquire_sem() usage)
 	flags &= B_CAN_INTERRUPT | B_KILL_CAN_INTERRUPT | B_RELATIVE_TIMEOUT
 		| B_ABSOLUTE_TIMEOUT;
@@ -1547,8 +1754,6 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 		timeout += system_time();
 	}
 
-	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) > 0;
-
 	status_t status;
 	port_message* message = NULL;
 
@@ -1598,7 +1803,7 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 	} else
 		portRef->write_count--;
 
-	status = get_port_message(msgCode, bufferSize, flags, timeout,
+	status = get_port_message(msgCode, bufferSize, area >= 0, flags, timeout,
 		&message, *portRef);
 	if (status != B_OK) {
 		if (status == B_BAD_PORT_ID) {
@@ -1615,7 +1820,14 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 	message->sender_group = getegid();
 	message->sender_team = team_get_current_team_id();
 
-	if (bufferSize > 0) {
+	if (area >= 0) {
+		status = attach_port_message_area(message, area, bufferSize,
+			!userCopy);
+		if (status != B_OK) {
+			put_port_message(message);
+			goto error;
+		}
+	} else if (bufferSize > 0) {
 		size_t offset = 0;
 		for (uint32 i = 0; i < vecCount; i++) {
 			size_t bytes = msgVecs[i].iov_len;
@@ -1662,6 +1874,37 @@ error:
 }
 
 
+status_t
+writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
+	size_t vecCount, size_t bufferSize, uint32 flags, bigtime_t timeout)
+{
+	return write_port_message(id, msgCode, msgVecs, vecCount, bufferSize, -1,
+		flags, timeout);
+}
+
+
+/*!	Writes a message whose data consists of the first \a size bytes of the
+	area \a area, which must belong to the current team. Instead of copying
+	the data, the area is removed from the team, and the reader gets the same
+	pages mapped into its team by read_port_area_etc(). Messages written this
+	way are not limited to PORT_MAX_MESSAGE_SIZE, but to kTeamSpaceLimit,
+	and are charged against the space available for port messages like any
+	other message. The area must not share its pages with any other area.
+	If the message cannot be written, the area remains untouched, unless
+	another thread of the team changed it while it was being moved.
+*/
+status_t
+write_port_area_etc(port_id id, int32 msgCode, area_id area, size_t size,
+	uint32 flags, bigtime_t timeout)
+{
+	if (area < 0)
+		return B_BAD_VALUE;
+
+	return write_port_message(id, msgCode, NULL, 0, size, area, flags,
+		timeout);
+}
+
+
 status_t
 set_port_owner(port_id id, team_id newTeamID)
 {
@@ -1920,6 +2163,51 @@ _user_writev_port_etc(port_id port, int32 messageCode, const iovec *userVecs,
 }
 
 
+ssize_t
+_user_read_port_area_etc(port_id port, int32 *userCode, area_id *userArea,
+	void **userAddress, uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (userCode == NULL || userArea == NULL || userAddress == NULL)
+		return B_BAD_VALUE;
+	if (!IS_USER_ADDRESS(userCode) || !IS_USER_ADDRESS(userArea)
+		|| !IS_USER_ADDRESS(userAddress))
+		return B_BAD_ADDRESS;
+
+	int32 messageCode;
+	area_id area;
+	void* address;
+	ssize_t bytesRead = read_port_area_etc(port, &messageCode, &area,
+		&address, flags | PORT_FLAG_USE_USER_MEMCPY | B_CAN_INTERRUPT,
+		timeout);
+
+	if (bytesRead >= 0
+		&& (user_memcpy(userCode, &messageCode, sizeof(int32)) != B_OK
+			|| user_memcpy(userArea, &area, sizeof(area_id)) != B_OK
+			|| user_memcpy(userAddress, &address, sizeof(void*)) != B_OK)) {
+		if (area >= 0)
+			vm_delete_area(team_get_current_team_id(), area, false);
+		return B_BAD_ADDRESS;
+	}
+
+	return syscall_restart_handle_timeout_post(bytesRead, timeout);
+}
+
+
+status_t
+_user_write_port_area_etc(port_id port, int32 messageCode, area_id area,
+	size_t size, uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	status_t status = write_port_area_etc(port, messageCode, area, size,
+		flags | PORT_FLAG_USE_USER_MEMCPY | B_CAN_INTERRUPT, timeout);
+
+	return syscall_restart_handle_timeout_post(status, timeout);
+}
+
+
 status_t
 _user_get_port_message_info_etc(port_id port, port_message_info *userInfo,
 	size_t infoSize, uint32 flags, bigtime_t timeout)
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2013, Paweł Dziepak, pdziepak@quarnos.org.
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	The batch mode aims for the throughput of long running, CPU bound jobs
+	rather than for latency. Threads get long quanta, stay on their core for
+	as long as their data is likely to be in its caches, and threads that
+	aren't real-time don't preempt other threads but wait for the end of their
+	quantum, unless an idle CPU is available.
+	Apart from that, it chooses cores like the low latency mode.
+*/
+
+
+#include "scheduler_common.h"
+#include "scheduler_cpu.h"
+#include "scheduler_modes.h"
+#include "scheduler_thread.h"
+
+
+using namespace Scheduler;
+
+
+const bigtime_t kCacheExpire = 500000;
+
+// moving a thread away from its caches has to be worth it
+const int kRebalanceLoadDifference = kLoadDifference * 2;
+
+
+static void
+switch_to_mode()
+{
+}
+
+
+static void
+set_cpu_enabled(int32 /* cpu */, bool /* enabled */)
+{
+}
+
+
+static bool
+has_cache_expired(const ThreadData* threadData)
+{
+	return low_latency_has_cache_expired(threadData, kCacheExpire);
+}
+
+
+static CoreEntry*
+rebalance(const ThreadData* threadData)
+{
+	return low_latency_rebalance(threadData, kRebalanceLoadDifference);
+}
+
+
+scheduler_mode_operations gSchedulerBatchMode = {
+	"batch",
+
+	4000,
+	2000,
+	{ 5, 10 },
+
+	100000,
+
+	true,
+
+	switch_to_mode,
+	set_cpu_enabled,
+	has_cache_expired,
+	low_latency_choose_core,
+	rebalance,
+	low_latency_rebalance_irqs,
+};
@@ -31,20 +31,28 @@ set_cpu_enabled(int32 /* cpu */, bool /* enabled */)
 }
 
 
-static bool
-has_cache_expired(const ThreadData* threadData)
+bool
+Scheduler::low_latency_has_cache_expired(const ThreadData* threadData,
+	bigtime_t cacheExpire)
 {
 	SCHEDULER_ENTER_FUNCTION();
 	if (threadData->WentSleepActive() == 0)
 		return false;
 	CoreEntry* core = threadData->Core();
 	bigtime_t activeTime = core->GetActiveTime();
-	return activeTime - threadData->WentSleepActive() > kCacheExpire;
+	return activeTime - threadData->WentSleepActive() > cacheExpire;
 }
 
 
-static CoreEntry*
-choose_core(const ThreadData* /* threadData */)
+static bool
+has_cache_expired(const ThreadData* threadData)
+{
+	return low_latency_has_cache_expired(threadData, kCacheExpire);
+}
+
+
+CoreEntry*
+Scheduler::low_latency_choose_core(const ThreadData* /* threadData */)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
@@ -72,8 +80,9 @@ choose_core(const ThreadData* /* threadData */)
 }
 
 
-static CoreEntry*
-rebalance(const ThreadData* threadData)
+CoreEntry*
+Scheduler::low_latency_rebalance(const ThreadData* threadData,
+	int32 loadDifference)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
@@ -92,12 +101,12 @@ rebalance(const ThreadData* threadData)
 	// the current one.
 	int32 coreLoad = core->GetLoad();
 	int32 otherLoad = other->GetLoad();
-	if (other == core || otherLoad + kLoadDifference >= coreLoad)
+	if (other == core || otherLoad + loadDifference >= coreLoad)
 		return core;
 
 	// Check whether migrating the current thread would result in both core
 	// loads become closer to the average.
-	int32 difference = coreLoad - otherLoad - kLoadDifference;
+	int32 difference = coreLoad - otherLoad - loadDifference;
 	ASSERT(difference > 0);
 
 	int32 threadLoad = threadData->GetLoad() / core->CPUCount();
@@ -105,8 +114,15 @@ rebalance(const ThreadData* threadData)
 }
 
 
-static void
-rebalance_irqs(bool idle)
+static CoreEntry*
+rebalance(const ThreadData* threadData)
+{
+	return low_latency_rebalance(threadData, kLoadDifference);
+}
+
+
+void
+Scheduler::low_latency_rebalance_irqs(bool idle)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
@@ -161,11 +177,13 @@ scheduler_mode_operations gSchedulerLowLatencyMode = {
 
 	5000,
 
+	false,
+
 	switch_to_mode,
 	set_cpu_enabled,
 	has_cache_expired,
-	choose_core,
+	low_latency_choose_core,
 	rebalance,
-	rebalance_irqs,
+	low_latency_rebalance_irqs,
 };
 
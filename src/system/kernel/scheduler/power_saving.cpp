@@ -245,6 +245,8 @@ scheduler_mode_operations gSchedulerPowerSavingMode = {
 
 	20000,
 
+	false,
+
 	switch_to_mode,
 	set_cpu_enabled,
 	has_cache_expired,
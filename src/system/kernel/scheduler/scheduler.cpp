@@ -66,6 +66,7 @@ spinlock gSchedulerListenersLock = B_SPINLOCK_INITIALIZER;
 static scheduler_mode_operations* sSchedulerModes[] = {
 	&gSchedulerLowLatencyMode,
 	&gSchedulerPowerSavingMode,
+	&gSchedulerBatchMode,
 };
 
 // Since CPU IDs used internally by the kernel bear no relation to the actual
@@ -127,7 +128,7 @@ enqueue(Thread* thread, bool newOne)
 		thread);
 
 	int32 heapPriority = CPUPriorityHeap::GetKey(targetCPU);
-	if (threadPriority > heapPriority
+	if ((threadPriority > heapPriority && threadData->CanPreempt(heapPriority))
 		|| (threadPriority == heapPriority && rescheduleNeeded)) {
 
 		if (targetCPU->ID() == smp_get_current_cpu())
@@ -387,6 +388,11 @@ reschedule(int32 nextState)
 		} else
 			nextThreadData = oldThreadData;
 	} else {
+		// rather than going idle, try to take over a thread that waits for
+		// another core
+		if (!gSingleCore && (!enqueueOldThread || oldThreadData->IsIdle()))
+			cpu->StealThread();
+
 		nextThreadData
 			= cpu->ChooseNextThread(enqueueOldThread ? oldThreadData : NULL,
 				putOldThreadAtBack);
@@ -518,7 +524,8 @@ status_t
 scheduler_set_operation_mode(scheduler_mode mode)
 {
 	if (mode != SCHEDULER_MODE_LOW_LATENCY
-		&& mode != SCHEDULER_MODE_POWER_SAVING) {
+		&& mode != SCHEDULER_MODE_POWER_SAVING
+		&& mode != SCHEDULER_MODE_BATCH) {
 		return B_BAD_VALUE;
 	}
 
@@ -714,6 +721,7 @@ scheduler_init()
 #ifdef SCHEDULER_PROFILING
 	Profiling::Profiler::Initialize();
 #endif
+	Profiling::init_event_counters();
 
 	status_t result = init();
 	if (result != B_OK)
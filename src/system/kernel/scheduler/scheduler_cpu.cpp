@@ -255,6 +255,41 @@ CPUEntry::ChooseNextThread(ThreadData* oldThread, bool putAtBack)
 }
 
 
+/*!	Called when this CPU is about to run its idle thread. Looks for a thread
+	that waits in the run queue of a busy core and moves it to the run queue of
+	this core, where ChooseNextThread() will find it. Cores in the same package
+	share their caches with this one and are tried first; threads are taken
+	from another package only if their cache has expired anyway.
+	\return \c true, if a thread has been moved to this core.
+*/
+bool
+CPUEntry::StealThread()
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	ASSERT(!gSingleCore);
+
+	if (fCore->QueuedThreadCount() > 0)
+		return false;
+
+	CPURunQueueLocker cpuLocker(this);
+	ThreadData* pinnedThread = fRunQueue.PeekMaximum();
+	if (pinnedThread != NULL && !pinnedThread->IsIdle())
+		return false;
+	cpuLocker.Unlock();
+
+	CoreEntry* core = _ChooseStealCore(false);
+	if (core != NULL && _StealThreadFrom(core, false))
+		return true;
+
+	if (gPackageCount < 2)
+		return false;
+
+	core = _ChooseStealCore(true);
+	return core != NULL && _StealThreadFrom(core, true);
+}
+
+
 void
 CPUEntry::TrackActivity(ThreadData* oldThreadData, ThreadData* nextThreadData)
 {
@@ -345,6 +380,82 @@ CPUEntry::_RequestPerformanceLevel(ThreadData* threadData)
 }
 
 
+/*!	Returns the core with the most threads waiting in its run queue, that
+	doesn't have an idle CPU which will run them soon anyway. Only cores in
+	other packages are considered if \a remote is \c true, only cores in the
+	same package otherwise. The counts are read without locking, the caller
+	has to check the run queue again.
+*/
+CoreEntry*
+CPUEntry::_ChooseStealCore(bool remote) const
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* chosenCore = NULL;
+	int32 chosenThreadCount = 0;
+
+	for (int32 i = 0; i < gCoreCount; i++) {
+		CoreEntry* core = &gCoreEntries[i];
+		if (core == fCore || (core->Package() != fCore->Package()) != remote)
+			continue;
+		if (core->CPUCount() == 0 || core->IdleCPUCount() > 0)
+			continue;
+
+		int32 threadCount = core->QueuedThreadCount();
+		if (threadCount > chosenThreadCount) {
+			chosenCore = core;
+			chosenThreadCount = threadCount;
+		}
+	}
+
+	return chosenCore;
+}
+
+
+bool
+CPUEntry::_StealThreadFrom(CoreEntry* core, bool remote)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreRunQueueLocker coreLocker(core);
+
+	ThreadData* threadData = core->PeekThread();
+	if (threadData == NULL)
+		return false;
+
+	// a thread that still has its data in the caches of another package is
+	// better off waiting there
+	if (remote && !threadData->HasCacheExpired())
+		return false;
+
+	// The thread lock is usually acquired before the run queue lock, so we
+	// must not wait for it here.
+	Thread* thread = threadData->GetThread();
+	if (!try_acquire_spinlock(&thread->scheduler_lock))
+		return false;
+
+	ASSERT(thread->pinned_to_cpu == 0);
+	core->Remove(threadData);
+	coreLocker.Unlock();
+
+	CoreEntry* targetCore = fCore;
+	CPUEntry* targetCPU = this;
+	threadData->ChooseCoreAndCPU(targetCore, targetCPU);
+	threadData->PutBack();
+
+	release_spinlock(&thread->scheduler_lock);
+
+	if (remote)
+		SCHEDULER_COUNT_EVENT(kEventRemoteSteal);
+	else
+		SCHEDULER_COUNT_EVENT(kEventSteal);
+
+	TRACE("CPU %" B_PRId32 " stole thread %" B_PRId32 " from core %" B_PRId32
+		"\n", fCPUNumber, thread->id, core->ID());
+	return true;
+}
+
+
 /* static */ int32
 CPUEntry::_RescheduleEvent(timer* /* unused */)
 {
@@ -357,8 +468,18 @@ CPUEntry::_RescheduleEvent(timer* /* unused */)
 /* static */ int32
 CPUEntry::_UpdateLoadEvent(timer* /* unused */)
 {
-	CoreEntry::GetCore(smp_get_current_cpu())->ChangeLoad(0);
-	CPUEntry::GetCPU(smp_get_current_cpu())->fUpdateLoadEvent = false;
+	CPUEntry* cpu = CPUEntry::GetCPU(smp_get_current_cpu());
+	cpu->Core()->ChangeLoad(0);
+	cpu->fUpdateLoadEvent = false;
+
+	// Threads may have been queued on busy cores since this CPU went idle.
+	// Entering the scheduler gives it a chance to steal one of them, and
+	// restarts this timer.
+	if (!gSingleCore && (cpu->_ChooseStealCore(false) != NULL
+			|| (gPackageCount > 1 && cpu->_ChooseStealCore(true) != NULL))) {
+		get_cpu_struct()->invoke_scheduler = true;
+		get_cpu_struct()->preempted = true;
+	}
 	return B_HANDLED_INTERRUPT;
 }
 
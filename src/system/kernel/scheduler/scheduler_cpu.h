@@ -78,6 +78,7 @@ public:
 
 						ThreadData*		ChooseNextThread(ThreadData* oldThread,
 											bool putAtBack);
+						bool			StealThread();
 
 						void			TrackActivity(ThreadData* oldThreadData,
 											ThreadData* nextThreadData);
@@ -91,6 +92,10 @@ private:
 						void			_RequestPerformanceLevel(
 											ThreadData* threadData);
 
+						CoreEntry*		_ChooseStealCore(bool remote) const;
+						bool			_StealThreadFrom(CoreEntry* core,
+											bool remote);
+
 	static				int32			_RescheduleEvent(timer* /* unused */);
 	static				int32			_UpdateLoadEvent(timer* /* unused */);
 
@@ -138,6 +143,10 @@ public:
 	inline				CPUPriorityHeap*	CPUHeap();
 
 	inline				int32			ThreadCount() const;
+	inline				int32			QueuedThreadCount() const
+											{ return fThreadCount; }
+	inline				int32			IdleCPUCount() const
+											{ return fIdleCPUCount; }
 
 	inline				void			LockRunQueue();
 	inline				void			UnlockRunQueue();
@@ -19,6 +19,9 @@ struct scheduler_mode_operations {
 
 	bigtime_t				maximum_latency;
 
+	// whether threads that aren't real-time may only preempt idle CPUs
+	bool					minimal_preemption;
+
 	void					(*switch_to_mode)();
 	void					(*set_cpu_enabled)(int32 cpu, bool enabled);
 	bool					(*has_cache_expired)(
@@ -32,6 +35,7 @@ struct scheduler_mode_operations {
 
 extern struct scheduler_mode_operations gSchedulerLowLatencyMode;
 extern struct scheduler_mode_operations gSchedulerPowerSavingMode;
+extern struct scheduler_mode_operations gSchedulerBatchMode;
 
 
 namespace Scheduler {
@@ -40,6 +44,14 @@ namespace Scheduler {
 extern scheduler_mode gCurrentModeID;
 extern scheduler_mode_operations* gCurrentMode;
 
+// The low latency mode's policies, shared with the batch mode
+bool low_latency_has_cache_expired(const ThreadData* threadData,
+	bigtime_t cacheExpire);
+CoreEntry* low_latency_choose_core(const ThreadData* threadData);
+CoreEntry* low_latency_rebalance(const ThreadData* threadData,
+	int32 loadDifference);
+void low_latency_rebalance_irqs(bool idle);
+
 
 }
 
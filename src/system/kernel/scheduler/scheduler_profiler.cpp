@@ -11,6 +11,72 @@
 #include <algorithm>
 
 
+Scheduler::Profiling::EventCounters
+	Scheduler::Profiling::gEventCounters[SMP_MAX_CPUS];
+
+
+static const char* const kEventNames[] = {
+	"steals",
+	"remote-steals",
+	"migrations",
+};
+
+
+static int
+dump_events(int argc, char** argv)
+{
+	using namespace Scheduler::Profiling;
+
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "reset") != 0)) {
+		print_debugger_command_usage(argv[0]);
+		return 0;
+	}
+
+	int32 cpuCount = smp_get_num_cpus();
+
+	if (argc == 2) {
+		memset(gEventCounters, 0, sizeof(EventCounters) * cpuCount);
+		return 0;
+	}
+
+	uint64 total[kEventCount];
+	memset(total, 0, sizeof(total));
+
+	kprintf("cpu");
+	for (int32 i = 0; i < kEventCount; i++)
+		kprintf(" %14s", kEventNames[i]);
+	kprintf("\n");
+
+	for (int32 cpu = 0; cpu < cpuCount; cpu++) {
+		kprintf("%3" B_PRId32, cpu);
+		for (int32 i = 0; i < kEventCount; i++) {
+			kprintf(" %14" B_PRIu64, gEventCounters[cpu].fCount[i]);
+			total[i] += gEventCounters[cpu].fCount[i];
+		}
+		kprintf("\n");
+	}
+
+	kprintf("all");
+	for (int32 i = 0; i < kEventCount; i++)
+		kprintf(" %14" B_PRIu64, total[i]);
+	kprintf("\n");
+
+	return 0;
+}
+
+
+void
+Scheduler::Profiling::init_event_counters()
+{
+	add_debugger_command_etc("scheduler_events", &dump_events,
+		"Show the scheduler event counters",
+		"[ \"reset\" ]\n"
+		"Shows how many threads each CPU has stolen from the run queues of\n"
+		"other cores, and how many threads it has moved to another core.\n"
+		"  reset     - Resets all counters to zero.\n", 0);
+}
+
+
 #ifdef SCHEDULER_PROFILING
 
 
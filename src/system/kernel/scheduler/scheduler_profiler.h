@@ -6,9 +6,50 @@
 #define KERNEL_SCHEDULER_PROFILER_H
 
 
+#include <cpu.h>
 #include <smp.h>
 
 
+namespace Scheduler {
+
+namespace Profiling {
+
+// Scheduler events that are counted. Unlike the function profiler below the
+// counters are always available, since they are cheap to maintain: each CPU
+// only updates its own counters, and does so with interrupts disabled.
+enum Event {
+	kEventSteal = 0,		// thread stolen from a core in the same package
+	kEventRemoteSteal,		// thread stolen from a core in another package
+	kEventMigration,		// thread assigned to a different core
+	kEventCount
+};
+
+struct EventCounters {
+			uint64			fCount[kEventCount];
+} CACHE_LINE_ALIGN;
+
+extern EventCounters gEventCounters[SMP_MAX_CPUS];
+
+
+void init_event_counters();
+
+
+inline void
+count_event(Event event)
+{
+	gEventCounters[smp_get_current_cpu()].fCount[event]++;
+}
+
+
+}	// namespace Profiling
+
+}	// namespace Scheduler
+
+
+#define SCHEDULER_COUNT_EVENT(event)	\
+	Scheduler::Profiling::count_event(Scheduler::Profiling::event)
+
+
 //#define SCHEDULER_PROFILING
 #ifdef SCHEDULER_PROFILING
 
@@ -60,7 +60,8 @@ ThreadData::_ChooseCPU(CoreEntry* core, bool& rescheduleNeeded) const
 			= CPUEntry::GetCPU(fThread->previous_cpu->cpu_num);
 		if (previousCPU->Core() == core && !fThread->previous_cpu->disabled) {
 			CoreCPUHeapLocker _(core);
-			if (CPUPriorityHeap::GetKey(previousCPU) < threadPriority) {
+			int32 priority = CPUPriorityHeap::GetKey(previousCPU);
+			if (priority < threadPriority && CanPreempt(priority)) {
 				previousCPU->UpdatePriority(threadPriority);
 				rescheduleNeeded = true;
 				return previousCPU;
@@ -72,7 +73,8 @@ ThreadData::_ChooseCPU(CoreEntry* core, bool& rescheduleNeeded) const
 	CPUEntry* cpu = core->CPUHeap()->PeekRoot();
 	ASSERT(cpu != NULL);
 
-	if (CPUPriorityHeap::GetKey(cpu) < threadPriority) {
+	int32 priority = CPUPriorityHeap::GetKey(cpu);
+	if (priority < threadPriority && CanPreempt(priority)) {
 		cpu->UpdatePriority(threadPriority);
 		rescheduleNeeded = true;
 	} else
@@ -165,6 +167,9 @@ ThreadData::ChooseCoreAndCPU(CoreEntry*& targetCore, CPUEntry*& targetCPU)
 	ASSERT(targetCPU != NULL);
 
 	if (fCore != targetCore) {
+		if (fCore != NULL)
+			SCHEDULER_COUNT_EVENT(kEventMigration);
+
 		fLoadMeasurementEpoch = targetCore->LoadMeasurementEpoch() - 1;
 		if (fReady) {
 			if (fCore != NULL)
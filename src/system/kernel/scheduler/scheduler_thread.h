@@ -44,6 +44,7 @@ public:
 	inline	bool		IsIdle() const;
 
 	inline	bool		HasCacheExpired() const;
+	inline	bool		CanPreempt(int32 priority) const;
 	inline	CoreEntry*	Rebalance() const;
 
 	inline	int32		GetEffectivePriority() const;
@@ -176,6 +177,18 @@ ThreadData::HasCacheExpired() const
 }
 
 
+/*!	Returns whether the thread may preempt a CPU that currently runs a thread
+	with the given \a priority, provided its own priority is higher.
+*/
+inline bool
+ThreadData::CanPreempt(int32 priority) const
+{
+	SCHEDULER_ENTER_FUNCTION();
+	return !gCurrentMode->minimal_preemption || priority == B_IDLE_PRIORITY
+		|| IsRealTime();
+}
+
+
 inline CoreEntry*
 ThreadData::Rebalance() const
 {
@@ -1341,6 +1341,25 @@ smp_send_broadcast_ici_interrupts_disabled(int32 currentCPU, int32 message,
 }
 
 
+static void
+quiescent_cpu(void* /*cookie*/, int /*cpu*/)
+{
+}
+
+
+/*!	Returns when every CPU has had interrupts enabled at least once since
+	the call. Code that runs with interrupts disabled can therefore look at
+	data without locking, if the writers unlink it first, and call this
+	function before they free it.
+	Must be called with interrupts enabled.
+*/
+void
+smp_wait_for_quiescent_cpus()
+{
+	call_all_cpus_sync(&quiescent_cpu, NULL);
+}
+
+
 /*!	Spin on non-boot CPUs until smp_wake_up_non_boot_cpus() has been called.
 
 	\param cpu The index of the calling CPU.
@@ -23,8 +23,10 @@
 #include <debug.h>
 #include <disk_device_manager/ddm_userland_interface.h>
 #include <elf.h>
+#include <event_queue.h>
 #include <frame_buffer_console.h>
 #include <fs/fd.h>
+#include <fs/io_ring.h>
 #include <fs/node_monitor.h>
 #include <generic_syscall.h>
 #include <int.h>
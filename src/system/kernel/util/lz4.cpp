@@ -0,0 +1,255 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A compressor and decompressor for the LZ4 block format.
+
+	A block is a sequence of tokens. Each token byte holds the number of
+	literals that follow it in its upper, and the length of the following
+	match minus 4 in its lower four bits; a value of 15 means that more
+	length bytes follow, which are added up until one is not 255. The
+	literals are followed by the match offset as a little endian 16 bit
+	value. The last token only has literals, and no match may start within
+	the last 12, or reach into the last 5 bytes of the data.
+*/
+
+
+#include <util/lz4.h>
+
+#include <string.h>
+
+
+#define MIN_MATCH		4
+#define HASH_BITS		12
+#define LAST_LITERALS	5
+#define MATCH_LIMIT		12
+#define MAX_OFFSET		65535
+
+
+static inline uint32
+read32(const uint8* data)
+{
+	uint32 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+static inline uint32
+hash_sequence(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+
+static inline uint8*
+write_length(uint8* out, size_t length)
+{
+	while (length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (uint8)length;
+	return out;
+}
+
+
+/*!	Returns the number of bytes a token with \a literals literals and a match
+	of \a matchLength - MIN_MATCH bytes needs at most.
+*/
+static inline size_t
+sequence_size(size_t literals, size_t matchLength)
+{
+	return 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1;
+}
+
+
+/*!	Compresses \a sourceSize bytes from \a source into \a dest.
+	\a workspace must point to LZ4_WORKSPACE_SIZE bytes of scratch memory.
+	\return The size of the compressed data, or \c 0, if it doesn't fit into
+		\a destCapacity bytes.
+*/
+size_t
+lz4_compress(const void* _source, size_t sourceSize, void* _dest,
+	size_t destCapacity, void* workspace)
+{
+	if (sourceSize > LZ4_MAX_INPUT_SIZE)
+		return 0;
+
+	const uint8* source = (const uint8*)_source;
+	const uint8* sourceEnd = source + sourceSize;
+	uint8* dest = (uint8*)_dest;
+	uint8* out = dest;
+	uint8* outEnd = dest + destCapacity;
+
+	uint16* table = (uint16*)workspace;
+	memset(table, 0, LZ4_WORKSPACE_SIZE);
+
+	const uint8* anchor = source;
+
+	if (sourceSize > MATCH_LIMIT) {
+		const uint8* in = source + 1;
+		const uint8* matchLimit = sourceEnd - MATCH_LIMIT;
+		const uint8* matchEnd = sourceEnd - LAST_LITERALS;
+
+		while (in < matchLimit) {
+			uint32 sequence = read32(in);
+			uint32 hash = hash_sequence(sequence);
+			const uint8* match = source + table[hash];
+			table[hash] = (uint16)(in - source);
+
+			if (match >= in || in - match > MAX_OFFSET
+				|| read32(match) != sequence) {
+				in++;
+				continue;
+			}
+
+			// extend the match backwards and forwards
+			while (in > anchor && match > source && in[-1] == match[-1]) {
+				in--;
+				match--;
+			}
+
+			const uint8* end = in + MIN_MATCH;
+			const uint8* reference = match + MIN_MATCH;
+			while (end < matchEnd && *end == *reference) {
+				end++;
+				reference++;
+			}
+
+			size_t literals = in - anchor;
+			size_t matchLength = end - in - MIN_MATCH;
+			if (sequence_size(literals, matchLength)
+					> (size_t)(outEnd - out)) {
+				return 0;
+			}
+
+			uint8* token = out++;
+			if (literals >= 15) {
+				*token = 15 << 4;
+				out = write_length(out, literals - 15);
+			} else
+				*token = literals << 4;
+
+			memcpy(out, anchor, literals);
+			out += literals;
+
+			uint16 offset = in - match;
+			*out++ = offset & 0xff;
+			*out++ = offset >> 8;
+
+			if (matchLength >= 15) {
+				*token |= 15;
+				out = write_length(out, matchLength - 15);
+			} else
+				*token |= matchLength;
+
+			in = anchor = end;
+		}
+	}
+
+	// the remaining bytes are written as literals
+	size_t literals = sourceEnd - anchor;
+	if (sequence_size(literals, 0) > (size_t)(outEnd - out))
+		return 0;
+
+	uint8* token = out++;
+	if (literals >= 15) {
+		*token = 15 << 4;
+		out = write_length(out, literals - 15);
+	} else
+		*token = literals << 4;
+
+	memcpy(out, anchor, literals);
+	out += literals;
+
+	return out - dest;
+}
+
+
+/*!	Decompresses \a sourceSize bytes of LZ4 compressed data from \a source
+	into \a dest.
+	\return The size of the decompressed data, or \c B_BAD_DATA, if the data
+		is corrupt or doesn't fit into \a destSize bytes.
+*/
+ssize_t
+lz4_decompress(const void* _source, size_t sourceSize, void* _dest,
+	size_t destSize)
+{
+	const uint8* in = (const uint8*)_source;
+	const uint8* inEnd = in + sourceSize;
+	uint8* dest = (uint8*)_dest;
+	uint8* out = dest;
+	uint8* outEnd = dest + destSize;
+
+	while (in < inEnd) {
+		uint8 token = *in++;
+
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			uint8 value;
+			do {
+				if (in >= inEnd)
+					return B_BAD_DATA;
+				value = *in++;
+				literals += value;
+			} while (value == 255);
+		}
+
+		if (literals > (size_t)(inEnd - in)
+			|| literals > (size_t)(outEnd - out)) {
+			return B_BAD_DATA;
+		}
+
+		memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+
+		// the last token doesn't have a match
+		if (in == inEnd)
+			break;
+
+		if (inEnd - in < 2)
+			return B_BAD_DATA;
+
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - dest))
+			return B_BAD_DATA;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15) {
+			uint8 value;
+			do {
+				if (in >= inEnd)
+					return B_BAD_DATA;
+				value = *in++;
+				matchLength += value;
+			} while (value == 255);
+		}
+		matchLength += MIN_MATCH;
+
+		if (matchLength > (size_t)(outEnd - out))
+			return B_BAD_DATA;
+
+		const uint8* match = out - offset;
+		if (offset >= matchLength) {
+			memcpy(out, match, matchLength);
+			out += matchLength;
+		} else {
+			// The match overlaps the data it produces, so it repeats every
+			// offset bytes -- copy it in growing pieces that don't overlap.
+			uint8* end = out + matchLength;
+			while (out < end) {
+				size_t chunk = min_c((size_t)(out - match),
+					(size_t)(end - out));
+				memcpy(out, match, chunk);
+				out += chunk;
+			}
+		}
+	}
+
+	return out - dest;
+}
@@ -55,6 +55,7 @@
 #include <vm/vm_priv.h>
 #include <vm/VMAddressSpace.h>
 
+#include "compressed_swap.h"
 #include "IORequest.h"
 
 
@@ -74,7 +75,11 @@
 // interval the has resizer is triggered (in 0.1s)
 #define SWAP_HASH_RESIZE_INTERVAL	5
 
-#define INITIAL_SWAP_HASH_SIZE		1024
+#define INITIAL_SWAP_HASH_SIZE		64
+
+// number of independently locked parts of the swap hash table
+#define SWAP_HASH_SHARD_SHIFT		4
+#define SWAP_HASH_SHARD_COUNT		(1 << SWAP_HASH_SHARD_SHIFT)
 
 #define SWAP_SLOT_NONE	RADIX_SLOT_NONE
 
@@ -82,6 +87,9 @@
 #define SWAP_BLOCK_SHIFT 5		/* 1 << SWAP_BLOCK_SHIFT == SWAP_BLOCK_PAGES */
 #define SWAP_BLOCK_MASK  (SWAP_BLOCK_PAGES - 1)
 
+// maximum number of swapped out pages read in with a faulting page
+#define SWAP_READ_AHEAD_PAGES	16
+
 
 static const char* const kDefaultSwapPath = "/var/swap";
 
@@ -142,8 +150,15 @@ struct SwapHashTableDefinition {
 typedef BOpenHashTable<SwapHashTableDefinition> SwapHashTable;
 typedef DoublyLinkedList<swap_file> SwapFileList;
 
-static SwapHashTable sSwapHashTable;
-static rw_lock sSwapHashLock;
+// The swap blocks are spread over several hash tables with their own locks,
+// so that paging in and out of different caches doesn't contend for a single
+// lock.
+struct swap_hash_shard {
+	rw_lock			lock;
+	SwapHashTable	table;
+};
+
+static swap_hash_shard sSwapHashShards[SWAP_HASH_SHARD_COUNT];
 
 static SwapFileList sSwapFileList;
 static mutex sSwapFileListLock;
@@ -156,6 +171,22 @@ static mutex sAvailSwapSpaceLock;
 static object_cache* sSwapBlockCache;
 
 
+/*!	Returns the shard the swap block containing the page at \a pageIndex of
+	\a cache belongs to.
+*/
+static inline swap_hash_shard&
+swap_hash_shard_for(VMAnonymousCache* cache, off_t pageIndex)
+{
+	swap_hash_key key = { cache, pageIndex };
+	uint32 hash = (uint32)SwapHashTableDefinition().HashKey(key);
+
+	// Use the upper bits of a multiplicative hash, so that the blocks of each
+	// shard are still spread evenly over its table.
+	return sSwapHashShards[
+		(hash * 2654435761U) >> (32 - SWAP_HASH_SHARD_SHIFT)];
+}
+
+
 #if SWAP_TRACING
 namespace SwapTracing {
 
@@ -254,6 +285,13 @@ dump_swap_info(int argc, char** argv)
 	kprintf("used:      %9" B_PRIu32 "\n", totalSwapPages - freeSwapPages);
 	kprintf("free:      %9" B_PRIu32 "\n", freeSwapPages);
 
+	compressed_swap_info info;
+	compressed_swap_get_info_unlocked(&info);
+	if (info.enabled) {
+		kprintf("compressed:%9" B_PRIu64 " (%" B_PRIu64 " KB)\n",
+			info.stored_pages, info.pool_size / 1024);
+	}
+
 	return 0;
 }
 
@@ -293,7 +331,10 @@ swap_slot_alloc(uint32 count)
 
 	if (j == sSwapFileCount) {
 		mutex_unlock(&sSwapFileListLock);
-		panic("swap_slot_alloc: swap space exhausted!\n");
+		// If there is no run of that many free slots left, the caller can
+		// still try to allocate fewer.
+		if (count == 1)
+			panic("swap_slot_alloc: swap space exhausted!\n");
 		return SWAP_SLOT_NONE;
 	}
 
@@ -333,6 +374,8 @@ swap_slot_dealloc(swap_addr_t slotIndex, uint32 count)
 	if (slotIndex == SWAP_SLOT_NONE)
 		return;
 
+	compressed_swap_free(slotIndex, count);
+
 	mutex_lock(&sSwapFileListLock);
 	swap_file* swapFile = find_swap_file(slotIndex);
 	slotIndex -= swapFile->first_slot;
@@ -341,6 +384,37 @@ swap_slot_dealloc(swap_addr_t slotIndex, uint32 count)
 }
 
 
+/*!	Stores the \a pageCount physical pages described by \a vecs in the
+	compressed swap pool, under the slots starting at \a slotIndex. Either
+	all pages are stored, or none; in the latter case, the pool doesn't hold
+	any stale copies for these slots anymore either.
+*/
+static bool
+swap_store_compressed(swap_addr_t slotIndex, const generic_io_vec* vecs,
+	size_t count, uint32 pageCount)
+{
+	uint32 stored = 0;
+	bool failed = !compressed_swap_enabled();
+	for (size_t i = 0; i < count && !failed; i++) {
+		for (generic_size_t offset = 0; offset < vecs[i].length;
+				offset += B_PAGE_SIZE) {
+			if (stored == pageCount || !compressed_swap_store(
+					slotIndex + stored, vecs[i].base + offset)) {
+				failed = true;
+				break;
+			}
+			stored++;
+		}
+	}
+
+	if (!failed && stored == pageCount)
+		return true;
+
+	compressed_swap_free(slotIndex, pageCount);
+	return false;
+}
+
+
 static off_t
 swap_space_reserve(off_t amount)
 {
@@ -367,15 +441,15 @@ swap_space_unreserve(off_t amount)
 
 
 static void
-swap_hash_resizer(void*, int)
+swap_hash_shard_resize(swap_hash_shard& shard)
 {
-	WriteLocker locker(sSwapHashLock);
+	WriteLocker locker(shard.lock);
 
 	size_t size;
 	void* allocation;
 
 	do {
-		size = sSwapHashTable.ResizeNeeded();
+		size = shard.table.ResizeNeeded();
 		if (size == 0)
 			return;
 
@@ -387,7 +461,15 @@ swap_hash_resizer(void*, int)
 
 		locker.Lock();
 
-	} while (!sSwapHashTable.Resize(allocation, size));
+	} while (!shard.table.Resize(allocation, size));
+}
+
+
+static void
+swap_hash_resizer(void*, int)
+{
+	for (uint32 i = 0; i < SWAP_HASH_SHARD_COUNT; i++)
+		swap_hash_shard_resize(sSwapHashShards[i]);
 }
 
 
@@ -403,10 +485,12 @@ public:
 	{
 	}
 
-	void SetTo(page_num_t pageIndex, swap_addr_t slotIndex, bool newSlot)
+	void SetTo(page_num_t pageIndex, swap_addr_t slotIndex, uint32 pageCount,
+		bool newSlot)
 	{
 		fPageIndex = pageIndex;
 		fSlotIndex = slotIndex;
+		fPageCount = pageCount;
 		fNewSlot = newSlot;
 	}
 
@@ -415,13 +499,13 @@ public:
 	{
 		if (fNewSlot) {
 			if (status == B_OK) {
-				fCache->_SwapBlockBuild(fPageIndex, fSlotIndex, 1);
+				fCache->_SwapBlockBuild(fPageIndex, fSlotIndex, fPageCount);
 			} else {
 				AutoLocker<VMCache> locker(fCache);
-				fCache->fAllocatedSwapSize -= B_PAGE_SIZE;
+				fCache->fAllocatedSwapSize -= (off_t)fPageCount * B_PAGE_SIZE;
 				locker.Unlock();
 
-				swap_slot_dealloc(fSlotIndex, 1);
+				swap_slot_dealloc(fSlotIndex, fPageCount);
 			}
 		}
 
@@ -434,6 +518,7 @@ private:
 	VMAnonymousCache*	fCache;
 	page_num_t			fPageIndex;
 	swap_addr_t			fSlotIndex;
+	uint32				fPageCount;
 	bool				fNewSlot;
 };
 
@@ -496,13 +581,14 @@ VMAnonymousCache::Resize(off_t newSize, int priority)
 		for (off_t pageIndex = (newSize + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
 			pageIndex < oldPageCount && fAllocatedSwapSize > 0; pageIndex++) {
 
-			WriteLocker locker(sSwapHashLock);
+			swap_hash_shard& shard = swap_hash_shard_for(this, pageIndex);
+			WriteLocker locker(shard.lock);
 
 			// Get the swap slot index for the page.
 			swap_addr_t blockIndex = pageIndex & SWAP_BLOCK_MASK;
 			if (swapBlock == NULL || blockIndex == 0) {
 				swap_hash_key key = { this, pageIndex };
-				swapBlock = sSwapHashTable.Lookup(key);
+				swapBlock = shard.table.Lookup(key);
 
 				if (swapBlock == NULL) {
 					pageIndex = ROUNDUP(pageIndex + 1, SWAP_BLOCK_PAGES);
@@ -531,10 +617,11 @@ VMAnonymousCache::Resize(off_t newSize, int priority)
 				if (--swapBlock->used == 0) {
 					// All swap pages have been freed -- we can discard the swap
 					// block.
-					sSwapHashTable.RemoveUnchecked(swapBlock);
+					shard.table.RemoveUnchecked(swapBlock);
 					object_cache_free(sSwapBlockCache, swapBlock,
 						CACHE_DONT_WAIT_FOR_MEMORY
 							| CACHE_DONT_LOCK_KERNEL_SPACE);
+					swapBlock = NULL;
 				}
 			}
 		}
@@ -576,12 +663,58 @@ VMAnonymousCache::HasPage(off_t offset)
 }
 
 
+void
+VMAnonymousCache::GetReadAheadRange(off_t offset, off_t& _start, off_t& _end)
+{
+	_start = offset;
+	_end = offset + B_PAGE_SIZE;
+
+	off_t pageIndex = offset >> PAGE_SHIFT;
+	swap_hash_shard& shard = swap_hash_shard_for(this, pageIndex);
+	ReadLocker locker(shard.lock);
+
+	swap_hash_key key = { this, pageIndex };
+	swap_block* swap = shard.table.Lookup(key);
+	if (swap == NULL)
+		return;
+
+	uint32 blockIndex = pageIndex & SWAP_BLOCK_MASK;
+	swap_addr_t slotIndex = swap->swap_slots[blockIndex];
+	if (slotIndex == SWAP_SLOT_NONE)
+		return;
+
+	// Extend the range to the neighbours in the same swap block whose swap
+	// slots continue the page's one, so that they can all be read with a
+	// single request. Since pages are swapped out in clusters, this is the
+	// case for most pages that were swapped out together.
+	uint32 first = blockIndex;
+	uint32 last = blockIndex;
+	while (last - first + 1 < SWAP_READ_AHEAD_PAGES) {
+		if (last + 1 < SWAP_BLOCK_PAGES
+			&& swap->swap_slots[last + 1] != SWAP_SLOT_NONE
+			&& swap->swap_slots[last + 1]
+				== slotIndex + (last + 1 - blockIndex)) {
+			last++;
+		} else if (first > 0
+			&& swap->swap_slots[first - 1] != SWAP_SLOT_NONE
+			&& swap->swap_slots[first - 1] + (blockIndex - first + 1)
+				== slotIndex) {
+			first--;
+		} else
+			break;
+	}
+
+	_start = (off_t)(pageIndex - blockIndex + first) << PAGE_SHIFT;
+	_end = (off_t)(pageIndex - blockIndex + last + 1) << PAGE_SHIFT;
+}
+
+
 bool
 VMAnonymousCache::DebugHasPage(off_t offset)
 {
 	off_t pageIndex = offset >> PAGE_SHIFT;
 	swap_hash_key key = { this, pageIndex };
-	swap_block* swap = sSwapHashTable.Lookup(key);
+	swap_block* swap = swap_hash_shard_for(this, pageIndex).table.Lookup(key);
 	if (swap == NULL)
 		return false;
 
@@ -594,13 +727,35 @@ VMAnonymousCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 	uint32 flags, generic_size_t* _numBytes)
 {
 	off_t pageIndex = offset >> PAGE_SHIFT;
+	bool physical = (flags & B_PHYSICAL_IO_REQUEST) != 0;
+	generic_size_t totalBytes = 0;
 
 	for (uint32 i = 0, j = 0; i < count; i = j) {
 		swap_addr_t startSlotIndex = _SwapBlockGetAddress(pageIndex + i);
+
+		// pages from the compressed swap pool don't need any I/O
+		if (physical) {
+			status_t status = compressed_swap_load(startSlotIndex,
+				vecs[i].base);
+			if (status == B_OK) {
+				totalBytes += vecs[i].length;
+				j = i + 1;
+				continue;
+			}
+			if (status != B_ENTRY_NOT_FOUND) {
+				*_numBytes = totalBytes;
+				return status;
+			}
+		}
+
+		generic_size_t length = vecs[i].length;
 		for (j = i + 1; j < count; j++) {
 			swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + j);
-			if (slotIndex != startSlotIndex + j - i)
+			if (slotIndex != startSlotIndex + j - i
+				|| (physical && compressed_swap_contains(slotIndex))) {
 				break;
+			}
+			length += vecs[j].length;
 		}
 
 		T(ReadPage(this, pageIndex, startSlotIndex));
@@ -611,12 +766,18 @@ VMAnonymousCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 		off_t pos = (off_t)(startSlotIndex - swapFile->first_slot)
 			* B_PAGE_SIZE;
 
+		generic_size_t bytesRead = length;
 		status_t status = vfs_read_pages(swapFile->vnode, swapFile->cookie, pos,
-			vecs + i, j - i, flags, _numBytes);
-		if (status != B_OK)
+			vecs + i, j - i, flags, &bytesRead);
+		totalBytes += bytesRead;
+		if (status != B_OK || bytesRead < length) {
+			// don't continue after a gap
+			*_numBytes = totalBytes;
 			return status;
+		}
 	}
 
+	*_numBytes = totalBytes;
 	return B_OK;
 }
 
@@ -630,17 +791,10 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 	AutoLocker<VMCache> locker(this);
 
 	page_num_t totalPages = 0;
-	for (uint32 i = 0; i < count; i++) {
-		page_num_t pageCount = (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-		swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + totalPages);
-		if (slotIndex != SWAP_SLOT_NONE) {
-			swap_slot_dealloc(slotIndex, pageCount);
-			_SwapBlockFree(pageIndex + totalPages, pageCount);
-			fAllocatedSwapSize -= pageCount * B_PAGE_SIZE;
-		}
+	for (uint32 i = 0; i < count; i++)
+		totalPages += (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
 
-		totalPages += pageCount;
-	}
+	_FreeSwapSpace(pageIndex, totalPages);
 
 	off_t totalSize = totalPages * B_PAGE_SIZE;
 	if (fAllocatedSwapSize + totalSize > fCommittedSwapSize)
@@ -660,6 +814,8 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 		page_num_t n = pageCount;
 
 		for (page_num_t j = 0; j < pageCount; j += n) {
+			n = min_c(n, pageCount - j);
+
 			swap_addr_t slotIndex;
 			// try to allocate n slots, if fail, try to allocate n/2
 			while ((slotIndex = swap_slot_alloc(n)) == SWAP_SLOT_NONE && n >= 2)
@@ -668,7 +824,7 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 			if (slotIndex == SWAP_SLOT_NONE)
 				panic("VMAnonymousCache::Write(): can't allocate swap space\n");
 
-			T(WritePage(this, pageIndex, slotIndex));
+			T(WritePage(this, pageIndex + totalPages + j, slotIndex));
 				// TODO: Assumes that only one page is written.
 
 			swap_file* swapFile = find_swap_file(slotIndex);
@@ -691,7 +847,7 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 				return status;
 			}
 
-			_SwapBlockBuild(pageIndex + totalPages, slotIndex, n);
+			_SwapBlockBuild(pageIndex + totalPages + j, slotIndex, n);
 			pagesLeft -= n;
 
 			if (n != pageCount) {
@@ -713,27 +869,46 @@ VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
 	size_t count, generic_size_t numBytes, uint32 flags,
 	AsyncIOCallback* _callback)
 {
-	// TODO: Currently this method is only used for single pages. Either make
-	// more flexible use of it or change the interface!
-	// This implementation relies on the current usage!
-	ASSERT(count == 1);
-	ASSERT(numBytes <= B_PAGE_SIZE);
-
 	page_num_t pageIndex = offset >> PAGE_SHIFT;
+	uint32 pageCount = (numBytes + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	ASSERT(pageCount > 0 && pageCount <= SWAP_BLOCK_PAGES);
+
+	// If the pages already have contiguous swap space assigned, we just write
+	// them there again. Otherwise we allocate one contiguous run of slots for
+	// all of them, so that they can be written -- and later be read back --
+	// with a single request.
 	swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex);
 	bool newSlot = slotIndex == SWAP_SLOT_NONE;
+	for (uint32 i = 1; !newSlot && i < pageCount; i++) {
+		if (_SwapBlockGetAddress(pageIndex + i) != slotIndex + i)
+			newSlot = true;
+	}
+
+	off_t size = (off_t)pageCount * B_PAGE_SIZE;
 
-	// If the page doesn't have any swap space yet, allocate it.
 	if (newSlot) {
 		AutoLocker<VMCache> locker(this);
-		if (fAllocatedSwapSize + B_PAGE_SIZE > fCommittedSwapSize) {
+		_FreeSwapSpace(pageIndex, pageCount);
+
+		if (fAllocatedSwapSize + size > fCommittedSwapSize) {
 			_callback->IOFinished(B_ERROR, true, 0);
 			return B_ERROR;
 		}
 
-		fAllocatedSwapSize += B_PAGE_SIZE;
+		slotIndex = swap_slot_alloc(pageCount);
+		if (slotIndex == SWAP_SLOT_NONE) {
+			// The swap space is too fragmented -- let Write() split the
+			// pages up.
+			locker.Unlock();
+
+			generic_size_t bytesWritten = numBytes;
+			status_t status = Write(offset, vecs, count, flags, &bytesWritten);
+			_callback->IOFinished(status, status != B_OK,
+				status == B_OK ? numBytes : 0);
+			return status;
+		}
 
-		slotIndex = swap_slot_alloc(1);
+		fAllocatedSwapSize += size;
 	}
 
 	// create our callback
@@ -743,27 +918,34 @@ VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
 	if (callback == NULL) {
 		if (newSlot) {
 			AutoLocker<VMCache> locker(this);
-			fAllocatedSwapSize -= B_PAGE_SIZE;
+			fAllocatedSwapSize -= size;
 			locker.Unlock();
 
-			swap_slot_dealloc(slotIndex, 1);
+			swap_slot_dealloc(slotIndex, pageCount);
 		}
 		_callback->IOFinished(B_NO_MEMORY, true, 0);
 		return B_NO_MEMORY;
 	}
-	// TODO: If the page already had swap space assigned, we don't need an own
+	// TODO: If the pages already had swap space assigned, we don't need an own
 	// callback.
 
-	callback->SetTo(pageIndex, slotIndex, newSlot);
+	callback->SetTo(pageIndex, slotIndex, pageCount, newSlot);
 
 	T(WritePage(this, pageIndex, slotIndex));
 
-	// write the page asynchrounously
+	// If the compressed swap pool takes the pages, we're done already.
+	if ((flags & B_PHYSICAL_IO_REQUEST) != 0
+		&& swap_store_compressed(slotIndex, vecs, count, pageCount)) {
+		callback->IOFinished(B_OK, false, numBytes);
+		return B_OK;
+	}
+
+	// write the pages asynchrounously
 	swap_file* swapFile = find_swap_file(slotIndex);
 	off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
 
 	return vfs_asynchronous_write_pages(swapFile->vnode, swapFile->cookie, pos,
-		vecs, 1, numBytes, flags, callback);
+		vecs, count, numBytes, flags, callback);
 }
 
 
@@ -780,7 +962,9 @@ VMAnonymousCache::CanWritePage(off_t offset)
 int32
 VMAnonymousCache::MaxPagesPerAsyncWrite() const
 {
-	return 1;
+	// WriteAsync() allocates the swap space for all pages at once, which
+	// swap_slot_alloc() can only do for up to BITMAP_RADIX slots.
+	return SWAP_BLOCK_PAGES;
 }
 
 
@@ -876,16 +1060,17 @@ void
 VMAnonymousCache::_SwapBlockBuild(off_t startPageIndex,
 	swap_addr_t startSlotIndex, uint32 count)
 {
-	WriteLocker locker(sSwapHashLock);
-
 	uint32 left = count;
 	for (uint32 i = 0, j = 0; i < count; i += j) {
 		off_t pageIndex = startPageIndex + i;
 		swap_addr_t slotIndex = startSlotIndex + i;
 
+		swap_hash_shard& shard = swap_hash_shard_for(this, pageIndex);
+		WriteLocker locker(shard.lock);
+
 		swap_hash_key key = { this, pageIndex };
 
-		swap_block* swap = sSwapHashTable.Lookup(key);
+		swap_block* swap = shard.table.Lookup(key);
 		while (swap == NULL) {
 			swap = (swap_block*)object_cache_alloc(sSwapBlockCache,
 				CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE);
@@ -894,7 +1079,7 @@ VMAnonymousCache::_SwapBlockBuild(off_t startPageIndex,
 				locker.Unlock();
 				snooze(10000);
 				locker.Lock();
-				swap = sSwapHashTable.Lookup(key);
+				swap = shard.table.Lookup(key);
 				continue;
 			}
 
@@ -904,7 +1089,7 @@ VMAnonymousCache::_SwapBlockBuild(off_t startPageIndex,
 			for (uint32 i = 0; i < SWAP_BLOCK_PAGES; i++)
 				swap->swap_slots[i] = SWAP_SLOT_NONE;
 
-			sSwapHashTable.InsertUnchecked(swap);
+			shard.table.InsertUnchecked(swap);
 		}
 
 		swap_addr_t blockIndex = pageIndex & SWAP_BLOCK_MASK;
@@ -921,13 +1106,15 @@ VMAnonymousCache::_SwapBlockBuild(off_t startPageIndex,
 void
 VMAnonymousCache::_SwapBlockFree(off_t startPageIndex, uint32 count)
 {
-	WriteLocker locker(sSwapHashLock);
-
 	uint32 left = count;
 	for (uint32 i = 0, j = 0; i < count; i += j) {
 		off_t pageIndex = startPageIndex + i;
+
+		swap_hash_shard& shard = swap_hash_shard_for(this, pageIndex);
+		WriteLocker locker(shard.lock);
+
 		swap_hash_key key = { this, pageIndex };
-		swap_block* swap = sSwapHashTable.Lookup(key);
+		swap_block* swap = shard.table.Lookup(key);
 
 		ASSERT(swap != NULL);
 
@@ -939,7 +1126,7 @@ VMAnonymousCache::_SwapBlockFree(off_t startPageIndex, uint32 count)
 
 		swap->used -= j;
 		if (swap->used == 0) {
-			sSwapHashTable.RemoveUnchecked(swap);
+			shard.table.RemoveUnchecked(swap);
 			object_cache_free(sSwapBlockCache, swap,
 				CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE);
 		}
@@ -950,10 +1137,11 @@ VMAnonymousCache::_SwapBlockFree(off_t startPageIndex, uint32 count)
 swap_addr_t
 VMAnonymousCache::_SwapBlockGetAddress(off_t pageIndex)
 {
-	ReadLocker locker(sSwapHashLock);
+	swap_hash_shard& shard = swap_hash_shard_for(this, pageIndex);
+	ReadLocker locker(shard.lock);
 
 	swap_hash_key key = { this, pageIndex };
-	swap_block* swap = sSwapHashTable.Lookup(key);
+	swap_block* swap = shard.table.Lookup(key);
 	swap_addr_t slotIndex = SWAP_SLOT_NONE;
 
 	if (swap != NULL) {
@@ -965,6 +1153,25 @@ VMAnonymousCache::_SwapBlockGetAddress(off_t pageIndex)
 }
 
 
+/*!	Frees the swap space of those of the \a count pages starting at
+	\a startPageIndex that have any.
+	The cache must be locked.
+*/
+void
+VMAnonymousCache::_FreeSwapSpace(off_t startPageIndex, uint32 count)
+{
+	for (uint32 i = 0; i < count && fAllocatedSwapSize > 0; i++) {
+		swap_addr_t slotIndex = _SwapBlockGetAddress(startPageIndex + i);
+		if (slotIndex == SWAP_SLOT_NONE)
+			continue;
+
+		swap_slot_dealloc(slotIndex, 1);
+		_SwapBlockFree(startPageIndex + i, 1);
+		fAllocatedSwapSize -= B_PAGE_SIZE;
+	}
+}
+
+
 status_t
 VMAnonymousCache::_Commit(off_t size, int priority)
 {
@@ -1094,19 +1301,27 @@ VMAnonymousCache::_MergeSwapPages(VMAnonymousCache* source)
 		offset < source->virtual_end;
 		offset += B_PAGE_SIZE * SWAP_BLOCK_PAGES) {
 
-		WriteLocker locker(sSwapHashLock);
-
 		off_t swapBlockPageIndex = offset >> PAGE_SHIFT;
+		swap_hash_shard& sourceShard
+			= swap_hash_shard_for(source, swapBlockPageIndex);
+		swap_hash_shard& shard = swap_hash_shard_for(this, swapBlockPageIndex);
+
+		WriteLocker sourceLocker(sourceShard.lock);
+
 		swap_hash_key key = { source, swapBlockPageIndex };
-		swap_block* sourceSwapBlock = sSwapHashTable.Lookup(key);
+		swap_block* sourceSwapBlock = sourceShard.table.Lookup(key);
 
 		// remove the source swap block -- we will either take over the swap
 		// space (and the block) or free it
 		if (sourceSwapBlock != NULL)
-			sSwapHashTable.RemoveUnchecked(sourceSwapBlock);
+			sourceShard.table.RemoveUnchecked(sourceSwapBlock);
+
+		sourceLocker.Unlock();
+
+		WriteLocker locker(shard.lock);
 
 		key.cache = this;
-		swap_block* swapBlock = sSwapHashTable.Lookup(key);
+		swap_block* swapBlock = shard.table.Lookup(key);
 
 		locker.Unlock();
 
@@ -1167,7 +1382,7 @@ VMAnonymousCache::_MergeSwapPages(VMAnonymousCache* source)
 			// swap block.
 			sourceSwapBlock->key.cache = this;
 			locker.Lock();
-			sSwapHashTable.InsertUnchecked(sourceSwapBlock);
+			shard.table.InsertUnchecked(sourceSwapBlock);
 			locker.Unlock();
 		} else {
 			// We need to take over some of the source's swap pages and there's
@@ -1413,9 +1628,11 @@ swap_init(void)
 			strerror(error));
 	}
 
-	// init swap hash table
-	sSwapHashTable.Init(INITIAL_SWAP_HASH_SIZE);
-	rw_lock_init(&sSwapHashLock, "swaphash");
+	// init swap hash tables
+	for (uint32 i = 0; i < SWAP_HASH_SHARD_COUNT; i++) {
+		sSwapHashShards[i].table.Init(INITIAL_SWAP_HASH_SIZE);
+		rw_lock_init(&sSwapHashShards[i].lock, "swaphash");
+	}
 
 	error = register_resource_resizer(swap_hash_resizer, NULL,
 		SWAP_HASH_RESIZE_INTERVAL);
@@ -1437,6 +1654,8 @@ swap_init(void)
 		"Print infos about the swap usage",
 		"\n"
 		"Print infos about the swap usage.\n", 0);
+
+	compressed_swap_init();
 }
 
 
@@ -1448,6 +1667,8 @@ swap_init_post_modules()
 	if (gReadOnlyBootDevice)
 		return;
 
+	compressed_swap_init_post_modules();
+
 	bool swapEnabled = true;
 	bool swapAutomatic = true;
 	off_t swapSize = 0;
@@ -43,6 +43,8 @@ public:
 
 	virtual	status_t			Commit(off_t size, int priority);
 	virtual	bool				HasPage(off_t offset);
+	virtual	void				GetReadAheadRange(off_t offset,
+									off_t& _start, off_t& _end);
 	virtual	bool				DebugHasPage(off_t offset);
 
 	virtual	int32				GuardSize()	{ return fGuardedSize; }
@@ -77,6 +79,8 @@ private:
 									swap_addr_t slotIndex, uint32 count);
 			void        		_SwapBlockFree(off_t pageIndex, uint32 count);
 			swap_addr_t			_SwapBlockGetAddress(off_t pageIndex);
+			void				_FreeSwapSpace(off_t startPageIndex,
+									uint32 count);
 			status_t			_Commit(off_t size, int priority);
 
 			void				_MergePagesSmallerSource(
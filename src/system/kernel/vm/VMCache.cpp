@@ -1211,6 +1211,22 @@ VMCache::HasPage(off_t offset)
 }
 
 
+/*!	Returns the range of pages around \a offset that can be read from the
+	backing store in the same request as the page at \a offset, without
+	adding noticeably to its cost. The range always contains \a offset; the
+	caller still has to check whether the other pages are already present.
+	The default implementation returns the page at \a offset only.
+
+	The cache must be locked.
+*/
+void
+VMCache::GetReadAheadRange(off_t offset, off_t& _start, off_t& _end)
+{
+	_start = offset;
+	_end = offset + B_PAGE_SIZE;
+}
+
+
 status_t
 VMCache::Read(off_t offset, const generic_io_vec *vecs, size_t count,
 	uint32 flags, generic_size_t *_numBytes)
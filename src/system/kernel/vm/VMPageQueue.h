@@ -40,8 +40,11 @@ public:
 	inline	void				AppendUnlocked(vm_page* page);
 	inline	void				AppendUnlocked(PageList& pages, uint32 count);
 	inline	void				PrependUnlocked(vm_page* page);
+	inline	void				PrependUnlocked(PageList& pages, uint32 count);
 	inline	void				RemoveUnlocked(vm_page* page);
 	inline	vm_page*			RemoveHeadUnlocked();
+	inline	uint32				RemoveHeadUnlocked(PageList& pages,
+									uint32 count);
 	inline	void				RequeueUnlocked(vm_page* page, bool tail);
 
 	inline	vm_page*			Head() const;
@@ -217,6 +220,30 @@ VMPageQueue::PrependUnlocked(vm_page* page)
 }
 
 
+void
+VMPageQueue::PrependUnlocked(PageList& pages, uint32 count)
+{
+#if DEBUG_PAGE_QUEUE
+	for (PageList::Iterator it = pages.GetIterator();
+			vm_page* page = it.Next();) {
+		if (page->queue != NULL) {
+			panic("%p->VMPageQueue::PrependUnlocked(): page %p thinks it is "
+				"already in queue %p", this, page, page->queue);
+		}
+
+		page->queue = this;
+	}
+
+#endif	// DEBUG_PAGE_QUEUE
+
+	InterruptsSpinLocker locker(fLock);
+
+	pages.MoveFrom(&fPages);
+	fPages.MoveFrom(&pages);
+	fCount += count;
+}
+
+
 void
 VMPageQueue::RemoveUnlocked(vm_page* page)
 {
@@ -233,6 +260,28 @@ VMPageQueue::RemoveHeadUnlocked()
 }
 
 
+/*!	Removes up to \a count pages from the head of the queue, and appends
+	them to \a pages.
+	\return The number of pages that were removed.
+*/
+uint32
+VMPageQueue::RemoveHeadUnlocked(PageList& pages, uint32 count)
+{
+	InterruptsSpinLocker locker(fLock);
+
+	uint32 removed = 0;
+	for (; removed < count; removed++) {
+		vm_page* page = RemoveHead();
+		if (page == NULL)
+			break;
+
+		pages.Add(page);
+	}
+
+	return removed;
+}
+
+
 void
 VMPageQueue::RequeueUnlocked(vm_page* page, bool tail)
 {
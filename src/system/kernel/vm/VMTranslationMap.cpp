@@ -31,6 +31,32 @@ VMTranslationMap::~VMTranslationMap()
 }
 
 
+/*!	Returns the size of the large pages MapLargePage() can map, or 0, if the
+	implementation doesn't support large pages.
+*/
+size_t
+VMTranslationMap::LargePageSize() const
+{
+	return 0;
+}
+
+
+/*!	Maps a physically contiguous, LargePageSize() aligned range of
+	LargePageSize() bytes with a single large page.
+	The map must be locked. The pages of the range must be accounted for
+	(wired) by the caller, just as with Map(). Should the range need to be
+	split later on (partial unmaps or protection changes), the implementation
+	has to take care of that transparently.
+*/
+status_t
+VMTranslationMap::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
 status_t
 VMTranslationMap::DebugMarkRangePresent(addr_t start, addr_t end,
 	bool markPresent)
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A pool of compressed pages in RAM in front of the swap files.
+
+	When a page is swapped out, VMAnonymousCache first offers it to the pool,
+	which keeps an LZ4 compressed copy of it under the swap slot the page was
+	assigned. Only if the pool is full, or the page doesn't compress well, it
+	is actually written to the swap file. Pages are looked up by their swap
+	slot when they are read back in, and removed again when the slot is freed.
+	Since every page in the pool still owns its swap slot, the swap space
+	accounting doesn't change.
+*/
+
+
+#include "compressed_swap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <KernelExport.h>
+
+#include <debug.h>
+#include <driver_settings.h>
+#include <heap.h>
+#include <kernel_daemon.h>
+#include <lock.h>
+#include <util/AutoLock.h>
+#include <util/lz4.h>
+#include <util/OpenHashTable.h>
+#include <vm/vm.h>
+#include <vm/vm_page.h>
+
+
+#if ENABLE_SWAP_SUPPORT
+
+//#define TRACE_COMPRESSED_SWAP
+#ifdef TRACE_COMPRESSED_SWAP
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) do { } while (false)
+#endif
+
+
+// interval the hash resizer is triggered (in 0.1s)
+#define COMPRESSED_PAGE_HASH_RESIZE_INTERVAL	5
+
+#define INITIAL_COMPRESSED_PAGE_HASH_SIZE		1024
+
+// default maximum size of the pool in percent of the physical memory
+#define DEFAULT_MAX_POOL_PERCENT	25
+
+// Pages that don't compress to at most this size go to the swap file
+// directly, since keeping them would save too little memory.
+static const size_t kMaxCompressedSize = B_PAGE_SIZE * 3 / 4;
+
+static const uint32 kFreeFlags
+	= HEAP_DONT_WAIT_FOR_MEMORY | HEAP_DONT_LOCK_KERNEL_SPACE;
+
+
+struct compressed_page {
+	compressed_page*	hash_link;
+	swap_addr_t			slot;
+	uint16				size;
+
+	uint8* Data()
+	{
+		return (uint8*)(this + 1);
+	}
+};
+
+struct CompressedPageHashDefinition {
+	typedef swap_addr_t KeyType;
+	typedef compressed_page ValueType;
+
+	size_t HashKey(swap_addr_t key) const
+	{
+		return key;
+	}
+
+	size_t Hash(const compressed_page* value) const
+	{
+		return value->slot;
+	}
+
+	bool Compare(swap_addr_t key, const compressed_page* value) const
+	{
+		return value->slot == key;
+	}
+
+	compressed_page*& GetLink(compressed_page* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+typedef BOpenHashTable<CompressedPageHashDefinition, false>
+	CompressedPageTable;
+
+
+static bool sEnabled = false;
+
+static CompressedPageTable sCompressedPages;
+static rw_lock sCompressedPagesLock
+	= RW_LOCK_INITIALIZER("compressed swap pages");
+static off_t sPoolSize;
+static off_t sMaxPoolSize;
+static int64 sStoredPages;
+
+// buffers used for compressing, protected by sCompressorLock
+static mutex sCompressorLock = MUTEX_INITIALIZER("compressed swap compressor");
+static uint8* sCompressBuffer;
+static void* sCompressWorkspace;
+
+static int64 sRejectedPages;
+static int64 sLoadedPages;
+
+
+static inline size_t
+compressed_page_allocation_size(size_t size)
+{
+	return sizeof(compressed_page) + size;
+}
+
+
+/*!	Removes the page stored for \a slotIndex from the table, if any.
+	The caller must hold sCompressedPagesLock for writing.
+	\return The removed page, or \c NULL.
+*/
+static compressed_page*
+remove_compressed_page(swap_addr_t slotIndex)
+{
+	compressed_page* page = sCompressedPages.Lookup(slotIndex);
+	if (page == NULL)
+		return NULL;
+
+	sCompressedPages.RemoveUnchecked(page);
+	sPoolSize -= compressed_page_allocation_size(page->size);
+	sStoredPages--;
+	return page;
+}
+
+
+static void
+compressed_page_hash_resizer(void*, int)
+{
+	WriteLocker locker(sCompressedPagesLock);
+
+	size_t size;
+	void* allocation;
+
+	do {
+		size = sCompressedPages.ResizeNeeded();
+		if (size == 0)
+			return;
+
+		locker.Unlock();
+
+		allocation = malloc(size);
+		if (allocation == NULL)
+			return;
+
+		locker.Lock();
+
+	} while (!sCompressedPages.Resize(allocation, size));
+}
+
+
+static int
+dump_compressed_swap_info(int argc, char** argv)
+{
+	if (!sEnabled) {
+		kprintf("compressed swap is disabled\n");
+		return 0;
+	}
+
+	kprintf("stored pages:   %" B_PRId64 "\n", sStoredPages);
+	kprintf("pool size:      %" B_PRIdOFF " of %" B_PRIdOFF " bytes\n",
+		sPoolSize, sMaxPoolSize);
+	if (sPoolSize > 0) {
+		kprintf("ratio:          %" B_PRIdOFF "%%\n",
+			sStoredPages * B_PAGE_SIZE * 100 / sPoolSize);
+	}
+	kprintf("rejected pages: %" B_PRId64 "\n", sRejectedPages);
+	kprintf("loaded pages:   %" B_PRId64 "\n", sLoadedPages);
+	return 0;
+}
+
+
+// #pragma mark -
+
+
+void
+compressed_swap_init(void)
+{
+	sCompressedPages.Init(INITIAL_COMPRESSED_PAGE_HASH_SIZE);
+
+	add_debugger_command_etc("compressed_swap", &dump_compressed_swap_info,
+		"Print infos about the compressed swap pool",
+		"\n"
+		"Print infos about the compressed swap pool.\n", 0);
+}
+
+
+void
+compressed_swap_init_post_modules(void)
+{
+	bool enabled = false;
+	uint32 maxPoolPercent = DEFAULT_MAX_POOL_PERCENT;
+
+	void* settings = load_driver_settings("virtual_memory");
+	if (settings != NULL) {
+		enabled = get_driver_boolean_parameter(settings, "compressed_swap",
+			false, false);
+
+		const char* value = get_driver_parameter(settings,
+			"compressed_swap_percent", NULL, NULL);
+		if (value != NULL)
+			maxPoolPercent = std::min(strtoul(value, NULL, 0), 90UL);
+
+		unload_driver_settings(settings);
+	}
+
+	if (!enabled || maxPoolPercent == 0)
+		return;
+
+	sCompressBuffer = (uint8*)malloc(kMaxCompressedSize);
+	sCompressWorkspace = malloc(LZ4_WORKSPACE_SIZE);
+	if (sCompressBuffer == NULL || sCompressWorkspace == NULL) {
+		free(sCompressBuffer);
+		free(sCompressWorkspace);
+		dprintf("compressed swap: out of memory\n");
+		return;
+	}
+
+	status_t error = register_resource_resizer(compressed_page_hash_resizer,
+		NULL, COMPRESSED_PAGE_HASH_RESIZE_INTERVAL);
+	if (error != B_OK) {
+		panic("compressed_swap_init_post_modules(): Failed to register "
+			"compressed page hash resizer: %s", strerror(error));
+	}
+
+	sMaxPoolSize = (off_t)vm_page_num_pages() * B_PAGE_SIZE / 100
+		* maxPoolPercent;
+	sEnabled = true;
+
+	dprintf("compressed swap: enabled, using up to %" B_PRIdOFF " MB\n",
+		sMaxPoolSize / (1024 * 1024));
+}
+
+
+bool
+compressed_swap_enabled(void)
+{
+	return sEnabled;
+}
+
+
+/*!	Compresses the physical page at \a page, and keeps it in the pool under
+	\a slotIndex, replacing what was stored for that slot before.
+	\return \c true, if the page has been stored, \c false, if it has to be
+		written to the swap file instead.
+*/
+bool
+compressed_swap_store(swap_addr_t slotIndex, phys_addr_t page)
+{
+	if (!sEnabled || sPoolSize + (off_t)kMaxCompressedSize > sMaxPoolSize)
+		return false;
+
+	MutexLocker compressorLocker(sCompressorLock);
+
+	addr_t address;
+	void* handle;
+	if (vm_get_physical_page(page, &address, &handle) != B_OK)
+		return false;
+
+	size_t size = lz4_compress((void*)address, B_PAGE_SIZE, sCompressBuffer,
+		kMaxCompressedSize, sCompressWorkspace);
+
+	vm_put_physical_page(address, handle);
+
+	if (size == 0) {
+		atomic_add64(&sRejectedPages, 1);
+		return false;
+	}
+
+	compressed_page* compressedPage = (compressed_page*)malloc_etc(
+		compressed_page_allocation_size(size), kFreeFlags);
+	if (compressedPage == NULL)
+		return false;
+
+	compressedPage->slot = slotIndex;
+	compressedPage->size = size;
+	memcpy(compressedPage->Data(), sCompressBuffer, size);
+
+	compressorLocker.Unlock();
+
+	WriteLocker locker(sCompressedPagesLock);
+
+	compressed_page* oldPage = remove_compressed_page(slotIndex);
+
+	if (sPoolSize + (off_t)compressed_page_allocation_size(size)
+			> sMaxPoolSize) {
+		locker.Unlock();
+		free_etc(compressedPage, kFreeFlags);
+		if (oldPage != NULL)
+			free_etc(oldPage, kFreeFlags);
+		return false;
+	}
+
+	sCompressedPages.InsertUnchecked(compressedPage);
+	sPoolSize += compressed_page_allocation_size(size);
+	sStoredPages++;
+
+	locker.Unlock();
+
+	if (oldPage != NULL)
+		free_etc(oldPage, kFreeFlags);
+
+	TRACE("compressed swap: stored slot %" B_PRIu32 " in %" B_PRIuSIZE
+		" bytes\n", slotIndex, size);
+	return true;
+}
+
+
+/*!	Decompresses the page stored under \a slotIndex into the physical page
+	at \a page. The page stays in the pool, since its swap slot is still
+	valid.
+	\return \c B_OK, if the page has been read, \c B_ENTRY_NOT_FOUND, if it is
+		not in the pool, another error code, if decompressing it failed.
+*/
+status_t
+compressed_swap_load(swap_addr_t slotIndex, phys_addr_t page)
+{
+	if (!sEnabled)
+		return B_ENTRY_NOT_FOUND;
+
+	ReadLocker locker(sCompressedPagesLock);
+
+	compressed_page* compressedPage = sCompressedPages.Lookup(slotIndex);
+	if (compressedPage == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	addr_t address;
+	void* handle;
+	status_t status = vm_get_physical_page(page, &address, &handle);
+	if (status != B_OK)
+		return status;
+
+	ssize_t size = lz4_decompress(compressedPage->Data(),
+		compressedPage->size, (void*)address, B_PAGE_SIZE);
+
+	vm_put_physical_page(address, handle);
+
+	if (size != B_PAGE_SIZE) {
+		dprintf("compressed swap: slot %" B_PRIu32 " is corrupt\n",
+			slotIndex);
+		return B_BAD_DATA;
+	}
+
+	atomic_add64(&sLoadedPages, 1);
+	return B_OK;
+}
+
+
+bool
+compressed_swap_contains(swap_addr_t slotIndex)
+{
+	if (!sEnabled)
+		return false;
+
+	ReadLocker locker(sCompressedPagesLock);
+	return sCompressedPages.Lookup(slotIndex) != NULL;
+}
+
+
+/*!	Removes the pages stored under the \a count slots starting at
+	\a slotIndex from the pool.
+*/
+void
+compressed_swap_free(swap_addr_t slotIndex, uint32 count)
+{
+	if (!sEnabled || sStoredPages == 0)
+		return;
+
+	for (uint32 i = 0; i < count; i++) {
+		WriteLocker locker(sCompressedPagesLock);
+		compressed_page* page = remove_compressed_page(slotIndex + i);
+		locker.Unlock();
+
+		if (page != NULL)
+			free_etc(page, kFreeFlags);
+	}
+}
+
+
+void
+compressed_swap_get_info(compressed_swap_info* info)
+{
+	ReadLocker locker(sCompressedPagesLock);
+	compressed_swap_get_info_unlocked(info);
+}
+
+
+/*!	Like compressed_swap_get_info(), but doesn't lock, and can therefore be
+	used from the kernel debugger; the values might not be consistent.
+*/
+void
+compressed_swap_get_info_unlocked(compressed_swap_info* info)
+{
+	info->enabled = sEnabled;
+	info->stored_pages = sStoredPages;
+	info->pool_size = sPoolSize;
+	info->max_pool_size = sMaxPoolSize;
+	info->rejected_pages = sRejectedPages;
+	info->loaded_pages = sLoadedPages;
+}
+
+
+#endif	// ENABLE_SWAP_SUPPORT
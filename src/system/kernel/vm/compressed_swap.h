@@ -0,0 +1,39 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_VM_COMPRESSED_SWAP_H
+#define _KERNEL_VM_COMPRESSED_SWAP_H
+
+
+#include "VMAnonymousCache.h"
+
+
+#if ENABLE_SWAP_SUPPORT
+
+struct compressed_swap_info {
+	bool	enabled;
+	uint64	stored_pages;		// # of pages in the compressed pool
+	uint64	pool_size;			// bytes used by the compressed pages
+	uint64	max_pool_size;
+	uint64	rejected_pages;		// # of pages that didn't compress well
+	uint64	loaded_pages;		// # of pages read back from the pool
+};
+
+
+extern "C" {
+	void compressed_swap_init(void);
+	void compressed_swap_init_post_modules(void);
+	bool compressed_swap_enabled(void);
+	bool compressed_swap_store(swap_addr_t slotIndex, phys_addr_t page);
+	status_t compressed_swap_load(swap_addr_t slotIndex, phys_addr_t page);
+	bool compressed_swap_contains(swap_addr_t slotIndex);
+	void compressed_swap_free(swap_addr_t slotIndex, uint32 count);
+	void compressed_swap_get_info(compressed_swap_info* info);
+	void compressed_swap_get_info_unlocked(compressed_swap_info* info);
+}
+
+#endif	// ENABLE_SWAP_SUPPORT
+
+
+#endif	/* _KERNEL_VM_COMPRESSED_SWAP_H */
@@ -33,6 +33,7 @@
 #include <condition_variable.h>
 #include <console.h>
 #include <debug.h>
+#include <driver_settings.h>
 #include <file_cache.h>
 #include <fs/fd.h>
 #include <heap.h>
@@ -247,8 +248,20 @@ static off_t sNeededMemory;
 static mutex sAvailableMemoryLock = MUTEX_INITIALIZER("available memory lock");
 static uint32 sPageFaults;
 
+// number of pages around a faulting address that are mapped as well, if they
+// are already resident
+static uint32 sFaultAroundPages = 16;
+static int64 sFaultAroundFaults;
+static int64 sFaultAroundMappedPages;
+
+// maximum number of pages read from a backing store in one page fault
+static const uint32 kMaxReadAheadPages = 16;
+static int64 sReadAheadPages;
+
 static VMPhysicalPageMapper* sPhysicalPageMapper;
 
+static bool sLargePagesForUserAreas = false;
+
 #if DEBUG_CACHE_LIST
 
 struct cache_info {
@@ -581,6 +594,112 @@ map_page(VMArea* area, vm_page* page, addr_t address, uint32 protection,
 }
 
 
+/*!	Tries to allocate up to \a _count physically contiguous runs of
+	\a largePageSize bytes, each aligned to its size, for use with
+	VMTranslationMap::MapLargePage(). Returns an array with the first page of
+	each run, and sets \a _count to the number of runs actually allocated.
+	The caller must not hold any locks.
+*/
+static vm_page**
+allocate_large_page_runs(page_num_t& _count, size_t largePageSize,
+	uint32 flags, int priority)
+{
+	vm_page** runs = (vm_page**)malloc(_count * sizeof(vm_page*));
+	if (runs == NULL) {
+		_count = 0;
+		return NULL;
+	}
+
+	physical_address_restrictions restrictions = {};
+	restrictions.alignment = largePageSize;
+
+	page_num_t count = 0;
+	for (; count < _count; count++) {
+		runs[count] = vm_page_allocate_page_run(PAGE_STATE_WIRED | flags,
+			largePageSize / B_PAGE_SIZE, &restrictions, priority);
+		if (runs[count] == NULL)
+			break;
+	}
+
+	if (count == 0) {
+		free(runs);
+		runs = NULL;
+	}
+
+	_count = count;
+	return runs;
+}
+
+
+/*!	Frees the \a count runs allocated by allocate_large_page_runs(), as well
+	as the array itself.
+*/
+static void
+free_large_page_runs(vm_page** runs, page_num_t count, size_t largePageSize)
+{
+	if (runs == NULL)
+		return;
+
+	for (page_num_t i = 0; i < count; i++) {
+		page_num_t pageNumber = runs[i]->physical_page_number;
+		for (size_t j = 0; j < largePageSize / B_PAGE_SIZE; j++) {
+			vm_page* page = vm_lookup_page(pageNumber + j);
+			if (page == NULL)
+				panic("couldn't lookup physical page just allocated\n");
+
+			vm_page_set_state(page, PAGE_STATE_FREE);
+		}
+	}
+
+	free(runs);
+}
+
+
+/*!	Inserts the pages of the run starting with \a page into the cache of the
+	wired \a area at \a offset, and maps them at \a address -- with a single
+	large page, if the translation map allows for it.
+	The caller must have reserved enough pages the translation map
+	implementation might need to map the pages individually.
+	The area's cache must be locked.
+*/
+static void
+map_large_page_run(VMArea* area, vm_page* page, addr_t address, off_t offset,
+	size_t largePageSize, uint32 protection, vm_page_reservation* reservation)
+{
+	VMTranslationMap* map = area->address_space->TranslationMap();
+	VMCache* cache = area->cache;
+	phys_addr_t physicalAddress
+		= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+	page_num_t pageNumber = page->physical_page_number;
+
+	map->Lock();
+
+	bool largePage = map->MapLargePage(address, physicalAddress, protection,
+		area->MemoryType(), reservation) == B_OK;
+
+	for (size_t i = 0; i < largePageSize / B_PAGE_SIZE; i++) {
+		page = vm_lookup_page(pageNumber + i);
+		if (page == NULL)
+			panic("couldn't lookup physical page just allocated\n");
+
+		if (!largePage) {
+			status_t status = map->Map(address + i * B_PAGE_SIZE,
+				physicalAddress + i * B_PAGE_SIZE, protection,
+				area->MemoryType(), reservation);
+			if (status < B_OK)
+				panic("couldn't map physical page in page run\n");
+		}
+
+		cache->InsertPage(page, offset + i * B_PAGE_SIZE);
+		increment_page_wired_count(page);
+
+		DEBUG_PAGE_ACCESS_END(page);
+	}
+
+	map->Unlock();
+}
+
+
 /*!	If \a preserveModified is \c true, the caller must hold the lock of the
 	page's cache.
 */
@@ -1292,9 +1411,17 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 		wiring = B_FULL_LOCK;
 	}
 
+	// Full lock areas may be backed by large pages. Pageable areas can't be
+	// for the time being, as their pages are mapped and unmapped individually.
+	bool useLargePages = wiring == B_FULL_LOCK && !isStack
+		&& (flags & CREATE_AREA_DONT_WAIT) == 0
+		&& ((protection & B_LARGE_PAGES_AREA) != 0
+			|| (sLargePagesForUserAreas && team != VMAddressSpace::KernelID()));
+
 	// For full lock or contiguous areas we're also going to map the pages and
 	// thus need to reserve pages for the mapping backend upfront.
 	addr_t reservedMapPages = 0;
+	size_t largePageSize = 0;
 	if (wiring == B_FULL_LOCK || wiring == B_CONTIGUOUS) {
 		AddressSpaceWriteLocker locker;
 		status_t status = locker.SetTo(team);
@@ -1303,6 +1430,30 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 
 		VMTranslationMap* map = locker.AddressSpace()->TranslationMap();
 		reservedMapPages = map->MaxPagesNeededToMap(0, size - 1);
+		if (useLargePages)
+			largePageSize = map->LargePageSize();
+	}
+
+	// Determine how many large pages the area can hold. Unless the address is
+	// fixed, we make sure the area will be suitably aligned.
+	virtual_address_restrictions largePageAddressRestrictions;
+	page_num_t largePageCount = 0;
+	if (largePageSize != 0 && size >= largePageSize) {
+		if (virtualAddressRestrictions->address_specification
+				== B_EXACT_ADDRESS) {
+			addr_t address = (addr_t)virtualAddressRestrictions->address;
+			addr_t start = ROUNDUP(address, largePageSize);
+			addr_t end = ROUNDDOWN(address + size, largePageSize);
+			if (end > start)
+				largePageCount = (end - start) / largePageSize;
+		} else {
+			largePageCount = size / largePageSize;
+			if (virtualAddressRestrictions->alignment < largePageSize) {
+				largePageAddressRestrictions = *virtualAddressRestrictions;
+				largePageAddressRestrictions.alignment = largePageSize;
+				virtualAddressRestrictions = &largePageAddressRestrictions;
+			}
+		}
 	}
 
 	int priority;
@@ -1334,12 +1485,22 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	VMAddressSpace* addressSpace;
 	status_t status;
 
+	// Allocate the page runs for the large pages first, as this may easily
+	// fail; whatever we don't get is backed by normal pages.
+	vm_page** largePages = NULL;
+	if (largePageCount > 0) {
+		largePages = allocate_large_page_runs(largePageCount, largePageSize,
+			pageAllocFlags, priority);
+	}
+
 	// For full lock areas reserve the pages before locking the address
 	// space. E.g. block caches can't release their memory while we hold the
 	// address space lock.
 	page_num_t reservedPages = reservedMapPages;
-	if (wiring == B_FULL_LOCK)
-		reservedPages += size / B_PAGE_SIZE;
+	if (wiring == B_FULL_LOCK) {
+		reservedPages += size / B_PAGE_SIZE
+			- largePageCount * (largePageSize / B_PAGE_SIZE);
+	}
 
 	vm_page_reservation reservation;
 	if (reservedPages > 0) {
@@ -1417,10 +1578,23 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 		{
 			// Allocate and map all pages for this area
 
+			addr_t end = area->Base() + (area->Size() - 1);
+			page_num_t largePagesUsed = 0;
 			off_t offset = 0;
-			for (addr_t address = area->Base();
-					address < area->Base() + (area->Size() - 1);
+			for (addr_t address = area->Base(); address < end;
 					address += B_PAGE_SIZE, offset += B_PAGE_SIZE) {
+				if (largePagesUsed < largePageCount
+					&& address % largePageSize == 0
+					&& end - address >= largePageSize - 1) {
+					map_large_page_run(area, largePages[largePagesUsed++],
+						address, offset, largePageSize, protection,
+						&reservation);
+
+					address += largePageSize - B_PAGE_SIZE;
+					offset += largePageSize - B_PAGE_SIZE;
+					continue;
+				}
+
 #ifdef DEBUG_KERNEL_STACKS
 #	ifdef STACK_GROWS_DOWNWARDS
 				if (isStack && address < area->Base()
@@ -1439,6 +1613,7 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 				DEBUG_PAGE_ACCESS_END(page);
 			}
 
+			ASSERT(largePagesUsed == largePageCount);
 			break;
 		}
 
@@ -1528,6 +1703,8 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	if (reservedPages > 0)
 		vm_page_unreserve_pages(&reservation);
 
+	free(largePages);
+
 	TRACE(("vm_create_anonymous_area: done\n"));
 
 	area->cache_type = CACHE_TYPE_RAM;
@@ -1548,6 +1725,7 @@ err1:
 	}
 
 err0:
+	free_large_page_runs(largePages, largePageCount, largePageSize);
 	if (reservedPages > 0)
 		vm_page_unreserve_pages(&reservation);
 	if (reservedMemory > 0)
@@ -3409,6 +3587,20 @@ dump_available_memory(int argc, char** argv)
 }
 
 
+static int
+dump_fault_statistics(int argc, char** argv)
+{
+	kprintf("page faults:             %" B_PRIu32 "\n", sPageFaults);
+	kprintf("fault-around window:     %" B_PRIu32 " pages\n",
+		sFaultAroundPages);
+	kprintf("fault-around faults:     %" B_PRId64 "\n", sFaultAroundFaults);
+	kprintf("pages mapped in advance: %" B_PRId64 "\n",
+		sFaultAroundMappedPages);
+	kprintf("pages read in advance:   %" B_PRId64 "\n", sReadAheadPages);
+	return 0;
+}
+
+
 static int
 dump_mapping_info(int argc, char** argv)
 {
@@ -4092,6 +4284,8 @@ vm_init(kernel_args* args)
 #endif
 	add_debugger_command("avail", &dump_available_memory,
 		"Dump available memory");
+	add_debugger_command("faults", &dump_fault_statistics,
+		"Dump page fault statistics");
 	add_debugger_command("dl", &display_mem, "dump memory long words (64-bit)");
 	add_debugger_command("dw", &display_mem, "dump memory words (32-bit)");
 	add_debugger_command("ds", &display_mem, "dump memory shorts (16-bit)");
@@ -4157,6 +4351,23 @@ vm_init_post_thread(kernel_args* args)
 status_t
 vm_init_post_modules(kernel_args* args)
 {
+	void* settings = load_driver_settings("virtual_memory");
+	if (settings != NULL) {
+		sLargePagesForUserAreas = get_driver_boolean_parameter(settings,
+			"large_pages", false, false);
+
+		// the fault-around window must be a power of two
+		const char* value = get_driver_parameter(settings,
+			"fault_around_pages", NULL, NULL);
+		if (value != NULL) {
+			uint32 pages = strtoul(value, NULL, 0);
+			sFaultAroundPages = 1;
+			while (sFaultAroundPages * 2 <= std::min(pages, (uint32)256))
+				sFaultAroundPages *= 2;
+		}
+		unload_driver_settings(settings);
+	}
+
 	return arch_vm_init_post_modules(args);
 }
 
@@ -4398,6 +4609,72 @@ struct PageFaultContext {
 };
 
 
+/*!	Determines which of the pages around the busy page \a page at \a offset
+	can be read in together with it, inserts fresh busy pages for them into
+	\a cache, and returns all pages -- including \a page -- in \a pages,
+	sorted by offset. Pages are only added as long as the range stays
+	contiguous, none of them is present in the cache yet, and they can be
+	allocated without waiting.
+	The cache must be locked.
+	\return The number of pages in \a pages; \a _start is set to the offset of
+		the first one.
+*/
+static uint32
+allocate_read_ahead_pages(VMCache* cache, off_t offset, vm_page* page,
+	vm_page** pages, off_t& _start)
+{
+	off_t start;
+	off_t end;
+	cache->GetReadAheadRange(offset, start, end);
+
+	start = std::max(std::max(start, cache->virtual_base),
+		offset - (off_t)(kMaxReadAheadPages - 1) * B_PAGE_SIZE);
+	end = std::min(std::min(end, cache->virtual_end),
+		start + (off_t)kMaxReadAheadPages * B_PAGE_SIZE);
+
+	off_t first = offset;
+	while (first - B_PAGE_SIZE >= start
+		&& cache->LookupPage(first - B_PAGE_SIZE) == NULL) {
+		first -= B_PAGE_SIZE;
+	}
+
+	off_t last = offset;
+	while (last + B_PAGE_SIZE < end
+		&& cache->LookupPage(last + B_PAGE_SIZE) == NULL) {
+		last += B_PAGE_SIZE;
+	}
+
+	uint32 count = (last - first) / B_PAGE_SIZE + 1;
+	vm_page_reservation reservation;
+	if (count == 1
+		|| !vm_page_try_reserve_pages(&reservation, count - 1,
+			VM_PRIORITY_USER)) {
+		pages[0] = page;
+		_start = offset;
+		return 1;
+	}
+
+	for (uint32 i = 0; i < count; i++) {
+		off_t pageOffset = first + (off_t)i * B_PAGE_SIZE;
+		if (pageOffset == offset) {
+			pages[i] = page;
+			continue;
+		}
+
+		pages[i] = vm_page_allocate_page(&reservation,
+			PAGE_STATE_INACTIVE | VM_PAGE_ALLOC_BUSY);
+		cache->InsertPage(pages[i], pageOffset);
+	}
+
+	vm_page_unreserve_pages(&reservation);
+
+	atomic_add64(&sReadAheadPages, count - 1);
+
+	_start = first;
+	return count;
+}
+
+
 /*!	Gets the page that should be mapped into the area.
 	Returns an error code other than \c B_OK, if the page couldn't be found or
 	paged in. The locking state of the address space and the caches is undefined
@@ -4446,38 +4723,65 @@ fault_get_page(PageFaultContext& context)
 				PAGE_STATE_ACTIVE | VM_PAGE_ALLOC_BUSY);
 			cache->InsertPage(page, context.cacheOffset);
 
+			// also read in the neighbouring pages the backing store can
+			// deliver with the same request
+			vm_page* pages[kMaxReadAheadPages];
+			off_t readOffset;
+			uint32 pageCount = allocate_read_ahead_pages(cache,
+				context.cacheOffset, page, pages, readOffset);
+
 			// We need to unlock all caches and the address space while reading
-			// the page in. Keep a reference to the cache around.
+			// the pages in. Keep a reference to the cache around.
 			cache->AcquireRefLocked();
 			context.UnlockAll();
 
-			// read the page in
-			generic_io_vec vec;
-			vec.base = (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
-			generic_size_t bytesRead = vec.length = B_PAGE_SIZE;
+			// read the pages in
+			generic_io_vec vecs[kMaxReadAheadPages];
+			for (uint32 i = 0; i < pageCount; i++) {
+				vecs[i].base
+					= (phys_addr_t)pages[i]->physical_page_number * B_PAGE_SIZE;
+				vecs[i].length = B_PAGE_SIZE;
+			}
+			generic_size_t bytesRead = (generic_size_t)pageCount * B_PAGE_SIZE;
 
-			status_t status = cache->Read(context.cacheOffset, &vec, 1,
+			status_t status = cache->Read(readOffset, vecs, pageCount,
 				B_PHYSICAL_IO_REQUEST, &bytesRead);
 
 			cache->Lock();
 
-			if (status < B_OK) {
-				// on error remove and free the page
-				dprintf("reading page from cache %p returned: %s!\n",
-					cache, strerror(status));
+			// Only the pages that were read completely are valid. If that
+			// doesn't include the page we faulted on, the fault fails.
+			uint32 pagesRead = 0;
+			if (status == B_OK) {
+				pagesRead = bytesRead / B_PAGE_SIZE;
+				uint32 faultIndex
+					= (context.cacheOffset - readOffset) / B_PAGE_SIZE;
+				if (faultIndex >= pagesRead) {
+					status = B_IO_ERROR;
+					pagesRead = 0;
+				}
+			}
 
-				cache->NotifyPageEvents(page, PAGE_EVENT_NOT_BUSY);
-				cache->RemovePage(page);
-				vm_page_set_state(page, PAGE_STATE_FREE);
+			// remove and free the pages that couldn't be read
+			for (uint32 i = pagesRead; i < pageCount; i++) {
+				cache->NotifyPageEvents(pages[i], PAGE_EVENT_NOT_BUSY);
+				cache->RemovePage(pages[i]);
+				vm_page_set_state(pages[i], PAGE_STATE_FREE);
+			}
 
+			if (status != B_OK) {
+				dprintf("reading page from cache %p returned: %s!\n",
+					cache, strerror(status));
 				cache->ReleaseRefAndUnlock();
 				return status;
 			}
 
-			// mark the page unbusy again
-			cache->MarkPageUnbusy(page);
+			// mark the pages unbusy again
+			for (uint32 i = 0; i < pagesRead; i++) {
+				cache->MarkPageUnbusy(pages[i]);
 
-			DEBUG_PAGE_ACCESS_END(page);
+				DEBUG_PAGE_ACCESS_END(pages[i]);
+			}
 
 			// Since we needed to unlock everything temporarily, the area
 			// situation might have changed. So we need to restart the whole
@@ -4539,6 +4843,89 @@ fault_get_page(PageFaultContext& context)
 }
 
 
+/*!	Maps the pages within the fault-around window of \a address that are
+	already resident, so that accessing them later won't cause a page fault.
+	Only the caches \a context has locked are considered, i.e. the top cache
+	down to the cache of the page that was just mapped at \a address. A page is
+	skipped if it's busy, or if another cache on the way has it, but not
+	resident.
+	The address space must be read-locked.
+*/
+static void
+fault_around(PageFaultContext& context, VMArea* area, addr_t address)
+{
+	if (sFaultAroundPages <= 1 || area->wiring != B_NO_LOCK)
+		return;
+
+	addr_t windowSize = sFaultAroundPages * B_PAGE_SIZE;
+	addr_t windowStart = ROUNDDOWN(address, windowSize);
+	addr_t start = std::max(windowStart, area->Base());
+	addr_t last = std::min(windowStart + (windowSize - 1),
+		area->Base() + (area->Size() - 1));
+
+	VMCache* bottomCache = context.page->Cache();
+	int64 mappedPages = 0;
+
+	for (addr_t pageAddress = start; pageAddress - start <= last - start;
+			pageAddress += B_PAGE_SIZE) {
+		if (pageAddress == address)
+			continue;
+
+		uint32 protection = get_area_page_protection(area, pageAddress);
+		if ((protection & (B_READ_AREA | B_KERNEL_READ_AREA)) == 0)
+			continue;
+
+		off_t cacheOffset = pageAddress - area->Base() + area->cache_offset;
+		vm_page* page = NULL;
+		for (VMCache* cache = context.topCache; cache != NULL;
+				cache = cache->source) {
+			page = cache->LookupPage(cacheOffset);
+			if (page != NULL || cache == bottomCache
+				|| cache->HasPage(cacheOffset)) {
+				break;
+			}
+		}
+
+		if (page == NULL || page->busy)
+			continue;
+
+		// pages of lower caches must be mapped read-only (copy-on-write)
+		if (page->Cache() != context.topCache)
+			protection &= ~(B_WRITE_AREA | B_KERNEL_WRITE_AREA);
+
+		// don't touch anything that is already mapped
+		context.map->Lock();
+		phys_addr_t physicalAddress;
+		uint32 flags;
+		bool isMapped = context.map->Query(pageAddress, &physicalAddress,
+				&flags) == B_OK
+			&& (flags & PAGE_PRESENT) != 0;
+		context.map->Unlock();
+
+		if (isMapped)
+			continue;
+
+		DEBUG_PAGE_ACCESS_START(page);
+		status_t status = map_page(area, page, pageAddress, protection,
+			&context.reservation);
+		DEBUG_PAGE_ACCESS_END(page);
+
+		if (status != B_OK) {
+			// We're out of mapping objects -- this is just an optimization,
+			// so don't try any harder.
+			break;
+		}
+
+		mappedPages++;
+	}
+
+	if (mappedPages > 0) {
+		atomic_add64(&sFaultAroundFaults, 1);
+		atomic_add64(&sFaultAroundMappedPages, mappedPages);
+	}
+}
+
+
 /*!	Makes sure the address in the given address space is mapped.
 
 	\param addressSpace The address space.
@@ -4565,11 +4952,14 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 
 	addressSpace->IncrementFaultCount();
 
-	// We may need up to 2 pages plus pages needed for mapping them -- reserving
-	// the pages upfront makes sure we don't have any cache locked, so that the
-	// page daemon/thief can do their job without problems.
-	size_t reservePages = 2 + context.map->MaxPagesNeededToMap(originalAddress,
-		originalAddress);
+	// We may need up to 2 pages plus pages needed for mapping them and the
+	// pages in the fault-around window -- reserving the pages upfront makes
+	// sure we don't have any cache locked, so that the page daemon/thief can
+	// do their job without problems.
+	addr_t faultAroundSize = sFaultAroundPages * B_PAGE_SIZE;
+	addr_t faultAroundStart = ROUNDDOWN(originalAddress, faultAroundSize);
+	size_t reservePages = 2 + context.map->MaxPagesNeededToMap(
+		faultAroundStart, faultAroundStart + (faultAroundSize - 1));
 	context.addressSpaceLocker.Unlock();
 	vm_page_reserve_pages(&context.reservation, reservePages,
 		addressSpace == VMAddressSpace::Kernel()
@@ -4774,6 +5164,10 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 
 		DEBUG_PAGE_ACCESS_END(context.page);
 
+		// map the resident neighbors of the page as well
+		if (mapPage && wirePage == NULL)
+			fault_around(context, area, address);
+
 		break;
 	}
 
@@ -27,6 +27,7 @@
 #include <heap.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <thread.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -133,6 +134,28 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+// Per-CPU caches of free and clear pages. Pages are moved between them and
+// the free/clear queues in batches, so that allocating and freeing a page
+// usually touches neither sFreePageQueuesLock nor the queues' spinlocks.
+// Cached pages keep their free/clear state, and are still part of
+// sUnreservedFreePages, so page reservations are not affected by them.
+// Anyone who needs to see all free pages in the queues while holding the
+// write lock has to call disable_page_cpu_caches() first.
+struct page_cpu_cache {
+	spinlock				lock;
+	VMPageQueue::PageList	pages[2];
+		// index 0 holds free, index 1 clear pages
+	uint32					count[2];
+} CACHE_LINE_ALIGN;
+
+static const uint32 kPageCPUCacheBatchSize = 16;
+static const uint32 kPageCPUCacheMaxCount = 64;
+
+static page_cpu_cache sPageCPUCaches[SMP_MAX_CPUS];
+static int32 sPageCPUCachesDisabled;
+
+static page_num_t count_page_cpu_cache_pages();
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -1117,6 +1140,9 @@ dump_page_stats(int argc, char **argv)
 		sFreePageQueue.Count());
 	kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n", &sClearPageQueue,
 		sClearPageQueue.Count());
+	kprintf("per-CPU caches: %" B_PRIuPHYSADDR " free/clear pages%s\n",
+		count_page_cpu_cache_pages(),
+		sPageCPUCachesDisabled != 0 ? " (disabled)" : "");
 	kprintf("modified queue: %p, count = %" B_PRIuPHYSADDR " (%" B_PRId32
 		" temporary, %" B_PRIuPHYSADDR " swappable, " "inactive: %"
 		B_PRIuPHYSADDR ")\n", &sModifiedPageQueue, sModifiedPageQueue.Count(),
@@ -1461,6 +1487,190 @@ unreserve_pages(uint32 count)
 }
 
 
+// #pragma mark - per-CPU page caches
+
+
+static inline page_cpu_cache&
+current_page_cpu_cache()
+{
+	return sPageCPUCaches[smp_get_current_cpu()];
+}
+
+
+/*!	Takes a page from the cache of the current CPU, and puts it into
+	\a pageState. If \a eitherList is \c false, the page is only taken from
+	the list with index \a index, otherwise the other list is tried as well.
+	\a _oldPageState is set to the free/clear state the page had before.
+*/
+static vm_page*
+page_cpu_cache_allocate(int index, bool eitherList, uint32 pageState,
+	int& _oldPageState)
+{
+	InterruptsLocker interruptsLocker;
+	page_cpu_cache& cache = current_page_cpu_cache();
+	SpinLocker locker(cache.lock);
+
+	vm_page* page = cache.pages[index].RemoveHead();
+	if (page == NULL && eitherList) {
+		index = 1 - index;
+		page = cache.pages[index].RemoveHead();
+	}
+	if (page == NULL)
+		return NULL;
+
+	cache.count[index]--;
+
+	// The state has to change while the page is still locked, or someone
+	// looking for free pages in the write locked queues could pick it
+	DEBUG_PAGE_ACCESS_START(page);
+	_oldPageState = page->State();
+	page->SetState(pageState);
+
+	return page;
+}
+
+
+/*!	Puts the freed \a page into the cache of the current CPU.
+	\return \c false, if the cache is full or disabled, and the page has to
+		go to the free/clear queues instead.
+*/
+static bool
+page_cpu_cache_free(vm_page* page, bool clear)
+{
+	int index = clear ? 1 : 0;
+
+	InterruptsLocker interruptsLocker;
+	page_cpu_cache& cache = current_page_cpu_cache();
+	SpinLocker locker(cache.lock);
+
+	if (atomic_get(&sPageCPUCachesDisabled) != 0
+		|| cache.count[index] >= kPageCPUCacheMaxCount) {
+		return false;
+	}
+
+	page->SetState(clear ? PAGE_STATE_CLEAR : PAGE_STATE_FREE);
+	DEBUG_PAGE_ACCESS_END(page);
+	cache.pages[index].Add(page, false);
+	cache.count[index]++;
+
+	return true;
+}
+
+
+/*!	Moves a batch of pages from the free (\a index 0) or clear (\a index 1)
+	queue into the cache of the current CPU.
+	The caller must hold the read lock of \c sFreePageQueuesLock.
+	\return The number of pages moved.
+*/
+static uint32
+page_cpu_cache_refill(int index)
+{
+	InterruptsLocker interruptsLocker;
+	page_cpu_cache& cache = current_page_cpu_cache();
+	SpinLocker locker(cache.lock);
+
+	if (atomic_get(&sPageCPUCachesDisabled) != 0)
+		return 0;
+
+	uint32 count = sPageQueues[PAGE_STATE_FREE + index].RemoveHeadUnlocked(
+		cache.pages[index], kPageCPUCacheBatchSize);
+	cache.count[index] += count;
+
+	return count;
+}
+
+
+/*!	Moves a batch of the least recently freed pages from the cache of the
+	current CPU back to the free (\a index 0) or clear (\a index 1) queue.
+	The caller must hold the read lock of \c sFreePageQueuesLock.
+*/
+static void
+page_cpu_cache_flush(int index)
+{
+	VMPageQueue::PageList pages;
+	uint32 count = 0;
+
+	{
+		InterruptsLocker interruptsLocker;
+		page_cpu_cache& cache = current_page_cpu_cache();
+		SpinLocker locker(cache.lock);
+
+		for (; count < kPageCPUCacheBatchSize; count++) {
+			vm_page* page = cache.pages[index].RemoveTail();
+			if (page == NULL)
+				break;
+
+			pages.Add(page, false);
+		}
+		cache.count[index] -= count;
+	}
+
+	if (count > 0)
+		sPageQueues[PAGE_STATE_FREE + index].PrependUnlocked(pages, count);
+}
+
+
+/*!	Moves the pages of all CPU caches back to the free/clear queues.
+	The caller must hold the write lock of \c sFreePageQueuesLock. Unless the
+	caches are disabled, pages may be freed into them again right away.
+*/
+static void
+drain_page_cpu_caches()
+{
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 cpu = 0; cpu < cpuCount; cpu++) {
+		page_cpu_cache& cache = sPageCPUCaches[cpu];
+		InterruptsSpinLocker locker(cache.lock);
+
+		for (int index = 0; index < 2; index++) {
+			if (cache.count[index] == 0)
+				continue;
+
+			sPageQueues[PAGE_STATE_FREE + index].PrependUnlocked(
+				cache.pages[index], cache.count[index]);
+			cache.count[index] = 0;
+		}
+	}
+}
+
+
+/*!	Empties all CPU caches, and keeps them empty until
+	enable_page_cpu_caches() is called, so that all free pages are in the
+	free/clear queues.
+	The caller must hold the write lock of \c sFreePageQueuesLock.
+*/
+static void
+disable_page_cpu_caches()
+{
+	atomic_add(&sPageCPUCachesDisabled, 1);
+	drain_page_cpu_caches();
+}
+
+
+static void
+enable_page_cpu_caches()
+{
+	atomic_add(&sPageCPUCachesDisabled, -1);
+}
+
+
+//!	Returns the number of free and clear pages in all CPU caches.
+static page_num_t
+count_page_cpu_cache_pages()
+{
+	page_num_t count = 0;
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 cpu = 0; cpu < cpuCount; cpu++)
+		count += sPageCPUCaches[cpu].count[0] + sPageCPUCaches[cpu].count[1];
+
+	return count;
+}
+
+
+// #pragma mark -
+
+
 static void
 free_page(vm_page* page, bool clear)
 {
@@ -1511,6 +1721,9 @@ free_page(vm_page* page, bool clear)
 	page->allocation_tracking_info.Clear();
 #endif
 
+	if (page_cpu_cache_free(page, clear))
+		return;
+
 	ReadLocker locker(sFreePageQueuesLock);
 
 	DEBUG_PAGE_ACCESS_END(page);
@@ -1523,6 +1736,9 @@ free_page(vm_page* page, bool clear)
 		sFreePageQueue.PrependUnlocked(page);
 	}
 
+	// make room in this CPU's cache for the next pages to be freed
+	page_cpu_cache_flush(clear ? 1 : 0);
+
 	locker.Unlock();
 }
 
@@ -1686,6 +1902,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 	}
 
 	WriteLocker locker(sFreePageQueuesLock);
+	disable_page_cpu_caches();
 
 	for (page_num_t i = 0; i < length; i++) {
 		vm_page *page = &sPages[startPage + i];
@@ -1721,6 +1938,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 		}
 	}
 
+	enable_page_cpu_caches();
 	return B_OK;
 }
 
@@ -2263,6 +2481,62 @@ PageWriterRun::PageWritten(PageWriteTransfer* transfer, status_t status,
 }
 
 
+#if ENABLE_SWAP_SUPPORT
+
+/*!	Adds the modified neighbours of \a page to \a run, so that they are
+	written back in the same request. The neighbours are taken from the
+	aligned window of as many pages as the cache can write at once, as long as
+	they are contiguous with \a page. This is only done for temporary caches,
+	whose pages will then be found next to each other in the swap file, too.
+	The page's cache must be locked, and \a page must have been added to
+	\a run already.
+	\return The number of pages added.
+*/
+static uint32
+add_page_cluster(PageWriterRun& run, vm_page* page, uint32 maxPages)
+{
+	VMCache* cache = page->Cache();
+	int32 clusterPages = cache->MaxPagesPerAsyncWrite();
+	if (!cache->temporary || clusterPages <= 1)
+		return 0;
+
+	page_num_t windowStart = ROUNDDOWN(page->cache_offset,
+		(page_num_t)clusterPages);
+	page_num_t windowEnd = windowStart + clusterPages;
+
+	uint32 added = 0;
+
+	for (int32 direction = -1; direction <= 1; direction += 2) {
+		for (page_num_t index = page->cache_offset + direction;
+				index >= windowStart && index < windowEnd && added < maxPages;
+				index += direction) {
+			off_t offset = (off_t)index << PAGE_SHIFT;
+			vm_page* neighbour = cache->LookupPage(offset);
+			if (neighbour == NULL || neighbour->busy
+				|| neighbour->State() != PAGE_STATE_MODIFIED
+				|| neighbour->WiredCount() > 0
+				|| !cache->CanWritePage(offset)) {
+				break;
+			}
+
+			DEBUG_PAGE_ACCESS_START(neighbour);
+			run.AddPage(neighbour);
+			DEBUG_PAGE_ACCESS_END(neighbour);
+
+			TPW(WritePage(neighbour));
+
+			cache->AcquireStoreRef();
+			cache->AcquireRefLocked();
+			added++;
+		}
+	}
+
+	return added;
+}
+
+#endif	// ENABLE_SWAP_SUPPORT
+
+
 /*!	The page writer continuously takes some pages from the modified
 	queue, writes them back, and moves them back to the active queue.
 	It runs in its own thread, and is only there to keep the number
@@ -2407,6 +2681,10 @@ page_writer(void* /*unused*/)
 
 			cache->AcquireRefLocked();
 			numPages++;
+
+#if ENABLE_SWAP_SUPPORT
+			numPages += add_page_cluster(run, page, kNumPages - numPages);
+#endif
 		}
 
 #ifdef TRACE_VM_PAGE
@@ -3513,60 +3791,68 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
+	int index = (flags & VM_PAGE_ALLOC_CLEAR) != 0 ? 1 : 0;
+	VMPageQueue* queue = &sPageQueues[PAGE_STATE_FREE + index];
+	VMPageQueue* otherQueue = &sPageQueues[PAGE_STATE_FREE + 1 - index];
+	int oldPageState;
 
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
-
-	ReadLocker locker(sFreePageQueuesLock);
-
-	vm_page* page = queue->RemoveHeadUnlocked();
+	// Usually, the page comes from the cache of the current CPU
+	vm_page* page = page_cpu_cache_allocate(index, false, pageState,
+		oldPageState);
 	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+		ReadLocker locker(sFreePageQueuesLock);
 
-		if (page == NULL) {
-			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
-			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
+		// Refill the cache from the primary queue, or, if that one is empty,
+		// from the secondary queue
+		if (page_cpu_cache_refill(index) > 0
+			|| page_cpu_cache_refill(1 - index) > 0) {
+			page = page_cpu_cache_allocate(index, true, pageState,
+				oldPageState);
+		}
 
-			page = queue->RemoveHead();
+		if (page == NULL) {
+			// The caches are disabled, or the queues were empty
+			page = queue->RemoveHeadUnlocked();
 			if (page == NULL)
-				otherQueue->RemoveHead();
+				page = otherQueue->RemoveHeadUnlocked();
 
 			if (page == NULL) {
-				panic("Had reserved page, but there is none!");
-				return NULL;
+				// Our reserved page is either in the cache of another CPU,
+				// or has moved between the queues after we checked them.
+				// Grab the write lock, and collect all pages in the queues.
+				locker.Unlock();
+				WriteLocker writeLocker(sFreePageQueuesLock);
+
+				drain_page_cpu_caches();
+
+				page = queue->RemoveHead();
+				if (page == NULL)
+					page = otherQueue->RemoveHead();
+
+				if (page == NULL) {
+					panic("Had reserved page, but there is none!");
+					return NULL;
+				}
+
+				// downgrade to read lock
+				locker.Lock();
 			}
 
-			// downgrade to read lock
-			locker.Lock();
+			DEBUG_PAGE_ACCESS_START(page);
+
+			oldPageState = page->State();
+			page->SetState(pageState);
 		}
 	}
 
 	if (page->CacheRef() != NULL)
 		panic("supposed to be free page %p has cache\n", page);
 
-	DEBUG_PAGE_ACCESS_START(page);
-
-	int oldPageState = page->State();
-	page->SetState(pageState);
 	page->busy = (flags & VM_PAGE_ALLOC_BUSY) != 0;
 	page->usage_count = 0;
 	page->accessed = false;
 	page->modified = false;
 
-	locker.Unlock();
-
 	if (pageState < PAGE_STATE_FIRST_UNQUEUED)
 		sPageQueues[pageState].AppendUnlocked(page);
 
@@ -3835,6 +4121,9 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 
 	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
 
+	// We need to see all free pages in the queues
+	disable_page_cpu_caches();
+
 	// First we try to get a run with free pages only. If that fails, we also
 	// consider cached pages. If there are only few free pages and many cached
 	// ones, the odds are that we won't find enough contiguous ones, so we skip
@@ -3874,6 +4163,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 				" boundary: %" B_PRIuPHYSADDR ")!\n", length, requestedStart,
 				end, restrictions->alignment, restrictions->boundary);
 
+			enable_page_cpu_caches();
 			freeClearQueueLocker.Unlock();
 			vm_page_unreserve_pages(&reservation);
 			return NULL;
@@ -3893,8 +4183,10 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 
 		if (foundRun) {
 			i = allocate_page_run(start, length, flags, freeClearQueueLocker);
-			if (i == length)
+			if (i == length) {
+				enable_page_cpu_caches();
 				return &sPages[start];
+			}
 
 			// apparently a cached page couldn't be allocated -- skip it and
 			// continue
@@ -4095,7 +4387,7 @@ vm_page_get_stats(system_info *info)
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
 	uint32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+		+ sClearPageQueue.Count() + count_page_cpu_cache_pages();
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
@@ -20,6 +20,7 @@
 
 #include <AutoDeleter.h>
 
+#include <event_queue.h>
 #include <fs/fd.h>
 #include <port.h>
 #include <sem.h>
@@ -398,6 +399,7 @@ create_select_sync(int numFDs, select_sync*& _sync)
 
 	sync->count = numFDs;
 	sync->ref_count = 1;
+	sync->queue = NULL;
 
 	for (int i = 0; i < numFDs; i++) {
 		sync->set[i].next = NULL;
@@ -418,6 +420,11 @@ put_select_sync(select_sync* sync)
 	FUNCTION(("put_select_sync(%p): -> %ld\n", sync, sync->ref_count - 1));
 
 	if (atomic_add(&sync->ref_count, -1) == 1) {
+		if (sync->queue != NULL) {
+			event_queue_free_entry(sync);
+			return;
+		}
+
 		delete_sem(sync->sem);
 		delete[] sync->set;
 		delete sync;
@@ -703,6 +710,10 @@ notify_select_events(select_info* info, uint16 events)
 
 	atomic_or(&info->events, events);
 
+	// event queues keep track of their ready objects themselves
+	if (info->sync->queue != NULL)
+		return event_queue_notify(info, events);
+
 	// only wake up the waiting select()/poll() call if the events
 	// match one of the selected ones
 	if (info->selected_events & events)
@@ -723,6 +734,26 @@ notify_select_events_list(select_info* list, uint16 events)
 }
 
 
+status_t
+select_object(uint32 type, int32 object, select_info* info, bool kernel)
+{
+	if (type >= kSelectOpsCount)
+		return B_BAD_VALUE;
+
+	return kSelectOps[type].select(object, info, kernel);
+}
+
+
+status_t
+deselect_object(uint32 type, int32 object, select_info* info, bool kernel)
+{
+	if (type >= kSelectOpsCount)
+		return B_BAD_VALUE;
+
+	return kSelectOps[type].deselect(object, info, kernel);
+}
+
+
 //	#pragma mark - public kernel API
 
 
@@ -0,0 +1,974 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A malloc() implementation with per-thread caches in front of size class
+	slabs.
+
+	Allocations of up to kMaxSmallSize bytes are rounded up to one of the
+	kSizeClassCount size classes, and carved from spans: kSpanSize aligned
+	areas of kSpanSize bytes that only hold objects of a single size class.
+	A span starts with its header, the objects are packed towards its end, so
+	that objects of a power of two size class are naturally aligned to their
+	size. The span an object belongs to is found by masking its address.
+
+	Every thread has a cache of free objects per size class, so that most
+	calls to malloc() and free() neither take a lock nor touch cache lines
+	another thread is using. Only when a cache runs empty or overflows, a
+	batch of objects is moved from or to the spans of the size class, under
+	the size class' lock. Spans that become empty are kept in a small cache
+	for reuse; beyond that, their area is deleted, returning the memory to
+	the kernel.
+
+	Larger allocations get an area of their own, which also starts with a
+	span header -- unless the allocation is kSpanSize aligned, in which case
+	the header is placed kSpanSize bytes before it.
+*/
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+#include <TLS.h>
+
+#include <errno_private.h>
+#include <fork.h>
+#include <libroot_private.h>
+#include <locks.h>
+#include <syscalls.h>
+#include <user_thread.h>
+
+
+static const size_t kSpanShift = 16;
+static const size_t kSpanSize = (size_t)1 << kSpanShift;
+static const addr_t kSpanMask = kSpanSize - 1;
+
+static const size_t kAlignment = 16;
+static const size_t kMaxSmallSize = 16384;
+static const uint32 kSizeClassCount = 36;
+
+static const uint32 kMaxBatchCount = 32;
+	// the maximum number of objects moved between a thread cache and the
+	// spans at once
+static const size_t kBatchBytes = 16384;
+	// the number of bytes a batch should have, if possible
+
+static const uint32 kMaxCachedEmptySpans = 16;
+static const uint32 kMaxFreeSpanAddresses = 256;
+
+static const uint32 kSmallSpanMagic = 'mgsm';
+static const uint32 kLargeSpanMagic = 'mglg';
+
+#if B_HAIKU_64_BIT
+static const addr_t kHeapReservationBase = 0x1000000000;
+static const addr_t kHeapReservationSize = 0x1000000000;
+#else
+static const addr_t kHeapReservationBase = 0x18000000;
+static const addr_t kHeapReservationSize = 0x48000000;
+#endif
+
+
+struct free_object {
+	free_object*	next;
+};
+
+struct heap_span {
+	uint32			magic;
+	area_id			area;
+
+	// small allocations only
+	heap_span*		next;
+	heap_span*		previous;
+	free_object*	free_list;
+	addr_t			unused;
+		// the objects from here to the end of the span were never allocated
+	uint32			size_class;
+	uint32			used_count;
+	uint32			object_count;
+
+	// large allocations only
+	size_t			size;
+		// the usable size of the allocation
+	size_t			area_size;
+};
+
+struct heap_size_class {
+	mutex			lock;
+	heap_span*		partial_spans;
+		// the spans that have free objects left
+	int32			span_count;
+	int32			used_objects;
+		// objects handed out to the thread caches, or the application
+	uint32			size;
+	uint32			batch_count;
+};
+
+struct thread_cache {
+	free_object*	lists[kSizeClassCount];
+	uint32			counts[kSizeClassCount];
+};
+
+// marks a thread that must not get a cache (anymore)
+static thread_cache* const kNoThreadCache = (thread_cache*)1;
+
+
+static heap_size_class sSizeClasses[kSizeClassCount];
+static uint8 sSizeClassIndex[kMaxSmallSize / kAlignment + 1];
+static int32 sCacheSlot = -1;
+
+// the address range the spans and large allocations are placed in,
+// protected by sRegionLock, as well as the empty span cache
+static mutex sRegionLock = MUTEX_INITIALIZER("heap regions");
+static addr_t sReservationBase;
+static addr_t sReservationEnd;
+static addr_t sNextRegionBase;
+static addr_t sFreeSpanAddresses[kMaxFreeSpanAddresses];
+static uint32 sFreeSpanAddressCount;
+static heap_span* sEmptySpans;
+static uint32 sEmptySpanCount;
+
+static int32 sSpanCount;
+static int64 sLargeBytes;
+
+
+static void
+init_size_classes()
+{
+	uint32 index = 0;
+	for (size_t size = kAlignment; size <= 128; size += kAlignment)
+		sSizeClasses[index++].size = size;
+
+	// four classes per power of two keep the waste below 25%
+	for (size_t base = 128; base < kMaxSmallSize; base *= 2) {
+		for (size_t i = 1; i <= 4; i++)
+			sSizeClasses[index++].size = base + i * base / 4;
+	}
+
+	for (uint32 i = 0; i < kSizeClassCount; i++) {
+		heap_size_class& sizeClass = sSizeClasses[i];
+		mutex_init_etc(&sizeClass.lock, "heap size class",
+			MUTEX_FLAG_ADAPTIVE);
+
+		sizeClass.batch_count = kBatchBytes / sizeClass.size;
+		if (sizeClass.batch_count < 2)
+			sizeClass.batch_count = 2;
+		else if (sizeClass.batch_count > kMaxBatchCount)
+			sizeClass.batch_count = kMaxBatchCount;
+	}
+
+	uint32 sizeClass = 0;
+	for (size_t i = 0; i <= kMaxSmallSize / kAlignment; i++) {
+		while (sSizeClasses[sizeClass].size < i * kAlignment)
+			sizeClass++;
+		sSizeClassIndex[i] = sizeClass;
+	}
+}
+
+
+static inline uint32
+size_class_for(size_t size)
+{
+	return sSizeClassIndex[(size + kAlignment - 1) / kAlignment];
+}
+
+
+static inline heap_span*
+span_for(void* address)
+{
+	addr_t base = (addr_t)address & ~kSpanMask;
+	if (base == (addr_t)address) {
+		// only kSpanSize aligned large allocations start at a span boundary
+		base -= kSpanSize;
+	}
+
+	return (heap_span*)base;
+}
+
+
+//	#pragma mark - regions
+
+
+static uint32
+region_protection()
+{
+	uint32 protection = B_READ_AREA | B_WRITE_AREA;
+	if (__gABIVersion < B_HAIKU_ABI_GCC_2_HAIKU)
+		protection |= B_EXECUTE_AREA;
+
+	return protection;
+}
+
+
+static area_id
+create_region_at(addr_t address, size_t size)
+{
+	void* base = (void*)address;
+	return create_area("heap", &base, B_EXACT_ADDRESS, size, B_NO_LOCK,
+		region_protection());
+}
+
+
+/*!	Creates an area of \a size bytes at an \a alignment aligned address.
+	\a alignment must be a power of two, and at least B_PAGE_SIZE.
+*/
+static void*
+allocate_region(size_t size, size_t alignment, area_id& _area)
+{
+	MutexLocker locker(sRegionLock);
+
+	// reuse the address of a span that has been returned before
+	while (size == kSpanSize && alignment == kSpanSize
+		&& sFreeSpanAddressCount > 0) {
+		addr_t address = sFreeSpanAddresses[--sFreeSpanAddressCount];
+		area_id area = create_region_at(address, size);
+		if (area == B_NO_MEMORY)
+			return NULL;
+		if (area >= 0) {
+			_area = area;
+			return (void*)address;
+		}
+	}
+
+	// take the next range of the reserved address range
+	if (sNextRegionBase != 0) {
+		addr_t address = (sNextRegionBase + alignment - 1) & ~(alignment - 1);
+		if (address >= sNextRegionBase && address + size > address
+			&& address + size <= sReservationEnd) {
+			area_id area = create_region_at(address, size);
+			if (area == B_NO_MEMORY)
+				return NULL;
+
+			// if another area is in the way, skip its range
+			sNextRegionBase = address + size;
+
+			if (area >= 0) {
+				_area = area;
+				return (void*)address;
+			}
+		}
+	}
+
+	locker.Unlock();
+
+	// Let the kernel choose an address range that is large enough for an
+	// aligned area, and replace the area with one at the aligned address.
+	for (int32 tries = 0; tries < 8; tries++) {
+		void* base;
+		area_id area = create_area("heap", &base, B_ANY_ADDRESS,
+			size + alignment, B_NO_LOCK, B_READ_AREA);
+		if (area < 0)
+			return NULL;
+
+		delete_area(area);
+
+		addr_t address = ((addr_t)base + alignment - 1) & ~(alignment - 1);
+		area = create_region_at(address, size);
+		if (area == B_NO_MEMORY)
+			return NULL;
+		if (area >= 0) {
+			_area = area;
+			return (void*)address;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void
+free_span_region(heap_span* span)
+{
+	addr_t address = (addr_t)span;
+	delete_area(span->area);
+	atomic_add(&sSpanCount, -1);
+
+	MutexLocker locker(sRegionLock);
+	if (address >= sReservationBase && address < sReservationEnd
+		&& sFreeSpanAddressCount < kMaxFreeSpanAddresses) {
+		sFreeSpanAddresses[sFreeSpanAddressCount++] = address;
+	}
+}
+
+
+//	#pragma mark - spans
+
+
+static void
+init_span(heap_span* span, uint32 sizeClass)
+{
+	size_t objectSize = sSizeClasses[sizeClass].size;
+
+	span->magic = kSmallSpanMagic;
+	span->next = NULL;
+	span->previous = NULL;
+	span->free_list = NULL;
+	span->size_class = sizeClass;
+	span->used_count = 0;
+	span->object_count = (kSpanSize - sizeof(heap_span)) / objectSize;
+	span->unused = (addr_t)span + kSpanSize
+		- span->object_count * objectSize;
+}
+
+
+static heap_span*
+allocate_span(uint32 sizeClass)
+{
+	heap_span* span = NULL;
+
+	mutex_lock(&sRegionLock);
+	if (sEmptySpans != NULL) {
+		span = sEmptySpans;
+		sEmptySpans = span->next;
+		sEmptySpanCount--;
+	}
+	mutex_unlock(&sRegionLock);
+
+	if (span == NULL) {
+		area_id area;
+		span = (heap_span*)allocate_region(kSpanSize, kSpanSize, area);
+		if (span == NULL)
+			return NULL;
+
+		span->area = area;
+		atomic_add(&sSpanCount, 1);
+	}
+
+	init_span(span, sizeClass);
+	return span;
+}
+
+
+static void
+release_span(heap_span* span)
+{
+	MutexLocker locker(sRegionLock);
+	if (sEmptySpanCount < kMaxCachedEmptySpans) {
+		span->next = sEmptySpans;
+		sEmptySpans = span;
+		sEmptySpanCount++;
+		return;
+	}
+
+	locker.Unlock();
+	free_span_region(span);
+}
+
+
+static inline void
+link_span(heap_size_class& sizeClass, heap_span* span)
+{
+	span->previous = NULL;
+	span->next = sizeClass.partial_spans;
+	if (span->next != NULL)
+		span->next->previous = span;
+	sizeClass.partial_spans = span;
+}
+
+
+static inline void
+unlink_span(heap_size_class& sizeClass, heap_span* span)
+{
+	if (span->previous != NULL)
+		span->previous->next = span->next;
+	else
+		sizeClass.partial_spans = span->next;
+	if (span->next != NULL)
+		span->next->previous = span->previous;
+}
+
+
+/*!	Takes up to \a count free objects of the size class from its spans, and
+	returns them as a list in \a _list.
+	\return The number of objects in the list.
+*/
+static uint32
+central_allocate(uint32 sizeClassIndex, uint32 count, free_object*& _list)
+{
+	heap_size_class& sizeClass = sSizeClasses[sizeClassIndex];
+	MutexLocker locker(sizeClass.lock);
+
+	free_object* list = NULL;
+	free_object** tail = &list;
+	uint32 allocated = 0;
+
+	while (allocated < count) {
+		heap_span* span = sizeClass.partial_spans;
+		if (span == NULL) {
+			locker.Unlock();
+			span = allocate_span(sizeClassIndex);
+			locker.Lock();
+
+			if (span == NULL)
+				break;
+
+			link_span(sizeClass, span);
+			sizeClass.span_count++;
+		}
+
+		while (allocated < count && span->used_count < span->object_count) {
+			free_object* object = span->free_list;
+			if (object != NULL)
+				span->free_list = object->next;
+			else {
+				object = (free_object*)span->unused;
+				span->unused += sizeClass.size;
+			}
+
+			*tail = object;
+			tail = &object->next;
+			span->used_count++;
+			allocated++;
+		}
+
+		if (span->used_count == span->object_count)
+			unlink_span(sizeClass, span);
+	}
+
+	*tail = NULL;
+	sizeClass.used_objects += allocated;
+
+	_list = list;
+	return allocated;
+}
+
+
+/*!	Returns the objects in \a list to their spans. Spans that become empty
+	are released, unless they are the last one of their size class.
+*/
+static void
+central_free(uint32 sizeClassIndex, free_object* list)
+{
+	heap_size_class& sizeClass = sSizeClasses[sizeClassIndex];
+	heap_span* emptySpans = NULL;
+
+	MutexLocker locker(sizeClass.lock);
+
+	while (list != NULL) {
+		free_object* object = list;
+		list = object->next;
+
+		heap_span* span = span_for(object);
+		if (span->used_count == span->object_count)
+			link_span(sizeClass, span);
+
+		object->next = span->free_list;
+		span->free_list = object;
+		sizeClass.used_objects--;
+
+		if (--span->used_count == 0 && sizeClass.span_count > 1) {
+			unlink_span(sizeClass, span);
+			sizeClass.span_count--;
+
+			span->next = emptySpans;
+			emptySpans = span;
+		}
+	}
+
+	locker.Unlock();
+
+	while (emptySpans != NULL) {
+		heap_span* span = emptySpans;
+		emptySpans = span->next;
+		release_span(span);
+	}
+}
+
+
+//	#pragma mark - thread caches
+
+
+static void
+destroy_thread_cache(void* _cache)
+{
+	thread_cache* cache = (thread_cache*)_cache;
+
+	defer_signals();
+
+	// whatever this thread frees from now on goes to the spans directly
+	tls_set(sCacheSlot, kNoThreadCache);
+
+	for (uint32 i = 0; i < kSizeClassCount; i++) {
+		if (cache->lists[i] != NULL)
+			central_free(i, cache->lists[i]);
+	}
+
+	free_object* object = (free_object*)cache;
+	object->next = NULL;
+	central_free(size_class_for(sizeof(thread_cache)), object);
+
+	undefer_signals();
+}
+
+
+static thread_cache*
+create_thread_cache()
+{
+	// on_exit_thread() allocates memory, too -- don't get here again
+	tls_set(sCacheSlot, kNoThreadCache);
+
+	free_object* object;
+	if (central_allocate(size_class_for(sizeof(thread_cache)), 1, object)
+			== 0) {
+		tls_set(sCacheSlot, NULL);
+		return NULL;
+	}
+
+	thread_cache* cache = (thread_cache*)object;
+	memset(cache, 0, sizeof(thread_cache));
+	tls_set(sCacheSlot, cache);
+
+	if (on_exit_thread(&destroy_thread_cache, cache) != B_OK) {
+		destroy_thread_cache(cache);
+		tls_set(sCacheSlot, NULL);
+		return NULL;
+	}
+
+	return cache;
+}
+
+
+static inline thread_cache*
+get_thread_cache()
+{
+	if (sCacheSlot < 0)
+		return NULL;
+
+	thread_cache* cache = (thread_cache*)tls_get(sCacheSlot);
+	if (cache == kNoThreadCache)
+		return NULL;
+	if (cache == NULL)
+		return create_thread_cache();
+
+	return cache;
+}
+
+
+//	#pragma mark - allocation
+
+
+static void*
+allocate_small(uint32 sizeClass)
+{
+	free_object* object;
+
+	thread_cache* cache = get_thread_cache();
+	if (cache == NULL) {
+		if (central_allocate(sizeClass, 1, object) == 0)
+			return NULL;
+		return object;
+	}
+
+	object = cache->lists[sizeClass];
+	if (object == NULL) {
+		uint32 count = central_allocate(sizeClass,
+			sSizeClasses[sizeClass].batch_count, object);
+		if (count == 0)
+			return NULL;
+
+		cache->counts[sizeClass] = count;
+	}
+
+	cache->lists[sizeClass] = object->next;
+	cache->counts[sizeClass]--;
+	return object;
+}
+
+
+static void
+free_small(heap_span* span, void* address)
+{
+	uint32 sizeClass = span->size_class;
+	free_object* object = (free_object*)address;
+
+	thread_cache* cache = get_thread_cache();
+	if (cache == NULL) {
+		object->next = NULL;
+		central_free(sizeClass, object);
+		return;
+	}
+
+	object->next = cache->lists[sizeClass];
+	cache->lists[sizeClass] = object;
+
+	uint32 batchCount = sSizeClasses[sizeClass].batch_count;
+	if (++cache->counts[sizeClass] <= 2 * batchCount)
+		return;
+
+	// keep the most recently freed batch, and return the older objects
+	free_object* last = object;
+	for (uint32 i = 1; i < batchCount; i++)
+		last = last->next;
+
+	free_object* list = last->next;
+	last->next = NULL;
+	cache->counts[sizeClass] = batchCount;
+
+	central_free(sizeClass, list);
+}
+
+
+static void*
+allocate_large(size_t size, size_t alignment)
+{
+	size_t regionAlignment = kSpanSize;
+	size_t offset;
+	size_t headerOffset = 0;
+
+	if (alignment < kSpanSize) {
+		if (alignment < kAlignment)
+			alignment = kAlignment;
+		offset = (sizeof(heap_span) + alignment - 1) & ~(alignment - 1);
+	} else {
+		regionAlignment = alignment;
+		offset = alignment;
+		headerOffset = alignment - kSpanSize;
+	}
+
+	if (size > ~(size_t)0 - offset - regionAlignment - B_PAGE_SIZE)
+		return NULL;
+
+	size_t areaSize = (offset + size + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+
+	area_id area;
+	addr_t base = (addr_t)allocate_region(areaSize, regionAlignment, area);
+	if (base == 0)
+		return NULL;
+
+	heap_span* span = (heap_span*)(base + headerOffset);
+	span->magic = kLargeSpanMagic;
+	span->area = area;
+	span->size = areaSize - offset;
+	span->area_size = areaSize;
+
+	atomic_add64(&sLargeBytes, areaSize);
+	return (void*)(base + offset);
+}
+
+
+static void
+free_large(heap_span* span)
+{
+	atomic_add64(&sLargeBytes, -(int64)span->area_size);
+	delete_area(span->area);
+}
+
+
+/*!	Tries to resize the area of a large allocation to hold \a newSize bytes.
+*/
+static bool
+resize_large(heap_span* span, size_t newSize)
+{
+	size_t offset = span->area_size - span->size;
+	if (newSize > ~(size_t)0 - offset - B_PAGE_SIZE)
+		return false;
+
+	size_t areaSize = (offset + newSize + B_PAGE_SIZE - 1)
+		& ~(B_PAGE_SIZE - 1);
+	if (resize_area(span->area, areaSize) != B_OK)
+		return false;
+
+	atomic_add64(&sLargeBytes, (int64)areaSize - (int64)span->area_size);
+	span->size = areaSize - offset;
+	span->area_size = areaSize;
+	return true;
+}
+
+
+static void*
+allocate(size_t size, size_t alignment)
+{
+	if (alignment <= kAlignment) {
+		if (size <= kMaxSmallSize)
+			return allocate_small(size_class_for(size));
+
+		return allocate_large(size, 0);
+	}
+
+	if (size <= kMaxSmallSize && alignment <= kMaxSmallSize) {
+		// objects of a size class that is a multiple of the alignment are
+		// always aligned, as they are packed towards the span's end
+		uint32 sizeClass = size_class_for(size);
+		while (sSizeClasses[sizeClass].size % alignment != 0)
+			sizeClass++;
+
+		return allocate_small(sizeClass);
+	}
+
+	return allocate_large(size, alignment);
+}
+
+
+static void
+fork_prepare(void)
+{
+	for (uint32 i = 0; i < kSizeClassCount; i++)
+		mutex_lock(&sSizeClasses[i].lock);
+	mutex_lock(&sRegionLock);
+}
+
+
+static void
+fork_finish(void)
+{
+	mutex_unlock(&sRegionLock);
+	for (uint32 i = 0; i < kSizeClassCount; i++)
+		mutex_unlock(&sSizeClasses[i].lock);
+}
+
+
+static void*
+heap_sbrk(long size)
+{
+	if (size <= 0)
+		return NULL;
+
+	void* address;
+	area_id area = create_area("sbrk heap", &address, B_ANY_ADDRESS,
+		((size_t)size + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1), B_NO_LOCK,
+		region_protection());
+	if (area < 0)
+		return NULL;
+
+	return address;
+}
+
+
+extern "C" void* (*sbrk_hook)(long);
+void* (*sbrk_hook)(long) = &heap_sbrk;
+
+
+//	#pragma mark - init
+
+
+extern "C" status_t
+__init_heap(void)
+{
+	init_size_classes();
+
+	// Reserve an address range for the spans, so that they are placed
+	// closely together; it may get reclaimed by other areas, though.
+	void* base = (void*)kHeapReservationBase;
+	if (_kern_reserve_address_range((addr_t*)&base, B_RANDOMIZED_BASE_ADDRESS,
+			kHeapReservationSize) == B_OK) {
+		sReservationBase = (addr_t)base;
+		sReservationEnd = sReservationBase + kHeapReservationSize;
+		sNextRegionBase = sReservationBase;
+	}
+
+	sCacheSlot = tls_allocate();
+
+	__register_atfork(&fork_prepare, &fork_finish, &fork_finish);
+		// Note: Needs malloc(). Hence we need to be fully initialized.
+
+	return B_OK;
+}
+
+
+extern "C" void
+__init_heap_post_env(void)
+{
+	// no heap options available
+}
+
+
+//	#pragma mark - public functions
+
+
+extern "C" void*
+malloc(size_t size)
+{
+	defer_signals();
+	void* address = allocate(size, 0);
+	undefer_signals();
+
+	if (address == NULL)
+		__set_errno(B_NO_MEMORY);
+
+	return address;
+}
+
+
+extern "C" void*
+calloc(size_t numElements, size_t size)
+{
+	if (size != 0 && numElements > ~(size_t)0 / size) {
+		__set_errno(B_NO_MEMORY);
+		return NULL;
+	}
+
+	void* address = malloc(numElements * size);
+	if (address != NULL)
+		memset(address, 0, numElements * size);
+
+	return address;
+}
+
+
+extern "C" void
+free(void* address)
+{
+	if (address == NULL)
+		return;
+
+	defer_signals();
+
+	heap_span* span = span_for(address);
+	if (span->magic == kSmallSpanMagic)
+		free_small(span, address);
+	else if (span->magic == kLargeSpanMagic)
+		free_large(span);
+	else {
+		debug_printf("free(): %p was not allocated by malloc()\n", address);
+		debugger("free(): invalid address");
+	}
+
+	undefer_signals();
+}
+
+
+extern "C" void*
+memalign(size_t alignment, size_t size)
+{
+	if ((alignment & (alignment - 1)) != 0) {
+		__set_errno(B_BAD_VALUE);
+		return NULL;
+	}
+
+	defer_signals();
+	void* address = allocate(size, alignment);
+	undefer_signals();
+
+	if (address == NULL)
+		__set_errno(B_NO_MEMORY);
+
+	return address;
+}
+
+
+extern "C" int
+posix_memalign(void** _pointer, size_t alignment, size_t size)
+{
+	if ((alignment & (sizeof(void*) - 1)) != 0
+		|| (alignment & (alignment - 1)) != 0 || _pointer == NULL) {
+		return B_BAD_VALUE;
+	}
+
+	defer_signals();
+	void* pointer = allocate(size, alignment);
+	undefer_signals();
+
+	if (pointer == NULL)
+		return B_NO_MEMORY;
+
+	*_pointer = pointer;
+	return 0;
+}
+
+
+extern "C" void*
+valloc(size_t size)
+{
+	return memalign(B_PAGE_SIZE, size);
+}
+
+
+extern "C" void*
+realloc(void* address, size_t newSize)
+{
+	if (address == NULL)
+		return malloc(newSize);
+
+	if (newSize == 0) {
+		free(address);
+		return NULL;
+	}
+
+	defer_signals();
+
+	heap_span* span = span_for(address);
+	size_t oldSize;
+	if (span->magic == kSmallSpanMagic)
+		oldSize = sSizeClasses[span->size_class].size;
+	else {
+		oldSize = span->size;
+
+		// shrink, or grow the area in place, if possible
+		if ((newSize < oldSize && oldSize - newSize >= kSpanSize)
+			|| newSize > oldSize) {
+			if (resize_large(span, newSize)) {
+				undefer_signals();
+				return address;
+			}
+		}
+	}
+
+	undefer_signals();
+
+	// if the existing object can hold the new size, just return it
+	if (newSize <= oldSize)
+		return address;
+
+	void* newAddress = malloc(newSize);
+	if (newAddress == NULL)
+		return NULL;
+
+	memcpy(newAddress, address, oldSize);
+	free(address);
+
+	return newAddress;
+}
+
+
+//	#pragma mark - BeOS specific extensions
+
+
+struct mstats {
+	size_t bytes_total;
+	size_t chunks_used;
+	size_t bytes_used;
+	size_t chunks_free;
+	size_t bytes_free;
+};
+
+
+extern "C" struct mstats mstats(void);
+
+extern "C" struct mstats
+mstats(void)
+{
+	// Note, the stats structure is not thread-safe, but it doesn't
+	// matter that much either
+	static struct mstats stats;
+
+	size_t used = 0;
+	size_t chunks = 0;
+
+	defer_signals();
+
+	for (uint32 i = 0; i < kSizeClassCount; i++) {
+		heap_size_class& sizeClass = sSizeClasses[i];
+		MutexLocker locker(sizeClass.lock);
+
+		// objects in the thread caches are counted as used
+		if (sizeClass.used_objects > 0)
+			chunks++;
+		used += (size_t)sizeClass.used_objects * sizeClass.size;
+	}
+
+	undefer_signals();
+
+	size_t total = (size_t)sSpanCount * kSpanSize + (size_t)sLargeBytes;
+	used += (size_t)sLargeBytes;
+
+	stats.bytes_total = total;
+	stats.chunks_used = chunks;
+	stats.bytes_used = used;
+	stats.chunks_free = kSizeClassCount - chunks;
+	stats.bytes_free = total - used;
+
+	return stats;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the random read performance of a raw disk device with an
+	increasing number of threads, each of which keeps one request in flight,
+	so that it shows how well a driver handles many concurrent requests.
+	It also measures the latency of flushing the drive cache. The device is
+	only read from.
+	Usage: disk_iops_benchmark <raw device> [seconds] [block size]
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Drivers.h>
+#include <OS.h>
+
+
+static const int32 kMaxThreads = 64;
+static const int32 kFlushCount = 100;
+
+static const char* sDevice;
+static int sFD;
+static off_t sBlockCount;
+static size_t sBlockSize = 4096;
+static bigtime_t sDuration = 5000000;
+static int32 sQuit;
+
+
+static status_t
+reader_thread(void* _operations)
+{
+	int64* _operationCount = (int64*)_operations;
+
+	void* buffer = malloc(sBlockSize);
+	if (buffer == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	uint32 seed = (uint32)find_thread(NULL);
+	int64 operations = 0;
+
+	while (atomic_get(&sQuit) == 0) {
+		off_t block = (((off_t)rand_r(&seed) << 31) | rand_r(&seed))
+			% sBlockCount;
+		ssize_t bytesRead = read_pos(sFD, block * sBlockSize, buffer,
+			sBlockSize);
+		if (bytesRead != (ssize_t)sBlockSize) {
+			fprintf(stderr, "Reading from %s failed: %s\n", sDevice,
+				strerror(bytesRead < 0 ? errno : B_ERROR));
+			exit(1);
+		}
+		operations++;
+	}
+
+	free(buffer);
+	*_operationCount = operations;
+	return B_OK;
+}
+
+
+static int64
+run(int32 threadCount)
+{
+	thread_id threads[kMaxThreads];
+	int64 operations[kMaxThreads];
+
+	sQuit = 0;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(reader_thread, "reader", B_NORMAL_PRIORITY,
+			&operations[i]);
+		resume_thread(threads[i]);
+	}
+
+	snooze(sDuration);
+	atomic_set(&sQuit, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		total += operations[i];
+	}
+
+	return total * 1000000 / sDuration;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <raw device> [seconds] [block size]\n",
+			argv[0]);
+		return 1;
+	}
+
+	sDevice = argv[1];
+	if (argc > 2)
+		sDuration = max_c(atoi(argv[2]), 1) * 1000000LL;
+	if (argc > 3)
+		sBlockSize = max_c(atoi(argv[3]) / 512, 1) * 512;
+
+	sFD = open(sDevice, O_RDONLY);
+	if (sFD < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", sDevice, strerror(errno));
+		return 1;
+	}
+
+	device_geometry geometry;
+	if (ioctl(sFD, B_GET_GEOMETRY, &geometry, sizeof(geometry)) != 0) {
+		fprintf(stderr, "Could not get the geometry of %s: %s\n", sDevice,
+			strerror(errno));
+		return 1;
+	}
+
+	off_t size = (off_t)geometry.bytes_per_sector
+		* geometry.sectors_per_track * geometry.cylinder_count
+		* geometry.head_count;
+	sBlockCount = size / sBlockSize;
+	if (sBlockCount == 0) {
+		fprintf(stderr, "%s is too small\n", sDevice);
+		return 1;
+	}
+
+	printf("%s: %" B_PRIdOFF " MB, %" B_PRIuSIZE " byte random reads\n",
+		sDevice, size / 1024 / 1024, sBlockSize);
+
+	int64 baseline = 0;
+	for (int32 threadCount = 1; threadCount <= kMaxThreads; threadCount *= 2) {
+		int64 iops = run(threadCount);
+		if (baseline == 0)
+			baseline = max_c(iops, 1);
+
+		printf("%3" B_PRId32 " threads: %8" B_PRId64 " IOPS, %6" B_PRId64
+			" MB/s (%3" B_PRId64 "%%)\n", threadCount, iops,
+			iops * (int64)sBlockSize / 1024 / 1024, iops * 100 / baseline);
+	}
+
+	bigtime_t start = system_time();
+	int32 flushCount = 0;
+	for (; flushCount < kFlushCount; flushCount++) {
+		if (ioctl(sFD, B_FLUSH_DRIVE_CACHE, NULL, 0) != 0) {
+			printf("flush: %s\n", strerror(errno));
+			break;
+		}
+	}
+	if (flushCount == kFlushCount) {
+		printf("flush: %" B_PRId64 " us\n",
+			(system_time() - start) / kFlushCount);
+	}
+
+	close(sFD);
+	return 0;
+}
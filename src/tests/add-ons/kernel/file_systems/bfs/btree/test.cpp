@@ -42,7 +42,7 @@ key* gKeys;
 int32 gNum = DEFAULT_NUM_KEYS;
 int32 gType = DEFAULT_KEY_TYPE;
 int32 gTreeCount = 0;
-bool gVerbose, gExcessive;
+bool gVerbose, gExcessive, gBulk;
 int32 gIterations = DEFAULT_ITERATIONS;
 int32 gHard = 1;
 Volume* gVolume;
@@ -419,9 +419,42 @@ checkTree(BPlusTree* tree)
 //	#pragma mark - "Torture" functions
 
 
+void
+bulkAddAllKeys(Transaction& transaction, BPlusTree* tree)
+{
+	printf("*** Bulk adding all keys to the tree...\n");
+
+	key_and_value* entries = new key_and_value[gNum];
+	for (int32 i = 0; i < gNum; i++) {
+		entries[i].key = (uint8*)gKeys[i].data;
+		entries[i].keyLength = gKeys[i].length;
+		entries[i].value = gKeys[i].value;
+	}
+
+	status_t status = tree->BulkInsert(transaction, entries, gNum);
+	delete[] entries;
+
+	if (status != B_OK) {
+		printf("BPlusTree::BulkInsert() returned: %s\n", strerror(status));
+		bailOut();
+	}
+
+	for (int32 i = 0; i < gNum; i++)
+		gKeys[i].in++;
+	gTreeCount += gNum;
+
+	checkTree(tree);
+}
+
+
 void
 addAllKeys(Transaction& transaction, BPlusTree* tree)
 {
+	if (gBulk) {
+		bulkAddAllKeys(transaction, tree);
+		return;
+	}
+
 	printf("*** Adding all keys to the tree...\n");
 	for (int32 i = 0; i < gNum; i++) {
 		status_t status = tree->Insert(transaction, (uint8*)gKeys[i].data,
@@ -620,7 +653,7 @@ usage(char* program)
 {
 	if (strrchr(program, '/'))
 		program = strrchr(program, '/') + 1;
-	fprintf(stderr, "usage: %s [-veh] [-t type] [-n keys] [-i iterations] "
+	fprintf(stderr, "usage: %s [-vebh] [-t type] [-n keys] [-i iterations] "
 			"[-h times] [-r seed]\n"
 		"BFS B+Tree torture test\n"
 		"\t-t\ttype is one of string, int32, uint32, int64, uint64, float,\n"
@@ -630,6 +663,8 @@ usage(char* program)
 		"\t-i\titerations is the number of the test cycles, defaults to %d.\n"
 		"\t-r\tthe seed for the random function, defaults to %ld.\n"
 		"\t-h\tremoves the keys and start over again for x times.\n"
+		"\t-b\tadd the keys with BPlusTree::BulkInsert() at the start of\n"
+		"\t\tevery cycle.\n"
 		"\t-e\texcessive validity tests: tree contents will be tested after "
 			"every operation\n"
 		"\t-v\tfor verbose output.\n",
@@ -657,6 +692,9 @@ main(int argc, char** argv)
 					case 'e':
 						gExcessive = true;
 						break;
+					case 'b':
+						gBulk = true;
+						break;
 					case 't':
 						if (*++argv == NULL)
 							usage(program);
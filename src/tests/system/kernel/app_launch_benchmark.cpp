@@ -0,0 +1,91 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how long launching a program takes, and how many page faults
+	that causes, averaged over a number of runs. The program should exit right
+	away (for example when passed "--help" or "--version").
+	Usage: app_launch_benchmark [-n <runs>] <program> [<arguments> ...]
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+#include <image.h>
+
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: app_launch_benchmark [-n <runs>] <program> "
+		"[<arguments> ...]\n");
+	exit(1);
+}
+
+
+static uint32
+page_faults()
+{
+	system_info info;
+	get_system_info(&info);
+	return info.page_faults;
+}
+
+
+int
+main(int argc, const char** argv)
+{
+	int32 runs = 20;
+
+	int argi = 1;
+	if (argi + 1 < argc && strcmp(argv[argi], "-n") == 0) {
+		runs = atoi(argv[argi + 1]);
+		argi += 2;
+	}
+	if (argi >= argc || runs <= 0)
+		usage();
+
+	bigtime_t totalTime = 0;
+	bigtime_t minTime = B_INFINITE_TIMEOUT;
+	uint64 totalFaults = 0;
+
+	// The first run populates the caches, only the others are measured.
+	for (int32 run = -1; run < runs; run++) {
+		uint32 faults = page_faults();
+		bigtime_t start = system_time();
+
+		thread_id thread = load_image(argc - argi, argv + argi,
+			(const char**)environ);
+		if (thread < 0) {
+			fprintf(stderr, "Failed to load \"%s\": %s\n", argv[argi],
+				strerror(thread));
+			return 1;
+		}
+
+		status_t returnValue;
+		resume_thread(thread);
+		wait_for_thread(thread, &returnValue);
+
+		bigtime_t time = system_time() - start;
+		faults = page_faults() - faults;
+
+		if (run < 0)
+			continue;
+
+		totalTime += time;
+		totalFaults += faults;
+		if (time < minTime)
+			minTime = time;
+	}
+
+	printf("%s: %" B_PRId32 " runs, %" B_PRId64 " usecs average, %" B_PRId64
+		" usecs minimum, %" B_PRIu64 " page faults per launch\n", argv[argi],
+		runs, totalTime / runs, minTime, totalFaults / runs);
+
+	return 0;
+}
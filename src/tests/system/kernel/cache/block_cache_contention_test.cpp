@@ -0,0 +1,152 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the throughput of concurrent block_cache_get()/block_cache_put()
+	calls on a working set that is completely cached.
+	Usage: block_cache_contention_test [threads] [blocks] [seconds]
+*/
+
+
+#define BUILDING_USERLAND_FS_SERVER
+	// the kernelland emulation does not provide asynchronous I/O
+
+#define write_pos	block_cache_write_pos
+#define writev_pos	block_cache_writev_pos
+#define read_pos	block_cache_read_pos
+
+#include "block_cache.cpp"
+
+#undef write_pos
+#undef writev_pos
+#undef read_pos
+
+
+static const size_t kBlockSize = 2048;
+static const int32 kMaxThreads = 64;
+
+static int32 sNumBlocks = 4096;
+static bigtime_t sDuration = 2000000;
+static void* sCache;
+static int32 sQuit;
+
+
+ssize_t
+block_cache_write_pos(int fd, off_t offset, const void* buffer, size_t size)
+{
+	return size;
+}
+
+
+ssize_t
+block_cache_writev_pos(int fd, off_t offset, const iovec* vecs, size_t count)
+{
+	ssize_t length = 0;
+	for (size_t i = 0; i < count; i++)
+		length += vecs[i].iov_len;
+
+	return length;
+}
+
+
+ssize_t
+block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
+{
+	memset(buffer, 0, size);
+	*(off_t*)buffer = offset / kBlockSize;
+	return size;
+}
+
+
+static status_t
+get_put_thread(void* _count)
+{
+	int64* _operations = (int64*)_count;
+	uint32 seed = (uint32)find_thread(NULL) * 2654435761U;
+	int64 operations = 0;
+
+	while (atomic_get(&sQuit) == 0) {
+		seed = seed * 1103515245 + 12345;
+		off_t blockNumber = (seed >> 8) % sNumBlocks;
+
+		const void* data = block_cache_get(sCache, blockNumber);
+		if (data == NULL || *(const off_t*)data != blockNumber) {
+			fprintf(stderr, "block %" B_PRIdOFF " has bad contents!\n",
+				blockNumber);
+			exit(1);
+		}
+		block_cache_put(sCache, blockNumber);
+		operations++;
+	}
+
+	*_operations = operations;
+	return B_OK;
+}
+
+
+static int64
+run(int32 numThreads)
+{
+	thread_id threads[kMaxThreads];
+	int64 operations[kMaxThreads];
+
+	sQuit = 0;
+
+	for (int32 i = 0; i < numThreads; i++) {
+		threads[i] = spawn_thread(get_put_thread, "get/put thread",
+			B_NORMAL_PRIORITY, &operations[i]);
+		resume_thread(threads[i]);
+	}
+
+	snooze(sDuration);
+	atomic_set(&sQuit, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < numThreads; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		total += operations[i];
+	}
+
+	return total * 1000000 / sDuration;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = 8;
+	if (argc > 1)
+		maxThreads = min_c(max_c(atoi(argv[1]), 1), kMaxThreads);
+	if (argc > 2)
+		sNumBlocks = max_c(atoi(argv[2]), 1);
+	if (argc > 3)
+		sDuration = max_c(atoi(argv[3]), 1) * 1000000LL;
+
+	block_cache_init();
+
+	sCache = block_cache_create(-1, sNumBlocks, kBlockSize, true);
+	if (sCache == NULL) {
+		fprintf(stderr, "Could not create block cache!\n");
+		return 1;
+	}
+
+	// warm up the cache, so that we only measure cache hits
+	for (int32 i = 0; i < sNumBlocks; i++) {
+		block_cache_get(sCache, i);
+		block_cache_put(sCache, i);
+	}
+
+	printf("%" B_PRId32 " blocks, %" B_PRIu32 " shards\n", sNumBlocks,
+		kBlockShardCount);
+
+	for (int32 numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		printf("%3" B_PRId32 " threads: %10" B_PRId64 " get/put per second\n",
+			numThreads, run(numThreads));
+	}
+
+	block_cache_delete(sCache, false);
+	return 0;
+}
@@ -4,12 +4,17 @@
  */
 
 
+#define BUILDING_USERLAND_FS_SERVER
+	// the kernelland emulation does not provide asynchronous I/O
+
 #define write_pos	block_cache_write_pos
+#define writev_pos	block_cache_writev_pos
 #define read_pos	block_cache_read_pos
 
 #include "block_cache.cpp"
 
 #undef write_pos
+#undef writev_pos
 #undef read_pos
 
 
@@ -133,6 +138,23 @@ block_cache_write_pos(int fd, off_t offset, const void* buffer, size_t size)
 }
 
 
+ssize_t
+block_cache_writev_pos(int fd, off_t offset, const iovec* vecs, size_t count)
+{
+	ssize_t written = 0;
+	for (size_t i = 0; i < count; i++) {
+		ssize_t bytes = block_cache_write_pos(fd, offset + written,
+			vecs[i].iov_base, vecs[i].iov_len);
+		if (bytes < 0)
+			return bytes;
+
+		written += bytes;
+	}
+
+	return written;
+}
+
+
 ssize_t
 block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
 {
@@ -189,7 +211,7 @@ test_blocks(off_t number, int32 count, int32 line)
 	for (int32 i = 0; i < count; i++, number++) {
 		MutexLocker locker(&gCache->lock);
 
-		cached_block* block = (cached_block*)hash_lookup(gCache->hash, &number);
+		cached_block* block = gCache->Lookup(number);
 		if (block == NULL) {
 			if (gBlocks[number].present)
 				error(line, "Block %Ld not found!", number);
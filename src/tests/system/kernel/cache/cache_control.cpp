@@ -8,9 +8,11 @@
 #include <syscalls.h>
 #include <generic_syscall.h>
 
+#include <block_cache.h>
 #include <file_cache.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -20,7 +22,8 @@ extern const char *__progname;
 void
 usage()
 {
-	fprintf(stderr, "usage: %s [clear | unset | set <module-name>]\n", __progname);
+	fprintf(stderr, "usage: %s [clear | stats | blockstats | unset | set <module-name>\n"
+		"\t| writeback [<interval> <expire> <ratio> <blocks-per-pass>]]\n", __progname);
 	exit(0);
 }
 
@@ -42,6 +45,61 @@ main(int argc, char **argv)
 		status = _kern_generic_syscall(CACHE_SYSCALLS, CACHE_CLEAR, NULL, 0);
 		if (status != B_OK)
 			fprintf(stderr, "%s: clearing the cache failed: %s\n", __progname, strerror(status));
+	} else if (!strcmp(argv[1], "stats")) {
+		file_cache_read_ahead_stats stats;
+		status = _kern_generic_syscall(CACHE_SYSCALLS, CACHE_GET_READ_AHEAD_STATS, &stats, sizeof(stats));
+		if (status != B_OK) {
+			fprintf(stderr, "%s: getting the read-ahead statistics failed: %s\n", __progname, strerror(status));
+			return 1;
+		}
+
+		printf("sequential hits:    %" B_PRId64 "\n", stats.sequential_hits);
+		printf("sequential misses:  %" B_PRId64 "\n", stats.sequential_misses);
+		printf("prefetch requests:  %" B_PRId64 "\n", stats.prefetch_requests);
+		printf("prefetched bytes:   %" B_PRId64 "\n", stats.prefetched_bytes);
+	} else if (!strcmp(argv[1], "blockstats")) {
+		block_cache_stats stats[64];
+		status = _kern_generic_syscall(BLOCK_CACHE_SYSCALLS, BLOCK_CACHE_GET_STATS, stats, sizeof(stats));
+		if (status < B_OK) {
+			fprintf(stderr, "%s: getting the block cache statistics failed: %s\n", __progname, strerror(status));
+			return 1;
+		}
+
+		int32 count = min_c(status, (int32)(sizeof(stats) / sizeof(stats[0])));
+		for (int32 i = 0; i < count; i++) {
+			printf("block cache %" B_PRId32 ": %" B_PRIdOFF " blocks of %" B_PRIuSIZE " bytes\n", i, stats[i].max_blocks, stats[i].block_size);
+			printf("  unused blocks:    %" B_PRId32 " (%" B_PRId32 " hot)\n", stats[i].unused_blocks, stats[i].hot_unused_blocks);
+			printf("  hits:             %" B_PRId64 "\n", stats[i].hits);
+			printf("  misses:           %" B_PRId64 "\n", stats[i].misses);
+			printf("  ghost hits:       %" B_PRId64 "\n", stats[i].ghost_hits);
+			printf("  promotions:       %" B_PRId64 "\n", stats[i].promotions);
+			printf("  evictions:        %" B_PRId64 "\n", stats[i].evictions);
+		}
+	} else if (!strcmp(argv[1], "writeback")) {
+		block_cache_writeback_policy policy;
+		if (argc > 5) {
+			policy.interval = strtoll(argv[2], NULL, 0);
+			policy.dirty_expire = strtoll(argv[3], NULL, 0);
+			policy.dirty_ratio = strtoul(argv[4], NULL, 0);
+			policy.blocks_per_pass = strtoul(argv[5], NULL, 0);
+
+			status = _kern_generic_syscall(BLOCK_CACHE_SYSCALLS, BLOCK_CACHE_SET_WRITEBACK_POLICY, &policy, sizeof(policy));
+			if (status != B_OK) {
+				fprintf(stderr, "%s: setting the writeback policy failed: %s\n", __progname, strerror(status));
+				return 1;
+			}
+		}
+
+		status = _kern_generic_syscall(BLOCK_CACHE_SYSCALLS, BLOCK_CACHE_GET_WRITEBACK_POLICY, &policy, sizeof(policy));
+		if (status != B_OK) {
+			fprintf(stderr, "%s: getting the writeback policy failed: %s\n", __progname, strerror(status));
+			return 1;
+		}
+
+		printf("interval:           %" B_PRId64 " usecs\n", policy.interval);
+		printf("dirty expire:       %" B_PRId64 " usecs\n", policy.dirty_expire);
+		printf("dirty ratio:        %" B_PRIu32 "%%\n", policy.dirty_ratio);
+		printf("blocks per pass:    %" B_PRIu32 "\n", policy.blocks_per_pass);
 	} else if (!strcmp(argv[1], "unset")) {
 		status = _kern_generic_syscall(CACHE_SYSCALLS, CACHE_SET_MODULE, NULL, 0);
 		if (status != B_OK)
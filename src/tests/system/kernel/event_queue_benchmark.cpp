@@ -0,0 +1,221 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares waiting for a few active descriptors out of many with poll()
+	and with an event queue, in both level-triggered and edge-triggered mode.
+	In every round, a byte is written into a number of pipes, and the
+	benchmark waits until all of them have been reported and read, like a
+	server with many mostly idle connections would.
+	Usage: event_queue_benchmark [descriptors] [active] [rounds]
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <event_queue_defs.h>
+#include <syscalls.h>
+
+
+static const int kMaxInfos = 64;
+
+static int sCount = 10000;
+static int sActive = 16;
+static int sRounds = 1000;
+static int* sReadFDs;
+static int* sWriteFDs;
+
+
+static void
+activate(int round)
+{
+	// spread the active pipes evenly, so that they are all different
+	int start = (round * 7919) % sCount;
+	for (int i = 0; i < sActive; i++) {
+		int index = (start + i * (sCount / sActive)) % sCount;
+		if (write(sWriteFDs[index], "x", 1) != 1) {
+			fprintf(stderr, "write failed: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+}
+
+
+static void
+consume(int fd)
+{
+	char buffer[16];
+	if (read(fd, buffer, sizeof(buffer)) != 1) {
+		fprintf(stderr, "read failed: %s\n", strerror(errno));
+		exit(1);
+	}
+}
+
+
+static bigtime_t
+run_poll()
+{
+	struct pollfd* fds = (struct pollfd*)malloc(sizeof(pollfd) * sCount);
+	for (int i = 0; i < sCount; i++) {
+		fds[i].fd = sReadFDs[i];
+		fds[i].events = POLLIN;
+	}
+
+	bigtime_t start = system_time();
+
+	for (int round = 0; round < sRounds; round++) {
+		activate(round);
+
+		int left = sActive;
+		while (left > 0) {
+			int ready = poll(fds, sCount, -1);
+			if (ready < 0) {
+				fprintf(stderr, "poll failed: %s\n", strerror(errno));
+				exit(1);
+			}
+
+			for (int i = 0; i < sCount && ready > 0; i++) {
+				if ((fds[i].revents & POLLIN) == 0)
+					continue;
+
+				consume(fds[i].fd);
+				ready--;
+				left--;
+			}
+		}
+	}
+
+	bigtime_t time = system_time() - start;
+	free(fds);
+	return time;
+}
+
+
+static bigtime_t
+run_event_queue(int32 flags, bigtime_t* _setupTime)
+{
+	bigtime_t start = system_time();
+
+	int queue = _kern_event_queue_create(O_CLOEXEC);
+	if (queue < 0) {
+		fprintf(stderr, "Could not create event queue: %s\n",
+			strerror(queue));
+		exit(1);
+	}
+
+	event_wait_info infos[kMaxInfos];
+	for (int i = 0; i < sCount; i += kMaxInfos) {
+		int count = min_c(sCount - i, kMaxInfos);
+		for (int j = 0; j < count; j++) {
+			infos[j].object = sReadFDs[i + j];
+			infos[j].type = B_OBJECT_TYPE_FD;
+			infos[j].events = B_EVENT_READ | flags;
+			infos[j].user_data = NULL;
+		}
+
+		ssize_t selected = _kern_event_queue_select(queue, infos, count);
+		if (selected != count) {
+			fprintf(stderr, "Could not select descriptors: %s\n",
+				strerror(selected < 0 ? selected : B_ERROR));
+			exit(1);
+		}
+	}
+
+	*_setupTime = system_time() - start;
+	start = system_time();
+
+	for (int round = 0; round < sRounds; round++) {
+		activate(round);
+
+		int left = sActive;
+		while (left > 0) {
+			ssize_t count = _kern_event_queue_wait(queue, infos, kMaxInfos,
+				B_RELATIVE_TIMEOUT, B_INFINITE_TIMEOUT);
+			if (count < 0) {
+				fprintf(stderr, "Waiting failed: %s\n", strerror(count));
+				exit(1);
+			}
+
+			for (ssize_t i = 0; i < count; i++) {
+				if ((infos[i].events & B_EVENT_READ) == 0)
+					continue;
+
+				consume(infos[i].object);
+				left--;
+			}
+		}
+	}
+
+	bigtime_t time = system_time() - start;
+	close(queue);
+	return time;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc > 1)
+		sCount = max_c(atoi(argv[1]), 1);
+	if (argc > 2)
+		sActive = min_c(max_c(atoi(argv[2]), 1), sCount);
+	if (argc > 3)
+		sRounds = max_c(atoi(argv[3]), 1);
+
+	struct rlimit limit;
+	limit.rlim_cur = limit.rlim_max = 2 * sCount + 64;
+	if (setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+		fprintf(stderr, "Could not raise the descriptor limit: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	sReadFDs = (int*)malloc(sizeof(int) * sCount);
+	sWriteFDs = (int*)malloc(sizeof(int) * sCount);
+	for (int i = 0; i < sCount; i++) {
+		int fds[2];
+		if (pipe(fds) != 0) {
+			fprintf(stderr, "Could not create pipe %d: %s\n", i,
+				strerror(errno));
+			return 1;
+		}
+		sReadFDs[i] = fds[0];
+		sWriteFDs[i] = fds[1];
+	}
+
+	printf("%d descriptors, %d active, %d rounds\n", sCount, sActive,
+		sRounds);
+
+	bigtime_t pollTime = run_poll();
+	printf("poll():               %8" B_PRId64 " us per round\n",
+		pollTime / sRounds);
+
+	bigtime_t setupTime;
+	bigtime_t time = run_event_queue(0, &setupTime);
+	printf("event queue (level):  %8" B_PRId64 " us per round (%" B_PRId64
+		"x), setup %" B_PRId64 " us\n", time / sRounds,
+		pollTime / max_c(time, 1), setupTime);
+
+	time = run_event_queue(B_EVENT_EDGE_TRIGGERED, &setupTime);
+	printf("event queue (edge):   %8" B_PRId64 " us per round (%" B_PRId64
+		"x), setup %" B_PRId64 " us\n", time / sRounds,
+		pollTime / max_c(time, 1), setupTime);
+
+	for (int i = 0; i < sCount; i++) {
+		close(sReadFDs[i]);
+		close(sWriteFDs[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares random reads of a file or device done by a pool of threads
+	calling pread() with the same reads submitted to an I/O ring, with the
+	same number of reads in flight.
+	Usage: io_ring_benchmark <file> [in flight] [block size] [reads]
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OS.h>
+#include <Drivers.h>
+
+#include <io_ring_defs.h>
+#include <syscalls.h>
+
+
+static const int32 kMaxInFlight = 256;
+
+static int sFD;
+static off_t sBlockCount;
+static size_t sBlockSize = 4096;
+static int32 sInFlight = 32;
+static int32 sReads = 20000;
+static int32 sNextRead;
+
+
+static off_t
+random_offset(uint32& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return (off_t)((seed >> 8) % sBlockCount) * sBlockSize;
+}
+
+
+static status_t
+read_thread(void* _seed)
+{
+	uint32 seed = (uint32)(addr_t)_seed;
+	void* buffer = malloc(sBlockSize);
+
+	while (atomic_add(&sNextRead, 1) < sReads) {
+		if (pread(sFD, buffer, sBlockSize, random_offset(seed)) < 0) {
+			fprintf(stderr, "pread failed: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+
+	free(buffer);
+	return B_OK;
+}
+
+
+static bigtime_t
+run_threads()
+{
+	thread_id threads[kMaxInFlight];
+	sNextRead = 0;
+
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < sInFlight; i++) {
+		threads[i] = spawn_thread(read_thread, "reader", B_NORMAL_PRIORITY,
+			(void*)(addr_t)(i + 1));
+		resume_thread(threads[i]);
+	}
+
+	for (int32 i = 0; i < sInFlight; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+	}
+
+	return system_time() - startTime;
+}
+
+
+static bigtime_t
+run_ring()
+{
+	io_ring_header* header;
+	area_id area;
+	int ring = _kern_io_ring_create(sInFlight, 0, &header, &area);
+	if (ring < 0) {
+		fprintf(stderr, "creating the ring failed: %s\n", strerror(ring));
+		exit(1);
+	}
+
+	io_ring_submission* submissions = (io_ring_submission*)((uint8*)header
+		+ header->submission_offset);
+	io_ring_completion* completions = (io_ring_completion*)((uint8*)header
+		+ header->completion_offset);
+	uint32 submissionMask = header->submission_count - 1;
+	uint32 completionMask = header->completion_count - 1;
+
+	uint8* buffers = (uint8*)malloc(sBlockSize * sInFlight);
+	uint32 seed = 1;
+
+	bigtime_t startTime = system_time();
+
+	int32 submitted = 0;
+	int32 completed = 0;
+	int32 inFlight = 0;
+	while (completed < sReads) {
+		// refill the submission ring; the user data is the buffer index
+		uint32 tail = header->submission_tail;
+		int32 count = 0;
+		while (inFlight + count < sInFlight && submitted + count < sReads) {
+			int32 index = (int32)((tail + count) % sInFlight);
+			io_ring_submission& submission
+				= submissions[(tail + count) & submissionMask];
+			submission.opcode = IO_RING_READ;
+			submission.flags = 0;
+			submission.fd = sFD;
+			submission.offset = random_offset(seed);
+			submission.buffer = buffers + index * sBlockSize;
+			submission.length = sBlockSize;
+			submission.user_data = (void*)(addr_t)index;
+			count++;
+		}
+		atomic_set((int32*)&header->submission_tail, tail + count);
+
+		ssize_t result = _kern_io_ring_enter(ring, count, 1, 0, 0);
+		if (result < 0) {
+			fprintf(stderr, "entering the ring failed: %s\n",
+				strerror(result));
+			exit(1);
+		}
+		submitted += result;
+		inFlight += result;
+
+		// reap all completions
+		uint32 head = header->completion_head;
+		uint32 completionTail = atomic_get((int32*)&header->completion_tail);
+		for (; head != completionTail; head++) {
+			if (completions[head & completionMask].result < 0) {
+				fprintf(stderr, "read failed: %s\n",
+					strerror(completions[head & completionMask].result));
+				exit(1);
+			}
+			completed++;
+			inFlight--;
+		}
+		atomic_set((int32*)&header->completion_head, head);
+	}
+
+	bigtime_t totalTime = system_time() - startTime;
+
+	close(ring);
+	delete_area(area);
+	free(buffers);
+
+	return totalTime;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr,
+			"Usage: %s <file> [in flight] [block size] [reads]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc > 2)
+		sInFlight = min_c(max_c(atoi(argv[2]), 1), kMaxInFlight);
+	if (argc > 3)
+		sBlockSize = max_c(atoi(argv[3]), 1);
+	if (argc > 4)
+		sReads = max_c(atoi(argv[4]), 1);
+
+	sFD = open(argv[1], O_RDONLY);
+	if (sFD < 0) {
+		fprintf(stderr, "opening %s failed: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	struct stat st;
+	fstat(sFD, &st);
+	off_t size = st.st_size;
+	if (S_ISCHR(st.st_mode)) {
+		device_geometry geometry;
+		if (ioctl(sFD, B_GET_GEOMETRY, &geometry, sizeof(geometry)) == 0) {
+			size = (off_t)geometry.bytes_per_sector
+				* geometry.sectors_per_track * geometry.cylinder_count
+				* geometry.head_count;
+		}
+	}
+
+	sBlockCount = size / sBlockSize;
+	if (sBlockCount == 0) {
+		fprintf(stderr, "%s is smaller than a block\n", argv[1]);
+		return 1;
+	}
+
+	printf("%" B_PRId32 " random reads of %" B_PRIuSIZE " bytes, %" B_PRId32
+		" in flight\n", sReads, sBlockSize, sInFlight);
+
+	bigtime_t threadTime = run_threads();
+	printf("threads:  %10" B_PRId64 " us, %8.0f reads/s\n", threadTime,
+		sReads * 1000000.0 / threadTime);
+
+	bigtime_t ringTime = run_ring();
+	printf("io ring:  %10" B_PRId64 " us, %8.0f reads/s (%5.2fx)\n", ringTime,
+		sReads * 1000000.0 / ringTime, (double)threadTime / ringTime);
+
+	close(sFD);
+	return 0;
+}
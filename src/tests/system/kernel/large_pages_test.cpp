@@ -0,0 +1,157 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Creates a fully locked area backed by large pages, and verifies that its
+	contents survive the large pages being split by protection changes and
+	partial unmaps. Also compares the time a random access pattern takes with
+	and without large pages.
+	Usage: large_pages_test [megabytes]
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <OS.h>
+
+#include <vm_defs.h>
+
+
+static const size_t kLargePageSize = 2 * 1024 * 1024;
+
+
+static void
+fill(uint32* data, size_t size)
+{
+	for (size_t i = 0; i < size / sizeof(uint32); i++)
+		data[i] = i * 2654435761U;
+}
+
+
+static bool
+verify(const uint32* data, size_t size, const char* step)
+{
+	for (size_t i = 0; i < size / sizeof(uint32); i++) {
+		if (data[i] != (uint32)(i * 2654435761U)) {
+			fprintf(stderr, "%s: bad data at offset %#" B_PRIxSIZE "\n", step,
+				i * sizeof(uint32));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static bigtime_t
+random_access(uint32* data, size_t size)
+{
+	size_t count = size / sizeof(uint32);
+	uint32 seed = 42;
+	uint32 sum = 0;
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < 16 * 1024 * 1024; i++) {
+		seed = seed * 1103515245 + 12345;
+		sum += data[(seed >> 4) % count];
+	}
+	bigtime_t time = system_time() - start;
+
+	// make sure the loop isn't optimized away
+	if (sum == 0)
+		printf(" ");
+	return time;
+}
+
+
+static area_id
+create_test_area(size_t size, uint32 extraProtection, uint32** _data)
+{
+	return create_area("large pages test", (void**)_data, B_ANY_ADDRESS, size,
+		B_FULL_LOCK, B_READ_AREA | B_WRITE_AREA | extraProtection);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	size_t size = 64 * 1024 * 1024;
+	if (argc > 1)
+		size = max_c(atoi(argv[1]), 4) * 1024 * 1024;
+
+	// Create an area that is a bit larger than a number of large pages, so
+	// that the tail has to be mapped with normal pages.
+	uint32* data;
+	area_id area = create_test_area(size + 3 * B_PAGE_SIZE, B_LARGE_PAGES_AREA,
+		&data);
+	if (area < 0) {
+		fprintf(stderr, "Failed to create area: %s\n", strerror(area));
+		return 1;
+	}
+
+	if ((addr_t)data % kLargePageSize != 0) {
+		fprintf(stderr, "Area at %p is not aligned to the large page size!\n",
+			data);
+		return 1;
+	}
+
+	fill(data, size);
+	if (!verify(data, size, "initial"))
+		return 1;
+
+	// Change the protection of a single page within the second large page
+	// (this splits it), and make sure the data is still there.
+	uint8* page = (uint8*)data + kLargePageSize + 5 * B_PAGE_SIZE;
+	if (mprotect(page, B_PAGE_SIZE, PROT_READ) != 0) {
+		fprintf(stderr, "mprotect() failed: %s\n", strerror(errno));
+		return 1;
+	}
+	if (!verify(data, size, "after mprotect()"))
+		return 1;
+	if (mprotect(page, B_PAGE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+		fprintf(stderr, "mprotect() failed: %s\n", strerror(errno));
+		return 1;
+	}
+
+	// Shrink the area so that it ends in the middle of a large page.
+	size -= kLargePageSize / 2;
+	status_t status = resize_area(area, size);
+	if (status != B_OK) {
+		fprintf(stderr, "resize_area() failed: %s\n", strerror(status));
+		return 1;
+	}
+	if (!verify(data, size, "after resize_area()"))
+		return 1;
+
+	// The protection of the whole area can be changed without splitting.
+	status = set_area_protection(area, B_READ_AREA);
+	if (status != B_OK) {
+		fprintf(stderr, "set_area_protection() failed: %s\n",
+			strerror(status));
+		return 1;
+	}
+	if (!verify(data, size, "after set_area_protection()"))
+		return 1;
+
+	printf("large pages:  %8" B_PRId64 " usecs\n", random_access(data, size));
+	delete_area(area);
+
+	area = create_test_area(size, 0, &data);
+	if (area < 0) {
+		fprintf(stderr, "Failed to create area: %s\n", strerror(area));
+		return 1;
+	}
+
+	fill(data, size);
+	printf("normal pages: %8" B_PRId64 " usecs\n", random_access(data, size));
+	delete_area(area);
+
+	printf("All tests passed.\n");
+	return 0;
+}
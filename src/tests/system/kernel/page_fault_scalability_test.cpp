@@ -0,0 +1,109 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how many page faults on fresh anonymous memory the system can
+	serve per second, with an increasing number of threads faulting in
+	parallel. Every fault needs a new page from the page allocator, and
+	every deleted area gives its pages back.
+	Usage: page_fault_scalability_test [threads] [pages] [seconds]
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static const int32 kMaxThreads = 64;
+
+static int32 sPages = 1024;
+static bigtime_t sDuration = 2000000;
+static int32 sQuit;
+
+
+static status_t
+fault_thread(void* _count)
+{
+	int64* _faults = (int64*)_count;
+	size_t size = (size_t)sPages * B_PAGE_SIZE;
+	int64 faults = 0;
+
+	while (atomic_get(&sQuit) == 0) {
+		uint8* address;
+		area_id area = create_area("page faults", (void**)&address,
+			B_ANY_ADDRESS, size, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+		if (area < 0) {
+			fprintf(stderr, "Could not create area: %s\n", strerror(area));
+			exit(1);
+		}
+
+		for (int32 i = 0; i < sPages; i++)
+			address[i * B_PAGE_SIZE] = 1;
+
+		delete_area(area);
+		faults += sPages;
+	}
+
+	*_faults = faults;
+	return B_OK;
+}
+
+
+static int64
+run(int32 numThreads)
+{
+	thread_id threads[kMaxThreads];
+	int64 faults[kMaxThreads];
+
+	sQuit = 0;
+
+	for (int32 i = 0; i < numThreads; i++) {
+		threads[i] = spawn_thread(fault_thread, "fault thread",
+			B_NORMAL_PRIORITY, &faults[i]);
+		resume_thread(threads[i]);
+	}
+
+	snooze(sDuration);
+	atomic_set(&sQuit, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < numThreads; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		total += faults[i];
+	}
+
+	return total * 1000000 / sDuration;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = info.cpu_count;
+	if (argc > 1)
+		maxThreads = atoi(argv[1]);
+	maxThreads = min_c(max_c(maxThreads, 1), kMaxThreads);
+	if (argc > 2)
+		sPages = max_c(atoi(argv[2]), 1);
+	if (argc > 3)
+		sDuration = max_c(atoi(argv[3]), 1) * 1000000LL;
+
+	printf("%" B_PRId32 " CPUs, %" B_PRId32 " pages per area\n",
+		info.cpu_count, sPages);
+
+	for (int32 numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		printf("%3" B_PRId32 " threads: %10" B_PRId64 " faults per second\n",
+			numThreads, run(numThreads));
+	}
+
+	return 0;
+}
@@ -1,14 +1,140 @@
 /*
  * Copyright 2008, Ingo Weinhold, ingo_weinhold@gmx.de.
+ * Copyright 2026, Haiku, Inc. All rights reserved.
  * Distributed under the terms of the MIT License.
  */
 
+
+/*!	Measures the time needed to resolve paths of increasing depth, and how
+	the number of resolved paths per second scales with the number of
+	threads doing it at the same time.
+	Before that, it checks that the lookups answered from a completely read
+	directory are still correct.
+	Usage: path_resolution_test [max threads] [seconds]
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <OS.h>
 
 
+static const int32 kMaxThreads = 64;
+
+static const char* const kPaths[] = {
+	"/",
+	"/boot",
+	"/boot/develop",
+	"/boot/develop/headers",
+	"/boot/develop/headers/posix",
+	"/boot/develop/headers/posix/sys",
+	"/boot/develop/headers/posix/sys/stat.h",
+	"/boot/develop/headers/posix/sys/missing.h",
+		// doesn't exist, but is answered by the entry cache, since the
+		// directory has been read (cf. read_directory())
+	NULL
+};
+
+static bigtime_t sDuration = 2000000;
+static int32 sQuit;
+
+
+static void
+read_directory(const char* path)
+{
+	DIR* dir = opendir(path);
+	if (dir == NULL)
+		return;
+
+	while (readdir(dir) != NULL)
+		;
+
+	closedir(dir);
+}
+
+
+static bool
+check_lstat(const char* path, int expectedError)
+{
+	struct stat st;
+	int error = lstat(path, &st) == 0 ? 0 : errno;
+	if (error == expectedError)
+		return true;
+
+	fprintf(stderr, "lstat(\"%s\") returned \"%s\", expected \"%s\"\n",
+		path, strerror(error), strerror(expectedError));
+	return false;
+}
+
+
+static bool
+create_file(const char* path)
+{
+	int fd = open(path, O_CREAT | O_WRONLY | O_EXCL, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", path,
+			strerror(errno));
+		return false;
+	}
+
+	close(fd);
+	return true;
+}
+
+
+/*!	Checks that a directory that has been read completely answers lookups of
+	missing entries with ENOENT, and still finds the entries that are created
+	or removed afterwards.
+*/
+static bool
+check_complete_directory()
+{
+	char directory[B_PATH_NAME_LENGTH];
+	snprintf(directory, sizeof(directory), "/tmp/path_resolution_test-%"
+		B_PRId32, find_thread(NULL));
+
+	char existing[B_PATH_NAME_LENGTH];
+	char missing[B_PATH_NAME_LENGTH];
+	char created[B_PATH_NAME_LENGTH];
+	snprintf(existing, sizeof(existing), "%s/existing", directory);
+	snprintf(missing, sizeof(missing), "%s/missing", directory);
+	snprintf(created, sizeof(created), "%s/created", directory);
+
+	if (mkdir(directory, 0755) != 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", directory,
+			strerror(errno));
+		return false;
+	}
+
+	bool success = create_file(existing);
+	if (success) {
+		read_directory(directory);
+
+		success = check_lstat(existing, 0)
+			&& check_lstat(missing, ENOENT)
+			&& check_lstat(missing, ENOENT)
+				// the second time, it's answered by the entry cache
+			&& create_file(created)
+			&& check_lstat(created, 0)
+			&& unlink(created) == 0
+			&& check_lstat(created, ENOENT);
+	}
+
+	unlink(created);
+	unlink(existing);
+	rmdir(directory);
+
+	return success;
+}
+
+
 static void
 time_lstat(const char* path)
 {
@@ -27,22 +153,90 @@ time_lstat(const char* path)
 }
 
 
+static status_t
+lstat_thread(void* _calls)
+{
+	int64 calls = 0;
+
+	while (atomic_get(&sQuit) == 0) {
+		for (int32 i = 0; kPaths[i] != NULL; i++) {
+			struct stat st;
+			lstat(kPaths[i], &st);
+		}
+		calls++;
+	}
+
+	*(int64*)_calls = calls;
+	return B_OK;
+}
+
+
+static int64
+run_threads(int32 threadCount)
+{
+	thread_id threads[kMaxThreads];
+	int64 calls[kMaxThreads];
+
+	sQuit = 0;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(lstat_thread, "lstat", B_NORMAL_PRIORITY,
+			&calls[i]);
+		resume_thread(threads[i]);
+	}
+
+	snooze(sDuration);
+	atomic_set(&sQuit, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		total += calls[i];
+	}
+
+	int32 pathCount = 0;
+	while (kPaths[pathCount] != NULL)
+		pathCount++;
+
+	return total * pathCount * 1000000 / sDuration;
+}
+
+
 int
-main()
-{
-	const char* const paths[] = {
-		"/",
-		"/boot",
-		"/boot/develop",
-		"/boot/develop/headers",
-		"/boot/develop/headers/posix",
-		"/boot/develop/headers/posix/sys",
-		"/boot/develop/headers/posix/sys/stat.h",
-		NULL
-	};
-
-	for (int32 i = 0; paths[i] != NULL; i++)
-		time_lstat(paths[i]);
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = min_c(info.cpu_count * 2, kMaxThreads);
+	if (argc > 1)
+		maxThreads = min_c(max_c(atoi(argv[1]), 1), kMaxThreads);
+	if (argc > 2)
+		sDuration = max_c(atoi(argv[2]), 1) * 1000000LL;
+
+	if (!check_complete_directory()) {
+		fprintf(stderr, "Lookups in a completely read directory are "
+			"wrong!\n");
+		return 1;
+	}
+
+	read_directory("/boot/develop/headers/posix/sys");
+
+	for (int32 i = 0; kPaths[i] != NULL; i++)
+		time_lstat(kPaths[i]);
+
+	printf("\nall paths, %" B_PRIu32 " CPUs:\n", info.cpu_count);
+
+	int64 baseline = 0;
+	for (int32 threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+		int64 callsPerSecond = run_threads(threadCount);
+		if (baseline == 0)
+			baseline = max_c(callsPerSecond, 1);
+
+		printf("%3" B_PRId32 " threads: %10" B_PRId64 " lstat()/s (%5.2fx)\n",
+			threadCount, callsPerSecond, (double)callsPerSecond / baseline);
+	}
 
 	return 0;
 }
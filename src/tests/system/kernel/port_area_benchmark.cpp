@@ -0,0 +1,194 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares copying port messages with moving their data as areas via
+	_kern_write_port_area_etc() and _kern_read_port_area_etc(). For each
+	message size the throughput of a stream of messages and the round trip
+	latency of a single message, answered by an empty reply, are measured.
+	Sender and receiver touch every cache line of the message, so that the
+	page faults of the area mode are accounted for.
+	Usage: port_area_benchmark [max size in KB]
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+#include <syscalls.h>
+
+
+static const size_t kCopyLimit = 256 * 1024;
+static const size_t kStreamBytes = 256 * 1024 * 1024;
+static const int32 kQueueLength = 16;
+static const int32 kRoundTrips = 200;
+static const int32 kQuitCode = 'quit';
+
+struct benchmark {
+	port_id		port;
+	port_id		replyPort;
+	size_t		size;
+	bool		useAreas;
+	bool		reply;
+};
+
+
+static uint32
+touch(const uint8* data, size_t size)
+{
+	uint32 sum = 0;
+	for (size_t offset = 0; offset < size; offset += 64)
+		sum += data[offset];
+	return sum;
+}
+
+
+static status_t
+send_message(benchmark& bench, uint8* buffer)
+{
+	if (!bench.useAreas) {
+		memset(buffer, 1, bench.size);
+		return write_port(bench.port, 0, buffer, bench.size);
+	}
+
+	uint8* address;
+	area_id area = create_area("port message", (void**)&address,
+		B_ANY_ADDRESS, (bench.size + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1),
+		B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (area < 0)
+		return area;
+
+	memset(address, 1, bench.size);
+
+	status_t status = _kern_write_port_area_etc(bench.port, 0, area,
+		bench.size, 0, 0);
+	if (status != B_OK)
+		delete_area(area);
+	return status;
+}
+
+
+static status_t
+receiver_thread(void* _bench)
+{
+	benchmark& bench = *(benchmark*)_bench;
+
+	uint8* buffer = (uint8*)malloc(bench.size);
+	uint32 sum = 0;
+
+	while (true) {
+		int32 code;
+		ssize_t bytes;
+		if (bench.useAreas) {
+			area_id area;
+			uint8* address;
+			bytes = _kern_read_port_area_etc(bench.port, &code, &area,
+				(void**)&address, 0, 0);
+			if (bytes > 0) {
+				sum += touch(address, bytes);
+				delete_area(area);
+			}
+		} else {
+			bytes = read_port(bench.port, &code, buffer, bench.size);
+			if (bytes > 0)
+				sum += touch(buffer, bytes);
+		}
+
+		if (bytes < 0 || code == kQuitCode)
+			break;
+
+		if (bench.reply)
+			write_port(bench.replyPort, 0, NULL, 0);
+	}
+
+	free(buffer);
+	return sum != 0 ? B_OK : B_ERROR;
+}
+
+
+/*!	Returns the throughput in MB/s, or the average round trip time in
+	microseconds, if \a reply is \c true.
+*/
+static int64
+run(size_t size, bool useAreas, bool reply)
+{
+	benchmark bench;
+	bench.port = create_port(kQueueLength, "port area benchmark");
+	bench.replyPort = create_port(1, "port area benchmark reply");
+	bench.size = size;
+	bench.useAreas = useAreas;
+	bench.reply = reply;
+
+	uint8* buffer = (uint8*)malloc(size);
+	if (bench.port < 0 || bench.replyPort < 0 || buffer == NULL) {
+		fprintf(stderr, "Could not set up benchmark\n");
+		exit(1);
+	}
+
+	thread_id thread = spawn_thread(receiver_thread, "receiver",
+		B_NORMAL_PRIORITY, &bench);
+	resume_thread(thread);
+
+	int32 count = reply ? kRoundTrips : max_c(kStreamBytes / size, 64);
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < count; i++) {
+		status_t status = send_message(bench, buffer);
+		if (status != B_OK) {
+			fprintf(stderr, "Could not send message: %s\n", strerror(status));
+			exit(1);
+		}
+
+		if (reply) {
+			int32 code;
+			read_port(bench.replyPort, &code, NULL, 0);
+		}
+	}
+
+	write_port(bench.port, kQuitCode, NULL, 0);
+
+	status_t returnValue;
+	wait_for_thread(thread, &returnValue);
+	bigtime_t time = max_c(system_time() - start, 1);
+
+	delete_port(bench.port);
+	delete_port(bench.replyPort);
+	free(buffer);
+
+	if (reply)
+		return time / count;
+	return (int64)size * count / time;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	size_t maxSize = 4 * 1024 * 1024;
+	if (argc > 1)
+		maxSize = max_c(atoi(argv[1]), 4) * 1024;
+
+	printf("    size   copy MB/s   area MB/s   copy us   area us\n");
+
+	for (size_t size = 4096; size <= maxSize; size *= 4) {
+		printf("%6" B_PRIuSIZE "KB", size / 1024);
+
+		if (size <= kCopyLimit)
+			printf(" %11" B_PRId64, run(size, false, false));
+		else
+			printf(" %11s", "-");
+		printf(" %11" B_PRId64, run(size, true, false));
+
+		if (size <= kCopyLimit)
+			printf(" %9" B_PRId64, run(size, false, true));
+		else
+			printf(" %9s", "-");
+		printf(" %9" B_PRId64 "\n", run(size, true, true));
+	}
+
+	return 0;
+}
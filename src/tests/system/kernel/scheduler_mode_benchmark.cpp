@@ -0,0 +1,168 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares the throughput of CPU bound parallel jobs in the different
+	scheduler modes. Every job repeatedly sums up its own buffer, which is
+	sized to fit into a typical L2 cache, so that both time slicing and
+	migrations show up in the results. A number of interfering threads of
+	higher priority wake up periodically and run for a short while, like
+	interactive or I/O completion threads would.
+	Usage: scheduler_mode_benchmark [jobs] [interferers] [seconds]
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+#include <scheduler.h>
+
+
+static const int32 kMaxThreads = 256;
+static const size_t kBufferSize = 256 * 1024;
+static const bigtime_t kInterferencePeriod = 1000;
+static const bigtime_t kInterferenceLength = 100;
+
+static const struct {
+	int32		mode;
+	const char*	name;
+} kModes[] = {
+	{ SCHEDULER_MODE_LOW_LATENCY, "low latency" },
+	{ SCHEDULER_MODE_POWER_SAVING, "power saving" },
+	{ SCHEDULER_MODE_BATCH, "batch" },
+};
+
+static bigtime_t sDuration = 5000000;
+static int32 sQuit;
+
+
+static status_t
+job_thread(void* _rounds)
+{
+	int64* _roundCount = (int64*)_rounds;
+
+	uint32* buffer = (uint32*)malloc(kBufferSize);
+	if (buffer == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	size_t count = kBufferSize / sizeof(uint32);
+	for (size_t i = 0; i < count; i++)
+		buffer[i] = i;
+
+	int64 rounds = 0;
+	uint32 sum = 0;
+	while (atomic_get(&sQuit) == 0) {
+		for (size_t i = 0; i < count; i++)
+			sum += buffer[i] ^ sum;
+		buffer[sum % count] = sum;
+		rounds++;
+	}
+
+	free(buffer);
+	*_roundCount = rounds;
+	return B_OK;
+}
+
+
+static status_t
+interfering_thread(void*)
+{
+	while (atomic_get(&sQuit) == 0) {
+		snooze(kInterferencePeriod);
+
+		bigtime_t end = system_time() + kInterferenceLength;
+		while (system_time() < end)
+			;
+	}
+
+	return B_OK;
+}
+
+
+static int64
+run(int32 jobCount, int32 interfererCount)
+{
+	thread_id threads[kMaxThreads];
+	thread_id interferers[kMaxThreads];
+	int64 rounds[kMaxThreads];
+
+	sQuit = 0;
+
+	for (int32 i = 0; i < jobCount; i++) {
+		threads[i] = spawn_thread(job_thread, "job", B_NORMAL_PRIORITY,
+			&rounds[i]);
+		resume_thread(threads[i]);
+	}
+
+	for (int32 i = 0; i < interfererCount; i++) {
+		interferers[i] = spawn_thread(interfering_thread, "interferer",
+			B_DISPLAY_PRIORITY, NULL);
+		resume_thread(interferers[i]);
+	}
+
+	snooze(sDuration);
+	atomic_set(&sQuit, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < jobCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		total += rounds[i];
+	}
+
+	for (int32 i = 0; i < interfererCount; i++) {
+		status_t returnValue;
+		wait_for_thread(interferers[i], &returnValue);
+	}
+
+	return total * 1000000 / sDuration;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 jobCount = info.cpu_count * 2;
+	int32 interfererCount = info.cpu_count;
+	if (argc > 1)
+		jobCount = atoi(argv[1]);
+	jobCount = min_c(max_c(jobCount, 1), kMaxThreads);
+	if (argc > 2)
+		interfererCount = min_c(max_c(atoi(argv[2]), 0), kMaxThreads);
+	if (argc > 3)
+		sDuration = max_c(atoi(argv[3]), 1) * 1000000LL;
+
+	printf("%" B_PRId32 " CPUs, %" B_PRId32 " jobs, %" B_PRId32
+		" interfering threads\n", info.cpu_count, jobCount, interfererCount);
+
+	int32 originalMode = get_scheduler_mode();
+	int64 baseline = 0;
+
+	for (size_t i = 0; i < sizeof(kModes) / sizeof(kModes[0]); i++) {
+		status_t status = set_scheduler_mode(kModes[i].mode);
+		if (status != B_OK) {
+			printf("%-12s: %s\n", kModes[i].name, strerror(status));
+			continue;
+		}
+
+		int64 throughput = run(jobCount, interfererCount);
+		if (baseline == 0)
+			baseline = throughput;
+
+		printf("%-12s: %10" B_PRId64 " rounds per second (%3" B_PRId64
+			"%%)\n", kModes[i].name, throughput,
+			baseline != 0 ? throughput * 100 / baseline : 0);
+	}
+
+	set_scheduler_mode(originalMode);
+	return 0;
+}
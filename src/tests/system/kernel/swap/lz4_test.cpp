@@ -0,0 +1,127 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Checks that the LZ4 codec used for the compressed swap pool restores
+	pages of different kinds of contents, and measures its speed and the
+	compression ratio it achieves for them.
+	Usage: lz4_test [pages]
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include <util/lz4.h>
+
+
+static const size_t kPageSize = 4096;
+
+
+static void
+fill_page(uint8* page, int32 kind, uint32& seed)
+{
+	for (size_t i = 0; i < kPageSize; i++) {
+		seed = seed * 1103515245 + 12345;
+
+		switch (kind) {
+			case 0:
+				// zeroes
+				page[i] = 0;
+				break;
+			case 1:
+				// sparse data, like a heap with mostly small numbers
+				page[i] = i % 16 < 4 ? (seed >> 24) & 0x0f : 0;
+				break;
+			case 2:
+				// text
+				page[i] = "the quick brown fox jumps over the lazy dog "
+					[(seed >> 16) % 8 + i % 37];
+				break;
+			default:
+				// random data
+				page[i] = seed >> 24;
+				break;
+		}
+	}
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 pageCount = 4096;
+	if (argc > 1)
+		pageCount = max_c(atoi(argv[1]), 1);
+
+	static const char* const kKinds[] = { "zeroes", "sparse", "text",
+		"random" };
+
+	uint8* pages = (uint8*)malloc(pageCount * kPageSize);
+	uint8* compressed = (uint8*)malloc(
+		pageCount * LZ4_COMPRESS_BOUND(kPageSize));
+	size_t* sizes = (size_t*)malloc(pageCount * sizeof(size_t));
+	void* workspace = malloc(LZ4_WORKSPACE_SIZE);
+	uint8 page[kPageSize];
+	if (pages == NULL || compressed == NULL || sizes == NULL
+		|| workspace == NULL) {
+		fprintf(stderr, "Out of memory!\n");
+		return 1;
+	}
+
+	for (int32 kind = 0; kind < 4; kind++) {
+		uint32 seed = kind;
+		for (int32 i = 0; i < pageCount; i++)
+			fill_page(pages + i * kPageSize, kind, seed);
+
+		bigtime_t compressTime = system_time();
+		uint64 totalSize = 0;
+		for (int32 i = 0; i < pageCount; i++) {
+			sizes[i] = lz4_compress(pages + i * kPageSize, kPageSize,
+				compressed + i * LZ4_COMPRESS_BOUND(kPageSize),
+				LZ4_COMPRESS_BOUND(kPageSize), workspace);
+			if (sizes[i] == 0) {
+				fprintf(stderr, "%s: compressing page %" B_PRId32 " failed\n",
+					kKinds[kind], i);
+				return 1;
+			}
+			totalSize += sizes[i];
+		}
+		compressTime = system_time() - compressTime;
+
+		bigtime_t decompressTime = system_time();
+		for (int32 i = 0; i < pageCount; i++) {
+			ssize_t size = lz4_decompress(
+				compressed + i * LZ4_COMPRESS_BOUND(kPageSize), sizes[i], page,
+				kPageSize);
+			if (size != (ssize_t)kPageSize
+				|| memcmp(page, pages + i * kPageSize, kPageSize) != 0) {
+				fprintf(stderr, "%s: page %" B_PRId32 " was not restored\n",
+					kKinds[kind], i);
+				return 1;
+			}
+		}
+		decompressTime = system_time() - decompressTime;
+
+		// a truncated page must be rejected
+		if (lz4_decompress(compressed, sizes[0] - 1, page, kPageSize)
+				== (ssize_t)kPageSize) {
+			fprintf(stderr, "%s: truncated page was accepted\n",
+				kKinds[kind]);
+			return 1;
+		}
+
+		uint64 bytes = (uint64)pageCount * kPageSize;
+		printf("%-7s ratio %5.2f, compress %6" B_PRIu64 " MB/s, decompress "
+			"%6" B_PRIu64 " MB/s\n", kKinds[kind], (double)bytes / totalSize,
+			bytes / max_c(compressTime, 1), bytes / max_c(decompressTime, 1));
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A malloc() benchmark in the style of Hoard's cache-scratch: the main
+	thread allocates a small object for every thread, which frees it, and
+	then repeatedly allocates an object of the same size and writes to it.
+	An allocator that hands memory freed by one thread out to another one
+	makes the threads write to the same cache lines ("passive false
+	sharing"), which doesn't scale at all.
+	With "-a", every thread only uses objects it allocated itself, which
+	shows active false sharing instead (cache-thrash).
+	Usage: cache_scratch [-a] [-t <threads>] [-i <iterations>]
+		[-r <repetitions>] [-s <size>]
+*/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static int32 sIterations = 1000;
+static int32 sRepetitions = 10000;
+static size_t sObjectSize = 8;
+
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: cache_scratch [-a] [-t <threads>] "
+		"[-i <iterations>] [-r <repetitions>] [-s <size>]\n");
+	exit(1);
+}
+
+
+static void*
+worker(void* object)
+{
+	// the object allocated by the main thread is freed right away
+	free(object);
+
+	for (int32 iteration = 0; iteration < sIterations; iteration++) {
+		volatile char* buffer = (volatile char*)malloc(sObjectSize);
+
+		for (int32 repetition = 0; repetition < sRepetitions; repetition++) {
+			for (size_t i = 0; i < sObjectSize; i++) {
+				buffer[i] = (char)i;
+				char value = buffer[i];
+				buffer[i] = value + 1;
+			}
+		}
+
+		free((void*)buffer);
+	}
+
+	return NULL;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = 4;
+	bool threadObjects = false;
+
+	for (int argi = 1; argi < argc; argi++) {
+		if (strcmp(argv[argi], "-a") == 0) {
+			threadObjects = true;
+			continue;
+		}
+
+		if (argi + 1 >= argc)
+			usage();
+
+		if (strcmp(argv[argi], "-t") == 0)
+			threadCount = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-i") == 0)
+			sIterations = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-r") == 0)
+			sRepetitions = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-s") == 0)
+			sObjectSize = strtoul(argv[argi + 1], NULL, 0);
+		else
+			usage();
+		argi++;
+	}
+
+	if (threadCount <= 0 || sIterations <= 0 || sRepetitions <= 0
+		|| sObjectSize == 0) {
+		usage();
+	}
+
+	pthread_t* threads = new pthread_t[threadCount];
+
+	// allocate the objects in one go, so that they are likely to share
+	// cache lines
+	char** objects = new char*[threadCount];
+	for (int32 i = 0; i < threadCount; i++)
+		objects[i] = threadObjects ? NULL : (char*)malloc(sObjectSize);
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < threadCount; i++)
+		pthread_create(&threads[i], NULL, &worker, objects[i]);
+	for (int32 i = 0; i < threadCount; i++)
+		pthread_join(threads[i], NULL);
+
+	bigtime_t time = system_time() - start;
+
+	printf("%s: %" B_PRId32 " threads, %" B_PRId32 " iterations of %"
+		B_PRId32 " writes to %" B_PRIuSIZE " bytes in %" B_PRId64 " usecs\n",
+		threadObjects ? "cache-thrash" : "cache-scratch", threadCount,
+		sIterations, sRepetitions, sObjectSize, time);
+
+	delete[] objects;
+	delete[] threads;
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A malloc() benchmark in the style of Larson and Krishnan's server
+	simulation: every thread owns an array of objects of random sizes, and
+	keeps replacing random ones with new objects. After a number of
+	replacements, a thread passes its array on to a new thread and exits, so
+	that objects get freed by other threads than the ones that allocated them.
+	Usage: larson [-t <threads>] [-r <rounds>] [-n <objects>]
+		[-o <operations per round>] [-m <min size>] [-M <max size>]
+*/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+struct thread_data {
+	char**		objects;
+	int32		rounds_left;
+	uint32		seed;
+	int64		operations;
+};
+
+
+static int32 sObjectCount = 1000;
+static int32 sOperationsPerRound = 10000;
+static size_t sMinSize = 10;
+static size_t sMaxSize = 500;
+
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: larson [-t <threads>] [-r <rounds>] "
+		"[-n <objects>] [-o <operations per round>] [-m <min size>] "
+		"[-M <max size>]\n");
+	exit(1);
+}
+
+
+static inline uint32
+next_random(uint32& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+
+static inline size_t
+random_size(uint32& seed)
+{
+	return sMinSize + next_random(seed) % (sMaxSize - sMinSize + 1);
+}
+
+
+static void*
+worker(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+
+	for (int32 i = 0; i < sOperationsPerRound; i++) {
+		int32 index = next_random(data->seed) % sObjectCount;
+		free(data->objects[index]);
+
+		size_t size = random_size(data->seed);
+		data->objects[index] = (char*)malloc(size);
+		data->objects[index][size - 1] = (char)i;
+	}
+
+	data->operations += sOperationsPerRound;
+
+	if (data->rounds_left > 1) {
+		// hand the objects over to a new thread
+		data->rounds_left--;
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, &worker, data) == 0)
+			pthread_detach(thread);
+		else
+			atomic_set(&data->rounds_left, 0);
+	} else
+		atomic_set(&data->rounds_left, 0);
+
+	return NULL;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = 4;
+	int32 rounds = 20;
+
+	for (int argi = 1; argi < argc; argi += 2) {
+		if (argi + 1 >= argc)
+			usage();
+
+		if (strcmp(argv[argi], "-t") == 0)
+			threadCount = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-r") == 0)
+			rounds = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-n") == 0)
+			sObjectCount = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-o") == 0)
+			sOperationsPerRound = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-m") == 0)
+			sMinSize = strtoul(argv[argi + 1], NULL, 0);
+		else if (strcmp(argv[argi], "-M") == 0)
+			sMaxSize = strtoul(argv[argi + 1], NULL, 0);
+		else
+			usage();
+	}
+
+	if (threadCount <= 0 || rounds <= 0 || sObjectCount <= 0
+		|| sOperationsPerRound <= 0 || sMinSize == 0 || sMaxSize < sMinSize)
+		usage();
+
+	thread_data* data = new thread_data[threadCount];
+
+	// the objects are initially allocated by the main thread
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].objects = new char*[sObjectCount];
+		data[i].rounds_left = rounds;
+		data[i].seed = i + 1;
+		data[i].operations = 0;
+
+		for (int32 j = 0; j < sObjectCount; j++)
+			data[i].objects[j] = (char*)malloc(random_size(data[i].seed));
+	}
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < threadCount; i++) {
+		pthread_t thread;
+		pthread_create(&thread, NULL, &worker, &data[i]);
+		pthread_detach(thread);
+	}
+
+	// wait until all threads have finished their rounds
+	while (true) {
+		bool done = true;
+		for (int32 i = 0; i < threadCount; i++) {
+			if (atomic_get(&data[i].rounds_left) > 0)
+				done = false;
+		}
+		if (done)
+			break;
+
+		snooze(1000);
+	}
+
+	bigtime_t time = system_time() - start;
+
+	int64 operations = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		operations += data[i].operations;
+
+		for (int32 j = 0; j < sObjectCount; j++)
+			free(data[i].objects[j]);
+		delete[] data[i].objects;
+	}
+
+	printf("larson: %" B_PRId32 " threads, %" B_PRId64 " operations of %"
+		B_PRIuSIZE " - %" B_PRIuSIZE " bytes in %" B_PRId64 " usecs, %"
+		B_PRId64 " operations/s\n", threadCount, operations, sMinSize,
+		sMaxSize, time, operations * 1000000 / (time > 0 ? time : 1));
+
+	delete[] data;
+	return 0;
+}
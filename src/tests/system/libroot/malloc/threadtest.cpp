@@ -0,0 +1,104 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A malloc() benchmark in the style of Hoard's threadtest: every thread
+	repeatedly allocates a number of objects, and frees them again. Since no
+	memory is shared between the threads, an allocator should scale linearly
+	with their number.
+	Usage: threadtest [-t <threads>] [-i <iterations>] [-n <objects>]
+		[-s <size>]
+*/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static int32 sIterations = 50;
+static int32 sObjectCount = 30000;
+static size_t sObjectSize = 8;
+
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: threadtest [-t <threads>] [-i <iterations>] "
+		"[-n <objects>] [-s <size>]\n");
+	exit(1);
+}
+
+
+static void*
+worker(void*)
+{
+	char** objects = (char**)malloc(sObjectCount * sizeof(char*));
+	if (objects == NULL)
+		return NULL;
+
+	for (int32 iteration = 0; iteration < sIterations; iteration++) {
+		for (int32 i = 0; i < sObjectCount; i++) {
+			objects[i] = (char*)malloc(sObjectSize);
+			objects[i][0] = (char)i;
+		}
+
+		for (int32 i = 0; i < sObjectCount; i++)
+			free(objects[i]);
+	}
+
+	free(objects);
+	return NULL;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = 4;
+
+	for (int argi = 1; argi < argc; argi += 2) {
+		if (argi + 1 >= argc)
+			usage();
+
+		if (strcmp(argv[argi], "-t") == 0)
+			threadCount = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-i") == 0)
+			sIterations = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-n") == 0)
+			sObjectCount = atoi(argv[argi + 1]);
+		else if (strcmp(argv[argi], "-s") == 0)
+			sObjectSize = strtoul(argv[argi + 1], NULL, 0);
+		else
+			usage();
+	}
+
+	if (threadCount <= 0 || sIterations <= 0 || sObjectCount <= 0
+		|| sObjectSize == 0) {
+		usage();
+	}
+
+	pthread_t* threads = new pthread_t[threadCount];
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < threadCount; i++)
+		pthread_create(&threads[i], NULL, &worker, NULL);
+	for (int32 i = 0; i < threadCount; i++)
+		pthread_join(threads[i], NULL);
+
+	bigtime_t time = system_time() - start;
+	int64 operations = (int64)threadCount * sIterations * sObjectCount;
+
+	printf("threadtest: %" B_PRId32 " threads, %" B_PRId64 " malloc()/free() "
+		"pairs of %" B_PRIuSIZE " bytes in %" B_PRId64 " usecs, %" B_PRId64
+		" pairs/s\n", threadCount, operations, sObjectSize, time,
+		operations * 1000000 / (time > 0 ? time : 1));
+
+	delete[] threads;
+	return 0;
+}
@@ -7,6 +7,9 @@
 #include "fssh.h"
 
 #include "command_checkfs.h"
+#include "command_defrag.h"
+#include "command_journalbench.h"
+#include "command_querybench.h"
 
 
 namespace FSShell {
@@ -17,6 +20,12 @@ register_additional_commands()
 {
 	CommandManager::Default()->AddCommand(command_checkfs, "checkfs",
 		"check file system");
+	CommandManager::Default()->AddCommand(command_defrag, "defrag",
+		"defragment files and directories");
+	CommandManager::Default()->AddCommand(command_journalbench, "journalbench",
+		"benchmark small metadata updates");
+	CommandManager::Default()->AddCommand(command_querybench, "querybench",
+		"benchmark queries on generated files");
 }
 
 
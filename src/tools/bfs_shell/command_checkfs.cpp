@@ -125,6 +125,9 @@ command_checkfs(int argc, const char* const* argv)
 		" array blocks, %lld)\n", result.stats.double_indirect_block_runs,
 		result.stats.double_indirect_array_blocks,
 		result.stats.blocks_in_double_indirect * result.stats.block_size);
+	fssh_dprintf("\tfragmented nodes\t\t%" B_PRIu64 " (%" B_PRIu64
+		" fragments)\n", result.stats.fragmented_nodes,
+		result.stats.fragments);
 
 	if (result.status == B_ENTRY_NOT_FOUND)
 		result.status = B_OK;
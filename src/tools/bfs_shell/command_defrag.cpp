@@ -0,0 +1,150 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_dirent.h"
+#include "fssh_stat.h"
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+struct defrag_stats {
+	uint64	nodes;
+	uint64	fragmented_nodes;
+	uint64	fragments;
+	uint64	new_fragments;
+	uint64	failed;
+};
+
+
+static void
+defragment_node(const char* path, int fd, uint32 flags, bool verbose,
+	defrag_stats& stats)
+{
+	struct defragment_control control;
+	memset(&control, 0, sizeof(control));
+	control.magic = BFS_IOCTL_DEFRAGMENT_MAGIC;
+	control.flags = flags;
+
+	stats.nodes++;
+
+	status_t status = _kern_ioctl(fd, BFS_IOCTL_DEFRAGMENT, &control,
+		sizeof(control));
+	if (status != B_OK) {
+		fssh_dprintf("%s: %s\n", path, strerror(status));
+		stats.failed++;
+		return;
+	}
+	if (control.fragments <= 1)
+		return;
+
+	stats.fragmented_nodes++;
+	stats.fragments += control.fragments;
+	stats.new_fragments += control.new_fragments;
+
+	if (verbose) {
+		fssh_dprintf("%s: %" B_PRIu32 " fragments", path, control.fragments);
+		if (control.new_fragments != control.fragments)
+			fssh_dprintf(", now %" B_PRIu32, control.new_fragments);
+		fssh_dprintf("\n");
+	}
+}
+
+
+static void
+defragment_directory(const char* path, uint32 flags, bool verbose,
+	defrag_stats& stats)
+{
+	int directory = _kern_open_dir(-1, path);
+	if (directory < 0) {
+		fssh_dprintf("%s: %s\n", path, strerror(directory));
+		stats.failed++;
+		return;
+	}
+
+	defragment_node(path, directory, flags, verbose, stats);
+
+	char buffer[sizeof(struct dirent) + B_FILE_NAME_LENGTH];
+	struct dirent* entry = (struct dirent*)buffer;
+
+	while (_kern_read_dir(directory, entry, sizeof(buffer), 1) == 1) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+
+		char entryPath[B_PATH_NAME_LENGTH];
+		snprintf(entryPath, sizeof(entryPath), "%s/%s", path, entry->d_name);
+
+		struct stat st;
+		if (_kern_read_stat(-1, entryPath, false, &st, sizeof(st)) != B_OK)
+			continue;
+
+		if (S_ISDIR(st.st_mode))
+			defragment_directory(entryPath, flags, verbose, stats);
+		else if (S_ISREG(st.st_mode)) {
+			int fd = _kern_open(-1, entryPath, O_RDONLY, 0);
+			if (fd < 0) {
+				fssh_dprintf("%s: %s\n", entryPath, strerror(fd));
+				stats.failed++;
+				continue;
+			}
+
+			defragment_node(entryPath, fd, flags, verbose, stats);
+			_kern_close(fd);
+		}
+	}
+
+	_kern_close(directory);
+}
+
+
+fssh_status_t
+command_defrag(int argc, const char* const* argv)
+{
+	uint32 flags = 0;
+	bool verbose = false;
+	const char* path = "/myfs";
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n"))
+			flags |= BFS_DEFRAGMENT_COUNT_ONLY;
+		else if (!strcmp(argv[i], "-v"))
+			verbose = true;
+		else if (argv[i][0] != '-')
+			path = argv[i];
+		else {
+			fssh_dprintf("Usage: %s [-n] [-v] [<path>]\n"
+				"Moves the data of all files and directories below <path>\n"
+				"(default /myfs) into as few contiguous block runs as\n"
+				"possible.\n"
+				"  -n  Only report the fragmentation; don't move any data\n"
+				"  -v  List all fragmented files and directories\n", argv[0]);
+			return B_OK;
+		}
+	}
+
+	defrag_stats stats;
+	memset(&stats, 0, sizeof(stats));
+
+	bigtime_t start = system_time();
+	defragment_directory(path, flags, verbose, stats);
+
+	fssh_dprintf("%" B_PRIu64 " nodes, %" B_PRIu64 " fragmented with %"
+		B_PRIu64 " fragments", stats.nodes, stats.fragmented_nodes,
+		stats.fragments);
+	if ((flags & BFS_DEFRAGMENT_COUNT_ONLY) == 0)
+		fssh_dprintf(", %" B_PRIu64 " fragments left", stats.new_fragments);
+	fssh_dprintf(" (%" B_PRId64 " ms)\n", (system_time() - start) / 1000);
+
+	return stats.failed != 0 ? B_ERROR : B_OK;
+}
+
+
+}	// namespace FSShell
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_dirent.h"
+#include "fssh_stat.h"
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+
+
+namespace FSShell {
+
+
+static const char* kDirectory = "/myfs/journalbench";
+static const char* kAttribute = "journalbench:counter";
+static const int32 kMaxThreads = 64;
+
+
+struct bench_thread {
+	int32		index;
+	int32		operations;
+	bigtime_t	total_latency;
+	bigtime_t	max_latency;
+	status_t	status;
+};
+
+
+/*!	Performs a number of small metadata updates - creating a file, adding
+	an attribute to it, renaming, and finally removing it again - each of
+	which is a separate transaction.
+*/
+static status_t
+metadata_operation(int directory, int32 thread, int32 index)
+{
+	char name[B_FILE_NAME_LENGTH];
+	char newName[B_FILE_NAME_LENGTH];
+	snprintf(name, sizeof(name), "file-%" B_PRId32 "-%" B_PRId32, thread,
+		index);
+	snprintf(newName, sizeof(newName), "renamed-%" B_PRId32 "-%" B_PRId32,
+		thread, index);
+
+	int fd = _kern_open(directory, name, O_CREAT | O_WRONLY, 0644);
+	if (fd < 0)
+		return fd;
+
+	status_t status = B_OK;
+	int attribute = _kern_create_attr(fd, kAttribute, B_INT32_TYPE, O_WRONLY);
+	if (attribute >= 0) {
+		if (_kern_write(attribute, 0, &index, sizeof(index)) < 0)
+			status = B_IO_ERROR;
+		_kern_close(attribute);
+	} else
+		status = attribute;
+
+	_kern_close(fd);
+
+	if (status == B_OK)
+		status = _kern_rename(directory, name, directory, newName);
+	if (status == B_OK)
+		status = _kern_unlink(directory, newName);
+
+	return status;
+}
+
+
+static status_t
+bench_thread_entry(void* _data)
+{
+	bench_thread* data = (bench_thread*)_data;
+	data->total_latency = 0;
+	data->max_latency = 0;
+
+	int directory = _kern_open_dir(-1, kDirectory);
+	if (directory < 0)
+		return data->status = directory;
+
+	for (int32 i = 0; i < data->operations; i++) {
+		bigtime_t start = system_time();
+
+		data->status = metadata_operation(directory, data->index, i);
+		if (data->status != B_OK)
+			break;
+
+		bigtime_t latency = system_time() - start;
+		data->total_latency += latency;
+		if (latency > data->max_latency)
+			data->max_latency = latency;
+	}
+
+	_kern_close(directory);
+	return data->status;
+}
+
+
+static status_t
+run(int32 numThreads, int32 operations)
+{
+	bench_thread data[kMaxThreads];
+	thread_id threads[kMaxThreads];
+
+	// start from a clean state
+	_kern_sync();
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < numThreads; i++) {
+		data[i].index = i;
+		data[i].operations = operations;
+		data[i].status = B_OK;
+
+		threads[i] = spawn_thread(bench_thread_entry, "journalbench",
+			B_NORMAL_PRIORITY, &data[i]);
+		if (threads[i] < 0)
+			return threads[i];
+		resume_thread(threads[i]);
+	}
+
+	bigtime_t totalLatency = 0;
+	bigtime_t maxLatency = 0;
+	status_t status = B_OK;
+
+	for (int32 i = 0; i < numThreads; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+
+		if (data[i].status != B_OK)
+			status = data[i].status;
+		totalLatency += data[i].total_latency;
+		if (data[i].max_latency > maxLatency)
+			maxLatency = data[i].max_latency;
+	}
+
+	bigtime_t elapsed = system_time() - start;
+
+	// measure how long it takes to get the remaining log entries to disk
+	bigtime_t syncStart = system_time();
+	_kern_sync();
+	bigtime_t syncTime = system_time() - syncStart;
+
+	if (status != B_OK)
+		return status;
+
+	int64 total = (int64)numThreads * operations;
+	fssh_dprintf("%3" B_PRId32 " threads: %8" B_PRId64 " ops/s, latency avg %6"
+		B_PRId64 " usecs, max %8" B_PRId64 " usecs, sync %6" B_PRId64 " ms\n",
+		numThreads, total * 1000000 / max_c(elapsed, 1), totalLatency / total,
+		maxLatency, syncTime / 1000);
+	return B_OK;
+}
+
+
+fssh_status_t
+command_journalbench(int argc, const char* const* argv)
+{
+	if (argc > 3 || (argc == 2 && !strcmp(argv[1], "--help"))) {
+		fssh_dprintf("Usage: %s [<threads> [<operations>]]\n"
+			"Runs <operations> (default 1000) small metadata updates (create,\n"
+			"write attribute, rename, remove) in %s with 1, 2, 4, ... up to\n"
+			"<threads> (default 8) concurrent threads, and measures the\n"
+			"throughput, and the latency of each update.\n",
+			argv[0], kDirectory);
+		return B_OK;
+	}
+
+	int32 maxThreads = argc > 1 ? strtol(argv[1], NULL, 0) : 8;
+	int32 operations = argc > 2 ? strtol(argv[2], NULL, 0) : 1000;
+	if (maxThreads <= 0 || maxThreads > kMaxThreads || operations <= 0)
+		return B_BAD_VALUE;
+
+	struct stat st;
+	if (_kern_read_stat(-1, kDirectory, false, &st, sizeof(st)) != B_OK) {
+		status_t status = _kern_create_dir(-1, kDirectory, 0755);
+		if (status != B_OK)
+			return status;
+	}
+
+	for (int32 numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		status_t status = run(numThreads, operations);
+		if (status != B_OK) {
+			fssh_dprintf("Benchmark failed: %s\n", strerror(status));
+			return status;
+		}
+	}
+
+	return B_OK;
+}
+
+
+}	// namespace FSShell
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Times a set of queries over files with indexed attributes, once with
+	and once without prefetching the query candidates. The volume is
+	remounted before every run, so that each starts with an empty block
+	cache.
+	The FS shell cannot read blocks asynchronously, so the prefetched blocks
+	are read before the query continues; what can be seen is the effect of
+	reading the candidates sorted, and in larger chunks. The image file may
+	still be cached by the host, though.
+*/
+
+
+#include "fssh_dirent.h"
+#include "fssh_fs_info.h"
+#include "fssh_stat.h"
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+static const char* kVolumePath = "/myfs";
+static const char* kDirectory = "/myfs/querybench";
+static const char* kValueAttribute = "querybench:value";
+static const char* kGroupAttribute = "querybench:group";
+
+static const char* kQueries[] = {
+	"querybench:value==42",
+	"querybench:value<100",
+	"(querybench:group==3)&&(querybench:value<500)",
+	"(querybench:value>=900)||(querybench:group==7)",
+	"name==file-1*",
+	NULL
+};
+
+
+static status_t
+write_int32_attribute(int fd, const char* name, int32 value)
+{
+	int attribute = _kern_create_attr(fd, name, B_INT32_TYPE, O_WRONLY);
+	if (attribute < 0)
+		return attribute;
+
+	ssize_t written = _kern_write(attribute, 0, &value, sizeof(value));
+	_kern_close(attribute);
+
+	if (written < 0)
+		return written;
+	return written == sizeof(value) ? B_OK : B_IO_ERROR;
+}
+
+
+/*!	Creates \a count files with indexed attributes in kDirectory, unless
+	the directory already exists.
+*/
+static status_t
+create_files(dev_t volume, int32 count)
+{
+	struct stat st;
+	if (_kern_read_stat(-1, kDirectory, false, &st, sizeof(st)) == B_OK) {
+		fssh_dprintf("Using existing files in %s\n", kDirectory);
+		return B_OK;
+	}
+
+	status_t status = _kern_create_index(volume, kValueAttribute,
+		B_INT32_TYPE, 0);
+	if (status == B_OK) {
+		status = _kern_create_index(volume, kGroupAttribute, B_INT32_TYPE,
+			0);
+	}
+	if (status != B_OK && status != B_FILE_EXISTS)
+		return status;
+
+	status = _kern_create_dir(-1, kDirectory, 0755);
+	if (status != B_OK)
+		return status;
+
+	int directory = _kern_open_dir(-1, kDirectory);
+	if (directory < 0)
+		return directory;
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < count; i++) {
+		char name[B_FILE_NAME_LENGTH];
+		snprintf(name, sizeof(name), "file-%" B_PRId32, i);
+
+		int fd = _kern_open(directory, name, O_CREAT | O_WRONLY, 0644);
+		if (fd < 0) {
+			status = fd;
+			break;
+		}
+
+		status = write_int32_attribute(fd, kValueAttribute, i % 1000);
+		if (status == B_OK)
+			status = write_int32_attribute(fd, kGroupAttribute, i % 10);
+
+		_kern_close(fd);
+		if (status != B_OK)
+			break;
+
+		if ((i + 1) % 1000 == 0)
+			fssh_dprintf("%9" B_PRId32 " files created\x1b[1A\n", i + 1);
+	}
+
+	_kern_close(directory);
+
+	if (status == B_OK) {
+		fssh_dprintf("Created %" B_PRId32 " files in %" B_PRId64 " ms\n",
+			count, (system_time() - start) / 1000);
+	}
+	return status;
+}
+
+
+/*!	Mounts the volume again, so that none of its blocks are cached anymore,
+	and turns prefetching query candidates on or off. \a volume is set to
+	the new ID of the volume.
+*/
+static status_t
+remount(dev_t& volume, bool prefetch)
+{
+	fs_info info;
+	status_t status = _kern_read_fs_info(volume, &info);
+	if (status != B_OK)
+		return status;
+
+	status = _kern_unmount(kVolumePath, 0);
+	if (status != B_OK)
+		return status;
+
+	volume = _kern_mount(kVolumePath, info.device_name, info.fsh_name, 0,
+		NULL, 0);
+	if (volume < 0)
+		return volume;
+
+	int fd = _kern_open_dir(-1, kVolumePath);
+	if (fd < 0)
+		return fd;
+
+	int32 value = prefetch ? 1 : 0;
+	status = _kern_ioctl(fd, BFS_IOCTL_PREFETCH_QUERIES, &value,
+		sizeof(value));
+	_kern_close(fd);
+	return status;
+}
+
+
+/*!	Runs the \a query \a runs times with a cold cache, and returns the
+	average time it took in \a _time.
+*/
+static status_t
+run_query(dev_t& volume, const char* query, int32 runs, bool prefetch,
+	int64& _matches, bigtime_t& _time)
+{
+	bigtime_t total = 0;
+	int64 matches = 0;
+
+	for (int32 run = 0; run < runs; run++) {
+		status_t status = remount(volume, prefetch);
+		if (status != B_OK)
+			return status;
+
+		bigtime_t start = system_time();
+
+		int fd = _kern_open_query(volume, query, strlen(query), 0, -1, -1);
+		if (fd < 0)
+			return fd;
+
+		char buffer[sizeof(struct dirent) + B_FILE_NAME_LENGTH];
+		struct dirent* entry = (struct dirent*)buffer;
+		matches = 0;
+
+		while (_kern_read_dir(fd, entry, sizeof(buffer), 1) == 1)
+			matches++;
+
+		_kern_close(fd);
+		total += system_time() - start;
+	}
+
+	_matches = matches;
+	_time = total / runs;
+	return B_OK;
+}
+
+
+fssh_status_t
+command_querybench(int argc, const char* const* argv)
+{
+	if (argc > 3 || (argc == 2 && !strcmp(argv[1], "--help"))) {
+		fssh_dprintf("Usage: %s [<files> [<runs>]]\n"
+			"Creates <files> files (default 100000) with indexed attributes\n"
+			"in %s, if it doesn't exist yet, and measures how long a number\n"
+			"of queries take on average over <runs> runs (default 5), with\n"
+			"and without prefetching the query candidates. The volume is\n"
+			"remounted before each run, so that all runs start with a cold\n"
+			"block cache; the host may still cache the image file, though.\n",
+			argv[0], kDirectory);
+		return B_OK;
+	}
+
+	int32 count = argc > 1 ? strtol(argv[1], NULL, 0) : 100000;
+	int32 runs = argc > 2 ? strtol(argv[2], NULL, 0) : 5;
+	if (count <= 0 || runs <= 0)
+		return B_BAD_VALUE;
+
+	struct stat st;
+	status_t status = _kern_read_stat(-1, kVolumePath, false, &st,
+		sizeof(st));
+	if (status != B_OK)
+		return status;
+
+	status = create_files(st.st_dev, count);
+	if (status != B_OK) {
+		fssh_dprintf("Creating the files failed: %s\n", strerror(status));
+		return status;
+	}
+
+	// write back the new files first, so that this doesn't skew the results
+	_kern_sync();
+
+	dev_t volume = st.st_dev;
+	fssh_dprintf(" matches  usecs/query  with prefetch\n");
+
+	for (int32 i = 0; kQueries[i] != NULL; i++) {
+		int64 matches;
+		bigtime_t time;
+		bigtime_t prefetchTime;
+		status = run_query(volume, kQueries[i], runs, false, matches, time);
+		if (status == B_OK) {
+			status = run_query(volume, kQueries[i], runs, true, matches,
+				prefetchTime);
+		}
+		if (status != B_OK) {
+			fssh_dprintf("Query \"%s\" failed: %s\n", kQueries[i],
+				strerror(status));
+			return status;
+		}
+
+		fssh_dprintf("%8" B_PRId64 " %12" B_PRId64 " %14" B_PRId64 "  %s\n",
+			matches, time, prefetchTime, kQueries[i]);
+	}
+
+	return B_OK;
+}
+
+
+}	// namespace FSShell
@@ -1703,6 +1703,73 @@ fssh_block_cache_get(void* _cache, fssh_off_t blockNumber)
 }
 
 
+/*!	There is no asynchronous I/O in the FS shell, so the blocks are read
+	right away. Adjacent blocks that are not in the cache yet are read in a
+	single request, though.
+*/
+fssh_status_t
+fssh_block_cache_prefetch(void* _cache, fssh_off_t blockNumber,
+	fssh_size_t numBlocks)
+{
+	block_cache* cache = (block_cache*)_cache;
+	MutexLocker locker(&cache->lock);
+
+	if (blockNumber < 0 || blockNumber + (fssh_off_t)numBlocks
+			> cache->max_blocks)
+		return FSSH_B_BAD_VALUE;
+
+	// don't push out the blocks we have just read
+	if (numBlocks > kMaxBlockCount / 2)
+		numBlocks = kMaxBlockCount / 2;
+
+	fssh_off_t end = blockNumber + numBlocks;
+	while (blockNumber < end) {
+		if (hash_lookup(cache->hash, &blockNumber) != NULL) {
+			blockNumber++;
+			continue;
+		}
+
+		fssh_off_t runEnd = blockNumber + 1;
+		while (runEnd < end && hash_lookup(cache->hash, &runEnd) == NULL)
+			runEnd++;
+
+		fssh_size_t length = (runEnd - blockNumber) * cache->block_size;
+		uint8_t* buffer = (uint8_t*)malloc(length);
+		if (buffer == NULL)
+			return FSSH_B_NO_MEMORY;
+
+		if (fssh_read_pos(cache->fd, blockNumber * cache->block_size, buffer,
+				length) < (fssh_ssize_t)length) {
+			free(buffer);
+			return FSSH_B_IO_ERROR;
+		}
+
+		fssh_off_t start = blockNumber;
+		for (; blockNumber < runEnd; blockNumber++) {
+			cached_block* block = cache->NewBlock(blockNumber);
+			if (block == NULL)
+				break;
+
+			fssh_memcpy(block->current_data,
+				buffer + (blockNumber - start) * cache->block_size,
+				cache->block_size);
+			hash_insert(cache->hash, block);
+
+			// nobody uses the block yet
+			block->unused = true;
+			cache->unused_blocks.Add(block);
+		}
+
+		free(buffer);
+
+		if (blockNumber < runEnd)
+			return FSSH_B_NO_MEMORY;
+	}
+
+	return FSSH_B_OK;
+}
+
+
 /*!	Changes the internal status of a writable block to \a dirty. This can be
 	helpful in case you realize you don't need to change that block anymore
 	for whatever reason.
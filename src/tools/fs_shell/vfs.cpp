@@ -2285,6 +2285,14 @@ fssh_entry_cache_remove(fssh_dev_t mountID, fssh_ino_t dirID, const char* name)
 }
 
 
+extern "C" fssh_status_t
+fssh_entry_cache_enable_complete_directories(fssh_dev_t mountID)
+{
+	// We don't implement an entry cache in the FS shell.
+	return FSSH_B_OK;
+}
+
+
 //	#pragma mark - private VFS API
 //	Functions the VFS exports for other parts of the kernel
 